@@ -59,3 +59,9 @@ workspace("test")
         links({ "tess2", "glfw.3", "glew", "z", "jpeg", "openswf" })
         linkoptions { "-framework OpenGL", "-framework Cocoa", "-framework IOKit", "-framework CoreVideo" }
         files({ "test/03-simple-timeline/*.cpp", "test/00-common/*.cpp", "source/**.cpp" })
+
+    project("04-benchmark")
+        optimize( "On" )
+        links({ "tess2", "glfw.3", "glew", "z", "jpeg" })
+        linkoptions { "-framework OpenGL", "-framework Cocoa", "-framework IOKit", "-framework CoreVideo" }
+        files({ "test/04-benchmark/*.cpp", "test/00-common/*.cpp", "source/**.cpp" })
@@ -0,0 +1,325 @@
+#include "atlas.hpp"
+
+#include <algorithm>
+
+namespace openswf
+{
+    /// ATLAS PAGE
+    Rid AtlasPage::get_texture_rid(Render& render)
+    {
+        if( dirty )
+        {
+            texture.release();
+            dirty = false;
+        }
+
+        return texture.get(render,
+            bitmap->get_ptr(), bitmap->get_width(), bitmap->get_height(),
+            bitmap->get_format(), mipmap);
+    }
+
+    /// GRADIENT ATLAS
+    GradientAtlas* GradientAtlas::create()
+    {
+        return new (std::nothrow) GradientAtlas();
+    }
+
+    GradientSlot GradientAtlas::insert(const IBitmap& bitmap)
+    {
+        assert( bitmap.get_format() == TextureFormat::RGBA8 );
+
+        auto width = bitmap.get_width(), height = bitmap.get_height();
+        m_stats.fills ++;
+        m_stats.bytes_before += bitmap.get_size();
+
+        // gradients of same kind and control points sample to same texels
+        std::string key((const char*)bitmap.get_ptr(), bitmap.get_size());
+        key.append((const char*)&width, sizeof(width));
+        key.append((const char*)&height, sizeof(height));
+
+        auto found = m_slots.find(key);
+        if( found != m_slots.end() )
+            return found->second;
+
+        GradientSlot slot;
+        if( width == GradientPageWidth && height == 1 )
+        {
+            if( m_linear_page < 0 || m_linear_rows == GradientPageRows )
+            {
+                BitmapPtr pixels = BitmapRGBA8::create(GradientPageWidth, GradientPageRows);
+                if( pixels == nullptr )
+                    return slot;
+
+                memset(pixels->get_ptr(), 0, pixels->get_size());
+                auto bytes = pixels->get_size();
+                // rows would be blended by mipmaps
+                AtlasPagePtr page(new (std::nothrow) AtlasPage(std::move(pixels), 0));
+                if( page == nullptr )
+                    return slot;
+
+                m_stats.bytes_after += bytes;
+                m_linear_page = (int)m_pages.size();
+                m_linear_rows = 0;
+                m_pages.push_back(std::move(page));
+            }
+
+            // texcoord v is at the center of row, which is not blended with
+            // its neighbours by linear filter.
+            auto& page = *m_pages[m_linear_page];
+            memcpy(page.bitmap->get_ptr() + m_linear_rows*GradientPageWidth*4, bitmap.get_ptr(), bitmap.get_size());
+            page.dirty = true;
+            slot = GradientSlot(m_linear_page, (m_linear_rows + 0.5f) / GradientPageRows);
+            m_linear_rows ++;
+        }
+        else
+        {
+            BitmapPtr pixels = BitmapRGBA8::create(width, height);
+            if( pixels == nullptr )
+                return slot;
+
+            memcpy(pixels->get_ptr(), bitmap.get_ptr(), bitmap.get_size());
+            auto bytes = pixels->get_size();
+            AtlasPagePtr page(new (std::nothrow) AtlasPage(std::move(pixels), 1));
+            if( page == nullptr )
+                return slot;
+
+            m_stats.bytes_after += bytes;
+            slot = GradientSlot((int)m_pages.size(), -1.f);
+            m_pages.push_back(std::move(page));
+        }
+
+        m_slots.insert(std::make_pair(key, slot));
+        m_stats.gradients ++;
+        m_stats.pages = (uint32_t)m_pages.size();
+        return slot;
+    }
+
+    Rid GradientAtlas::get_texture_rid(int page, Render& render)
+    {
+        if( page < 0 || page >= (int)m_pages.size() )
+            return 0;
+        return m_pages[page]->get_texture_rid(render);
+    }
+
+    /// SKYLINE PACKER
+    SkylinePacker::SkylinePacker(int width, int height)
+    : m_width(width), m_height(height)
+    {
+        m_skyline.push_back(Segment(0, 0, width));
+    }
+
+    // the lowest y a rectangle could be placed at with its left on segment,
+    // or -1 if it crosses the right or bottom of page.
+    int SkylinePacker::fit(int index, int width, int height) const
+    {
+        auto x = m_skyline[index].x;
+        if( x + width > m_width )
+            return -1;
+
+        auto y = 0, rest = width;
+        for( auto i=index; rest > 0; i++ )
+        {
+            assert( i < m_skyline.size() );
+            y = std::max(y, m_skyline[i].y);
+            if( y + height > m_height )
+                return -1;
+            rest -= m_skyline[i].width;
+        }
+
+        return y;
+    }
+
+    bool SkylinePacker::insert(int width, int height, int& out_x, int& out_y)
+    {
+        // the lowest top, then the narrowest segment
+        auto best = -1, best_y = 0, best_top = 0, best_width = 0;
+        for( auto i=0; i<m_skyline.size(); i++ )
+        {
+            auto y = fit(i, width, height);
+            if( y < 0 ) continue;
+
+            auto top = y + height;
+            if( best < 0 || top < best_top || (top == best_top && m_skyline[i].width < best_width) )
+            {
+                best = i;
+                best_y = y;
+                best_top = top;
+                best_width = m_skyline[i].width;
+            }
+        }
+
+        if( best < 0 )
+            return false;
+
+        out_x = m_skyline[best].x;
+        out_y = best_y;
+
+        // the new segment covers the ones below it, which are cut or removed
+        m_skyline.insert(m_skyline.begin()+best, Segment(out_x, out_y+height, width));
+        auto right = out_x + width;
+        for( auto i=best+1; i<m_skyline.size(); )
+        {
+            auto& segment = m_skyline[i];
+            if( segment.x >= right )
+                break;
+
+            auto end = segment.x + segment.width;
+            if( end <= right )
+            {
+                m_skyline.erase(m_skyline.begin()+i);
+                continue;
+            }
+
+            segment.width = end - right;
+            segment.x = right;
+            break;
+        }
+
+        // merges neighbours of the same height
+        for( auto i=0; i+1<m_skyline.size(); )
+        {
+            if( m_skyline[i].y == m_skyline[i+1].y )
+            {
+                m_skyline[i].width += m_skyline[i+1].width;
+                m_skyline.erase(m_skyline.begin()+i+1);
+            }
+            else
+                i++;
+        }
+
+        return true;
+    }
+
+    /// IMAGE ATLAS
+    ImageAtlas* ImageAtlas::create()
+    {
+        return new (std::nothrow) ImageAtlas();
+    }
+
+    static bool is_packable(const Image& image)
+    {
+        auto& bitmap = image.get_bitmap();
+        auto format = bitmap.get_format();
+        return !image.is_repeating() &&
+            bitmap.get_width() <= ImageMaxSize && bitmap.get_height() <= ImageMaxSize &&
+            (format == TextureFormat::RGBA8 || format == TextureFormat::RGB8);
+    }
+
+    // copies image into page at x and y, padding repeats its nearest texel
+    static void copy_padded(const IBitmap& bitmap, IBitmap& page, int x, int y)
+    {
+        auto width = (int)bitmap.get_width(), height = (int)bitmap.get_height();
+        auto size = bitmap.get_format() == TextureFormat::RGBA8 ? 4 : 3;
+        auto stride = (int)page.get_width();
+
+        for( auto row=0; row<height+ImagePadding*2; row++ )
+        {
+            auto sy = std::min(std::max(row-ImagePadding, 0), height-1);
+            auto source = bitmap.get_ptr() + sy*width*size;
+            auto dest = page.get_ptr() + ((y+row)*stride + x)*4;
+            for( auto col=0; col<width+ImagePadding*2; col++ )
+            {
+                auto texel = source + std::min(std::max(col-ImagePadding, 0), width-1)*size;
+                dest[col*4+0] = texel[0];
+                dest[col*4+1] = texel[1];
+                dest[col*4+2] = texel[2];
+                dest[col*4+3] = size == 4 ? texel[3] : 255;
+            }
+        }
+    }
+
+    void ImageAtlas::pack(std::vector<Image*> images)
+    {
+        std::sort(images.begin(), images.end(), [](Image* a, Image* b)
+        {
+            if( a->get_height() != b->get_height() )
+                return a->get_height() > b->get_height();
+            return a->get_width() > b->get_width();
+        });
+
+        // places all images first, so that pages are only as high as used
+        struct Placement { Image* image; int page, x, y; };
+        std::vector<Placement> placements;
+        std::vector<int> heights;
+
+        std::vector<SkylinePacker> packers;
+        for( auto image : images )
+        {
+            m_stats.images ++;
+            if( !is_packable(*image) )
+                continue;
+
+            auto width = (int)image->get_width() + ImagePadding*2;
+            auto height = (int)image->get_height() + ImagePadding*2;
+
+            Placement placement = { image, 0, 0, 0 };
+            for( ; placement.page<packers.size(); placement.page++ )
+            {
+                if( packers[placement.page].insert(width, height, placement.x, placement.y) )
+                    break;
+            }
+
+            if( placement.page == packers.size() )
+            {
+                packers.push_back(SkylinePacker(ImagePageSize, ImagePageSize));
+                heights.push_back(0);
+                if( !packers.back().insert(width, height, placement.x, placement.y) )
+                    continue;
+            }
+
+            heights[placement.page] = std::max(heights[placement.page], placement.y+height);
+            placements.push_back(placement);
+        }
+
+        // pages are cut to the used height, textures of any size are supported
+        // since opengl 3. mipmaps would blend neighbours of an image, which
+        // are not created. images of a page which fails to be allocated are
+        // left unpacked.
+        std::vector<int> pages(heights.size(), -1);
+        for( auto i=0; i<heights.size(); i++ )
+        {
+            BitmapPtr pixels = BitmapRGBA8::create(ImagePageSize, heights[i]);
+            if( pixels == nullptr )
+                continue;
+
+            memset(pixels->get_ptr(), 0, pixels->get_size());
+            auto bytes = pixels->get_size();
+            AtlasPagePtr page(new (std::nothrow) AtlasPage(std::move(pixels), 0));
+            if( page == nullptr )
+                continue;
+
+            m_stats.bytes_pages += bytes;
+            pages[i] = (int)m_pages.size();
+            m_pages.push_back(std::move(page));
+        }
+
+        for( auto& placement : placements )
+        {
+            placement.page = pages[placement.page];
+            if( placement.page < 0 )
+                continue;
+
+            auto& page = *m_pages[placement.page]->bitmap;
+            auto& bitmap = placement.image->get_bitmap();
+            copy_padded(bitmap, page, placement.x, placement.y);
+
+            auto x = placement.x + ImagePadding, y = placement.y + ImagePadding;
+            auto width = (float)page.get_width(), height = (float)page.get_height();
+            placement.image->set_atlas(this, placement.page, Rect(
+                x / width, (x + bitmap.get_width()) / width,
+                y / height, (y + bitmap.get_height()) / height));
+
+            m_stats.packed ++;
+            m_stats.bytes_packed += bitmap.get_width()*bitmap.get_height()*4;
+        }
+
+        m_stats.pages = (uint32_t)m_pages.size();
+    }
+
+    Rid ImageAtlas::get_texture_rid(int page, Render& render)
+    {
+        if( page < 0 || page >= (int)m_pages.size() )
+            return 0;
+        return m_pages[page]->get_texture_rid(render);
+    }
+}
@@ -0,0 +1,150 @@
+#pragma once
+
+#include "image.hpp"
+#include "residency.hpp"
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+namespace openswf
+{
+    // pixels shared by several textures of a player, which are uploaded to the
+    // render of first use as images, and again if they are changed after that.
+    struct AtlasPage
+    {
+        BitmapPtr       bitmap;
+        int             mipmap;
+        bool            dirty;
+        ResidentTexture texture;
+
+        AtlasPage(BitmapPtr bitmap, int mipmap)
+        : bitmap(std::move(bitmap)), mipmap(mipmap), dirty(false) {}
+
+        Rid get_texture_rid(Render& render);
+    };
+
+    // pages are tracked by address once uploaded, so they are never moved
+    typedef std::unique_ptr<AtlasPage> AtlasPagePtr;
+
+    /// GRADIENT ATLAS
+
+    // linear gradients are rows of shared pages which are as wide as one of
+    // them, so that sampling clamps at both ends as with a texture of its own.
+    // the others are kept in pages of their own. both are shared by identical
+    // gradients.
+    const static int GradientPageWidth  = 64;
+    const static int GradientPageRows   = 64;
+
+    // where a gradient is, row is the texcoord v of it in page, or negative
+    // if the gradient covers the whole page.
+    struct GradientSlot
+    {
+        int     page;
+        float   row;
+
+        GradientSlot() : page(-1), row(-1.f) {}
+        GradientSlot(int page, float row) : page(page), row(row) {}
+    };
+
+    // sizes of gradient textures with the atlas, and without as one texture
+    // for each fill.
+    struct GradientStats
+    {
+        uint32_t fills, gradients, pages;
+        uint64_t bytes_before, bytes_after;
+
+        GradientStats()
+        : fills(0), gradients(0), pages(0), bytes_before(0), bytes_after(0) {}
+    };
+
+    class GradientAtlas
+    {
+    protected:
+        std::vector<AtlasPagePtr>                       m_pages;
+        std::unordered_map<std::string, GradientSlot>   m_slots;
+        int                                             m_linear_page, m_linear_rows;
+        GradientStats                                   m_stats;
+
+        GradientAtlas() : m_linear_page(-1), m_linear_rows(0) {}
+
+    public:
+        static GradientAtlas* create();
+
+        // finds the slot of a gradient with the same texels, or copies it
+        // into the atlas.
+        GradientSlot insert(const IBitmap& bitmap);
+        Rid get_texture_rid(int page, Render& render);
+
+        const GradientStats& get_stats() const;
+    };
+
+    /// IMAGE ATLAS
+
+    // places rectangles into a page by the skyline bottom-left heuristic,
+    // which keeps the top edge of placed ones as segments from left to right.
+    class SkylinePacker
+    {
+    protected:
+        struct Segment
+        {
+            int x, y, width;
+            Segment(int x, int y, int width) : x(x), y(y), width(width) {}
+        };
+
+        int                     m_width, m_height;
+        std::vector<Segment>    m_skyline;
+
+        int fit(int index, int width, int height) const;
+
+    public:
+        SkylinePacker(int width, int height);
+
+        // returns false if the rectangle does not fit in the rest
+        bool insert(int width, int height, int& x, int& y);
+    };
+
+    // small images are packed into shared pages at load time, with their edge
+    // texels extruded into padding so that filtering clamps as before. images
+    // of repeating fills are kept in textures of their own.
+    const static int ImagePageSize      = 512;
+    const static int ImageMaxSize       = 128;
+    const static int ImagePadding       = 2;
+
+    struct ImageStats
+    {
+        uint32_t images, packed, pages;
+        uint64_t bytes_packed, bytes_pages;
+
+        ImageStats()
+        : images(0), packed(0), pages(0), bytes_packed(0), bytes_pages(0) {}
+    };
+
+    class ImageAtlas
+    {
+    protected:
+        std::vector<AtlasPagePtr>   m_pages;
+        ImageStats                  m_stats;
+
+    public:
+        static ImageAtlas* create();
+
+        // packs the small and not repeating ones of images into new pages,
+        // higher ones first.
+        void pack(std::vector<Image*> images);
+        Rid  get_texture_rid(int page, Render& render);
+
+        const ImageStats& get_stats() const;
+    };
+
+    /// INLINE METHODS
+    inline const GradientStats& GradientAtlas::get_stats() const
+    {
+        return m_stats;
+    }
+
+    inline const ImageStats& ImageAtlas::get_stats() const
+    {
+        return m_stats;
+    }
+}
@@ -3,7 +3,8 @@
 #include <cstdint>
 #include <cassert>
 
-#define DEBUG_AVM
+// traces every executed action, which is much slower
+// #define DEBUG_AVM
 
 #define NS_OPENSWF_BEGIN namespace openswf {
 #define NS_OPENSWF_END }
@@ -30,6 +31,8 @@ class GCObject;
 class ContextObject;
 class StringObject;
 class ScriptObject;
+class Shape;
+class Profiler;
 class VirtualMachine;
 
 NS_AVM_END
\ No newline at end of file
@@ -0,0 +1,201 @@
+#include "avm/bytecode.hpp"
+
+#include "stream.hpp"
+
+#include <algorithm>
+
+NS_AVM_BEGIN
+
+enum class OpPushCode : uint8_t
+{
+    STRING = 0,
+    FLOAT,
+    NIL,
+    UNDEFINED,
+    REGISTER,
+    BOOLEAN,
+    DOUBLE,
+    INTEGER,
+    CONSTANT8,
+    CONSTANT16
+};
+
+static Literal read_literal(Stream& stream, std::vector<std::string>& strings)
+{
+    Literal literal;
+    literal.code = LiteralCode::VALUE;
+    literal.index = 0;
+
+    auto type = (OpPushCode)stream.read_uint8();
+    switch(type)
+    {
+        case OpPushCode::STRING:
+        {
+            literal.code = LiteralCode::STRING;
+            literal.index = strings.size();
+            strings.push_back(stream.read_string());
+            break;
+        }
+
+        case OpPushCode::FLOAT:
+            literal.value.set_number(stream.read_float32());
+            break;
+
+        case OpPushCode::NIL:
+            literal.value.set_nil();
+            break;
+
+        // registers are not supported yet
+        case OpPushCode::REGISTER:
+            stream.read_uint8();
+            break;
+
+        case OpPushCode::BOOLEAN:
+            literal.value.set_boolean(stream.read_uint8());
+            break;
+
+        case OpPushCode::DOUBLE:
+            literal.value.set_number(stream.read_float64());
+            break;
+
+        case OpPushCode::INTEGER:
+            literal.value.set_integer(stream.read_uint32());
+            break;
+
+        case OpPushCode::CONSTANT8:
+        {
+            literal.code = LiteralCode::CONSTANT;
+            literal.index = stream.read_uint8();
+            break;
+        }
+
+        case OpPushCode::CONSTANT16:
+        {
+            literal.code = LiteralCode::CONSTANT;
+            literal.index = stream.read_uint16();
+            break;
+        }
+
+        default:
+            break;
+    }
+
+    return literal;
+}
+
+Bytecode* Bytecode::create(const uint8_t* bytes, int length)
+{
+    auto bytecode = new (std::nothrow) Bytecode();
+    if( bytecode == nullptr )
+        return nullptr;
+
+    auto& instructions = bytecode->m_instructions;
+    auto& strings = bytecode->m_strings;
+
+    // offsets of records in block and the ones jumps go to, which are
+    // resolved once all instructions are known.
+    std::vector<uint32_t> offsets;
+    std::vector<std::pair<uint32_t, int32_t>> jumps;
+
+    auto stream = Stream(bytes, length);
+    while( stream.get_position() < (uint32_t)length )
+    {
+        auto start = stream.get_position();
+        auto code = (Opcode)stream.read_uint8();
+        if( code == Opcode::END )
+            break;
+
+        uint32_t size = (uint8_t)code >= 0x80 ? stream.read_uint16() : 0;
+        auto finish = std::min(stream.get_position() + size, (uint32_t)length);
+
+        Instruction instruction = { code, 0, 0, 0 };
+        switch(code)
+        {
+            case Opcode::PUSH:
+            {
+                instruction.operand = bytecode->m_literals.size();
+                while( stream.get_position() < finish )
+                    bytecode->m_literals.push_back(read_literal(stream, strings));
+                instruction.count = bytecode->m_literals.size() - instruction.operand;
+                break;
+            }
+
+            case Opcode::CONSTANT_POOL:
+            {
+                instruction.count = stream.read_uint16();
+                instruction.operand = strings.size();
+                for( auto i=0; i<instruction.count; i++ )
+                    strings.push_back(stream.read_string());
+                break;
+            }
+
+            case Opcode::GOTO_LABEL:
+            {
+                instruction.operand = strings.size();
+                strings.push_back(stream.read_string());
+                break;
+            }
+
+            case Opcode::GOTO_FRAME:
+            {
+                instruction.operand = stream.read_uint16();
+                break;
+            }
+
+            case Opcode::GET_VARIABLE:
+            case Opcode::SET_VARIABLE:
+            case Opcode::GET_MEMBER:
+            case Opcode::SET_MEMBER:
+            {
+                instruction.operand = bytecode->m_caches.size();
+                bytecode->m_caches.push_back(InlineCache());
+                break;
+            }
+
+            // offsets are relative to the next record
+            case Opcode::JUMP:
+            case Opcode::IF:
+            {
+                auto offset = stream.read_int16();
+                jumps.push_back(std::make_pair(instructions.size(), (int32_t)finish + offset));
+                break;
+            }
+
+            default:
+                break;
+        }
+
+        offsets.push_back(start);
+        instructions.push_back(instruction);
+        stream.set_position(finish);
+    }
+
+    offsets.push_back(stream.get_position());
+    instructions.push_back(Instruction { Opcode::END, 0, 0, 0 });
+
+    // jumps into the middle of a record or out of block go to END
+    auto last = (uint32_t)instructions.size() - 1;
+    for( auto& jump : jumps )
+    {
+        auto found = std::lower_bound(offsets.begin(), offsets.end(), (uint32_t)jump.second);
+        auto valid = jump.second >= 0 && found != offsets.end() && *found == (uint32_t)jump.second;
+        instructions[jump.first].operand = valid ? (uint32_t)(found - offsets.begin()) : last;
+    }
+
+    return bytecode;
+}
+
+void Bytecode::intern(StringTable& table) const
+{
+    // shapes of caches belong to the virtual machine of table
+    for( auto& cache : m_caches )
+        cache = InlineCache();
+
+    m_atoms.clear();
+    m_atoms.reserve(m_strings.size());
+    for( auto& str : m_strings )
+        m_atoms.push_back(table.intern(str));
+    m_table = table.get_id();
+}
+
+NS_AVM_END
@@ -0,0 +1,134 @@
+#pragma once
+
+#include "avm/avm.hpp"
+#include "avm/opcode.hpp"
+#include "avm/value.hpp"
+#include "avm/string_table.hpp"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+NS_AVM_BEGIN
+
+// an action decoded ahead of execution, whose operand is:
+//  PUSH            the first of count literals
+//  CONSTANT_POOL   the first of count strings
+//  GOTO_LABEL      a string
+//  GOTO_FRAME      the frame
+//  JUMP, IF        the instruction to jump to
+//  GET_VARIABLE, SET_VARIABLE, GET_MEMBER, SET_MEMBER
+//                  its inline cache
+struct Instruction
+{
+    Opcode      code;
+    uint8_t     reserved;
+    uint16_t    count;
+    uint32_t    operand;
+};
+
+enum class LiteralCode : uint8_t
+{
+    VALUE,      // numbers, booleans, null and undefined
+    STRING,     // a string of bytecode
+    CONSTANT    // an entry of constant pool at execution
+};
+
+struct Literal
+{
+    LiteralCode code;
+    uint32_t    index;
+    Value       value;
+};
+
+// a monomorphic cache of the last variable accessed by an instruction,
+// which is hit by objects of the same shape with the same name.
+struct InlineCache
+{
+    const Shape*        shape;
+    const StringObject* name;
+    uint32_t            slot;
+
+    InlineCache() : shape(nullptr), name(nullptr), slot(0) {}
+
+    bool hit(const Shape* s, const StringObject* n) const
+    {
+        return shape == s && name == n;
+    }
+};
+
+// actions of a block decoded once, with jumps resolved into instructions
+// and operands parsed. it always ends with END, which is where jumps out of
+// the block go. its strings are interned into atoms of the table it's
+// executed with, which are kept with inline caches until another table is
+// used.
+class Bytecode
+{
+protected:
+    std::vector<Instruction>    m_instructions;
+    std::vector<Literal>        m_literals;
+    std::vector<std::string>    m_strings;
+
+    mutable std::vector<StringObject*>  m_atoms;
+    mutable std::vector<InlineCache>    m_caches;
+    mutable uint32_t                    m_table;
+
+    void intern(StringTable& table) const;
+
+public:
+    Bytecode() : m_table(0) {}
+
+    static Bytecode* create(const uint8_t* bytes, int length);
+
+    const Instruction*  get_instructions() const;
+    uint32_t            get_instruction_count() const;
+    const Literal&      get_literal(uint32_t index) const;
+    const std::string&  get_string(uint32_t index) const;
+    InlineCache&        get_cache(uint32_t index) const;
+    uint32_t            get_cache_count() const;
+    // atoms of strings in table, in the order of strings
+    StringObject* const* get_atoms(StringTable& table) const;
+};
+
+typedef std::unique_ptr<Bytecode> BytecodePtr;
+
+// INLINE METHODS
+
+inline const Instruction* Bytecode::get_instructions() const
+{
+    return m_instructions.data();
+}
+
+inline uint32_t Bytecode::get_instruction_count() const
+{
+    return (uint32_t)m_instructions.size();
+}
+
+inline const Literal& Bytecode::get_literal(uint32_t index) const
+{
+    return m_literals[index];
+}
+
+inline const std::string& Bytecode::get_string(uint32_t index) const
+{
+    return m_strings[index];
+}
+
+inline InlineCache& Bytecode::get_cache(uint32_t index) const
+{
+    return m_caches[index];
+}
+
+inline uint32_t Bytecode::get_cache_count() const
+{
+    return (uint32_t)m_caches.size();
+}
+
+inline StringObject* const* Bytecode::get_atoms(StringTable& table) const
+{
+    if( m_table != table.get_id() )
+        intern(table);
+    return m_atoms.data();
+}
+
+NS_AVM_END
@@ -2,63 +2,83 @@
 
 #include "avm/avm.hpp"
 #include "avm/script_object.hpp"
+#include "avm/string_object.hpp"
+#include "avm/bytecode.hpp"
 
 #include <vector>
-#include <unordered_map>
 
 NS_AVM_BEGIN
 
 const static int MaxOperands = 32;
 
+// instruction is the one being executed, which is followed by next unless
+// it jumps. backward jumps charge instructions of loops to the budget shared
+// by all executions of virtual machine, the block is aborted once it's used
+// up.
 struct MovieEnvironment
 {
-    VirtualMachine* vm;
-    ContextObject*    object;
-    MovieNode*      node;
-    Stream*         bytecode;
-    int32_t         version;
-    int32_t         finish;
+    VirtualMachine*     vm;
+    ContextObject*      object;
+    MovieNode*          node;
+    int32_t             version;
+
+    const Bytecode*     bytecode;
+    const Instruction*  instruction;
+    const Instruction*  next;
+    StringObject* const* atoms;
+    int64_t*            budget;
 
 protected:
     Value           m_operands[MaxOperands];
     int             m_current_operand;
 
 public:
-    MovieEnvironment(VirtualMachine* vm, ContextObject* that, Stream* bc);
+    MovieEnvironment(VirtualMachine* vm, ContextObject* that, const Bytecode* bytecode);
 
     void    push(Value value);
     Value   pop();
     Value   back();
     int     get_current_op() const;
-    bool    is_finished() const;
+
+    void    jump(uint32_t target);
+    // goes to END with nothing on stack
+    void    abort();
 };
 
 // ContextObject is the minimal runtime context in avm.
 class ContextObject : public ScriptObject
 {
     friend class VirtualMachine;
-    typedef std::unordered_map<std::string, Value> Scope;
+    typedef VariableMap Scope;
 
 protected:
+    VirtualMachine&                 m_vm;
     std::vector<StringObject*>      m_constants;
     std::vector<Scope>              m_scope_chain;
     MovieNode*                      m_movie_node;
 
 public:
-    ContextObject();
+    ContextObject(VirtualMachine& vm);
 
-    void        execute(VirtualMachine& vm, Stream& bytecode);
+    void        execute(VirtualMachine& vm, const Bytecode& bytecode);
     bool        expired() const;
     MovieNode*  get_movie_node();
 
     void attach_movie(ContextObject*);
     void push_scope();
-    void set_local_variable(const char*, Value);
+    void set_local_variable(const StringObject*, Value);
     void pop_scope();
 
-    virtual void mark(uint8_t);
+    // variables by names of host, which are interned if necessary
+    using ScriptObject::set_variable;
+    using ScriptObject::get_variable;
+    void  set_variable(const char*, Value);
+    Value get_variable(const char*);
+
+    virtual void trace(Heap&);
     virtual std::string to_string() const;
-    virtual Value get_variable(const char*);
+    virtual Value get_variable(const StringObject*);
+    virtual Value get_variable(const StringObject*, InlineCache&);
 
 protected:
     void attach(MovieNode*);
@@ -66,6 +86,8 @@ protected:
     void set_scope();
 
     static void initialize();
+    // times every instruction, see Profiler
+    static void execute_profiled(MovieEnvironment&, Profiler&);
 
     // swf3
     static void op_next_frame(MovieEnvironment&);
@@ -143,6 +165,17 @@ inline int MovieEnvironment::get_current_op() const
     return m_current_operand;
 }
 
+inline void MovieEnvironment::jump(uint32_t target)
+{
+    next = bytecode->get_instructions() + target;
+    if( next <= instruction )
+    {
+        *budget -= instruction - next + 1;
+        if( *budget < 0 )
+            abort();
+    }
+}
+
 inline bool ContextObject::expired() const
 {
     return m_movie_node == nullptr;
@@ -163,8 +196,18 @@ inline void ContextObject::pop_scope()
     m_scope_chain.pop_back();
 }
 
-inline void ContextObject::set_local_variable(const char* name, Value value)
+// locals defined outside of any scope are variables of the timeline
+inline void ContextObject::set_local_variable(const StringObject* name, Value value)
 {
+    assert( name->is_atom() );
+    if( m_scope_chain.empty() )
+    {
+        set_variable(name, value);
+        return;
+    }
+
+    if( m_heap != nullptr )
+        m_heap->write_barrier(this, value);
     m_scope_chain.back()[name] = value;
 }
 
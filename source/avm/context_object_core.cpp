@@ -2,65 +2,99 @@
 #include "avm/opcode.hpp"
 #include "avm/virtual_machine.hpp"
 #include "avm/string_object.hpp"
+#include "avm/profiler.hpp"
 
 #include "stream.hpp"
 #include "movie_clip.hpp"
 
+#include <atomic>
+#include <mutex>
+
 NS_AVM_BEGIN
 
 MovieEnvironment::MovieEnvironment(
-    VirtualMachine* vm, ContextObject* that, Stream* bc)
+    VirtualMachine* vm, ContextObject* that, const Bytecode* bytecode)
     : vm(vm), version(vm->get_version()),
     object(that), node(that->get_movie_node()),
-    bytecode(bc), m_current_operand(0) {}
+    bytecode(bytecode), instruction(nullptr), next(bytecode->get_instructions()),
+    atoms(bytecode->get_atoms(vm->get_strings())), budget(&vm->m_budget),
+    m_current_operand(0) {}
 
-bool MovieEnvironment::is_finished() const
+void MovieEnvironment::abort()
 {
-    return bytecode->get_position() >= finish;
+    m_current_operand = 0;
+    next = bytecode->get_instructions() + bytecode->get_instruction_count() - 1;
 }
 
-typedef std::function<void(MovieEnvironment&)> OpHandler;
-static std::unordered_map<uint8_t, OpHandler> s_handlers;
+// opcodes with handlers, the others are skipped
+#define AVM_HANDLERS(X) \
+    X(NEXT_FRAME,       op_next_frame) \
+    X(PREV_FRAME,       op_prev_frame) \
+    X(GOTO_FRAME,       op_goto_frame) \
+    X(GOTO_LABEL,       op_goto_label) \
+    X(PLAY,             op_play) \
+    X(STOP,             op_stop) \
+    X(PUSH,             op_push) \
+    X(POP,              op_pop) \
+    X(ADD,              op_add) \
+    X(SUBTRACT,         op_subtract) \
+    X(MULTIPLY,         op_multiply) \
+    X(DIVIDE,           op_divide) \
+    X(EQUALS,           op_equals) \
+    X(LESS,             op_less) \
+    X(GREATER,          op_greater) \
+    X(AND,              op_and) \
+    X(OR,               op_or) \
+    X(NOT,              op_not) \
+    X(JUMP,             op_jump) \
+    X(IF,               op_if) \
+    X(DEFINE_LOCAL,     op_define_local) \
+    X(GET_VARIABLE,     op_get_variable) \
+    X(SET_VARIABLE,     op_set_variable) \
+    X(GET_PROPERTY,     op_get_property) \
+    X(SET_PROPERTY,     op_set_property) \
+    X(SET_MEMBER,       op_set_member) \
+    X(GET_MEMBER,       op_get_member) \
+    X(TRACE,            op_trace) \
+    X(CONSTANT_POOL,    op_constants)
+
+// threaded dispatch jumps from the end of each handler to the next one, with
+// labels as values of gcc and clang. others call through the table.
+#if defined(__GNUC__) || defined(__clang__)
+#define AVM_THREADED_DISPATCH
+#endif
+
+typedef void (*OpHandler)(MovieEnvironment&);
+static OpHandler s_handlers[256];
+static std::atomic<bool> s_handlers_ready(false);
+static std::mutex s_handlers_mutex;
 
+static void op_undefined(MovieEnvironment&)
+{
+#ifdef DEBUG_AVM
+    printf("[!] UNDEFINED OP\n");
+#endif
+}
+
+// it's safe to initialize from several threads
 void ContextObject::initialize()
 {
-    if( s_handlers.size() != 0 ) return;
-    
-    s_handlers[(uint8_t)Opcode::NEXT_FRAME]     = ContextObject::op_next_frame;
-    s_handlers[(uint8_t)Opcode::PREV_FRAME]     = ContextObject::op_prev_frame;
-    s_handlers[(uint8_t)Opcode::GOTO_FRAME]     = ContextObject::op_goto_frame;
-    s_handlers[(uint8_t)Opcode::GOTO_LABEL]     = ContextObject::op_goto_label;
-    s_handlers[(uint8_t)Opcode::PLAY]           = ContextObject::op_play;
-    s_handlers[(uint8_t)Opcode::STOP]           = ContextObject::op_stop;
-
-    s_handlers[(uint8_t)Opcode::PUSH]           = ContextObject::op_push;
-    s_handlers[(uint8_t)Opcode::POP]            = ContextObject::op_pop;
-
-    s_handlers[(uint8_t)Opcode::ADD]            = ContextObject::op_add;
-    s_handlers[(uint8_t)Opcode::SUBTRACT]       = ContextObject::op_subtract;
-    s_handlers[(uint8_t)Opcode::MULTIPLY]       = ContextObject::op_multiply;
-    s_handlers[(uint8_t)Opcode::DIVIDE]         = ContextObject::op_divide;
-    s_handlers[(uint8_t)Opcode::EQUALS]         = ContextObject::op_equals;
-    s_handlers[(uint8_t)Opcode::LESS]           = ContextObject::op_less;
-    s_handlers[(uint8_t)Opcode::GREATER]        = ContextObject::op_greater;
-    s_handlers[(uint8_t)Opcode::AND]            = ContextObject::op_and;
-    s_handlers[(uint8_t)Opcode::OR]             = ContextObject::op_or;
-    s_handlers[(uint8_t)Opcode::NOT]            = ContextObject::op_not;
-
-    s_handlers[(uint8_t)Opcode::JUMP]           = ContextObject::op_jump;
-    s_handlers[(uint8_t)Opcode::IF]             = ContextObject::op_if;
-
-    s_handlers[(uint8_t)Opcode::DEFINE_LOCAL]   = ContextObject::op_define_local;
-    // s_handlers[(uint8_t)Opcode::DEFINE_LOCAL2]  = ContextObject::op_define_local2;
-    s_handlers[(uint8_t)Opcode::GET_VARIABLE]   = ContextObject::op_get_variable;
-    s_handlers[(uint8_t)Opcode::SET_VARIABLE]   = ContextObject::op_set_variable;
-    s_handlers[(uint8_t)Opcode::GET_PROPERTY]   = ContextObject::op_get_property;
-    s_handlers[(uint8_t)Opcode::SET_PROPERTY]   = ContextObject::op_set_property;
-    s_handlers[(uint8_t)Opcode::SET_MEMBER]     = ContextObject::op_set_member;
-    s_handlers[(uint8_t)Opcode::GET_MEMBER]     = ContextObject::op_get_member;
-
-    s_handlers[(uint8_t)Opcode::TRACE]          = ContextObject::op_trace;
-    s_handlers[(uint8_t)Opcode::CONSTANT_POOL]  = ContextObject::op_constants;
+    if( s_handlers_ready.load(std::memory_order_acquire) ) return;
+
+    std::lock_guard<std::mutex> guard(s_handlers_mutex);
+    if( s_handlers_ready.load(std::memory_order_relaxed) ) return;
+
+    for( auto i=0; i<256; i++ )
+        s_handlers[i] = op_undefined;
+
+#define AVM_REGISTER(code, handler) \
+    s_handlers[(uint8_t)Opcode::code] = ContextObject::handler;
+    AVM_HANDLERS(AVM_REGISTER)
+#undef AVM_REGISTER
+
+    // END is handled by execute
+    s_handlers[(uint8_t)Opcode::END] = op_undefined;
+    s_handlers_ready.store(true, std::memory_order_release);
 }
 
 static void get_x()
@@ -73,20 +107,20 @@ static void set_x()
 
 }
 
-ContextObject::ContextObject()
-: m_movie_node(nullptr)
+ContextObject::ContextObject(VirtualMachine& vm)
+: m_vm(vm), m_movie_node(nullptr)
 {
     initialize();
 }
 
+// scopes are pushed by calls of functions only, variables of frame scripts
+// belong to the timeline
 void ContextObject::attach(MovieNode* node)
 {
-    push_scope();
-
     m_movie_node = node;
 
-    set_variable("this", Value().set_object(this));
-    set_variable("", Value().set_object(this));
+    set_variable(m_vm.intern("this"), Value().set_object(this));
+    set_variable(m_vm.intern(""), Value().set_object(this));
 }
 
 void ContextObject::detach()
@@ -96,7 +130,19 @@ void ContextObject::detach()
     m_constants.clear();
 }
 
+void ContextObject::set_variable(const char* name, Value value)
+{
+    set_variable(m_vm.intern(name), value);
+}
+
+// names never interned can't be variables
 Value ContextObject::get_variable(const char* name)
+{
+    auto atom = m_vm.get_strings().find(name);
+    return atom != nullptr ? get_variable(atom) : Value();
+}
+
+Value ContextObject::get_variable(const StringObject* name)
 {
     for( int i=m_scope_chain.size()-1; i>=0; i-- )
     {
@@ -106,13 +152,21 @@ Value ContextObject::get_variable(const char* name)
     }
 
     auto value = ScriptObject::get_variable(name);
-    if( value.type != ValueCode::UNDEFINED )
+    if( !value.is_undefined() )
         return value;
 
     return Value();
 }
 
-void ContextObject::execute(VirtualMachine& vm, Stream& bytecode)
+// variables of scopes may hide the ones of slots
+Value ContextObject::get_variable(const StringObject* name, InlineCache& cache)
+{
+    if( !m_scope_chain.empty() )
+        return get_variable(name);
+    return ScriptObject::get_variable(name, cache);
+}
+
+void ContextObject::execute(VirtualMachine& vm, const Bytecode& bytecode)
 {
    if( expired() )
    {
@@ -122,59 +176,110 @@ void ContextObject::execute(VirtualMachine& vm, Stream& bytecode)
    }
 
     auto env = MovieEnvironment(&vm, this, &bytecode);
+    if( vm.get_profiler() != nullptr )
+    {
+        execute_profiled(env, *vm.get_profiler());
+        return;
+    }
+
+#ifdef DEBUG_AVM
+#define AVM_TRACE(code) \
+    printf("EXECUTE OP: %s(0x%X)\n", opcode_to_string((Opcode)code), (uint32_t)code);
+#else
+#define AVM_TRACE(code)
+#endif
+
+#ifdef AVM_THREADED_DISPATCH
+    static void* s_labels[256];
+    static std::atomic<bool> s_labels_ready(false);
+    if( !s_labels_ready.load(std::memory_order_acquire) )
+    {
+        std::lock_guard<std::mutex> guard(s_handlers_mutex);
+        if( !s_labels_ready.load(std::memory_order_relaxed) )
+        {
+            for( auto i=0; i<256; i++ )
+                s_labels[i] = &&label_undefined;
+            s_labels[(uint8_t)Opcode::END] = &&label_end;
+
+#define AVM_LABEL(code, handler) \
+            s_labels[(uint8_t)Opcode::code] = &&label_##code;
+            AVM_HANDLERS(AVM_LABEL)
+#undef AVM_LABEL
+            s_labels_ready.store(true, std::memory_order_release);
+        }
+    }
+
+    uint8_t code;
+#define AVM_DISPATCH() \
+    env.instruction = env.next++; \
+    code = (uint8_t)env.instruction->code; \
+    AVM_TRACE(code) \
+    goto *s_labels[code];
+
+    AVM_DISPATCH();
+
+#define AVM_CASE(code, handler) \
+label_##code: \
+    ContextObject::handler(env); \
+    AVM_DISPATCH();
+    AVM_HANDLERS(AVM_CASE)
+#undef AVM_CASE
 
+label_undefined:
+    op_undefined(env);
+    AVM_DISPATCH();
+
+label_end:
+    assert( env.get_current_op() == 0 );
+    return;
+
+#undef AVM_DISPATCH
+#else
     for(;;)
     {
-        auto code = (Opcode)bytecode.read_uint8();
-        if( code == Opcode::END )
+        env.instruction = env.next++;
+        auto code = (uint8_t)env.instruction->code;
+        if( code == (uint8_t)Opcode::END )
         {
             assert( env.get_current_op() == 0 );
             return;
         }
 
-        auto size = 0;
-        if( (uint8_t)code >= 0x80 ) size = bytecode.read_uint16();
-        env.finish = bytecode.get_position() + size;
-
-        auto found = s_handlers.find((uint8_t)code);
-        if( found != s_handlers. end() )
-        {
-#ifdef DEBUG_AVM
-            printf("EXECUTE OP: %s(0x%X, %d)\n",
-                opcode_to_string(code), (uint32_t)code, size);
+        AVM_TRACE(code)
+        s_handlers[code](env);
+    }
 #endif
-            found->second(env);
-        }
-        else
+#undef AVM_TRACE
+}
+
+// a loop of its own, so that the one above costs nothing more
+void ContextObject::execute_profiled(MovieEnvironment& env, Profiler& profiler)
+{
+    profiler.start_instruction();
+    for(;;)
+    {
+        env.instruction = env.next++;
+        auto code = env.instruction->code;
+        if( code == Opcode::END )
         {
-#ifdef DEBUG_AVM
-            printf("[!] UNDEFINED OP: %s(0x%X, %d)\n",
-                opcode_to_string(code), (uint32_t)code, size);
-#endif
+            assert( env.get_current_op() == 0 );
+            return;
         }
-        
-        bytecode.set_position(env.finish);
+
+        s_handlers[(uint8_t)code](env);
+        profiler.finish_instruction(code);
     }
 }
 
-void ContextObject::mark(uint8_t v)
+void ContextObject::trace(Heap& heap)
 {
-    if( get_marked_value() != 0 )
-        return;
+    ScriptObject::trace(heap);
 
-    ScriptObject::mark(v);
-
-    for( auto scope : m_scope_chain )
+    for( auto& scope : m_scope_chain )
     {
-        for( auto pair : scope )
-        {
-            auto object = pair.second.to_object();
-            if( object != nullptr ) object->mark(v);
-        }
+        for( auto& pair : scope )
+            heap.shade(pair.second);
     }
-
-    for( auto str : m_constants )
-        str->mark(v);
 }
 
 std::string ContextObject::to_string() const
@@ -189,95 +294,41 @@ std::string ContextObject::to_string() const
 
 void ContextObject::op_constants(MovieEnvironment& env)
 {
-    auto count = env.bytecode->read_uint16();
-
-    env.object->m_constants.clear();
-    for( auto i=0; i<count; i++ )
-    {
-        auto str = env.vm->new_object<StringObject>();
-        str->set(env.bytecode->read_string());
+    auto& instruction = *env.instruction;
+    auto first = env.atoms + instruction.operand;
 
-        env.object->m_constants.push_back(str);
+    // atoms are never collected, so constants are not marked
+    env.object->m_constants.assign(first, first + instruction.count);
 
 #ifdef DEBUG_AVM
-        printf("\t[%d] %s\n", i, env.object->m_constants.back()->c_str());
+    for( auto i=0; i<instruction.count; i++ )
+        printf("\t[%d] %s\n", i, first[i]->c_str());
 #endif
-    }
 }
 
-enum class OpPushCode : uint8_t
-{
-    STRING = 0,
-    FLOAT,
-    NIL,
-    UNDEFINED,
-    REGISTER,
-    BOOLEAN,
-    DOUBLE,
-    INTEGER,
-    CONSTANT8,
-    CONSTANT16
-};
-
 void ContextObject::op_push(MovieEnvironment& env)
 {
-    for( auto i=0; !env.is_finished(); i++ )
+    auto& instruction = *env.instruction;
+    auto& constants = env.object->m_constants;
+
+    auto first = &env.bytecode->get_literal(instruction.operand);
+    for( auto i=0; i<instruction.count; i++ )
     {
-        auto type = (OpPushCode)env.bytecode->read_uint8();
-        switch(type)
+        auto& literal = first[i];
+        if( literal.code == LiteralCode::VALUE )
+        {
+            env.push(literal.value);
+        }
+        else if( literal.code == LiteralCode::STRING )
+        {
+            env.push(Value().set_object(env.atoms[literal.index]));
+        }
+        else
         {
-            case OpPushCode::STRING:
-            {
-                auto str = env.vm->new_object<StringObject>();
-                str->set(env.bytecode->read_string());
-
-                env.push(Value().set_object(str));
-                break;
-            }
-
-            case OpPushCode::FLOAT:
-            {
-                env.push(Value().set_number(env.bytecode->read_float32()));
-                break;
-            }
-
-            case OpPushCode::BOOLEAN:
-            {
-                env.push(Value().set_boolean(env.bytecode->read_uint8()));
-                break;
-            }
-
-            case OpPushCode::DOUBLE:
-            {
-                env.push(Value().set_number(env.bytecode->read_float64()));
-                break;
-            }
-
-            case OpPushCode::INTEGER:
-            {
-                env.push(Value().set_integer(env.bytecode->read_uint32()));
-                break;
-            }
-
-            case OpPushCode::CONSTANT8:
-            {
-                auto index = env.bytecode->read_uint8();
-                env.push(Value().set_object(env.object->m_constants[index]));
-                break;
-            }
-
-            case OpPushCode::CONSTANT16:
-            {
-                auto index2 = env.bytecode->read_uint16();
-                env.push(Value().set_object(env.object->m_constants[index2]));
-                break;
-            }
-
-            default:
-            {
+            if( literal.index < constants.size() )
+                env.push(Value().set_object(constants[literal.index]));
+            else
                 env.push(Value());
-                break;
-            }
         }
 
 #ifdef DEBUG_AVM
@@ -309,14 +360,13 @@ void ContextObject::op_prev_frame(MovieEnvironment& env)
 
 void ContextObject::op_goto_frame(MovieEnvironment& env)
 {
-    auto frame = env.bytecode->read_uint16();
-    env.node->goto_frame(frame);
+    env.node->goto_frame(env.instruction->operand);
 }
 
 void ContextObject::op_goto_label(MovieEnvironment& env)
 {
-    auto name = env.bytecode->read_string();
-    env.node->goto_named_frame(name);
+    auto& name = env.bytecode->get_string(env.instruction->operand);
+    env.node->goto_named_frame(name.c_str());
 }
 
 void ContextObject::op_play(MovieEnvironment& env)
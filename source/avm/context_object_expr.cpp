@@ -9,26 +9,45 @@
 
 NS_AVM_BEGIN
 
+// pops operands of a binary expression as numbers, op1 is the one on top.
+// doubles are taken as they are, with a single test for both.
+static inline void pop_numbers(MovieEnvironment& env, double& op1, double& op2)
+{
+    auto v1 = env.pop();
+    auto v2 = env.pop();
+
+    if( Value::are_doubles(v1, v2) )
+    {
+        op1 = v1.get_double();
+        op2 = v2.get_double();
+    }
+    else
+    {
+        op1 = v1.to_number();
+        op2 = v2.to_number();
+    }
+}
+
 void ContextObject::op_add(MovieEnvironment& env)
 {
-    auto op1 = env.pop().to_number();
-    auto op2 = env.pop().to_number();
+    double op1, op2;
+    pop_numbers(env, op1, op2);
 
     env.push(Value().set_number(op1+op2));
 }
 
 void ContextObject::op_subtract(MovieEnvironment& env)
 {
-    auto op1 = env.pop().to_number();
-    auto op2 = env.pop().to_number();
+    double op1, op2;
+    pop_numbers(env, op1, op2);
 
     env.push(Value().set_number(op2-op1));
 }
 
 void ContextObject::op_multiply(MovieEnvironment& env)
 {
-    auto op1 = env.pop().to_number();
-    auto op2 = env.pop().to_number();
+    double op1, op2;
+    pop_numbers(env, op1, op2);
 
     env.push(Value().set_number(op2*op1));
 }
@@ -37,8 +56,8 @@ void ContextObject::op_divide(MovieEnvironment& env)
 {
     const static char* err = "#ERROR#";
 
-    auto op1 = env.pop().to_number();
-    auto op2 = env.pop().to_number();
+    double op1, op2;
+    pop_numbers(env, op1, op2);
 
     if( op1 == 0 )
     {
@@ -46,9 +65,7 @@ void ContextObject::op_divide(MovieEnvironment& env)
         static auto infinity = std::numeric_limits<double>::infinity();
         if( env.version < 5 )
         {
-            auto str = env.vm->new_object<StringObject>();
-            str->set(err);
-            env.push(Value().set_object(str));
+            env.push(Value().set_object(env.vm->intern(err)));
         }
         else if( op2 == 0 || std::isnan(op2) || std::isnan(op1) )
         {
@@ -65,8 +82,8 @@ void ContextObject::op_divide(MovieEnvironment& env)
 
 void ContextObject::op_equals(MovieEnvironment& env)
 {
-    auto op1 = env.pop().to_number();
-    auto op2 = env.pop().to_number();
+    double op1, op2;
+    pop_numbers(env, op1, op2);
 
     if( env.version < 5 )
         env.push(Value().set_number(op2 == op1 ? 1 : 0));
@@ -76,8 +93,8 @@ void ContextObject::op_equals(MovieEnvironment& env)
 
 void ContextObject::op_less(MovieEnvironment& env)
 {
-    auto op1 = env.pop().to_number();
-    auto op2 = env.pop().to_number();
+    double op1, op2;
+    pop_numbers(env, op1, op2);
 
     if( env.version < 5 )
         env.push(Value().set_number(op2 < op1 ? 1 : 0));
@@ -87,8 +104,8 @@ void ContextObject::op_less(MovieEnvironment& env)
 
 void ContextObject::op_greater(MovieEnvironment& env)
 {
-    auto op1 = env.pop().to_number();
-    auto op2 = env.pop().to_number();
+    double op1, op2;
+    pop_numbers(env, op1, op2);
 
     if( env.version < 5 )
         env.push(Value().set_number(op2 >= op1 ? 1 : 0));
@@ -98,8 +115,8 @@ void ContextObject::op_greater(MovieEnvironment& env)
 
 void ContextObject::op_and(MovieEnvironment& env)
 {
-    auto op1 = env.pop().to_number();
-    auto op2 = env.pop().to_number();
+    double op1, op2;
+    pop_numbers(env, op1, op2);
 
     if( env.version < 5 )
         env.push(Value().set_number(op2 != 0 && op1 != 0 ? 1 : 0));
@@ -109,8 +126,8 @@ void ContextObject::op_and(MovieEnvironment& env)
 
 void ContextObject::op_or(MovieEnvironment& env)
 {
-    auto op1 = env.pop().to_number();
-    auto op2 = env.pop().to_number();
+    double op1, op2;
+    pop_numbers(env, op1, op2);
 
     if( env.version < 5 )
         env.push(Value().set_number(op2 != 0 || op1 != 0 ? 1 : 0));
@@ -130,17 +147,13 @@ void ContextObject::op_not(MovieEnvironment& env)
 
 void ContextObject::op_jump(MovieEnvironment& env)
 {
-    auto offset = env.bytecode->read_int16();
-    auto current = env.bytecode->get_position();
-    env.bytecode->set_position(current+offset);
+    env.jump(env.instruction->operand);
 }
 
 void ContextObject::op_if(MovieEnvironment& env)
 {
-    auto offset = env.bytecode->read_int16();
-    auto current = env.bytecode->get_position();
     if( env.pop().to_boolean() )
-        env.bytecode->set_position(current+offset);
+        env.jump(env.instruction->operand);
 }
 
 // void ContextObject::op_call(MovieEnvironment& env)
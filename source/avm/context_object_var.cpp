@@ -11,9 +11,8 @@ NS_AVM_BEGIN
 void ContextObject::op_define_local(MovieEnvironment& env)
 {
     auto value  = env.pop();
-    auto name   = env.pop().to_object<StringObject>();
-    
-    env.object->set_local_variable(name->c_str(), value);
+    auto name   = env.vm->intern(env.pop());
+    env.object->set_local_variable(name, value);
 }
 
 // sets the variable name in the current execution context to value.
@@ -22,18 +21,26 @@ void ContextObject::op_define_local(MovieEnvironment& env)
 void ContextObject::op_set_variable(MovieEnvironment& env)
 {
     auto value  = env.pop();
-    auto name   = env.pop().to_object<StringObject>();
-    env.object->set_variable(name->c_str(), value);
+    auto name   = env.vm->intern(env.pop());
+    auto& cache = env.bytecode->get_cache(env.instruction->operand);
+    env.object->set_variable(name, value, cache);
 }
 
 // pushes the value of the variable to the stack.
 // A variable in another execution context can be referenced by prefixing
 // the variable name with the target path and a colon.
+// names never interned can't be variables
 void ContextObject::op_get_variable(MovieEnvironment& env)
 {
-    auto name = env.pop().to_object<StringObject>();
-    assert(name != nullptr);
-    env.push( env.object->get_variable(name->c_str()) );
+    auto name = env.vm->find(env.pop());
+    if( name == nullptr )
+    {
+        env.push(Value());
+        return;
+    }
+
+    auto& cache = env.bytecode->get_cache(env.instruction->operand);
+    env.push( env.object->get_variable(name, cache) );
 }
 
 void ContextObject::op_set_member(MovieEnvironment& env)
@@ -42,13 +49,12 @@ void ContextObject::op_set_member(MovieEnvironment& env)
 
 void ContextObject::op_get_member(MovieEnvironment& env)
 {
-    auto name = env.pop().to_object<StringObject>();
-    assert(name != nullptr);
-
+    auto name = env.vm->find(env.pop());
     auto object = env.pop().to_object<ScriptObject>();
-    if( object != nullptr )
+    if( object != nullptr && name != nullptr )
     {
-        env.push( object->get_variable(name->c_str()) );
+        auto& cache = env.bytecode->get_cache(env.instruction->operand);
+        env.push( object->get_variable(name, cache) );
         return;
     }
 
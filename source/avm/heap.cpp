@@ -0,0 +1,295 @@
+#include "avm/heap.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+NS_AVM_BEGIN
+
+const static uint32_t   InitialNurserySize = 256;
+const static uint32_t   InitialThreshold = 1024;
+const static double     DefaultBudgetMs = 1.0;
+// objects marked or swept between checks of clock
+const static uint32_t   WorkPerCheck = 64;
+// work done by safepoints once frames can't keep up with allocations
+const static uint32_t   WorkPerSafepoint = 256;
+
+typedef std::chrono::steady_clock Clock;
+
+static double elapsed_ms(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+Heap::Heap()
+: m_young(nullptr), m_old(nullptr), m_promoted(nullptr), m_sweep(nullptr),
+m_phase(GCPhase::IDLE), m_tracing(Tracing::MINOR), m_nursery_size(InitialNurserySize),
+m_threshold(InitialThreshold), m_budget_ms(DefaultBudgetMs)
+{}
+
+Heap::~Heap()
+{
+    for( auto list : { m_young, m_old, m_promoted } )
+    {
+        for( auto object = list; object != nullptr; )
+        {
+            auto next = object->m_next;
+            destroy(object);
+            object = next;
+        }
+    }
+
+    for( auto root : m_roots )
+        delete root;
+}
+
+void Heap::track(GCObject* object)
+{
+    object->m_generation = GCGeneration::YOUNG;
+    object->m_heap = this;
+    object->m_next = m_young;
+    m_young = object;
+    m_stats.young_objects ++;
+}
+
+// slots are returned to free lists of slabs
+void Heap::destroy(GCObject* object)
+{
+    auto index = object->m_slab;
+    object->~GCObject();
+    m_slabs.free(object, index);
+}
+
+void Heap::add_root(GCObject* root)
+{
+    root->m_generation = GCGeneration::ROOT;
+    root->m_heap = this;
+    root->m_root = (uint32_t)m_roots.size();
+    m_roots.push_back(root);
+}
+
+// the last root is moved into the slot of removed one
+void Heap::remove_root(GCObject* root)
+{
+    assert( root->m_heap == this && m_roots[root->m_root] == root );
+
+    auto last = m_roots.back();
+    last->m_root = root->m_root;
+    m_roots[root->m_root] = last;
+    m_roots.pop_back();
+
+    root->m_root = 0;
+    root->m_heap = nullptr;
+}
+
+void Heap::remember(GCObject* young)
+{
+    young->m_remembered = true;
+    m_remembered.push_back(young);
+    m_stats.remembered ++;
+}
+
+// minor collections trace young objects only, major ones old objects only
+void Heap::shade(GCObject* object)
+{
+    if( object->m_color != GCColor::WHITE )
+        return;
+
+    if( m_tracing == Tracing::MINOR )
+    {
+        if( object->m_generation != GCGeneration::YOUNG )
+            return;
+        object->m_color = GCColor::GRAY;
+        m_young_gray.push_back(object);
+    }
+    else
+    {
+        if( object->m_generation != GCGeneration::OLD )
+            return;
+        object->m_color = GCColor::GRAY;
+        m_gray.push_back(object);
+    }
+}
+
+// young objects reachable from remembered ones survive. with old objects
+// being marked, they are promoted as black. they are kept apart from the old
+// list while sweeping, which would sweep them as white.
+void Heap::collect_young()
+{
+    m_tracing = Tracing::MINOR;
+    for( auto young : m_remembered )
+    {
+        young->m_remembered = false;
+        shade(young);
+    }
+    m_remembered.clear();
+
+    while( !m_young_gray.empty() )
+    {
+        auto object = m_young_gray.back();
+        m_young_gray.pop_back();
+        object->m_color = GCColor::BLACK;
+        object->trace(*this);
+    }
+
+    auto survivor = m_phase == GCPhase::MARK ? GCColor::BLACK : GCColor::WHITE;
+    auto& promoted = m_phase == GCPhase::SWEEP ? m_promoted : m_old;
+    for( auto object = m_young; object != nullptr; )
+    {
+        auto next = object->m_next;
+        if( object->m_color == GCColor::BLACK )
+        {
+            object->m_generation = GCGeneration::OLD;
+            object->m_color = survivor;
+            object->m_next = promoted;
+            promoted = object;
+            m_stats.old_objects ++;
+            m_stats.promoted ++;
+        }
+        else
+        {
+            destroy(object);
+            m_stats.freed ++;
+        }
+        object = next;
+    }
+
+    m_young = nullptr;
+    m_stats.young_objects = 0;
+    m_stats.minor_collections ++;
+}
+
+// roots are traced at once, stores into them are shaded by barriers since
+void Heap::begin_major()
+{
+    collect_young();
+
+    m_phase = GCPhase::MARK;
+    m_tracing = Tracing::MAJOR;
+    for( auto root : m_roots )
+        root->trace(*this);
+}
+
+bool Heap::advance(uint32_t work)
+{
+    for( ; work > 0; work-- )
+    {
+        if( m_phase == GCPhase::MARK )
+        {
+            // the nursery is emptied before sweeping, objects promoted
+            // since are kept apart
+            if( m_gray.empty() )
+            {
+                collect_young();
+                m_phase = GCPhase::SWEEP;
+                m_sweep = &m_old;
+                continue;
+            }
+
+            auto object = m_gray.back();
+            m_gray.pop_back();
+            object->m_color = GCColor::BLACK;
+            m_tracing = Tracing::MAJOR;
+            object->trace(*this);
+        }
+        else if( m_phase == GCPhase::SWEEP )
+        {
+            auto object = *m_sweep;
+            if( object == nullptr )
+            {
+                // objects promoted while sweeping are put back in front
+                while( m_promoted != nullptr )
+                {
+                    auto next = m_promoted->m_next;
+                    m_promoted->m_next = m_old;
+                    m_old = m_promoted;
+                    m_promoted = next;
+                }
+
+                m_sweep = nullptr;
+                m_phase = GCPhase::IDLE;
+                m_threshold = std::max(InitialThreshold, m_stats.old_objects * 2);
+                m_stats.major_collections ++;
+                return true;
+            }
+
+            if( object->m_color == GCColor::WHITE )
+            {
+                *m_sweep = object->m_next;
+                destroy(object);
+                m_stats.old_objects --;
+                m_stats.freed ++;
+            }
+            else
+            {
+                object->m_color = GCColor::WHITE;
+                m_sweep = &object->m_next;
+            }
+        }
+        else
+            return true;
+    }
+
+    return m_phase == GCPhase::IDLE;
+}
+
+void Heap::record_pause(double ms)
+{
+    auto bucket = 0;
+    while( bucket < GCPauseBuckets-1 && ms > GCPauseBounds[bucket] )
+        bucket ++;
+
+    m_stats.pauses[bucket] ++;
+    m_stats.pause_total_ms += ms;
+    m_stats.pause_max_ms = std::max(m_stats.pause_max_ms, ms);
+}
+
+void Heap::safepoint()
+{
+    auto behind = m_stats.old_objects >= m_threshold * 2;
+    if( m_stats.young_objects < m_nursery_size && !behind )
+        return;
+
+    auto start = Clock::now();
+    if( m_stats.young_objects >= m_nursery_size )
+        collect_young();
+
+    if( behind )
+    {
+        if( m_phase == GCPhase::IDLE )
+            begin_major();
+        advance(WorkPerSafepoint);
+    }
+
+    record_pause(elapsed_ms(start));
+}
+
+void Heap::step(double budget_ms)
+{
+    if( m_phase == GCPhase::IDLE &&
+        m_stats.old_objects + m_stats.young_objects < m_threshold )
+        return;
+
+    auto start = Clock::now();
+    if( m_phase == GCPhase::IDLE )
+        begin_major();
+
+    while( !advance(WorkPerCheck) && elapsed_ms(start) < budget_ms ) {}
+
+    m_stats.steps ++;
+    record_pause(elapsed_ms(start));
+}
+
+void Heap::collect()
+{
+    auto start = Clock::now();
+
+    // a major collection in progress may have missed garbage made since
+    while( !advance(WorkPerCheck) ) {}
+
+    begin_major();
+    while( !advance(WorkPerCheck) ) {}
+
+    record_pause(elapsed_ms(start));
+}
+
+NS_AVM_END
@@ -0,0 +1,202 @@
+#pragma once
+
+#include "avm/avm.hpp"
+#include "avm/object.hpp"
+#include "avm/value.hpp"
+#include "avm/slab.hpp"
+#include "avm/shape.hpp"
+
+#include <new>
+#include <vector>
+
+NS_AVM_BEGIN
+
+const static int GCPauseBuckets = 10;
+// upper bounds of pauses in histogram by milliseconds, the last is unbounded
+const static double GCPauseBounds[GCPauseBuckets-1] = { 0.05, 0.1, 0.25, 0.5, 1, 2, 4, 8, 16 };
+
+enum class GCPhase : uint8_t
+{
+    IDLE = 0,
+    MARK,
+    SWEEP
+};
+
+struct GCStats
+{
+    uint32_t young_objects;
+    uint32_t old_objects;
+    uint32_t minor_collections;
+    uint32_t major_collections;
+    uint32_t steps;             // slices of major collections
+    uint32_t remembered;        // young objects stored into older ones
+    uint64_t promoted;
+    uint64_t freed;
+    uint64_t allocated_bytes;
+
+    double   pause_total_ms;
+    double   pause_max_ms;
+    uint32_t pauses[GCPauseBuckets];
+
+    GCStats()
+    : young_objects(0), old_objects(0), minor_collections(0), major_collections(0),
+    steps(0), remembered(0), promoted(0), freed(0), allocated_bytes(0), pause_total_ms(0), pause_max_ms(0)
+    {
+        for( auto i=0; i<GCPauseBuckets; i++ ) pauses[i] = 0;
+    }
+};
+
+// a generational heap collected incrementally. objects are allocated into the
+// nursery, which is collected at once when it's full, survivors are promoted
+// to the old generation. old objects are marked and swept in slices of a time
+// budget, usually once a frame.
+//
+// both collections rely on write barriers of stores into variables: young
+// objects stored into older ones are remembered as roots of the nursery, and
+// objects stored while marking are shaded so that nothing reachable is left
+// white. a remembered object survives the next minor collection even if it's
+// overwritten since, it's left to major ones then. collections only happen
+// between executions of scripts, when there are no values on stacks of
+// environments.
+class Heap
+{
+protected:
+    enum class Tracing : uint8_t { MINOR, MAJOR };
+
+    GCObject*               m_young;
+    GCObject*               m_old;
+    GCObject*               m_promoted;     // while sweeping
+    GCObject**              m_sweep;
+
+    std::vector<GCObject*>  m_roots;
+    std::vector<GCObject*>  m_remembered;
+    std::vector<GCObject*>  m_gray;
+    std::vector<GCObject*>  m_young_gray;
+
+    GCPhase                 m_phase;
+    Tracing                 m_tracing;
+    uint32_t                m_nursery_size;
+    uint32_t                m_threshold;
+    double                  m_budget_ms;
+    GCStats                 m_stats;
+    SlabAllocator           m_slabs;
+    ShapeTree               m_shapes;
+
+    void track(GCObject*);
+    void destroy(GCObject*);
+    void remember(GCObject* young);
+    void collect_young();
+    void begin_major();
+    // returns true once the major collection is finished
+    bool advance(uint32_t work);
+    void record_pause(double ms);
+
+public:
+    Heap();
+    ~Heap();
+
+    // objects are placed in slabs of heap, and are destroyed by it
+    template<typename T> T* allocate()
+    {
+        auto index = SlabAllocator::get_class(sizeof(T));
+        auto object = new (m_slabs.allocate(index, sizeof(T))) T();
+        object->m_slab = index;
+        m_stats.allocated_bytes += sizeof(T);
+        track(object);
+        return object;
+    }
+
+    // roots are traced by every major collection until removed, both in
+    // constant time
+    void add_root(GCObject*);
+    void remove_root(GCObject*);
+
+    inline void shade(const Value&);
+    void        shade(GCObject*);
+    inline void write_barrier(GCObject* owner, const Value&);
+
+    // called after each execution, collects nursery if it's full
+    void safepoint();
+    // advances a major collection within the budget, starting one if needed
+    void step();
+    void step(double budget_ms);
+    // finishes all of the work at once
+    void collect();
+
+    void set_nursery_size(uint32_t objects);
+    void set_budget(double ms);
+
+    GCPhase             get_phase() const;
+    uint32_t            get_root_count() const;
+    const GCStats&      get_stats() const;
+    const SlabStats&    get_slab_stats() const;
+    ShapeTree&          get_shapes();
+};
+
+// INLINE METHODS
+
+inline void Heap::shade(const Value& value)
+{
+    if( value.is_object() )
+        shade(value.get_object());
+}
+
+inline void Heap::write_barrier(GCObject* owner, const Value& value)
+{
+    if( !value.is_object() )
+        return;
+
+    auto object = value.get_object();
+    if( object->m_generation == GCGeneration::YOUNG &&
+        owner->m_generation != GCGeneration::YOUNG && !object->m_remembered )
+        remember(object);
+
+    if( m_phase == GCPhase::MARK && object->m_color == GCColor::WHITE &&
+        object->m_generation == GCGeneration::OLD )
+    {
+        m_tracing = Tracing::MAJOR;
+        shade(object);
+    }
+}
+
+inline void Heap::step()
+{
+    step(m_budget_ms);
+}
+
+inline void Heap::set_nursery_size(uint32_t objects)
+{
+    m_nursery_size = objects;
+}
+
+inline void Heap::set_budget(double ms)
+{
+    m_budget_ms = ms;
+}
+
+inline GCPhase Heap::get_phase() const
+{
+    return m_phase;
+}
+
+inline uint32_t Heap::get_root_count() const
+{
+    return (uint32_t)m_roots.size();
+}
+
+inline const GCStats& Heap::get_stats() const
+{
+    return m_stats;
+}
+
+inline ShapeTree& Heap::get_shapes()
+{
+    return m_shapes;
+}
+
+inline const SlabStats& Heap::get_slab_stats() const
+{
+    return m_slabs.get_stats();
+}
+
+NS_AVM_END
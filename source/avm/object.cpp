@@ -2,14 +2,12 @@
 
 NS_AVM_BEGIN
 
-void GCObject::mark(uint8_t v)
-{
-    m_marked = v;
-}
+void GCObject::trace(Heap&)
+{}
 
 std::string GCObject::to_string() const
 {
     return "[type GCObject]";
 }
 
-NS_AVM_END
\ No newline at end of file
+NS_AVM_END
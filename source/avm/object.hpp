@@ -6,20 +6,51 @@
 
 NS_AVM_BEGIN
 
+enum class GCColor : uint8_t
+{
+    WHITE = 0,  // not reached yet
+    GRAY,       // reached, with references not traced yet
+    BLACK       // reached and traced
+};
+
+enum class GCGeneration : uint8_t
+{
+    PERMANENT = 0,  // not managed by heap
+    ATOM,           // strings interned by StringTable
+    ROOT,           // contexts, which are freed explicitly
+    OLD,
+    YOUNG
+};
+
+class Heap;
 class GCObject
 {
-    friend class VirtualMachine;
+    friend class Heap;
+    friend class StringTable;
 
 private:
-    uint8_t     m_marked;
-    GCObject*   m_next;
+    GCColor         m_color;
+    GCGeneration    m_generation;
+    bool            m_remembered;
+    uint8_t         m_slab;         // class of slab allocated from
+    uint32_t        m_root;         // index in roots of heap
+    GCObject*       m_next;
+
+protected:
+    Heap*           m_heap;
 
 public:
-    GCObject() : m_marked(0), m_next(nullptr) {}
+    GCObject()
+    : m_color(GCColor::WHITE), m_generation(GCGeneration::PERMANENT),
+    m_remembered(false), m_slab(0xFF), m_root(0), m_next(nullptr), m_heap(nullptr) {}
+    virtual ~GCObject() {}
+
+    GCColor         get_color() const { return m_color; }
+    GCGeneration    get_generation() const { return m_generation; }
 
-    uint8_t get_marked_value() const { return m_marked; }
-    virtual void mark(uint8_t v);
+    // shades objects referenced by this one, see Heap::shade
+    virtual void trace(Heap&);
     virtual std::string to_string() const;
 };
 
-NS_AVM_END
\ No newline at end of file
+NS_AVM_END
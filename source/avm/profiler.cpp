@@ -0,0 +1,228 @@
+#include "avm/profiler.hpp"
+#include "avm/context_object.hpp"
+
+#include <algorithm>
+#include <cstdarg>
+#include <cstdio>
+
+NS_AVM_BEGIN
+
+Profiler::Profiler(const Heap& heap)
+: m_heap(heap)
+{
+    reset();
+}
+
+void Profiler::reset()
+{
+    m_gc = m_heap.get_stats();
+    for( auto& profile : m_opcodes )
+        profile = OpcodeProfile();
+    m_instructions = 0;
+
+    // executions in progress go on with fresh entries
+    m_actions.clear();
+    m_action_index.clear();
+    m_contexts.clear();
+    m_context_index.clear();
+    for( auto& execution : m_executions )
+    {
+        execution.instructions = 0;
+        execution.action = (uint32_t)-1;
+        execution.context = (uint32_t)-1;
+    }
+}
+
+uint32_t Profiler::get_action(ActionSite site)
+{
+    auto key = ((uint32_t)site.sprite << 16) | site.frame;
+    auto found = m_action_index.find(key);
+    if( found != m_action_index.end() )
+        return found->second;
+
+    auto index = (uint32_t)m_actions.size();
+    m_actions.push_back(ActionProfile());
+    m_actions.back().site = site;
+    m_action_index[key] = index;
+    return index;
+}
+
+uint32_t Profiler::get_context(const ContextObject& context)
+{
+    auto found = m_context_index.find(&context);
+    if( found != m_context_index.end() )
+        return found->second;
+
+    auto index = (uint32_t)m_contexts.size();
+    m_contexts.push_back(ContextProfile());
+    m_contexts.back().name = context.to_string();
+    m_context_index[&context] = index;
+    return index;
+}
+
+void Profiler::begin(const ContextObject& context, ActionSite site)
+{
+    Execution execution;
+    execution.instructions = m_instructions;
+    execution.action = get_action(site);
+    execution.context = get_context(context);
+    execution.start = Clock::now();
+    m_executions.push_back(execution);
+}
+
+void Profiler::end()
+{
+    assert( !m_executions.empty() );
+
+    auto& execution = m_executions.back();
+    auto ms = std::chrono::duration<double, std::milli>(Clock::now() - execution.start).count();
+    auto instructions = m_instructions - execution.instructions;
+
+    if( execution.action < m_actions.size() )
+    {
+        auto& action = m_actions[execution.action];
+        action.executions ++;
+        action.instructions += instructions;
+        action.ms += ms;
+    }
+
+    if( execution.context < m_contexts.size() )
+    {
+        auto& context = m_contexts[execution.context];
+        context.executions ++;
+        context.instructions += instructions;
+        context.ms += ms;
+    }
+
+    m_executions.pop_back();
+}
+
+void Profiler::forget(const ContextObject* context)
+{
+    auto found = m_context_index.find(context);
+    if( found == m_context_index.end() )
+        return;
+
+    m_contexts[found->second].freed = true;
+    m_context_index.erase(found);
+}
+
+GCProfile Profiler::get_gc() const
+{
+    auto& stats = m_heap.get_stats();
+
+    GCProfile profile;
+    profile.minor_collections = stats.minor_collections - m_gc.minor_collections;
+    profile.major_collections = stats.major_collections - m_gc.major_collections;
+    profile.steps = stats.steps - m_gc.steps;
+    profile.allocated_bytes = stats.allocated_bytes - m_gc.allocated_bytes;
+    profile.freed = stats.freed - m_gc.freed;
+    profile.pause_total_ms = stats.pause_total_ms - m_gc.pause_total_ms;
+    profile.pause_max_ms = stats.pause_max_ms;
+    profile.slab_bytes = m_heap.get_slab_stats().bytes;
+    return profile;
+}
+
+/// JSON
+
+static void append(std::string& json, const char* format, ...)
+{
+    char buffer[256];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+    json += buffer;
+}
+
+static void append_string(std::string& json, const std::string& str)
+{
+    json += '"';
+    for( auto ch : str )
+    {
+        if( ch == '"' || ch == '\\' )
+        {
+            json += '\\';
+            json += ch;
+        }
+        else if( (uint8_t)ch < 0x20 )
+            append(json, "\\u%04x", (uint32_t)(uint8_t)ch);
+        else
+            json += ch;
+    }
+    json += '"';
+}
+
+// names of opcodes are padded for traces
+static std::string get_opcode_name(Opcode code)
+{
+    std::string name = opcode_to_string(code);
+    name.erase(name.find_last_not_of(' ') + 1);
+    return name;
+}
+
+template<typename T> static std::vector<const T*> sort_by_time(const std::vector<T>& profiles)
+{
+    std::vector<const T*> sorted;
+    for( auto& profile : profiles )
+        sorted.push_back(&profile);
+
+    std::stable_sort(sorted.begin(), sorted.end(),
+        [](const T* lh, const T* rh) { return lh->ms > rh->ms; });
+    return sorted;
+}
+
+std::string Profiler::to_json() const
+{
+    std::string json;
+    append(json, "{\n  \"instructions\": %llu,\n  \"opcodes\": [", (unsigned long long)m_instructions);
+
+    auto first = true;
+    for( auto code=0; code<256; code++ )
+    {
+        auto& profile = m_opcodes[code];
+        if( profile.instructions == 0 )
+            continue;
+
+        append(json, "%s\n    { \"code\": %d, \"name\": ", first ? "" : ",", code);
+        append_string(json, get_opcode_name((Opcode)code));
+        append(json, ", \"instructions\": %llu, \"ms\": %.6f }",
+            (unsigned long long)profile.instructions, profile.ms);
+        first = false;
+    }
+
+    json += "\n  ],\n  \"actions\": [";
+    first = true;
+    for( auto action : sort_by_time(m_actions) )
+    {
+        append(json, "%s\n    { \"sprite\": %u, \"frame\": %u, \"executions\": %llu, "
+            "\"instructions\": %llu, \"ms\": %.6f }",
+            first ? "" : ",", action->site.sprite, action->site.frame,
+            (unsigned long long)action->executions, (unsigned long long)action->instructions,
+            action->ms);
+        first = false;
+    }
+
+    json += "\n  ],\n  \"contexts\": [";
+    first = true;
+    for( auto context : sort_by_time(m_contexts) )
+    {
+        append(json, "%s\n    { \"name\": ", first ? "" : ",");
+        append_string(json, context->name);
+        append(json, ", \"freed\": %s, \"executions\": %llu, \"instructions\": %llu, \"ms\": %.6f }",
+            context->freed ? "true" : "false", (unsigned long long)context->executions,
+            (unsigned long long)context->instructions, context->ms);
+        first = false;
+    }
+
+    auto gc = get_gc();
+    append(json, "\n  ],\n  \"gc\": { \"minor_collections\": %u, \"major_collections\": %u, "
+        "\"steps\": %u, ", gc.minor_collections, gc.major_collections, gc.steps);
+    append(json, "\"allocated_bytes\": %llu, \"freed\": %llu, ",
+        (unsigned long long)gc.allocated_bytes, (unsigned long long)gc.freed);
+    append(json, "\"pause_total_ms\": %.6f, \"pause_max_ms\": %.6f, \"slab_bytes\": %llu }\n}\n",
+        gc.pause_total_ms, gc.pause_max_ms, (unsigned long long)gc.slab_bytes);
+    return json;
+}
+
+NS_AVM_END
@@ -0,0 +1,166 @@
+#pragma once
+
+#include "avm/avm.hpp"
+#include "avm/opcode.hpp"
+#include "avm/heap.hpp"
+
+#include <chrono>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+NS_AVM_BEGIN
+
+// where a block of actions comes from, the frame counts from 1. blocks
+// executed by host have no site.
+struct ActionSite
+{
+    uint16_t sprite;
+    uint16_t frame;
+
+    ActionSite() : sprite(0), frame(0) {}
+    ActionSite(uint16_t s, uint16_t f) : sprite(s), frame(f) {}
+};
+
+struct OpcodeProfile
+{
+    uint64_t instructions;
+    double   ms;
+
+    OpcodeProfile() : instructions(0), ms(0) {}
+};
+
+struct ActionProfile
+{
+    ActionSite  site;
+    uint64_t    executions;
+    uint64_t    instructions;
+    double      ms;
+
+    ActionProfile() : executions(0), instructions(0), ms(0) {}
+};
+
+struct ContextProfile
+{
+    std::string name;           // of movie node at first execution
+    bool        freed;
+    uint64_t    executions;
+    uint64_t    instructions;
+    double      ms;
+
+    ContextProfile() : freed(false), executions(0), instructions(0), ms(0) {}
+};
+
+// collections since profiling started
+struct GCProfile
+{
+    uint32_t minor_collections;
+    uint32_t major_collections;
+    uint32_t steps;
+    uint64_t allocated_bytes;
+    uint64_t freed;
+    double   pause_total_ms;
+    double   pause_max_ms;       // of all time
+    uint64_t slab_bytes;         // currently in pages
+
+    GCProfile()
+    : minor_collections(0), major_collections(0), steps(0), allocated_bytes(0),
+    freed(0), pause_total_ms(0), pause_max_ms(0), slab_bytes(0) {}
+};
+
+// counts instructions and time spent by scripts, by opcodes, by blocks of
+// actions and by contexts. it's created by the virtual machine once
+// profiling is enabled, which executes blocks with a dispatch loop timing
+// every instruction then. executions nested in others are counted by both
+// of blocks and contexts.
+class Profiler
+{
+    typedef std::chrono::steady_clock Clock;
+
+protected:
+    struct Execution
+    {
+        Clock::time_point   start;
+        uint64_t            instructions;
+        uint32_t            action;
+        uint32_t            context;
+    };
+
+    const Heap&                                     m_heap;
+    GCStats                                         m_gc;
+    OpcodeProfile                                   m_opcodes[256];
+    uint64_t                                        m_instructions;
+    std::vector<ActionProfile>                      m_actions;
+    std::unordered_map<uint32_t, uint32_t>          m_action_index;
+    std::vector<ContextProfile>                     m_contexts;
+    std::unordered_map<const ContextObject*, uint32_t> m_context_index;
+    std::vector<Execution>                          m_executions;
+    Clock::time_point                               m_last;
+
+    uint32_t get_action(ActionSite);
+    uint32_t get_context(const ContextObject&);
+
+public:
+    Profiler(const Heap& heap);
+
+    // clears all of the counts, as if profiling started just now
+    void reset();
+
+    // called by virtual machine around executions of blocks, and by
+    // contexts in between, once before the first instruction and after each
+    // one, which starts the next.
+    void begin(const ContextObject&, ActionSite);
+    void end();
+    inline void start_instruction();
+    inline void finish_instruction(Opcode);
+    // freed contexts are kept in results, but not matched by address
+    void forget(const ContextObject*);
+
+    uint64_t                            get_instruction_count() const;
+    const OpcodeProfile&                get_opcode(Opcode) const;
+    const std::vector<ActionProfile>&   get_actions() const;
+    const std::vector<ContextProfile>&  get_contexts() const;
+    GCProfile                           get_gc() const;
+
+    // results as a json object, with blocks and contexts sorted by time
+    std::string to_json() const;
+};
+
+// INLINE METHODS
+
+inline void Profiler::start_instruction()
+{
+    m_last = Clock::now();
+}
+
+inline void Profiler::finish_instruction(Opcode code)
+{
+    auto now = Clock::now();
+    auto& profile = m_opcodes[(uint8_t)code];
+    profile.instructions ++;
+    profile.ms += std::chrono::duration<double, std::milli>(now - m_last).count();
+    m_instructions ++;
+    m_last = now;
+}
+
+inline uint64_t Profiler::get_instruction_count() const
+{
+    return m_instructions;
+}
+
+inline const OpcodeProfile& Profiler::get_opcode(Opcode code) const
+{
+    return m_opcodes[(uint8_t)code];
+}
+
+inline const std::vector<ActionProfile>& Profiler::get_actions() const
+{
+    return m_actions;
+}
+
+inline const std::vector<ContextProfile>& Profiler::get_contexts() const
+{
+    return m_contexts;
+}
+
+NS_AVM_END
@@ -1,34 +1,108 @@
 #include "avm/script_object.hpp"
 #include "avm/string_object.hpp"
+#include "avm/bytecode.hpp"
 
 NS_AVM_BEGIN
 
-void ScriptObject::mark(uint8_t v)
+void ScriptObject::trace(Heap& heap)
 {
-    if( get_marked_value() != 0 )
-        return;
+    for( auto& value : m_slots )
+        heap.shade(value);
+
+    if( m_dictionary != nullptr )
+    {
+        for( auto& pair : *m_dictionary )
+            heap.shade(pair.second);
+    }
+}
+
+void ScriptObject::to_dictionary()
+{
+    m_dictionary.reset(new VariableMap());
+    for( auto shape = m_shape; shape != nullptr && shape->get_name() != nullptr; shape = shape->get_parent() )
+        (*m_dictionary)[shape->get_name()] = m_slots[shape->get_count()-1];
 
-    GCObject::mark(v);
+    m_shape = nullptr;
+    m_slots.clear();
+    m_slots.shrink_to_fit();
+}
 
-    for( auto pair : m_variables )
+void ScriptObject::set_variable(const StringObject* name, Value value)
+{
+    assert( name->is_atom() );
+    if( m_heap != nullptr )
+        m_heap->write_barrier(this, value);
+
+    if( m_dictionary == nullptr )
     {
-        auto object = pair.second.to_object();
-        if( object != nullptr ) object->mark(v);
+        auto slot = m_shape != nullptr ? m_shape->find(name) : -1;
+        if( slot >= 0 )
+        {
+            m_slots[slot] = value;
+            return;
+        }
+
+        if( m_heap != nullptr && m_slots.size() < MaxShapeSlots )
+        {
+            auto& shapes = m_heap->get_shapes();
+            m_shape = shapes.transition(m_shape != nullptr ? m_shape : shapes.get_empty(), name);
+            m_slots.push_back(value);
+            return;
+        }
+
+        to_dictionary();
     }
+
+    (*m_dictionary)[name] = value;
 }
 
-void ScriptObject::set_variable(const char* name, Value value)
+Value ScriptObject::get_variable(const StringObject* name)
 {
-    // printf("set variable %s -> %s\n", name, value.to_string().c_str());
-    m_variables[name] = value;
+    if( m_dictionary != nullptr )
+    {
+        auto found = m_dictionary->find(name);
+        if( found != m_dictionary->end() )
+            return found->second;
+        return Value();
+    }
+
+    auto slot = m_shape != nullptr ? m_shape->find(name) : -1;
+    return slot >= 0 ? m_slots[slot] : Value();
+}
+
+// only slots of shapes are cached, dictionaries have no shapes to hit
+void ScriptObject::update_cache(const StringObject* name, InlineCache& cache) const
+{
+    auto slot = m_shape != nullptr ? m_shape->find(name) : -1;
+    if( slot >= 0 )
+    {
+        cache.shape = m_shape;
+        cache.name = name;
+        cache.slot = slot;
+    }
+}
+
+void ScriptObject::set_variable(const StringObject* name, Value value, InlineCache& cache)
+{
+    if( cache.hit(m_shape, name) )
+    {
+        if( m_heap != nullptr )
+            m_heap->write_barrier(this, value);
+        m_slots[cache.slot] = value;
+        return;
+    }
+
+    set_variable(name, value);
+    update_cache(name, cache);
 }
 
-Value ScriptObject::get_variable(const char* name)
+Value ScriptObject::get_variable(const StringObject* name, InlineCache& cache)
 {
-    auto found = m_variables.find(name);
-    if( found != m_variables.end() )
-        return found->second;
-    return Value();
+    if( cache.hit(m_shape, name) )
+        return m_slots[cache.slot];
+
+    update_cache(name, cache);
+    return get_variable(name);
 }
 
-NS_AVM_END
\ No newline at end of file
+NS_AVM_END
@@ -3,21 +3,56 @@
 #include "avm/avm.hpp"
 #include "avm/object.hpp"
 #include "avm/value.hpp"
+#include "avm/string_object.hpp"
+#include "avm/shape.hpp"
+#include "avm/heap.hpp"
 
-#include <unordered_map>
-#include <string>
+#include <memory>
+#include <vector>
 
 NS_AVM_BEGIN
 
+struct InlineCache;
+
+// variables are kept in slots laid out by the shape of object, which is
+// null until the first variable is set. objects grown beyond MaxShapeSlots,
+// or not managed by a heap, keep them in a dictionary instead.
 class ScriptObject : public GCObject
 {
 protected:
-    std::unordered_map<std::string, Value> m_variables;
+    const Shape*                    m_shape;
+    std::vector<Value>              m_slots;
+    std::unique_ptr<VariableMap>    m_dictionary;
+
+    void to_dictionary();
+    void update_cache(const StringObject* name, InlineCache& cache) const;
 
 public:
-    virtual void    mark(uint8_t);
-    virtual void    set_variable(const char*, Value);
-    virtual Value   get_variable(const char*);
+    ScriptObject() : m_shape(nullptr) {}
+
+    virtual void    trace(Heap&);
+    virtual void    set_variable(const StringObject*, Value);
+    virtual Value   get_variable(const StringObject*);
+
+    // accesses variables through inline cache of an instruction, which is
+    // updated on misses
+    virtual void    set_variable(const StringObject*, Value, InlineCache&);
+    virtual Value   get_variable(const StringObject*, InlineCache&);
+
+    const Shape*    get_shape() const;
+    bool            is_dictionary() const;
 };
 
-NS_AVM_END
\ No newline at end of file
+// INLINE METHODS
+
+inline const Shape* ScriptObject::get_shape() const
+{
+    return m_shape;
+}
+
+inline bool ScriptObject::is_dictionary() const
+{
+    return m_dictionary != nullptr;
+}
+
+NS_AVM_END
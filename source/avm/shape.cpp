@@ -0,0 +1,53 @@
+#include "avm/shape.hpp"
+
+NS_AVM_BEGIN
+
+const static uint32_t ShapeWalkLimit = 8;
+
+int32_t Shape::find(const StringObject* name) const
+{
+    if( m_count <= ShapeWalkLimit )
+    {
+        for( auto shape = this; shape->m_parent != nullptr; shape = shape->m_parent )
+        {
+            if( shape->m_name == name )
+                return shape->m_count - 1;
+        }
+        return -1;
+    }
+
+    if( m_index == nullptr )
+    {
+        m_index.reset(new Index());
+        for( auto shape = this; shape->m_parent != nullptr; shape = shape->m_parent )
+            (*m_index)[shape->m_name] = shape->m_count - 1;
+    }
+
+    auto found = m_index->find(name);
+    return found != m_index->end() ? (int32_t)found->second : -1;
+}
+
+ShapeTree::ShapeTree()
+{
+    m_shapes.push_back(std::unique_ptr<Shape>(new Shape()));
+}
+
+const Shape* ShapeTree::transition(const Shape* shape, const StringObject* name)
+{
+    // shapes are shared and immutable except for their transitions
+    auto parent = const_cast<Shape*>(shape);
+    auto found = parent->m_transitions.find(name);
+    if( found != parent->m_transitions.end() )
+        return found->second;
+
+    auto child = new Shape();
+    child->m_parent = parent;
+    child->m_name = name;
+    child->m_count = parent->m_count + 1;
+
+    m_shapes.push_back(std::unique_ptr<Shape>(child));
+    parent->m_transitions[name] = child;
+    return child;
+}
+
+NS_AVM_END
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "avm/avm.hpp"
+#include "avm/value.hpp"
+#include "avm/string_object.hpp"
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+NS_AVM_BEGIN
+
+// variables are named by atoms, see StringTable
+typedef std::unordered_map<const StringObject*, Value, AtomHash> VariableMap;
+
+// objects with more variables than this are kept as dictionaries
+const static uint32_t MaxShapeSlots = 64;
+
+// a hidden class of objects, which maps names of variables to slots. shapes
+// are immutable, adding a variable moves an object to the child shape of
+// that name, so objects adding the same names in the same order share
+// shapes.
+class Shape
+{
+    friend class ShapeTree;
+    typedef std::unordered_map<const StringObject*, uint32_t, AtomHash> Index;
+
+protected:
+    const Shape*            m_parent;
+    const StringObject*     m_name;     // of the last slot
+    uint32_t                m_count;
+    std::unordered_map<const StringObject*, Shape*, AtomHash> m_transitions;
+    // built at first lookup of long shapes, short ones walk their parents
+    mutable std::unique_ptr<Index> m_index;
+
+public:
+    Shape() : m_parent(nullptr), m_name(nullptr), m_count(0) {}
+
+    uint32_t            get_count() const;
+    const StringObject* get_name() const;
+    const Shape*        get_parent() const;
+    // returns -1 if there is no slot of name
+    int32_t             find(const StringObject* name) const;
+};
+
+// shapes of a virtual machine, which live as long as it does
+class ShapeTree
+{
+protected:
+    std::vector<std::unique_ptr<Shape>> m_shapes;
+
+public:
+    ShapeTree();
+
+    const Shape*    get_empty() const;
+    // returns the shape with name added to shape
+    const Shape*    transition(const Shape* shape, const StringObject* name);
+    uint32_t        get_count() const;
+};
+
+// INLINE METHODS
+
+inline uint32_t Shape::get_count() const
+{
+    return m_count;
+}
+
+inline const StringObject* Shape::get_name() const
+{
+    return m_name;
+}
+
+inline const Shape* Shape::get_parent() const
+{
+    return m_parent;
+}
+
+inline const Shape* ShapeTree::get_empty() const
+{
+    return m_shapes.front().get();
+}
+
+inline uint32_t ShapeTree::get_count() const
+{
+    return (uint32_t)m_shapes.size();
+}
+
+NS_AVM_END
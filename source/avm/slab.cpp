@@ -0,0 +1,33 @@
+#include "avm/slab.hpp"
+
+NS_AVM_BEGIN
+
+SlabAllocator::SlabAllocator()
+{
+    for( auto i=0; i<SlabClasses; i++ )
+    {
+        m_classes[i].free = nullptr;
+        m_classes[i].cursor = nullptr;
+        m_classes[i].end = nullptr;
+    }
+}
+
+// pages are aligned by the global allocator, and sizes of slots are multiples
+// of the granularity, so are the slots.
+void* SlabAllocator::allocate_page(uint8_t index)
+{
+    auto size = (index + 1) * SlabGranularity;
+    auto count = SlabPageSize / size;
+
+    m_pages.push_back(std::unique_ptr<uint8_t[]>(new uint8_t[count * size]));
+    m_stats.pages ++;
+    m_stats.bytes += count * size;
+
+    auto& sc = m_classes[index];
+    auto slot = m_pages.back().get();
+    sc.cursor = slot + size;
+    sc.end = slot + count * size;
+    return slot;
+}
+
+NS_AVM_END
@@ -0,0 +1,122 @@
+#pragma once
+
+#include "avm/avm.hpp"
+
+#include <memory>
+#include <vector>
+
+NS_AVM_BEGIN
+
+const static int SlabGranularity = 16;
+const static int SlabClasses = 16;
+// sizes above it are allocated from the global allocator
+const static int SlabMaxSize = SlabGranularity * SlabClasses;
+const static int SlabPageSize = 16 * 1024;
+const static uint8_t SlabLarge = 0xFF;
+
+struct SlabStats
+{
+    uint32_t pages;
+    uint64_t bytes;         // of pages
+    uint32_t slots;         // allocated ones
+    uint32_t large;         // allocations from global allocator
+
+    SlabStats() : pages(0), bytes(0), slots(0), large(0) {}
+};
+
+// allocates memory by classes of size, each of which carves slots out of
+// pages of its own. freed slots are linked into free lists of their classes
+// and reused first, pages are kept until the allocator is destroyed. slots
+// of the same class are contiguous, as are objects allocated one after
+// another.
+class SlabAllocator
+{
+protected:
+    struct FreeSlot
+    {
+        FreeSlot* next;
+    };
+
+    struct SizeClass
+    {
+        FreeSlot*   free;
+        uint8_t*    cursor;
+        uint8_t*    end;
+    };
+
+    SizeClass                               m_classes[SlabClasses];
+    std::vector<std::unique_ptr<uint8_t[]>> m_pages;
+    SlabStats                               m_stats;
+
+    void* allocate_page(uint8_t index);
+
+public:
+    SlabAllocator();
+
+    // returns the class of size, or SlabLarge
+    static uint8_t get_class(size_t size);
+
+    void* allocate(uint8_t index, size_t size);
+    void  free(void* memory, uint8_t index);
+
+    const SlabStats& get_stats() const;
+};
+
+// INLINE METHODS
+
+inline uint8_t SlabAllocator::get_class(size_t size)
+{
+    if( size == 0 || size > SlabMaxSize )
+        return SlabLarge;
+    return (uint8_t)((size + SlabGranularity - 1) / SlabGranularity - 1);
+}
+
+inline void* SlabAllocator::allocate(uint8_t index, size_t size)
+{
+    if( index == SlabLarge )
+    {
+        m_stats.large ++;
+        return ::operator new(size);
+    }
+
+    auto& sc = m_classes[index];
+    m_stats.slots ++;
+    if( sc.free != nullptr )
+    {
+        auto slot = sc.free;
+        sc.free = slot->next;
+        return slot;
+    }
+
+    if( sc.cursor != sc.end )
+    {
+        auto slot = sc.cursor;
+        sc.cursor += (index + 1) * SlabGranularity;
+        return slot;
+    }
+
+    return allocate_page(index);
+}
+
+inline void SlabAllocator::free(void* memory, uint8_t index)
+{
+    if( index == SlabLarge )
+    {
+        m_stats.large --;
+        ::operator delete(memory);
+        return;
+    }
+
+    auto slot = static_cast<FreeSlot*>(memory);
+    auto& sc = m_classes[index];
+    slot->next = sc.free;
+    sc.free = slot;
+    m_stats.slots --;
+}
+
+inline const SlabStats& SlabAllocator::get_stats() const
+{
+    return m_stats;
+}
+
+NS_AVM_END
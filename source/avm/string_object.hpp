@@ -7,14 +7,23 @@
 
 NS_AVM_BEGIN
 
+// strings interned by StringTable are atoms, which are immutable and never
+// collected. two atoms are equal only if they are the same object.
 class StringObject : public GCObject
 {
+    friend class StringTable;
+
 protected:
-    std::string m_content;
+    std::string     m_content;
+    uint32_t        m_hash;
+    StringObject*   m_next_atom;
 
 public:
+    StringObject() : m_hash(0), m_next_atom(nullptr) {}
+
     void set(const char* str)
     {
+        assert( !is_atom() );
         m_content = str;
     }
 
@@ -23,7 +32,31 @@ public:
         return m_content.c_str();
     }
 
+    size_t get_length() const
+    {
+        return m_content.size();
+    }
+
+    bool is_atom() const
+    {
+        return get_generation() == GCGeneration::ATOM;
+    }
+
+    uint32_t get_hash() const
+    {
+        return m_hash;
+    }
+
     virtual std::string to_string() const;
 };
 
-NS_AVM_END
\ No newline at end of file
+// hashes atoms by their precomputed hash, they are compared by pointers
+struct AtomHash
+{
+    size_t operator()(const StringObject* atom) const
+    {
+        return atom->get_hash();
+    }
+};
+
+NS_AVM_END
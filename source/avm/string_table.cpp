@@ -0,0 +1,96 @@
+#include "avm/string_table.hpp"
+
+#include <atomic>
+#include <cstring>
+
+NS_AVM_BEGIN
+
+const static size_t InitialBuckets = 256;
+
+static std::atomic<uint32_t> s_table_ids(1);
+
+StringTable::StringTable()
+: m_count(0), m_id(s_table_ids++)
+{
+    m_buckets.resize(InitialBuckets, nullptr);
+}
+
+StringTable::~StringTable()
+{
+    for( auto atom : m_buckets )
+    {
+        while( atom != nullptr )
+        {
+            auto next = atom->m_next_atom;
+            delete atom;
+            atom = next;
+        }
+    }
+}
+
+// fnv-1a
+uint32_t StringTable::hash(const char* str, size_t length)
+{
+    uint32_t h = 2166136261u;
+    for( size_t i=0; i<length; i++ )
+    {
+        h ^= (uint8_t)str[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+StringObject* StringTable::intern(const char* str, size_t length)
+{
+    auto h = hash(str, length);
+    auto& bucket = m_buckets[h & (m_buckets.size()-1)];
+    for( auto atom = bucket; atom != nullptr; atom = atom->m_next_atom )
+    {
+        if( atom->m_hash == h && atom->m_content.size() == length &&
+            memcmp(atom->m_content.data(), str, length) == 0 )
+            return atom;
+    }
+
+    auto atom = new StringObject();
+    atom->m_content.assign(str, length);
+    atom->m_hash = h;
+    atom->m_generation = GCGeneration::ATOM;
+    atom->m_next_atom = bucket;
+    bucket = atom;
+
+    if( ++m_count > m_buckets.size() )
+        rehash(m_buckets.size() * 2);
+    return atom;
+}
+
+StringObject* StringTable::find(const char* str) const
+{
+    auto length = strlen(str);
+    auto h = hash(str, length);
+    for( auto atom = m_buckets[h & (m_buckets.size()-1)]; atom != nullptr; atom = atom->m_next_atom )
+    {
+        if( atom->m_hash == h && atom->m_content.size() == length &&
+            memcmp(atom->m_content.data(), str, length) == 0 )
+            return atom;
+    }
+    return nullptr;
+}
+
+void StringTable::rehash(size_t buckets)
+{
+    std::vector<StringObject*> rehashed(buckets, nullptr);
+    for( auto atom : m_buckets )
+    {
+        while( atom != nullptr )
+        {
+            auto next = atom->m_next_atom;
+            auto& bucket = rehashed[atom->m_hash & (buckets-1)];
+            atom->m_next_atom = bucket;
+            bucket = atom;
+            atom = next;
+        }
+    }
+    m_buckets.swap(rehashed);
+}
+
+NS_AVM_END
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "avm/avm.hpp"
+#include "avm/string_object.hpp"
+
+#include <string>
+#include <vector>
+
+NS_AVM_BEGIN
+
+// interns strings of a virtual machine into atoms, which live as long as the
+// table does. names of variables, constant pools and string literals are all
+// atoms, so repeated scripts find them without allocating.
+class StringTable
+{
+protected:
+    std::vector<StringObject*>  m_buckets;
+    uint32_t                    m_count;
+    uint32_t                    m_id;
+
+    void rehash(size_t buckets);
+
+public:
+    StringTable();
+    ~StringTable();
+
+    StringObject*   intern(const char* str, size_t length);
+    StringObject*   intern(const std::string& str);
+    // returns nullptr if the string has not been interned
+    StringObject*   find(const char* str) const;
+
+    uint32_t        get_count() const;
+    // unique among tables, bytecode uses it to know its atoms are still valid
+    uint32_t        get_id() const;
+
+    static uint32_t hash(const char* str, size_t length);
+};
+
+// INLINE METHODS
+
+inline StringObject* StringTable::intern(const std::string& str)
+{
+    return intern(str.c_str(), str.size());
+}
+
+inline uint32_t StringTable::get_count() const
+{
+    return m_count;
+}
+
+inline uint32_t StringTable::get_id() const
+{
+    return m_id;
+}
+
+NS_AVM_END
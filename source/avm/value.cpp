@@ -7,7 +7,7 @@ NS_AVM_BEGIN
 
 std::string Value::to_string() const
 {
-    switch(this->type)
+    switch(get_type())
     {
         case ValueCode::UNDEFINED:
             return "undefined";
@@ -18,39 +18,41 @@ std::string Value::to_string() const
         case ValueCode::NUMBER:
         {
             std::stringstream s;
-            s << this->inner.d;
+            s << get_double();
             return s.str();
         }
 
         case ValueCode::INTEGER:
         {
             std::stringstream s;
-            s << this->inner.i;
+            s << (int32_t)(uint32_t)m_bits;
             return s.str();
         }
 
         case ValueCode::BOOLEAN:
-            return this->inner.i > 0 ? "true" : "false";
+            return (m_bits & 1) ? "true" : "false";
 
         case ValueCode::OBJECT:
-            return this->inner.object->to_string();
+            return get_object()->to_string();
 
         default:
             return "[exception]";
     }
 }
 
-double Value::to_number() const
+double Value::to_number_slow() const
 {
+    auto tag = get_tag();
     return
-        this->type == ValueCode::NUMBER ? this->inner.d :
-        this->type == ValueCode::INTEGER ? (double)this->inner.i :
-        this->type == ValueCode::BOOLEAN ? ( this->inner.i > 0 ? 1 : 0 ) :
-        0.0f;
+        tag == TagInteger ? (double)(int32_t)(uint32_t)m_bits :
+        tag == TagBoolean ? (double)(m_bits & 1) :
+        0.0;
 }
 
 int32_t Value::to_integer() const
 {
+    if( get_tag() == TagInteger )
+        return (int32_t)(uint32_t)m_bits;
     return static_cast<int32_t>(to_number());
 }
 
@@ -59,4 +61,4 @@ bool Value::to_boolean() const
     return to_number() > 0;
 }
 
-NS_AVM_END
\ No newline at end of file
+NS_AVM_END
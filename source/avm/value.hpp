@@ -2,6 +2,7 @@
 
 #include "avm/avm.hpp"
 
+#include <cstring>
 #include <string>
 
 NS_AVM_BEGIN
@@ -16,20 +17,33 @@ enum class ValueCode : uint8_t
     OBJECT
 };
 
-struct Value
+// values are nan-boxed into 64 bits. doubles are stored as they are, with
+// nans made canonical, so that negative nans with payloads are left to tag
+// other values in upper 16 bits, with the payload in lower 48 bits:
+//  0xFFF9  int32
+//  0xFFFA  boolean
+//  0xFFFB  null
+//  0xFFFC  undefined
+//  0xFFFD  pointer to a collectable object
+class Value
 {
-    union Innervalue
-    {
-        GCObject*   object;     // collectable objects
-        int64_t     i;          // integer numbers and booleans
-        double      d;          // float numbers;
-    };
+protected:
+    const static uint64_t TagShift      = 48;
+    const static uint64_t PayloadMask   = (1ull << TagShift) - 1;
+    const static uint64_t TagInteger    = 0xFFF9ull << TagShift;
+    const static uint64_t TagBoolean    = 0xFFFAull << TagShift;
+    const static uint64_t TagNull       = 0xFFFBull << TagShift;
+    const static uint64_t TagUndefined  = 0xFFFCull << TagShift;
+    const static uint64_t TagObject     = 0xFFFDull << TagShift;
+    const static uint64_t CanonicalNaN  = 0x7FF8000000000000ull;
+
+    uint64_t m_bits;
 
-    ValueCode   type;
-    Innervalue  inner;
+    uint64_t get_tag() const { return m_bits & ~PayloadMask; }
+    double   to_number_slow() const;
 
-    Value() : type(ValueCode::UNDEFINED) {}
-    Value(const Value& rh) : inner(rh.inner), type(rh.type) {}
+public:
+    Value() : m_bits(TagUndefined) {}
 
     Value& set_nil();
     Value& set_undefined();
@@ -38,6 +52,18 @@ struct Value
     Value& set_boolean(bool);
     Value& set_object(GCObject*);
 
+    ValueCode get_type() const;
+    // doubles are all of the values below tags
+    bool      is_double() const { return m_bits < TagInteger; }
+    bool      is_object() const { return get_tag() == TagObject; }
+    bool      is_undefined() const { return m_bits == TagUndefined; }
+    // the value must be a double
+    double    get_double() const;
+    // the value must be an object
+    GCObject* get_object() const;
+
+    static bool are_doubles(const Value& lh, const Value& rh);
+
     std::string to_string() const;
 
     // converts value to floating-point
@@ -48,16 +74,12 @@ struct Value
 
     GCObject*   to_object()
     {
-        if( this->type == ValueCode::OBJECT )
-            return this->inner.object;
-        return nullptr;
+        return is_object() ? get_object() : nullptr;
     }
 
     template<typename T> T* to_object()
     {
-        if( this->type == ValueCode::OBJECT )
-            return dynamic_cast<T*>(this->inner.object);
-        return nullptr;
+        return is_object() ? dynamic_cast<T*>(get_object()) : nullptr;
     }
 };
 
@@ -65,34 +87,34 @@ struct Value
 
 inline Value& Value::set_nil()
 {
-    this->type = ValueCode::NULLPTR;
+    m_bits = TagNull;
     return *this;
 }
 
 inline Value& Value::set_undefined()
 {
-    this->type = ValueCode::UNDEFINED;
+    m_bits = TagUndefined;
     return *this;
 }
 
 inline Value& Value::set_number(double num)
 {
-    this->type = ValueCode::NUMBER;
-    this->inner.d = num;
+    if( num != num )
+        m_bits = CanonicalNaN;
+    else
+        memcpy(&m_bits, &num, sizeof(num));
     return *this;
 }
 
 inline Value& Value::set_integer(int32_t integer)
 {
-    this->type = ValueCode::INTEGER;
-    this->inner.i = integer;
+    m_bits = TagInteger | (uint32_t)integer;
     return *this;
 }
 
 inline Value& Value::set_boolean(bool boolean)
 {
-    this->type = ValueCode::INTEGER;
-    this->inner.i = boolean ? 1 : 0;
+    m_bits = TagBoolean | (boolean ? 1 : 0);
     return *this;
 }
 
@@ -100,15 +122,52 @@ inline Value& Value::set_object(GCObject* object)
 {
     if( object != nullptr )
     {
-        this->type = ValueCode::OBJECT;
-        this->inner.object = object;
+        assert( ((uint64_t)(uintptr_t)object & ~PayloadMask) == 0 );
+        m_bits = TagObject | (uint64_t)(uintptr_t)object;
     }
     else
     {
-        this->type = ValueCode::NULLPTR;
+        m_bits = TagNull;
     }
-    
+
     return *this;
 }
 
+inline ValueCode Value::get_type() const
+{
+    if( is_double() )
+        return ValueCode::NUMBER;
+
+    switch( get_tag() )
+    {
+        case TagInteger:    return ValueCode::INTEGER;
+        case TagBoolean:    return ValueCode::BOOLEAN;
+        case TagNull:       return ValueCode::NULLPTR;
+        case TagObject:     return ValueCode::OBJECT;
+        default:            return ValueCode::UNDEFINED;
+    }
+}
+
+inline double Value::get_double() const
+{
+    double num;
+    memcpy(&num, &m_bits, sizeof(num));
+    return num;
+}
+
+inline GCObject* Value::get_object() const
+{
+    return reinterpret_cast<GCObject*>((uintptr_t)(m_bits & PayloadMask));
+}
+
+inline bool Value::are_doubles(const Value& lh, const Value& rh)
+{
+    return (lh.m_bits < TagInteger) & (rh.m_bits < TagInteger);
+}
+
+inline double Value::to_number() const
+{
+    return is_double() ? get_double() : to_number_slow();
+}
+
 NS_AVM_END
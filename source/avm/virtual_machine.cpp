@@ -1,83 +1,99 @@
 #include "avm/virtual_machine.hpp"
 #include "avm/context_object.hpp"
+#include "avm/string_object.hpp"
 
 #include "stream.hpp"
 #include "movie_clip.hpp"
 
-NS_AVM_BEGIN
+#include <algorithm>
 
-const static int InitialGCThreshold = 4;
+NS_AVM_BEGIN
 
 VirtualMachine::VirtualMachine(int version)
-: m_gc_threshold(InitialGCThreshold), m_objects(0), m_version(version)
+: m_version(version), m_budget(0), m_depth(0), m_recursed(false)
+{}
+
+// objects and contexts are deleted by heap
+VirtualMachine::~VirtualMachine()
+{}
+
+void VirtualMachine::execute(ContextObject* context, const uint8_t* bytes, int length)
 {
-    m_root = new GCObject();
+    BytecodePtr bytecode(Bytecode::create(bytes, length));
+    if( bytecode != nullptr )
+        execute(context, *bytecode);
 }
 
-VirtualMachine::~VirtualMachine()
+// the budget is given to blocks executed by host, which is shared by
+// the ones they execute. a block nested too deep uses it up to abort the
+// others too. the heap is only collected once no block is running.
+void VirtualMachine::execute(ContextObject* context, const Bytecode& bytecode, ActionSite site)
 {
-    for(GCObject* current = m_root; current != nullptr;)
+    if( context == nullptr )
+        return;
+
+    if( m_depth == 0 )
     {
-        auto tmp = current;
-        current = current->m_next;
-        delete tmp;
+        m_budget = (int64_t)m_limits.max_instructions;
+        m_recursed = false;
+        m_stats.executions ++;
+    }
+    else if( m_depth >= m_limits.max_recursion || m_budget < 0 )
+    {
+        m_recursed = m_recursed || m_budget >= 0;
+        m_budget = -1;
+        return;
     }
-    m_root = nullptr;
 
-    for(GCObject* current = m_context; current != nullptr;)
+    m_depth ++;
+    m_stats.max_depth = std::max(m_stats.max_depth, m_depth);
+    if( m_profiler != nullptr )
     {
-        auto tmp = current;
-        current = current->m_next;
-        delete tmp;
+        m_profiler->begin(*context, site);
+        context->execute(*this, bytecode);
+        m_profiler->end();
     }
-    m_context = nullptr;
-}
+    else
+        context->execute(*this, bytecode);
+    m_depth --;
 
-void VirtualMachine::execute(ContextObject* context, const uint8_t* bytecode, int length)
-{
-    if( context == nullptr )
+    if( m_depth > 0 )
         return;
 
-    auto stream = Stream(bytecode, length);
-    context->execute(*this, stream);
+    if( m_budget < 0 )
+    {
+        if( m_recursed )
+            m_stats.recursion_aborts ++;
+        else
+            m_stats.budget_aborts ++;
 
-    if( m_objects > m_gc_threshold )
-        gabarge_collect();
+#ifdef DEBUG_AVM
+        printf("[AVM] script aborted by %s.\n", m_recursed ? "recursion" : "timeout");
+#endif
+    }
+
+    m_heap.safepoint();
 }
 
-void VirtualMachine::gabarge_collect()
+void VirtualMachine::set_profiling(bool enabled)
 {
-    int objects = m_objects;
-
-    // mark
-    for(GCObject* current = m_context; current != nullptr; current = current->m_next)
-        current->mark(1);
+    if( !enabled )
+        m_profiler.reset();
+    else if( m_profiler == nullptr )
+        m_profiler.reset(new (std::nothrow) Profiler(m_heap));
+}
 
-    // sweep
-    for(GCObject* prev = m_root, *current = m_root->m_next; current != nullptr;)
-    {
-        if( current->m_marked == 0 )
-        {
-            prev->m_next = current->m_next;
-            delete current;
-            current = prev->m_next;
-            m_objects--;
-        }
-        else
-        {
-            // unmark it for next gc
-            current->m_marked = 0;
-            prev = current;
-            current = current->m_next;
-        }
-    }
+void VirtualMachine::gabarge_collect()
+{
+#ifdef DEBUG_AVM
+    auto freed = m_heap.get_stats().freed;
+#endif
 
-    // 
-    m_gc_threshold = m_objects * 2;
+    m_heap.collect();
 
 #ifdef DEBUG_AVM
     printf("[AVM] gabarge collected %d objects, %d remaining.\n",
-        objects - m_objects, m_objects);
+        (int)(m_heap.get_stats().freed - freed), get_object_count());
 #endif
 }
 
@@ -86,19 +102,26 @@ ContextObject* VirtualMachine::new_context(MovieNode* node)
     if( node == nullptr )
         return nullptr;
 
-    auto context = new ContextObject();
+    auto context = new ContextObject(*this);
+    m_heap.add_root(context);
     context->attach(node);
     node->set_context(context);
+    return context;
+}
 
-    if( m_context == nullptr )
-        m_context = context;
-    else
-    {
-        context->m_next = m_context;
-        m_context = context;
-    }
+// only atoms have the generation, so they are found without casting
+StringObject* VirtualMachine::intern(Value value)
+{
+    if( value.is_object() && value.get_object()->get_generation() == GCGeneration::ATOM )
+        return static_cast<StringObject*>(value.get_object());
+    return m_strings.intern(value.to_string());
+}
 
-    return context;
+StringObject* VirtualMachine::find(Value value)
+{
+    if( value.is_object() && value.get_object()->get_generation() == GCGeneration::ATOM )
+        return static_cast<StringObject*>(value.get_object());
+    return m_strings.find(value.to_string().c_str());
 }
 
 void VirtualMachine::free_context(ContextObject* context)
@@ -106,27 +129,12 @@ void VirtualMachine::free_context(ContextObject* context)
     if( context == nullptr )
         return;
 
-    context->detach();
+    if( m_profiler != nullptr )
+        m_profiler->forget(context);
 
-    for(GCObject* current = m_context, *prev = m_context;
-        current != nullptr;
-        prev = current, current = current->m_next)
-    {
-        if( context == current )
-        {
-            if( m_context == current )
-            {
-                m_context = static_cast<ContextObject*>(current->m_next);
-                delete current;
-            }
-            else
-            {
-                prev->m_next = current->m_next;
-                delete current;
-            }
-            return;
-        }
-    }
+    context->detach();
+    m_heap.remove_root(context);
+    delete context;
 }
 
 NS_AVM_END
\ No newline at end of file
@@ -2,45 +2,152 @@
 
 #include "avm/avm.hpp"
 #include "avm/context_object.hpp"
+#include "avm/string_table.hpp"
+#include "avm/heap.hpp"
+#include "avm/profiler.hpp"
+
+#include <cstring>
+#include <memory>
 
 NS_AVM_BEGIN
 
+// instructions executed in a second, a little less than measured by
+// AVM_DISPATCH, by which timeouts of scripts are turned into budgets.
+const static uint64_t InstructionsPerSecond = 100000000;
+const static uint16_t DefaultMaxRecursion = 256;
+const static uint16_t DefaultTimeoutSeconds = 15;
+
+// limits of ScriptLimits tags, with the timeout as a budget of instructions
+// for each block executed by host, including the ones it executes. a timeout
+// of 0 is taken as the default.
+struct ScriptLimits
+{
+    uint16_t max_recursion;
+    uint64_t max_instructions;
+
+    ScriptLimits()
+    : max_recursion(DefaultMaxRecursion),
+    max_instructions(DefaultTimeoutSeconds * InstructionsPerSecond) {}
+
+    ScriptLimits(uint16_t recursion, uint16_t timeout_seconds)
+    : max_recursion(recursion),
+    max_instructions((timeout_seconds > 0 ? timeout_seconds : DefaultTimeoutSeconds) * InstructionsPerSecond) {}
+};
+
+struct ScriptStats
+{
+    uint64_t executions;        // of blocks by host
+    uint32_t budget_aborts;
+    uint32_t recursion_aborts;
+    uint16_t max_depth;
+
+    ScriptStats() : executions(0), budget_aborts(0), recursion_aborts(0), max_depth(0) {}
+};
+
 class VirtualMachine
 {
+    friend struct MovieEnvironment;
+
 protected:
-    GCObject*       m_root;
-    ContextObject*  m_context;
-    uint32_t        m_gc_threshold;
-    uint32_t        m_objects;
     int32_t         m_version;
+    StringTable     m_strings;
+    Heap            m_heap;
+    std::unique_ptr<Profiler> m_profiler;
+
+    ScriptLimits    m_limits;
+    ScriptStats     m_stats;
+    int64_t         m_budget;       // instructions left
+    uint16_t        m_depth;        // of nested executions
+    bool            m_recursed;     // too deep since host executed
 
 public:
     VirtualMachine(int version = 10);
     ~VirtualMachine();
 
+    // blocks of frames are profiled by their sites. blocks running out of
+    // budget or nested too deep are aborted, with everything they executed
+    // left as it is, which are counted in stats.
+    void execute(ContextObject*, const Bytecode& bytecode, ActionSite site = ActionSite());
+    // decodes bytes for this execution only, see Bytecode
     void execute(ContextObject*, const uint8_t* bytes, int length);
+    // collects all garbage at once, frames step the heap instead
     void gabarge_collect();
 
     template<typename T> T* new_object()
     {
-        auto nv = new T();
-        nv->m_next = m_root->m_next;
-        m_root->m_next = nv;
-        m_objects ++;
-        return nv;
+        return m_heap.allocate<T>();
     }
- 
+
     ContextObject*  new_context(MovieNode*);
     void            free_context(ContextObject*);
 
-    int32_t get_version() const;
+    // values other than atoms are interned by their strings. names which
+    // are only read are found instead, so that they don't fill the table.
+    StringObject*   intern(const char*);
+    StringObject*   intern(Value);
+    // returns nullptr if the string of value has not been interned
+    StringObject*   find(Value);
+    StringTable&    get_strings();
+    Heap&           get_heap();
+
+    void                set_limits(const ScriptLimits&);
+    const ScriptLimits& get_limits() const;
+    const ScriptStats&  get_script_stats() const;
+
+    // profiling starts with no counts, there is no profiler while disabled
+    void            set_profiling(bool);
+    Profiler*       get_profiler();
+
+    int32_t  get_version() const;
+    uint32_t get_object_count() const;
 };
 
 // INLINE METHODS
 
+inline StringObject* VirtualMachine::intern(const char* str)
+{
+    return m_strings.intern(str, strlen(str));
+}
+
+inline StringTable& VirtualMachine::get_strings()
+{
+    return m_strings;
+}
+
+inline Heap& VirtualMachine::get_heap()
+{
+    return m_heap;
+}
+
+inline void VirtualMachine::set_limits(const ScriptLimits& limits)
+{
+    m_limits = limits;
+}
+
+inline const ScriptLimits& VirtualMachine::get_limits() const
+{
+    return m_limits;
+}
+
+inline const ScriptStats& VirtualMachine::get_script_stats() const
+{
+    return m_stats;
+}
+
+inline Profiler* VirtualMachine::get_profiler()
+{
+    return m_profiler.get();
+}
+
 inline int32_t VirtualMachine::get_version() const
 {
     return m_version;
 }
 
+inline uint32_t VirtualMachine::get_object_count() const
+{
+    auto& stats = m_heap.get_stats();
+    return stats.young_objects + stats.old_objects;
+}
+
 NS_AVM_END
\ No newline at end of file
@@ -9,6 +9,7 @@
 namespace openswf
 {
     class INode;
+    class RenderContext;
     class Player;
 
     class ICharacter
@@ -43,7 +44,7 @@ namespace openswf
 
         virtual ~INode() {}
         virtual void update(float dt) = 0;
-        virtual void render(const Matrix& matrix, const ColorTransform& cxform) = 0;
+        virtual void render(RenderContext& context, const Matrix& matrix, const ColorTransform& cxform) = 0;
         virtual uint16_t get_character_id() const;
 
         void set_transform(const Matrix& matrix);
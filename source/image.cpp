@@ -1,4 +1,6 @@
 #include "image.hpp"
+#include "atlas.hpp"
+#include "render_context.hpp"
 
 namespace openswf
 {
@@ -15,22 +17,91 @@ namespace openswf
 
     bool Image::initialize(uint16_t cid, BitmapPtr data)
     {
+        if( data == nullptr )
+            return false;
+
         m_character_id  = cid;
         m_bitmap = std::move(data);
-        m_rid = 0;
+        m_repeating = false;
+        m_format = m_bitmap->get_format();
+        m_width = m_bitmap->get_width();
+        m_height = m_bitmap->get_height();
+        m_retention = BitmapRetention::KEEP;
+        m_decoder = nullptr;
+        m_decodes = 1;
+        m_atlas = nullptr;
+        m_atlas_page = -1;
         return true;
     }
 
-    Rid Image::get_texture_rid()
+    Image::~Image()
+    {}
+
+    // texture is uploaded to the render of first use, and moved if the image
+    // is rendered with another one later, or uploaded again once evicted.
+    Rid Image::get_texture_rid(Render& render)
     {
-        if( m_rid == 0 )
+        if( m_atlas != nullptr )
+            return m_atlas->get_texture_rid(m_atlas_page, render);
+
+        if( m_bitmap == nullptr && !m_texture.is_resident(render) )
         {
-            m_rid = Render::get_instance().create_texture(
-                m_bitmap->get_ptr(), m_bitmap->get_width(), m_bitmap->get_height(),
-                m_bitmap->get_format(), 1);
+            m_bitmap = m_decoder(m_source_header, m_source.get());
+            if( m_bitmap == nullptr )
+                return 0;
+
+            assert( m_bitmap->get_format() == m_format );
+            m_decodes ++;
         }
 
-        return m_rid;
+        auto rid = m_texture.get(render,
+            m_bitmap != nullptr ? m_bitmap->get_ptr() : nullptr,
+            m_width, m_height, m_format, 1);
+
+        trim();
+        return rid;
+    }
+
+    // pixels are released once they are kept by a texture or an atlas page,
+    // and could be decoded again.
+    void Image::trim()
+    {
+        if( m_retention != BitmapRetention::RELEASE || m_bitmap == nullptr )
+            return;
+
+        if( m_atlas != nullptr || m_texture.is_resident() )
+            m_bitmap.reset();
+    }
+
+    void Image::set_source(const TagHeader& header, BytesPtr bytes, BitmapDecoder decoder)
+    {
+        assert( decoder != nullptr );
+        m_source_header = header;
+        m_source = std::move(bytes);
+        m_decoder = decoder;
+    }
+
+    bool Image::set_retention(BitmapRetention retention)
+    {
+        if( retention == BitmapRetention::RELEASE && m_source == nullptr && m_atlas == nullptr )
+            return false;
+
+        m_retention = retention;
+        trim();
+        return true;
+    }
+
+    void Image::add_bitmap_stats(BitmapStats& stats) const
+    {
+        stats.images ++;
+        stats.decodes += m_decodes;
+        if( m_bitmap != nullptr )
+            stats.bytes_bitmaps += m_bitmap->get_size();
+        else
+            stats.released ++;
+
+        if( m_source != nullptr )
+            stats.bytes_sources += m_source_header.size;
     }
 
     INode* Image::create_instance()
@@ -47,17 +118,18 @@ namespace openswf
     void ImageNode::update(float dt)
     {}
 
-    void ImageNode::render(const Matrix& matrix, const ColorTransform& cxform)
+    void ImageNode::render(RenderContext& context, const Matrix& matrix, const ColorTransform& cxform)
     {
-        auto& shader = Shader::get_instance();
+        auto& shader = context.get_shader();
         shader.set_program(PROGRAM_DEFAULT);
-        shader.set_texture(0, m_bitmap->get_texture_rid());
+        shader.set_texture(0, m_bitmap->get_texture_rid(context.get_render()));
 
+        auto width = m_bitmap->get_width(), height = m_bitmap->get_height();
         VertexPack vertices[4] = {
-            {0, 0, 0, 0},
-            {(float)m_bitmap->get_width(), 0, 1, 0},
-            {(float)m_bitmap->get_width(), (float)m_bitmap->get_height(), 1, 1},
-            {0, (float)m_bitmap->get_height(), 0, 1} };
+            VertexPack(Point2f(0, 0), m_bitmap->get_texcoord(Point2f(0, 0))),
+            VertexPack(Point2f(width, 0), m_bitmap->get_texcoord(Point2f(1, 0))),
+            VertexPack(Point2f(width, height), m_bitmap->get_texcoord(Point2f(1, 1))),
+            VertexPack(Point2f(0, height), m_bitmap->get_texcoord(Point2f(0, 1))) };
 
         shader.draw(
             vertices[0], vertices[1], vertices[2], vertices[3],
@@ -2,12 +2,18 @@
 
 #include "character.hpp"
 #include "shader.hpp"
+#include "residency.hpp"
+#include "swf/record.hpp"
+
+#include <algorithm>
 
 namespace openswf
 {
     class IBitmap
     {
     public:
+        virtual ~IBitmap() {}
+
         virtual uint32_t        get_width() const = 0;
         virtual uint32_t        get_height() const = 0;
         virtual uint32_t        get_size() const = 0;
@@ -172,6 +178,29 @@ namespace openswf
 
     typedef Bitmap<PixelA8> BitmapA8;
 
+    // whether pixels of images are kept on cpu once they are uploaded. released
+    // ones are decoded again from a copy of their tags if their textures are
+    // evicted, or images are packed whose pixels are kept by atlas pages.
+    enum class BitmapRetention : uint8_t
+    {
+        KEEP,
+        RELEASE
+    };
+
+    // decodes pixels from the bytes of a tag which follow its header
+    typedef BitmapPtr (*BitmapDecoder)(const TagHeader& header, const uint8_t* bytes);
+
+    struct BitmapStats
+    {
+        uint32_t images, released, decodes;
+        uint64_t bytes_bitmaps, bytes_sources; // resident on cpu
+
+        BitmapStats()
+        : images(0), released(0), decodes(0), bytes_bitmaps(0), bytes_sources(0) {}
+    };
+
+    class ImageAtlas;
+
     // The SWF file format specification supports a variety of bitmap formats.
     // All bitmaps are compressed to reduce file size. Lossy compression,
     // best for imprecise images such as photographs, is provided by JPEG bitmaps;
@@ -181,21 +210,60 @@ namespace openswf
     class Image : public ICharacter
     {
     protected:
-        uint16_t    m_character_id;
-        BitmapPtr   m_bitmap;
-        Rid         m_rid;
+        uint16_t        m_character_id;
+        BitmapPtr       m_bitmap;
+        ResidentTexture m_texture;
+        bool            m_repeating;
+
+        // bitmap may be released, whose size and format are kept
+        TextureFormat   m_format;
+        int             m_width, m_height;
+        BitmapRetention m_retention;
+
+        // the tag which pixels are decoded from
+        TagHeader       m_source_header;
+        BytesPtr        m_source;
+        BitmapDecoder   m_decoder;
+        uint32_t        m_decodes;
+
+        // the page and texcoords of image if it's packed into atlas
+        ImageAtlas*     m_atlas;
+        int             m_atlas_page;
+        Rect            m_atlas_region;
+
+        void trim();
 
     public:
         static Image* create(uint16_t cid, BitmapPtr data);
         bool initialize(uint16_t cid, BitmapPtr data);
+        virtual ~Image();
 
         virtual INode*   create_instance();
         virtual uint16_t get_character_id() const;
 
-        Rid             get_texture_rid();
+        Rid             get_texture_rid(Render& render);
         TextureFormat   get_texture_format() const;
         float           get_width() const;
         float           get_height() const;
+        // pixels on cpu, which are only valid if they are not released
+        const IBitmap&  get_bitmap() const;
+        bool            has_bitmap() const;
+
+        // keeps a copy of the tag, so that pixels could be released
+        void            set_source(const TagHeader& header, BytesPtr bytes, BitmapDecoder decoder);
+        // pixels can't be released by images without a source or an atlas
+        // page to get them again, which are left as they are with false.
+        bool            set_retention(BitmapRetention retention);
+        void            add_bitmap_stats(BitmapStats& stats) const;
+
+        // maps texcoords of image into the texture it's drawn with, which are
+        // clamped into image if it's packed.
+        Point2f         get_texcoord(const Point2f& texcoord) const;
+
+        // images of repeating fills are not packed, whose texcoords wrap
+        void            set_repeating();
+        bool            is_repeating() const;
+        void            set_atlas(ImageAtlas* atlas, int page, const Rect& region);
     };
 
     class ImageNode : public INode
@@ -208,22 +276,62 @@ namespace openswf
         : INode(env, bitmap), m_bitmap(bitmap) {}
 
         virtual void update(float dt);
-        virtual void render(const Matrix& matrix, const ColorTransform& cxform);
+        virtual void render(RenderContext& context, const Matrix& matrix, const ColorTransform& cxform);
     };
 
     // INLINE METHODS
     inline TextureFormat Image::get_texture_format() const
     {
-        return m_bitmap->get_format();
+        return m_format;
     }
 
     inline float Image::get_width() const
     {
-        return m_bitmap->get_width();
+        return (float)m_width;
     }
 
     inline float Image::get_height() const
     {
-        return m_bitmap->get_height();
+        return (float)m_height;
+    }
+
+    inline const IBitmap& Image::get_bitmap() const
+    {
+        assert( m_bitmap != nullptr );
+        return *m_bitmap;
+    }
+
+    inline bool Image::has_bitmap() const
+    {
+        return m_bitmap != nullptr;
+    }
+
+    inline Point2f Image::get_texcoord(const Point2f& texcoord) const
+    {
+        if( m_atlas == nullptr )
+            return texcoord;
+
+        auto u = std::min(std::max(texcoord.x, 0.f), 1.f);
+        auto v = std::min(std::max(texcoord.y, 0.f), 1.f);
+        return Point2f(
+            m_atlas_region.xmin + u*m_atlas_region.get_width(),
+            m_atlas_region.ymin + v*m_atlas_region.get_height());
+    }
+
+    inline void Image::set_repeating()
+    {
+        m_repeating = true;
+    }
+
+    inline bool Image::is_repeating() const
+    {
+        return m_repeating;
+    }
+
+    inline void Image::set_atlas(ImageAtlas* atlas, int page, const Rect& region)
+    {
+        m_atlas = atlas;
+        m_atlas_page = page;
+        m_atlas_region = region;
     }
 }
\ No newline at end of file
@@ -0,0 +1,265 @@
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <vector>
+#include <unordered_map>
+
+#include "mesh.hpp"
+
+namespace openswf
+{
+    const static uint32_t   Unused = ~0u;
+
+    void MeshOptimizer::optimize(VertexPack* vertices, uint32_t& vsize, uint32_t* indices, uint32_t& isize)
+    {
+        weld(vertices, vsize, indices, isize);
+        remove_degenerate(vertices, indices, isize);
+        optimize_cache(vsize, indices, isize);
+        optimize_fetch(vertices, vsize, indices, isize);
+    }
+
+    void MeshOptimizer::weld(VertexPack* vertices, uint32_t& vsize, uint32_t* indices, uint32_t isize)
+    {
+        // vertices are keyed by bits of their position, colors and texcoords
+        // are not assigned until rendering.
+        std::unordered_map<uint64_t, uint32_t> welded;
+        welded.reserve(vsize);
+
+        std::vector<uint32_t> remap(vsize, Unused);
+        for( auto i=0; i<isize; i++ )
+        {
+            auto index = indices[i];
+            if( remap[index] == Unused )
+            {
+                uint32_t x, y;
+                memcpy(&x, &vertices[index].position.x, sizeof(uint32_t));
+                memcpy(&y, &vertices[index].position.y, sizeof(uint32_t));
+
+                auto key = ((uint64_t)x << 32) | (uint64_t)y;
+                auto found = welded.emplace(key, index).first;
+                remap[index] = found->second;
+            }
+
+            indices[i] = remap[index];
+        }
+
+        // merged vertices are dropped by compaction
+        optimize_fetch(vertices, vsize, indices, isize);
+    }
+
+    void MeshOptimizer::remove_degenerate(const VertexPack* vertices, uint32_t* indices, uint32_t& isize)
+    {
+        auto size = 0u;
+        for( auto i=0; i+2<isize; i+=3 )
+        {
+            auto a = indices[i], b = indices[i+1], c = indices[i+2];
+            if( a == b || b == c || c == a )
+                continue;
+
+            auto& pa = vertices[a].position;
+            auto& pb = vertices[b].position;
+            auto& pc = vertices[c].position;
+            if( (pb.x - pa.x)*(pc.y - pa.y) - (pb.y - pa.y)*(pc.x - pa.x) == 0.f )
+                continue;
+
+            indices[size++] = a;
+            indices[size++] = b;
+            indices[size++] = c;
+        }
+
+        isize = size;
+    }
+
+    /// VERTEX CACHE OPTIMIZATION
+    const static int    CacheSize           = 32;
+    const static int    MaxValence          = 32;
+    const static float  CacheDecayPower     = 1.5f;
+    const static float  LastTriangleScore   = 0.75f;
+    const static float  ValenceBoostScale   = 2.0f;
+    const static float  ValenceBoostPower   = 0.5f;
+
+    struct ScoreTable
+    {
+        float cache[CacheSize];
+        float valence[MaxValence];
+
+        ScoreTable()
+        {
+            for( auto i=0; i<CacheSize; i++ )
+            {
+                // the vertices of last triangle have a fixed score, so that
+                // it does not matter which one of them was used first.
+                if( i < 3 )
+                    cache[i] = LastTriangleScore;
+                else
+                    cache[i] = std::pow(1.f - (float)(i-3) / (float)(CacheSize-3), CacheDecayPower);
+            }
+
+            // boosts vertices with few triangles left to get rid of them
+            valence[0] = 0.f;
+            for( auto i=1; i<MaxValence; i++ )
+                valence[i] = ValenceBoostScale * std::pow((float)i, -ValenceBoostPower);
+        }
+
+        float get(int cache_position, uint32_t remaining) const
+        {
+            if( remaining == 0 ) return -1.f;
+
+            auto score = cache_position < 0 ? 0.f : cache[cache_position];
+            return score + valence[std::min(remaining, (uint32_t)MaxValence-1)];
+        }
+    };
+
+    void MeshOptimizer::optimize_cache(uint32_t vsize, uint32_t* indices, uint32_t isize)
+    {
+        static const ScoreTable table;
+
+        auto triangle_count = isize / 3;
+        if( triangle_count < 2 )
+            return;
+
+        // triangles of each vertex in compressed rows, the first remaining[v]
+        // entries of a row are the triangles not emitted yet.
+        std::vector<uint32_t> offsets(vsize+1, 0), remaining(vsize, 0);
+        for( auto i=0; i<triangle_count*3; i++ )
+            remaining[indices[i]] ++;
+
+        for( auto i=0; i<vsize; i++ )
+            offsets[i+1] = offsets[i] + remaining[i];
+
+        std::vector<uint32_t> adjacency(triangle_count*3);
+        std::vector<uint32_t> cursor(offsets.begin(), offsets.end()-1);
+        for( auto i=0; i<triangle_count*3; i++ )
+            adjacency[cursor[indices[i]]++] = i/3;
+
+        std::vector<float> vertex_score(vsize);
+        for( auto i=0; i<vsize; i++ )
+            vertex_score[i] = table.get(-1, remaining[i]);
+
+        std::vector<bool> emitted(triangle_count, false);
+
+        std::vector<uint32_t> output;
+        output.reserve(triangle_count*3);
+
+        uint32_t cache[CacheSize+3], next_cache[CacheSize+3];
+        auto cache_size = 0;
+        auto scan = 0u;
+        auto best = Unused;
+
+        for( auto n=0; n<triangle_count; n++ )
+        {
+            // no candidate from the cache, takes the next one in order
+            if( best == Unused )
+            {
+                while( emitted[scan] ) scan++;
+                best = scan;
+            }
+
+            emitted[best] = true;
+            auto triangle = indices + best*3;
+            output.insert(output.end(), triangle, triangle+3);
+
+            // removes the triangle from the rows of its vertices
+            for( auto j=0; j<3; j++ )
+            {
+                auto vertex = triangle[j];
+                auto row = adjacency.data() + offsets[vertex];
+                for( auto k=0; k<remaining[vertex]; k++ )
+                {
+                    if( row[k] == best )
+                    {
+                        std::swap(row[k], row[remaining[vertex]-1]);
+                        break;
+                    }
+                }
+                remaining[vertex] --;
+            }
+
+            // moves vertices of the triangle to the front of cache
+            auto next_size = 0;
+            for( auto j=0; j<3; j++ )
+                next_cache[next_size++] = triangle[j];
+
+            for( auto j=0; j<cache_size; j++ )
+            {
+                auto vertex = cache[j];
+                if( vertex != triangle[0] && vertex != triangle[1] && vertex != triangle[2] )
+                    next_cache[next_size++] = vertex;
+            }
+
+            for( auto j=CacheSize; j<next_size; j++ )
+                vertex_score[next_cache[j]] = table.get(-1, remaining[next_cache[j]]);
+
+            cache_size = std::min(next_size, CacheSize);
+            for( auto j=0; j<cache_size; j++ )
+            {
+                cache[j] = next_cache[j];
+                vertex_score[cache[j]] = table.get(j, remaining[cache[j]]);
+            }
+
+            // rescores triangles around the cache and picks the best one
+            auto best_score = -1.f;
+            best = Unused;
+            for( auto j=0; j<next_size; j++ )
+            {
+                auto vertex = next_cache[j];
+                auto row = adjacency.data() + offsets[vertex];
+                for( auto k=0; k<remaining[vertex]; k++ )
+                {
+                    auto candidate = row[k];
+                    auto corners = indices + candidate*3;
+                    auto score = vertex_score[corners[0]] + vertex_score[corners[1]] + vertex_score[corners[2]];
+                    if( score > best_score )
+                    {
+                        best_score = score;
+                        best = candidate;
+                    }
+                }
+            }
+        }
+
+        memcpy(indices, output.data(), output.size()*sizeof(uint32_t));
+    }
+
+    void MeshOptimizer::optimize_fetch(VertexPack* vertices, uint32_t& vsize, uint32_t* indices, uint32_t isize)
+    {
+        std::vector<uint32_t> remap(vsize, Unused);
+        std::vector<VertexPack> ordered;
+        ordered.reserve(vsize);
+
+        for( auto i=0; i<isize; i++ )
+        {
+            auto index = indices[i];
+            if( remap[index] == Unused )
+            {
+                remap[index] = ordered.size();
+                ordered.push_back(vertices[index]);
+            }
+            indices[i] = remap[index];
+        }
+
+        std::copy(ordered.begin(), ordered.end(), vertices);
+        vsize = ordered.size();
+    }
+
+    float MeshOptimizer::get_acmr(const uint32_t* indices, uint32_t isize, int cache_size)
+    {
+        if( isize < 3 )
+            return 0.f;
+
+        std::vector<uint32_t> cache;
+        auto misses = 0;
+        for( auto i=0; i<isize; i++ )
+        {
+            if( std::find(cache.begin(), cache.end(), indices[i]) != cache.end() )
+                continue;
+
+            misses ++;
+            cache.push_back(indices[i]);
+            if( cache.size() > cache_size )
+                cache.erase(cache.begin());
+        }
+
+        return (float)misses / (float)(isize / 3);
+    }
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "shader.hpp"
+
+namespace openswf
+{
+    // sizes of meshes before and after optimization
+    struct MeshStats
+    {
+        uint32_t vertices_before, vertices_after;
+        uint32_t indices_before, indices_after;
+
+        MeshStats()
+        : vertices_before(0), vertices_after(0), indices_before(0), indices_after(0) {}
+
+        MeshStats& operator += (const MeshStats& rh)
+        {
+            vertices_before += rh.vertices_before;
+            vertices_after  += rh.vertices_after;
+            indices_before  += rh.indices_before;
+            indices_after   += rh.indices_after;
+            return *this;
+        }
+    };
+
+    // post-processing of triangle lists, all methods work in place and
+    // update the sizes of vertices and indices.
+    class MeshOptimizer
+    {
+    public:
+        // all of the steps below in order
+        static void optimize(VertexPack* vertices, uint32_t& vsize, uint32_t* indices, uint32_t& isize);
+
+        // merges vertices with the same position
+        static void weld(VertexPack* vertices, uint32_t& vsize, uint32_t* indices, uint32_t isize);
+
+        // drops triangles with repeated vertices or without area
+        static void remove_degenerate(const VertexPack* vertices, uint32_t* indices, uint32_t& isize);
+
+        // reorders triangles for the post-transform vertex cache, with
+        // the linear-speed algorithm of Tom Forsyth.
+        static void optimize_cache(uint32_t vsize, uint32_t* indices, uint32_t isize);
+
+        // reorders vertices by their first use in indices, and drops the unused
+        static void optimize_fetch(VertexPack* vertices, uint32_t& vsize, uint32_t* indices, uint32_t isize);
+
+        // average cache miss ratio of a fifo cache, misses per triangle
+        static float get_acmr(const uint32_t* indices, uint32_t isize, int cache_size);
+    };
+}
@@ -150,7 +150,7 @@ namespace openswf
         }
     }
 
-    ActionPtr FrameAction::create(TagHeader header, BytesPtr bytes)
+    ActionPtr FrameAction::create(TagHeader header, BytesPtr bytes, uint16_t frame)
     {
         auto action = new (std::nothrow) FrameAction();
         if( action )
@@ -159,6 +159,7 @@ namespace openswf
 
             action->m_header = header;
             action->m_bytes = std::move(bytes);
+            action->m_frame = frame;
             return ActionPtr(action);
         }
 
@@ -167,8 +168,17 @@ namespace openswf
 
     void FrameAction::execute(MovieClip& movie, MovieNode& node)
     {
+        if( m_bytecode == nullptr )
+        {
+            m_bytecode.reset(avm::Bytecode::create(m_bytes.get(), m_header.size));
+            if( m_bytecode == nullptr )
+                return;
+            m_bytes.reset();
+        }
+
         auto& vm = movie.get_player()->get_virtual_machine();
-        vm.execute(node.get_context(), m_bytes.get(), m_header.size);
+        vm.execute(node.get_context(), *m_bytecode,
+            avm::ActionSite(movie.get_character_id(), m_frame));
     }
 
     MovieClip::MovieClip(uint16_t cid, uint16_t frame_count, float frame_rate)
@@ -228,6 +238,13 @@ namespace openswf
         m_children.clear();
     }
 
+    avm::ContextObject* MovieNode::get_context()
+    {
+        if( m_context == nullptr )
+            m_player->get_virtual_machine().new_context(this);
+        return m_context;
+    }
+
     // INHERITANTED
     void MovieNode::update(float dt)
     {
@@ -256,10 +273,10 @@ namespace openswf
             pair.second->update(dt);
     }
 
-    void MovieNode::render(const Matrix& matrix, const ColorTransform& cxform)
+    void MovieNode::render(RenderContext& context, const Matrix& matrix, const ColorTransform& cxform)
     {
         for( auto& pair : m_children )
-            pair.second->render( matrix*m_matrix, cxform*m_cxform );
+            pair.second->render( context, matrix*m_matrix, cxform*m_cxform );
     }
 
     // PROTECTED METHODS
@@ -356,7 +373,6 @@ namespace openswf
             if( node != nullptr )
             {
                 node->set_parent(this);
-                node->set_context(m_player->get_virtual_machine().new_context(node));
             }
 
             m_children[depth] = instance;
@@ -4,6 +4,7 @@
 #include "character.hpp"
 #include "swf/record.hpp"
 #include "avm/value.hpp"
+#include "avm/bytecode.hpp"
 
 #include <map>
 #include <unordered_map>
@@ -37,10 +38,16 @@ namespace openswf
     typedef std::unique_ptr<FrameAction> ActionPtr;
     typedef std::vector<ActionPtr> ActionList;
 
+    // actions are decoded at first execution, the bytes are released then.
+    // the frame they belong to, counted from 1, identifies them in profiles.
     class FrameAction : FrameCommand
     {
+    protected:
+        avm::BytecodePtr m_bytecode;
+        uint16_t         m_frame;
+
     public:
-        static ActionPtr create(TagHeader header, BytesPtr bytes);
+        static ActionPtr create(TagHeader header, BytesPtr bytes, uint16_t frame);
         virtual void execute(MovieClip&, MovieNode&);
     };
 
@@ -136,7 +143,7 @@ namespace openswf
         MovieNode(Player* env, MovieClip* sprite);
         virtual ~MovieNode();
         virtual void update(float dt);
-        virtual void render(const Matrix& matrix, const ColorTransform& cxform);
+        virtual void render(RenderContext& context, const Matrix& matrix, const ColorTransform& cxform);
 
         template<typename T> T* get(const std::string& name)
         {
@@ -152,6 +159,7 @@ namespace openswf
         void reset();
         void set_status(MovieGoto status);
         void set_context(avm::ContextObject*);
+        // contexts are created once scripts run on nodes or refer to them
         avm::ContextObject* get_context();
 
         void goto_frame(uint16_t frame, MovieGoto status = MovieGoto::NOCHANGE, int offset = 0);
@@ -186,11 +194,6 @@ namespace openswf
         m_context = context;
     }
 
-    inline avm::ContextObject* MovieNode::get_context()
-    {
-        return m_context;
-    }
-
     inline void MovieNode::set_status(MovieGoto status)
     {
         if( status == MovieGoto::PLAY ) m_paused = false;
@@ -3,10 +3,12 @@
 #include "stream.hpp"
 #include "player.hpp"
 #include "shader.hpp"
+#include "render_context.hpp"
 
 #include "shape.hpp"
 #include "image.hpp"
 #include "movie_clip.hpp"
+#include "snapshot.hpp"
 
 #include "swf/parser.hpp"
 
@@ -15,5 +17,8 @@
 
 namespace openswf
 {
-    bool initialize(float width, float height);
+    // creates a default context for applications which render on one thread
+    bool initialize(float width, float height, RenderBackend backend = RenderBackend::OPENGL);
+    void dispose();
+    RenderContext& get_context();
 }
\ No newline at end of file
@@ -1,41 +1,47 @@
 #include "player.hpp"
 #include "movie_clip.hpp"
 #include "shape.hpp"
+#include "atlas.hpp"
 #include "stream.hpp"
-#include "render.hpp"
+#include "render_context.hpp"
 
 #include "swf/parser.hpp"
 #include "avm/avm.hpp"
 #include "avm/virtual_machine.hpp"
 
 #include <ctime>
+#include <algorithm>
 
 namespace openswf
 {
-    const static int        MaxRecursionDepth = 256;
-    const static float      TimeoutSeconds = 0.1f;
     const static uint32_t   ClocksPerMs = CLOCKS_PER_SEC * 0.001;
 
     Player::Player()
-    : m_version(10),
-    m_avm(nullptr), m_script_max_recursion(MaxRecursionDepth), m_script_timeout(TimeoutSeconds)
+    : m_version(10), m_gradients(nullptr), m_images(nullptr), m_bitmap_retention(BitmapRetention::KEEP),
+    m_avm(nullptr), m_script_max_recursion(avm::DefaultMaxRecursion), m_script_timeout(avm::DefaultTimeoutSeconds)
     {}
 
-    Player* Player::create(Stream& stream)
+    Player* Player::create(Stream& stream, BitmapRetention retention)
     {
         auto player = new (std::nothrow) Player();
-        if( player && player->initialize(stream) )
+        if( player && player->initialize(stream, retention) )
             return player;
 
         if( player ) delete player;
         return nullptr;
     }
 
-    bool Player::initialize(Stream& stream)
+    bool Player::initialize(Stream& stream, BitmapRetention retention)
     {
+        m_bitmap_retention = retention;
         stream.set_position(0);
         auto header = SWFHeader::read(stream);
 
+        m_gradients = GradientAtlas::create();
+        m_images = ImageAtlas::create();
+        if( m_gradients == nullptr || m_images == nullptr )
+            return false;
+
         m_sprite = new (std::nothrow) MovieClip(0, header.frame_count, header.frame_rate);
         m_sprite->set_player(this);
 
@@ -56,10 +62,45 @@ namespace openswf
                     Parser::to_string(env.tag.code));
         }
 
+        // meshes of other levels are built lazily while playing, get_mesh_stats counts them later
+        auto& stats = m_mesh_stats;
+        if( stats.vertices_before > 0 )
+            printf("[INFO] shape meshes built while loading optimized from %u to %u vertices, %u to %u indices.\n",
+                stats.vertices_before, stats.vertices_after, stats.indices_before, stats.indices_after);
+
+        // images are packed once all of the fills using them are known
+        std::vector<Image*> images;
+        for( auto& pair : m_dictionary )
+        {
+            auto image = dynamic_cast<Image*>(pair.second);
+            if( image != nullptr )
+                images.push_back(image);
+        }
+
+        m_images->pack(images);
+        auto& packed = m_images->get_stats();
+        if( packed.packed > 0 )
+            printf("[INFO] %u of %u images packed into %u atlas pages.\n",
+                packed.packed, packed.images, packed.pages);
+
+        // pixels of packed images are kept by pages, others by textures later
+        for( auto image : images )
+        {
+            if( !image->set_retention(m_bitmap_retention) )
+                printf("[WARN] image %u keeps its pixels without a source.\n", image->get_character_id());
+        }
+
+        auto& gradients = m_gradients->get_stats();
+        if( gradients.fills > 0 )
+            printf("[INFO] %u gradient fills share %u gradients in %u textures, %llu to %llu bytes.\n",
+                gradients.fills, gradients.gradients, gradients.pages,
+                (unsigned long long)gradients.bytes_before, (unsigned long long)gradients.bytes_after);
+
         m_root = new (std::nothrow) MovieNode(this, m_sprite);
         m_root->set_name("_level0");
 
         m_avm = new (std::nothrow) avm::VirtualMachine(m_version);
+        m_avm->set_limits(avm::ScriptLimits(m_script_max_recursion, m_script_timeout));
         m_context = m_avm->new_context(m_root);
         return true;
     }
@@ -70,6 +111,19 @@ namespace openswf
             delete pair.second;
         m_dictionary.clear();
 
+        // after shapes and images, which refer to them
+        if( m_gradients != nullptr )
+        {
+            delete m_gradients;
+            m_gradients = nullptr;
+        }
+
+        if( m_images != nullptr )
+        {
+            delete m_images;
+            m_images = nullptr;
+        }
+
         if( m_sprite != nullptr )
         {
             delete m_sprite;
@@ -93,13 +147,36 @@ namespace openswf
     void Player::update(float dt)
     {
         m_root->update(dt);
+
+        // garbage of scripts is collected in slices within a budget of frame
+        m_avm->get_heap().step();
     }
 
-    void Player::render()
+    void Player::render(RenderContext& context)
     {
-        Render::get_instance().clear(CLEAR_COLOR | CLEAR_DEPTH,
+        context.get_render().clear(CLEAR_COLOR | CLEAR_DEPTH,
             m_background.r, m_background.g, m_background.b, m_background.a);
-        m_root->render(Matrix::identity, ColorTransform::identity);
+        m_root->render(context, Matrix::identity, ColorTransform::identity);
+    }
+
+    void Player::goto_frame(uint16_t frame)
+    {
+        auto count = m_root->get_frame_count();
+        frame = std::min(std::max(frame, (uint16_t)1), count);
+
+        auto rate = m_root->get_frame_rate();
+        auto delta = 1.f / (rate > 0.f ? rate : 1.f);
+
+        // a frame is stepped by each update, except the first one which only
+        // enters frame 1. it wraps at the end of timeline if frame is behind.
+        for( auto i=0; i<=count+1 && m_root->get_current_frame() != frame; i++ )
+        {
+            auto last = m_root->get_current_frame();
+            update(delta);
+
+            if( m_root->get_current_frame() == last )
+                break;
+        }
     }
 
     void Player::set_character(uint16_t cid, ICharacter* ch)
@@ -109,6 +186,18 @@ namespace openswf
         m_dictionary[cid] = ch;
     }
 
+    BitmapStats Player::get_bitmap_stats() const
+    {
+        BitmapStats stats;
+        for( auto& pair : m_dictionary )
+        {
+            auto image = dynamic_cast<const Image*>(pair.second);
+            if( image != nullptr )
+                image->add_bitmap_stats(stats);
+        }
+        return stats;
+    }
+
     uint32_t Player::get_eplased_ms() const
     {
         return clock() / ClocksPerMs - m_start_ms;
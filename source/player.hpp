@@ -3,6 +3,8 @@
 #include "debug.hpp"
 #include "types.hpp"
 #include "movie_clip.hpp"
+#include "mesh.hpp"
+#include "image.hpp"
 #include "avm/avm.hpp"
 
 #include <memory>
@@ -13,6 +15,9 @@ namespace openswf
     class ICharacter;
     class Stream;
     class Parser;
+    class RenderContext;
+    class GradientAtlas;
+    class ImageAtlas;
     class Player
     {
         friend class Parser;
@@ -30,20 +35,28 @@ namespace openswf
         uint8_t         m_version;
         uint16_t        m_script_max_recursion, m_script_timeout;
         uint32_t        m_start_ms;
+        MeshStats       m_mesh_stats;
+        GradientAtlas*  m_gradients;
+        ImageAtlas*     m_images;
+        BitmapRetention m_bitmap_retention;
 
         avm::VirtualMachine*    m_avm;
         avm::ContextObject*     m_context;
 
     protected:
         Player();
-        bool initialize(Stream& stream);
+        bool initialize(Stream& stream, BitmapRetention retention);
 
     public:
-        static Player* create(Stream& stream);
+        // pixels of images are released once uploaded with BitmapRetention::RELEASE
+        static Player* create(Stream& stream, BitmapRetention retention = BitmapRetention::KEEP);
         ~Player();
 
         void update(float dt);
-        void render();
+        void render(RenderContext& context);
+        // advances the root timeline to frame without rendering, actions are
+        // executed as playing. it stops early if root is stopped by actions.
+        void goto_frame(uint16_t frame);
 
         //
         void            set_character(uint16_t, ICharacter* ch);
@@ -67,6 +80,14 @@ namespace openswf
         uint16_t        get_script_timeout() const;
         uint32_t        get_eplased_ms() const;
 
+        void             add_mesh_stats(const MeshStats& stats);
+        const MeshStats& get_mesh_stats() const;
+        GradientAtlas&   get_gradient_atlas();
+        ImageAtlas&      get_image_atlas();
+        BitmapRetention  get_bitmap_retention() const;
+        // sums images of dictionary, pixels of atlas pages are not included
+        BitmapStats      get_bitmap_stats() const;
+
         MovieClip&              get_root_def();
         MovieNode&              get_root();
         avm::VirtualMachine&    get_virtual_machine();
@@ -114,6 +135,31 @@ namespace openswf
         return m_script_timeout;
     }
 
+    inline void Player::add_mesh_stats(const MeshStats& stats)
+    {
+        m_mesh_stats += stats;
+    }
+
+    inline const MeshStats& Player::get_mesh_stats() const
+    {
+        return m_mesh_stats;
+    }
+
+    inline GradientAtlas& Player::get_gradient_atlas()
+    {
+        return *m_gradients;
+    }
+
+    inline ImageAtlas& Player::get_image_atlas()
+    {
+        return *m_images;
+    }
+
+    inline BitmapRetention Player::get_bitmap_retention() const
+    {
+        return m_bitmap_retention;
+    }
+
     inline MovieClip& Player::get_root_def()
     {
         return *m_sprite;
@@ -1,4 +1,6 @@
 #include "render.hpp"
+#include "render_software.hpp"
+#include "residency.hpp"
 #include "debug.hpp"
 #include "types.hpp"
 
@@ -221,43 +223,50 @@ namespace openswf
         void apply_scissor();
     };
 
-    template<typename T> T* array_alloc(std::vector<T>& resources)
+    class GLRender : public Render
     {
-        for( int i=0; i<resources.size(); i++ )
-        {
-            if( resources[i].handle == 0 ) 
-                return &resources[i];
-        }
-
-        resources.push_back(T());
-        return &resources[resources.size()-1];
-    }
-
-    template<typename T> void array_free(std::vector<T>& resources, Rid rid)
-    {
-        if( rid <= 0 || rid > resources.size() )
-            return;
-
-        resources[rid-1].handle = 0;
-    }
-
-    template<typename T> T* array_get(std::vector<T>& resources, Rid rid)
-    {
-        if( rid <= 0 || rid > resources.size() )
-            return nullptr;
-
-        return &resources[rid-1];
-    }
-
-    template<typename T> Rid array_id(std::vector<T>& resources, T* target)
-    {
-        for( int i=0; i<resources.size(); i++ )
-        {
-            if( &resources[i] == target )
-                return i+1;
-        }
-        return 0;
-    }
+    protected:
+        RenderInstance* m_state;
+
+        GLRender() : m_state(nullptr) {}
+
+    public:
+        static GLRender* create();
+        virtual ~GLRender();
+
+        virtual void set_viewport(int x, int y, int width, int height);
+        virtual void set_scissor(bool enable, int x=0, int y=0, int width=0, int height=0);
+        virtual void set_blend(BlendFunc src, BlendFunc dst);
+        virtual void set_depth(bool write, DepthTestFunc test);
+        virtual void set_cull(CullMode mode);
+
+        virtual void reset();
+        virtual void flush();
+        virtual void finish();
+
+        virtual void clear(uint32_t mask, uint8_t r, uint8_t g, uint8_t b, uint8_t a);
+        virtual void draw(DrawMode mode, int from_index, int number_index);
+
+        virtual void bind_shader(Rid id);
+        virtual void bind_index_buffer(Rid id, ElementFormat format, int stride, int offset);
+        virtual void bind_vertex_buffer(int index, Rid id,
+            int n, ElementFormat format, int stride, int offset, bool normalized = false);
+        virtual void bind_texture(int index, Rid id);
+        virtual void bind_uniform(int index, UniformFormat format, const float* v);
+
+        virtual Rid create_buffer(RenderObject what, const void* data, int size);
+        virtual Rid create_texture(const void* data, int width, int height, TextureFormat format, int mipmap);
+        virtual Rid create_shader(const char* vs, const char* fs, int attribute_n,
+            int texture_n, const char** textures,
+            int uniform_n, const char** uniforms);
+
+        virtual void release(RenderObject what, Rid id);
+
+        virtual void update_buffer(Rid id, const void* data, int size);
+        virtual void update_buffer_range(Rid id, int offset, const void* data, int size);
+        virtual int  get_texture_memsize(Rid id);
+        virtual void read_pixels(int x, int y, int width, int height, void* pixels);
+    };
 
     void RenderInstance::reset()
     {
@@ -512,104 +521,115 @@ namespace openswf
         }
     }
 
-    //// GLOBAL RENDER SINGLETON 
-    static Render* s_instance = nullptr;
+    //// RENDER FACTORY
+    Render::Render()
+    : m_residency(new TextureResidency(*this))
+    {}
 
-    bool Render::initialize()
+    // owners of textures are told after the backend has released them all
+    Render::~Render()
     {
-        assert( s_instance == nullptr );
-        s_instance = new (std::nothrow) Render();
-        if( !s_instance ) return false;
+        delete m_residency;
+    }
 
-        s_instance->m_state = new (std::nothrow) RenderInstance();
-        if( !s_instance->m_state )
+    Render* Render::create(RenderBackend backend)
+    {
+        if( backend == RenderBackend::SOFTWARE )
+            return SoftwareRender::create();
+        return GLRender::create();
+    }
+
+    //// OPENGL RENDER
+    GLRender* GLRender::create()
+    {
+        auto render = new (std::nothrow) GLRender();
+        if( !render ) return nullptr;
+
+        render->m_state = new (std::nothrow) RenderInstance();
+        if( !render->m_state )
         {
-            dispose();
-            return false;
+            delete render;
+            return nullptr;
         }
 
         glewExperimental = GL_TRUE;
         if( glewInit() != GLEW_OK )
         {
-            dispose();
-            return false;
+            delete render;
+            return nullptr;
         }
         CHECK_GL_ERROR
 
-        auto state = s_instance->m_state;
+        auto state = render->m_state;
         memset(state, 0, sizeof(RenderState));
 
         // default render framebuffer
         glGetIntegerv(GL_FRAMEBUFFER_BINDING, &state->framebuffer);
         CHECK_GL_ERROR
 
-        s_instance->reset();
-        return true;
+        render->reset();
+        return render;
     }
 
-    #define SAFE_DELETE(target) do { if(target != nullptr) { delete target; target = nullptr; } } while(0);
-
-    void Render::dispose()
+    GLRender::~GLRender()
     {
-        if( s_instance != nullptr )
+        if( m_state != nullptr )
         {
-            if( s_instance->m_state != nullptr )
-                SAFE_DELETE(s_instance->m_state);
-
-            SAFE_DELETE(s_instance);
+            delete m_state;
+            m_state = nullptr;
         }
     }
 
-    Render& Render::get_instance()
-    {
-        assert( s_instance != nullptr );
-        return *s_instance;
-    }
-
     //// IMPLEMENTATIONS OF RENDER APPLICATION INTERFACE
-    void Render::set_viewport(int x, int y, int width, int height)
+    void GLRender::set_viewport(int x, int y, int width, int height)
     {
         glViewport(x, y, width, height);
     }
 
-    void Render::set_scissor(bool enable, int x, int y, int width, int height)
+    void GLRender::set_scissor(bool enable, int x, int y, int width, int height)
     {
         m_state->current.scissor = enable;
         m_state->current.scissor_rect = Rect(x, x+width, y, y+height);
         m_state->change_flags |= CHANGE_SCISSOR;
     }
 
-    void Render::set_blend(BlendFunc src, BlendFunc dst)
+    void GLRender::set_blend(BlendFunc src, BlendFunc dst)
     {
         m_state->current.blend_src = src;
         m_state->current.blend_dst = dst;
         m_state->change_flags |= CHANGE_BLEND;
     }
 
-    void Render::set_depth(bool write, DepthTestFunc format)
+    void GLRender::set_depth(bool write, DepthTestFunc format)
     {
         m_state->current.depth = format;
         m_state->current.depthmask = write;
         m_state->change_flags |= CHANGE_DEPTH;
     }
 
-    void Render::set_cull(CullMode mode)
+    void GLRender::set_cull(CullMode mode)
     {
         m_state->current.cull = mode;
         m_state->change_flags |= CHANGE_CULL;
     }
 
-    void Render::reset()
+    void GLRender::reset()
     {
         this->m_state->reset();
     }
 
-    void Render::flush()
+    void GLRender::flush()
+    {
+        this->m_state->commit();
+    }
+
+    void GLRender::finish()
     {
         this->m_state->commit();
+        glFinish();
     }
 
-    void Render::clear(uint32_t mask, uint8_t r, uint8_t g, uint8_t b, uint8_t a)
+    void GLRender::clear(uint32_t mask, uint8_t r, uint8_t g, uint8_t b, uint8_t a)
     {
         GLbitfield targets = 0;
         
@@ -630,7 +650,7 @@ namespace openswf
         CHECK_GL_ERROR
     }
 
-    void Render::draw(DrawMode mode, int from_index, int number)
+    void GLRender::draw(DrawMode mode, int from_index, int number)
     {
         static int draw_mode[] = {
             GL_TRIANGLES,
@@ -648,9 +668,12 @@ namespace openswf
         auto offset = from_index*get_sizeof_format(format);
         glDrawElements(draw_mode[(int)mode], number, format, (char*)0+offset);
         CHECK_GL_ERROR
+
+        m_stats.draw_calls ++;
+        m_stats.triangles += mode == DrawMode::TRIANGLE ? number / 3 : 0;
     }
 
-    void Render::bind_index_buffer(Rid id, ElementFormat format, int stride, int offset)
+    void GLRender::bind_index_buffer(Rid id, ElementFormat format, int stride, int offset)
     {
         m_state->current.index_buffer = BufferLayout(id,
             1, ElementFormatTable[(int)format],
@@ -658,7 +681,7 @@ namespace openswf
         m_state->change_flags |= CHANGE_VERTEXARRAY;
     }
 
-    void Render::bind_vertex_buffer(int index, Rid id, int n, ElementFormat format, int stride, int offset, bool normalized)
+    void GLRender::bind_vertex_buffer(int index, Rid id, int n, ElementFormat format, int stride, int offset, bool normalized)
     {
         assert( index >= 0 && index < MaxVertexBufferSlot );
         m_state->current.vertex_buffers[index] = BufferLayout(id,
@@ -667,14 +690,14 @@ namespace openswf
         m_state->change_flags |= CHANGE_VERTEXARRAY;
     }
 
-    void Render::bind_texture(int index, Rid id)
+    void GLRender::bind_texture(int index, Rid id)
     {
         assert( index >= 0 && index < MaxTexture );
         m_state->current.textures[index] = id;
         m_state->change_flags |= CHANGE_TEXTURE;
     }
 
-    void Render::bind_uniform(int index, UniformFormat format, const float* v)
+    void GLRender::bind_uniform(int index, UniformFormat format, const float* v)
     {
         auto program = array_get(m_state->programs, m_state->current.program);
         if( program == nullptr || program->handle == 0)
@@ -736,7 +759,7 @@ namespace openswf
         CHECK_GL_ERROR
     }
 
-    void Render::bind_shader(Rid id)
+    void GLRender::bind_shader(Rid id)
     {
         m_state->current.program = id;
         m_state->change_flags |= CHANGE_SHADER;
@@ -768,7 +791,7 @@ namespace openswf
         return shader;
     }
 
-    Rid Render::create_shader(
+    Rid GLRender::create_shader(
         const char* vs_src, const char* fs_src,
         int attribute_n,
         int texture_n, const char** textures,
@@ -833,7 +856,7 @@ namespace openswf
         return array_id(m_state->programs, program);
     }
 
-    Rid Render::create_buffer(RenderObject what, const void* data, int size)
+    Rid GLRender::create_buffer(RenderObject what, const void* data, int size)
     {
         assert( what == RenderObject::VERTEX_BUFFER || what == RenderObject::INDEX_BUFFER );
 
@@ -853,7 +876,7 @@ namespace openswf
         return array_id(m_state->buffers, buffer);
     }
 
-    void Render::update_buffer(Rid id, const void* data, int size)
+    void GLRender::update_buffer(Rid id, const void* data, int size)
     {
         auto buffer = array_get(m_state->buffers, id);
         if( buffer == nullptr ) return;
@@ -866,7 +889,48 @@ namespace openswf
         CHECK_GL_ERROR
     }
 
-    Rid Render::create_texture(const void* data, int width, int height, TextureFormat format, int mipmap)
+    void GLRender::update_buffer_range(Rid id, int offset, const void* data, int size)
+    {
+        auto buffer = array_get(m_state->buffers, id);
+        if( buffer == nullptr ) return;
+
+        // the copy target is not a part of vertex array states
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffer->handle);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, offset, size, data);
+
+        CHECK_GL_ERROR
+    }
+
+    int GLRender::get_texture_memsize(Rid id)
+    {
+        auto texture = array_get(m_state->textures, id);
+        return texture != nullptr ? texture->memsize : 0;
+    }
+
+    void GLRender::read_pixels(int x, int y, int width, int height, void* pixels)
+    {
+        assert( width > 0 && height > 0 && pixels != nullptr );
+
+        m_state->commit();
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadPixels(x, y, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+        CHECK_GL_ERROR
+
+        // opengl returns rows from bottom to top
+        auto stride = width * 4;
+        std::vector<uint8_t> row(stride);
+        auto bytes = (uint8_t*)pixels;
+        for( auto i=0; i<height/2; i++ )
+        {
+            auto top = bytes + i*stride;
+            auto bottom = bytes + (height-1-i)*stride;
+            memcpy(row.data(), top, stride);
+            memcpy(top, bottom, stride);
+            memcpy(bottom, row.data(), stride);
+        }
+    }
+
+    Rid GLRender::create_texture(const void* data, int width, int height, TextureFormat format, int mipmap)
     {
         assert(mipmap >= 0 && width > 0 && height > 0);
 
@@ -937,7 +1001,7 @@ namespace openswf
         return array_id(m_state->textures, texture);
     }
 
-    void Render::release(RenderObject what, Rid id)
+    void GLRender::release(RenderObject what, Rid id)
     {
         switch(what)
         {
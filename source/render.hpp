@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cstdint>
+#include <vector>
 
 namespace openswf
 {
@@ -107,49 +108,124 @@ namespace openswf
         BACK,
     };
 
-    class RenderInstance;
+    enum class RenderBackend : uint8_t
+    {
+        OPENGL = 0,
+        SOFTWARE,
+    };
+
+    // counters of submitted work, pixels are only counted by backends
+    // which rasterize by themselves.
+    struct RenderStats
+    {
+        uint32_t draw_calls;
+        uint32_t triangles;
+        uint64_t pixels;
+
+        RenderStats() : draw_calls(0), triangles(0), pixels(0) {}
+    };
+
+    class TextureResidency;
     class Render
     {
     protected:
-        RenderInstance* m_state;
+        RenderStats         m_stats;
+        TextureResidency*   m_residency;
+
+        Render();
 
     public:
-        static Render& get_instance();
-        static bool initialize();
-        static void dispose();
-
-        void set_viewport(int x, int y, int width, int height);
-        void set_scissor(bool enable, int x=0, int y=0, int width=0, int height=0);
-        void set_blend(BlendFunc src, BlendFunc dst);
-        void set_depth(bool write, DepthTestFunc test);
-        void set_cull(CullMode mode);
-
-        void reset();
-        void flush();
-
-        void clear(uint32_t mask, uint8_t r, uint8_t g, uint8_t b, uint8_t a);
-        void draw(DrawMode mode, int from_index, int number_index);
-
-        void bind_shader(Rid id);
-        void bind_index_buffer(Rid id, ElementFormat format, int stride, int offset);
-        void bind_vertex_buffer(int index, Rid id, 
-            int n, ElementFormat format, int stride, int offset, bool normalized = false);
-        void bind_texture(int index, Rid id);
-        void bind_uniform(int index, UniformFormat format, const float* v);
-
-        Rid create_buffer(RenderObject what, const void* data, int size);
-        Rid create_texture(const void* data, int width, int height, TextureFormat format, int mipmap);
-        Rid create_shader(const char* vs, const char* fs, int attribute_n,
+        static Render* create(RenderBackend backend = RenderBackend::OPENGL);
+
+        virtual ~Render();
+
+        virtual void set_viewport(int x, int y, int width, int height) = 0;
+        virtual void set_scissor(bool enable, int x=0, int y=0, int width=0, int height=0) = 0;
+        virtual void set_blend(BlendFunc src, BlendFunc dst) = 0;
+        virtual void set_depth(bool write, DepthTestFunc test) = 0;
+        virtual void set_cull(CullMode mode) = 0;
+
+        virtual void reset() = 0;
+        virtual void flush() = 0;
+        // blocks until all of submitted commands are completed
+        virtual void finish() = 0;
+
+        virtual void clear(uint32_t mask, uint8_t r, uint8_t g, uint8_t b, uint8_t a) = 0;
+        virtual void draw(DrawMode mode, int from_index, int number_index) = 0;
+
+        virtual void bind_shader(Rid id) = 0;
+        virtual void bind_index_buffer(Rid id, ElementFormat format, int stride, int offset) = 0;
+        virtual void bind_vertex_buffer(int index, Rid id,
+            int n, ElementFormat format, int stride, int offset, bool normalized = false) = 0;
+        virtual void bind_texture(int index, Rid id) = 0;
+        virtual void bind_uniform(int index, UniformFormat format, const float* v) = 0;
+
+        virtual Rid create_buffer(RenderObject what, const void* data, int size) = 0;
+        virtual Rid create_texture(const void* data, int width, int height, TextureFormat format, int mipmap) = 0;
+        virtual Rid create_shader(const char* vs, const char* fs, int attribute_n,
             int texture_n, const char** textures,
-            int uniform_n, const char** uniforms);
+            int uniform_n, const char** uniforms) = 0;
+
+        virtual void release(RenderObject what, Rid id) = 0;
+        // bytes of texture storage, with mipmaps
+        virtual int  get_texture_memsize(Rid id) = 0;
+
+        // replaces the storage of buffer, data could be null to only allocate it
+        virtual void update_buffer(Rid id, const void* data, int size) = 0;
+        // overwrites a range of buffer storage without touching the bindings
+        virtual void update_buffer_range(Rid id, int offset, const void* data, int size) = 0;
 
-        void release(RenderObject what, Rid id);
+        // reads RGBA8 pixels of current target, the origin of region is at the
+        // bottom-left as viewport, rows are written from top to bottom.
+        virtual void read_pixels(int x, int y, int width, int height, void* pixels) = 0;
 
-        void update_buffer(Rid id, const void* data, int size);
+        const RenderStats&  get_stats() const { return m_stats; }
+        void                reset_stats() { m_stats = RenderStats(); }
+        TextureResidency&   get_residency() { return *m_residency; }
 
         // void update_texture(Rid id, int width, int height, const void* pixels, int slice, int miplevel);
         // void subupdate_texture(Rid id, const void* pixels, int x, int y, int w, int h);
         // Rid create_target(int width, int height, TextureFormat format);
     };
 
+    /// RESOURCE SLOTS
+    // resources of backends are kept in arrays, a slot with zero handle is free.
+    // the id of a resource is its index plus one, so zero is never valid.
+    template<typename T> T* array_alloc(std::vector<T>& resources)
+    {
+        for( int i=0; i<resources.size(); i++ )
+        {
+            if( resources[i].handle == 0 )
+                return &resources[i];
+        }
+
+        resources.push_back(T());
+        return &resources[resources.size()-1];
+    }
+
+    template<typename T> void array_free(std::vector<T>& resources, Rid rid)
+    {
+        if( rid <= 0 || rid > resources.size() )
+            return;
+
+        resources[rid-1].handle = 0;
+    }
+
+    template<typename T> T* array_get(std::vector<T>& resources, Rid rid)
+    {
+        if( rid <= 0 || rid > resources.size() )
+            return nullptr;
+
+        return &resources[rid-1];
+    }
+
+    template<typename T> Rid array_id(std::vector<T>& resources, T* target)
+    {
+        for( int i=0; i<resources.size(); i++ )
+        {
+            if( &resources[i] == target )
+                return i+1;
+        }
+        return 0;
+    }
 }
\ No newline at end of file
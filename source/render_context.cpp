@@ -0,0 +1,79 @@
+#include "render_context.hpp"
+#include "shader.hpp"
+
+namespace openswf
+{
+    static const char* default_vs =
+        "#version 330 core\n"
+        "layout(location = 0) in vec4 in_position;\n"
+        "layout(location = 1) in vec2 in_texcoord;\n"
+        "layout(location = 2) in vec4 in_diffuse;\n"
+        "layout(location = 3) in vec4 in_additive;\n"
+        "uniform mat4 transform;\n"
+        "out vec2 vs_texcoord;\n"
+        "out vec4 vs_diffuse;\n"
+        "out vec4 vs_additive;\n"
+        "void main() {\n"
+        "  gl_Position = transform * in_position;\n"
+        "  vs_texcoord = in_texcoord;\n"
+        "  vs_diffuse  = in_diffuse;\n"
+        "  vs_additive = in_additive;\n"
+        "}\n";
+
+    static const char* default_fs =
+        "#version 330 core\n"
+        "uniform sampler2D texture0;\n"
+        "in vec2 vs_texcoord;\n"
+        "in vec4 vs_diffuse;\n"
+        "in vec4 vs_additive;\n"
+        "out vec4 color;\n"
+        "void main()\n"
+        "{\n"
+        "  color = texture(texture0, vs_texcoord)*vs_diffuse+vs_additive;\n"
+        "}\n";
+
+    RenderContext::RenderContext()
+    : m_render(nullptr), m_shader(nullptr), m_screen(nullptr)
+    {}
+
+    RenderContext* RenderContext::create(Render* render, float width, float height)
+    {
+        auto context = new (std::nothrow) RenderContext();
+        if( context && context->initialize(render, width, height) )
+            return context;
+
+        if( context ) delete context;
+        else if( render ) delete render;
+        return nullptr;
+    }
+
+    bool RenderContext::initialize(Render* render, float width, float height)
+    {
+        m_render = render;
+        if( m_render == nullptr )
+            return false;
+
+        m_screen = Screen::create(width, height);
+        if( m_screen == nullptr )
+            return false;
+
+        m_shader = Shader::create(*m_render, *m_screen);
+        if( m_shader == nullptr )
+            return false;
+
+        const char* textures[] = { "texture0" };
+        const char* uniforms[] = { "transform" };
+
+        m_shader->create(PROGRAM_DEFAULT, default_vs, default_fs, 1, textures, 1, uniforms);
+        m_shader->set_program(PROGRAM_DEFAULT);
+        m_shader->set_blend(BlendFunc::ONE, BlendFunc::ONE_MINUS_SRC_ALPHA);
+        return true;
+    }
+
+    RenderContext::~RenderContext()
+    {
+        if( m_shader ) delete m_shader;
+        if( m_screen ) delete m_screen;
+        if( m_render ) delete m_render;
+    }
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "render.hpp"
+
+namespace openswf
+{
+    class Shader;
+    class Screen;
+
+    // a render context owns everything needed to draw players: the render
+    // device with its state cache, a batcher of it and a screen. contexts share
+    // nothing mutable, so players could be rendered in parallel with one
+    // context per thread. a context should not be used by several threads at
+    // the same time, and players should be deleted before the context they
+    // are rendered with, which owns their textures.
+    class RenderContext
+    {
+    protected:
+        Render* m_render;
+        Shader* m_shader;
+        Screen* m_screen;
+
+        RenderContext();
+        bool initialize(Render* render, float width, float height);
+
+    public:
+        // takes the ownership of render, default programs are created with it.
+        static RenderContext* create(Render* render, float width, float height);
+        ~RenderContext();
+
+        Render& get_render();
+        Shader& get_shader();
+        Screen& get_screen();
+    };
+
+    /// INLINE METHODS
+    inline Render& RenderContext::get_render()
+    {
+        return *m_render;
+    }
+
+    inline Shader& RenderContext::get_shader()
+    {
+        return *m_shader;
+    }
+
+    inline Screen& RenderContext::get_screen()
+    {
+        return *m_screen;
+    }
+}
@@ -0,0 +1,1347 @@
+#include "render_software.hpp"
+#include "debug.hpp"
+
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define OPENSWF_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace openswf
+{
+    const static int        TileSize            = 64;
+    const static int        SubPixelBits        = 8;
+    const static int64_t    SubPixelScale       = 1 << SubPixelBits;
+    // vertices are clamped into the guard band, so that edge functions of
+    // sub-pixel coordinates never overflow 64 bits.
+    const static float      GuardBand           = (float)(1 << 20);
+    // pending triangles are resolved once there are too many of them
+    const static uint32_t   MaxQueuedTriangles  = 1 << 18;
+
+    /// FOUR LANES OF FLOAT
+    // a pixel of RGBA or a group of attributes, span shading works on all
+    // channels of one pixel at once.
+#ifdef OPENSWF_SSE2
+    struct Vec4
+    {
+        __m128 v;
+
+        Vec4() {}
+        Vec4(__m128 v) : v(v) {}
+        Vec4(float x, float y, float z, float w) : v(_mm_setr_ps(x, y, z, w)) {}
+        explicit Vec4(float s) : v(_mm_set1_ps(s)) {}
+
+        static Vec4 load(const float* p) { return _mm_loadu_ps(p); }
+
+        Vec4 operator + (const Vec4& rh) const { return _mm_add_ps(v, rh.v); }
+        Vec4 operator - (const Vec4& rh) const { return _mm_sub_ps(v, rh.v); }
+        Vec4 operator * (const Vec4& rh) const { return _mm_mul_ps(v, rh.v); }
+
+        float get_w() const { return _mm_cvtss_f32(_mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3))); }
+        Vec4 splat_w() const { return _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3)); }
+
+        Vec4 saturate() const
+        {
+            return _mm_min_ps(_mm_max_ps(v, _mm_setzero_ps()), _mm_set1_ps(1.f));
+        }
+
+        // pixels are packed with red in the lowest byte
+        static Vec4 unpack(uint32_t pixel)
+        {
+            auto zero = _mm_setzero_si128();
+            auto bytes = _mm_cvtsi32_si128((int)pixel);
+            auto lanes = _mm_unpacklo_epi16(_mm_unpacklo_epi8(bytes, zero), zero);
+            return _mm_mul_ps(_mm_cvtepi32_ps(lanes), _mm_set1_ps(1.f/255.f));
+        }
+
+        uint32_t pack() const
+        {
+            auto lanes = _mm_cvtps_epi32(_mm_mul_ps(v, _mm_set1_ps(255.f)));
+            lanes = _mm_packs_epi32(lanes, lanes);
+            lanes = _mm_packus_epi16(lanes, lanes);
+            return (uint32_t)_mm_cvtsi128_si32(lanes);
+        }
+    };
+#else
+    struct Vec4
+    {
+        float v[4];
+
+        Vec4() {}
+        Vec4(float x, float y, float z, float w) { v[0] = x; v[1] = y; v[2] = z; v[3] = w; }
+        explicit Vec4(float s) { v[0] = v[1] = v[2] = v[3] = s; }
+
+        static Vec4 load(const float* p) { return Vec4(p[0], p[1], p[2], p[3]); }
+
+        Vec4 operator + (const Vec4& rh) const
+        {
+            return Vec4(v[0]+rh.v[0], v[1]+rh.v[1], v[2]+rh.v[2], v[3]+rh.v[3]);
+        }
+
+        Vec4 operator - (const Vec4& rh) const
+        {
+            return Vec4(v[0]-rh.v[0], v[1]-rh.v[1], v[2]-rh.v[2], v[3]-rh.v[3]);
+        }
+
+        Vec4 operator * (const Vec4& rh) const
+        {
+            return Vec4(v[0]*rh.v[0], v[1]*rh.v[1], v[2]*rh.v[2], v[3]*rh.v[3]);
+        }
+
+        float get_w() const { return v[3]; }
+        Vec4 splat_w() const { return Vec4(v[3]); }
+
+        Vec4 saturate() const
+        {
+            Vec4 out;
+            for( auto i=0; i<4; i++ ) out.v[i] = std::min(std::max(v[i], 0.f), 1.f);
+            return out;
+        }
+
+        static Vec4 unpack(uint32_t pixel)
+        {
+            const float scale = 1.f/255.f;
+            return Vec4(
+                (float)(pixel & 0xFF) * scale, (float)((pixel >> 8) & 0xFF) * scale,
+                (float)((pixel >> 16) & 0xFF) * scale, (float)(pixel >> 24) * scale);
+        }
+
+        uint32_t pack() const
+        {
+            uint32_t pixel = 0;
+            for( auto i=0; i<4; i++ )
+                pixel |= (uint32_t)(v[i] * 255.f + 0.5f) << (i*8);
+            return pixel;
+        }
+    };
+#endif
+
+    static inline Vec4 lerp(const Vec4& from, const Vec4& to, float ratio)
+    {
+        return from + (to - from) * Vec4(ratio);
+    }
+
+    static inline uint32_t pack_rgba(uint32_t r, uint32_t g, uint32_t b, uint32_t a)
+    {
+        return r | (g << 8) | (b << 16) | (a << 24);
+    }
+
+    static int64_t floor_div(int64_t a, int64_t b)
+    {
+        auto q = a / b;
+        if( (a % b != 0) && ((a < 0) != (b < 0)) ) q--;
+        return q;
+    }
+
+    static int64_t ceil_div(int64_t a, int64_t b)
+    {
+        return -floor_div(-a, b);
+    }
+
+    /// RESOURCES AND PIPELINE STATES
+    struct SoftLayout
+    {
+        Rid             rid;
+        int             n;
+        ElementFormat   format;
+        int             stride;
+        int             offset;
+        bool            normalized;
+    };
+
+    struct SoftBuffer
+    {
+        uint32_t                handle;
+        std::vector<uint8_t>    data;
+
+        SoftBuffer() : handle(0) {}
+    };
+
+    struct SoftTexture
+    {
+        uint32_t                handle;
+        int                     width;
+        int                     height;
+        std::vector<uint32_t>   pixels; // RGBA8 of any format
+
+        SoftTexture() : handle(0), width(0), height(0) {}
+    };
+
+    struct SoftProgram
+    {
+        uint32_t        handle;
+        int             attribute_n;
+        int             texture_n;
+        int             uniform_n;
+        UniformFormat   formats[MaxUniform];
+        float           uniforms[MaxUniform][16];
+
+        SoftProgram() : handle(0) {}
+    };
+
+    // states of a draw call which are needed by shading
+    struct SoftDrawState
+    {
+        Rid                 texture;
+        const SoftTexture*  sampler;    // resolved from texture before shading
+        BlendFunc           blend_src, blend_dst;
+        DepthTestFunc       depth;
+        bool                depthmask;
+        int                 clip[4];    // xmin, ymin, xmax, ymax of rows from top
+    };
+
+    // attributes are interpolated in this order, colors first to be loaded as lanes
+    enum SoftAttribute
+    {
+        ATTR_DIFFUSE    = 0,
+        ATTR_ADDITIVE   = 4,
+        ATTR_U          = 8,
+        ATTR_V,
+        ATTR_Z,
+        ATTR_COUNT      = 12,
+    };
+
+    struct SoftVertex
+    {
+        float   x, y;   // pixels of rows from top
+        float   attributes[ATTR_COUNT];
+        bool    discard;
+    };
+
+    struct SoftTriangle
+    {
+        // edge functions a*x+b*y+c of sub-pixel positions, which are not less
+        // than bias inside. bias is 1 for edges excluded by the top-left rule.
+        int64_t     a[3], b[3], c[3], bias[3];
+        int         xmin, ymin, xmax, ymax;
+        float       x0, y0;
+        float       base[ATTR_COUNT], ddx[ATTR_COUNT], ddy[ATTR_COUNT];
+        uint32_t    state;
+        bool        flat;   // colors are constant
+    };
+
+    class SoftwareInstance
+    {
+    public:
+        RenderStats*            stats;
+
+        // framebuffer is stored from the top row, as images
+        int                     width, height;
+        std::vector<uint32_t>   colors;
+        std::vector<float>      depths;
+        int                     viewport[4];
+
+        Rid                     program;
+        Rid                     textures[MaxTexture];
+        SoftLayout              vertex_buffers[MaxVertexBufferSlot];
+        SoftLayout              index_buffer;
+        BlendFunc               blend_src, blend_dst;
+        DepthTestFunc           depth;
+        bool                    depthmask;
+        CullMode                cull;
+        bool                    scissor;
+        int                     scissor_rect[4];
+
+        std::vector<SoftBuffer>     buffers;
+        std::vector<SoftTexture>    textures_list;
+        std::vector<SoftProgram>    programs;
+
+        // pending works, triangles are binned into tiles in order of submission
+        int                                 tiles_x, tiles_y;
+        std::vector<SoftDrawState>          states;
+        std::vector<SoftTriangle>           triangles;
+        std::vector<std::vector<uint32_t>>  bins;
+        std::vector<uint32_t>               active_tiles;
+        std::vector<uint32_t>               indices;
+        std::vector<SoftVertex>             vertices;
+
+        // workers wait for a new generation of tiles, and the last one
+        // finished notifies the main thread.
+        std::vector<std::thread>    threads;
+        std::mutex                  mutex;
+        std::condition_variable     wake, done;
+        uint32_t                    generation;
+        int                         busy;
+        bool                        quit;
+        std::atomic<uint32_t>       next_tile;
+        std::atomic<uint64_t>       pixels;
+
+        SoftwareInstance();
+
+        void start(int count);
+        void stop();
+        void reset();
+        void resize(int width, int height);
+        void resolve();
+
+        void fetch(const SoftLayout& layout, uint32_t index, float* out) const;
+        uint32_t fetch_index(int position) const;
+        void transform(const SoftProgram& program, uint32_t index, SoftVertex& vertex) const;
+        uint32_t push_state();
+        void get_clip(int* clip) const;
+
+        void add_triangle(const SoftVertex* v0, const SoftVertex* v1, const SoftVertex* v2,
+            uint32_t state, bool cull);
+        void add_line(const SoftVertex& from, const SoftVertex& to, uint32_t state);
+
+    protected:
+        void run();
+        void shade_tiles();
+        uint64_t shade_tile(uint32_t tile);
+    };
+
+    SoftwareInstance::SoftwareInstance()
+    : stats(nullptr), width(0), height(0), tiles_x(0), tiles_y(0),
+    generation(0), busy(0), quit(false), next_tile(0), pixels(0)
+    {
+        reset();
+    }
+
+    void SoftwareInstance::start(int count)
+    {
+        // the main thread works as one of them
+        for( auto i=1; i<count; i++ )
+            threads.push_back(std::thread(&SoftwareInstance::run, this));
+    }
+
+    void SoftwareInstance::stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            quit = true;
+        }
+
+        wake.notify_all();
+        for( auto& thread : threads )
+            thread.join();
+        threads.clear();
+    }
+
+    void SoftwareInstance::reset()
+    {
+        viewport[0] = viewport[1] = 0;
+        viewport[2] = width;
+        viewport[3] = height;
+
+        program = 0;
+        memset(textures, 0, sizeof(textures));
+        memset(vertex_buffers, 0, sizeof(vertex_buffers));
+        memset(&index_buffer, 0, sizeof(index_buffer));
+
+        blend_src = blend_dst = BlendFunc::DISABLE;
+        depth = DepthTestFunc::DISABLE;
+        depthmask = false;
+        cull = CullMode::DISABLE;
+        scissor = false;
+        memset(scissor_rect, 0, sizeof(scissor_rect));
+    }
+
+    void SoftwareInstance::resize(int w, int h)
+    {
+        width = w;
+        height = h;
+        colors.assign(w*h, 0);
+        depths.assign(w*h, 1.f);
+
+        tiles_x = (w + TileSize - 1) / TileSize;
+        tiles_y = (h + TileSize - 1) / TileSize;
+        bins.clear();
+        bins.resize(tiles_x*tiles_y);
+    }
+
+    void SoftwareInstance::run()
+    {
+        uint32_t seen = 0;
+        for( ;; )
+        {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [&]() { return quit || generation != seen; });
+                if( quit ) return;
+                seen = generation;
+            }
+
+            shade_tiles();
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if( --busy == 0 ) done.notify_one();
+            }
+        }
+    }
+
+    void SoftwareInstance::resolve()
+    {
+        if( triangles.empty() )
+            return;
+
+        for( auto& state : states )
+        {
+            auto texture = array_get(textures_list, state.texture);
+            state.sampler = texture != nullptr && texture->handle != 0 ? texture : nullptr;
+        }
+
+        for( auto i=0; i<bins.size(); i++ )
+        {
+            if( !bins[i].empty() )
+                active_tiles.push_back(i);
+        }
+
+        next_tile = 0;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            busy = (int)threads.size();
+            generation ++;
+        }
+
+        wake.notify_all();
+        shade_tiles();
+
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            done.wait(lock, [&]() { return busy == 0; });
+        }
+
+        for( auto tile : active_tiles )
+            bins[tile].clear();
+
+        active_tiles.clear();
+        triangles.clear();
+        states.clear();
+
+        stats->pixels += pixels.exchange(0);
+    }
+
+    /// VERTEX PROCESSING
+    static int get_sizeof_format(ElementFormat format)
+    {
+        switch(format)
+        {
+            case ElementFormat::BYTE:
+            case ElementFormat::UNSIGNED_BYTE:
+                return 1;
+
+            case ElementFormat::SHORT:
+            case ElementFormat::UNSIGNED_SHORT:
+                return 2;
+
+            default:
+                return 4;
+        }
+    }
+
+    static float read_element(const uint8_t* p, ElementFormat format, bool normalized)
+    {
+        switch(format)
+        {
+            case ElementFormat::BYTE:
+                return normalized ? std::max((float)*(int8_t*)p / 127.f, -1.f) : (float)*(int8_t*)p;
+
+            case ElementFormat::UNSIGNED_BYTE:
+                return normalized ? (float)*p / 255.f : (float)*p;
+
+            case ElementFormat::SHORT:
+            {
+                int16_t v; memcpy(&v, p, sizeof(v));
+                return normalized ? std::max((float)v / 32767.f, -1.f) : (float)v;
+            }
+
+            case ElementFormat::UNSIGNED_SHORT:
+            {
+                uint16_t v; memcpy(&v, p, sizeof(v));
+                return normalized ? (float)v / 65535.f : (float)v;
+            }
+
+            case ElementFormat::INT:
+            {
+                int32_t v; memcpy(&v, p, sizeof(v));
+                return normalized ? std::max((float)v / 2147483647.f, -1.f) : (float)v;
+            }
+
+            case ElementFormat::UNSIGNED_INT:
+            {
+                uint32_t v; memcpy(&v, p, sizeof(v));
+                return normalized ? (float)v / 4294967295.f : (float)v;
+            }
+
+            default:
+            {
+                float v; memcpy(&v, p, sizeof(v));
+                return v;
+            }
+        }
+    }
+
+    // missing components are filled with (0, 0, 0, 1) as opengl does
+    void SoftwareInstance::fetch(const SoftLayout& layout, uint32_t index, float* out) const
+    {
+        out[0] = out[1] = out[2] = 0.f;
+        out[3] = 1.f;
+
+        if( layout.rid <= 0 || layout.rid > buffers.size() )
+            return;
+
+        auto& buffer = buffers[layout.rid-1];
+        auto size = get_sizeof_format(layout.format);
+        auto stride = layout.stride > 0 ? layout.stride : size * layout.n;
+        auto offset = (size_t)layout.offset + (size_t)index * stride;
+        if( buffer.handle == 0 || offset + size * layout.n > buffer.data.size() )
+            return;
+
+        for( auto i=0; i<layout.n && i<4; i++ )
+            out[i] = read_element(buffer.data.data() + offset + i*size, layout.format, layout.normalized);
+    }
+
+    uint32_t SoftwareInstance::fetch_index(int position) const
+    {
+        auto& buffer = buffers[index_buffer.rid-1];
+        auto size = get_sizeof_format(index_buffer.format);
+        auto offset = (size_t)position * size;
+        if( offset + size > buffer.data.size() )
+            return 0;
+
+        auto p = buffer.data.data() + offset;
+        if( size == 1 ) return *p;
+
+        if( size == 2 )
+        {
+            uint16_t v; memcpy(&v, p, sizeof(v));
+            return v;
+        }
+
+        uint32_t v; memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    void SoftwareInstance::transform(const SoftProgram& program, uint32_t index, SoftVertex& vertex) const
+    {
+        float position[4], texcoord[4], diffuse[4], additive[4];
+        fetch(vertex_buffers[0], index, position);
+        fetch(vertex_buffers[1], index, texcoord);
+        fetch(vertex_buffers[2], index, diffuse);
+        fetch(vertex_buffers[3], index, additive);
+
+        // uniform 0 is the column-major transform of default shader
+        float clip[4] = { position[0], position[1], position[2], position[3] };
+        if( program.uniform_n > 0 && program.formats[0] == UniformFormat::MATRIX_F44 )
+        {
+            auto m = program.uniforms[0];
+            for( auto r=0; r<4; r++ )
+                clip[r] = m[r]*position[0] + m[4+r]*position[1] + m[8+r]*position[2] + m[12+r]*position[3];
+        }
+
+        // primitives are not clipped, the ones behind viewer are dropped
+        vertex.discard = !(clip[3] > 1e-6f);
+        if( vertex.discard )
+            return;
+
+        auto inv = 1.f / clip[3];
+        auto nx = clip[0] * inv, ny = clip[1] * inv, nz = clip[2] * inv;
+
+        vertex.x = (float)viewport[0] + (nx * 0.5f + 0.5f) * (float)viewport[2];
+        vertex.y = (float)(height - viewport[1]) - (ny * 0.5f + 0.5f) * (float)viewport[3];
+
+        for( auto i=0; i<4; i++ )
+        {
+            vertex.attributes[ATTR_DIFFUSE+i] = diffuse[i];
+            vertex.attributes[ATTR_ADDITIVE+i] = additive[i];
+        }
+
+        vertex.attributes[ATTR_U] = texcoord[0];
+        vertex.attributes[ATTR_V] = texcoord[1];
+        vertex.attributes[ATTR_Z] = std::min(std::max(nz * 0.5f + 0.5f, 0.f), 1.f);
+        vertex.attributes[ATTR_COUNT-1] = 0.f;
+    }
+
+    // pixels out of viewport, scissor or framebuffer are never touched
+    void SoftwareInstance::get_clip(int* clip) const
+    {
+        clip[0] = std::max(viewport[0], 0);
+        clip[1] = std::max(height - (viewport[1] + viewport[3]), 0);
+        clip[2] = std::min(viewport[0] + viewport[2], width);
+        clip[3] = std::min(height - viewport[1], height);
+
+        if( scissor )
+        {
+            clip[0] = std::max(clip[0], scissor_rect[0]);
+            clip[1] = std::max(clip[1], height - (scissor_rect[1] + scissor_rect[3]));
+            clip[2] = std::min(clip[2], scissor_rect[0] + scissor_rect[2]);
+            clip[3] = std::min(clip[3], height - scissor_rect[1]);
+        }
+    }
+
+    uint32_t SoftwareInstance::push_state()
+    {
+        SoftDrawState state;
+        state.texture = textures[0];
+        state.sampler = nullptr;
+        state.blend_src = blend_src;
+        state.blend_dst = blend_dst;
+        state.depth = depth;
+        state.depthmask = depthmask;
+        get_clip(state.clip);
+
+        states.push_back(state);
+        return (uint32_t)states.size() - 1;
+    }
+
+    /// TRIANGLE SETUP AND BINNING
+    static int64_t to_subpixel(float v)
+    {
+        v = std::min(std::max(v, -GuardBand), GuardBand);
+        return (int64_t)std::floor(v * (float)SubPixelScale + 0.5f);
+    }
+
+    void SoftwareInstance::add_triangle(const SoftVertex* v0, const SoftVertex* v1, const SoftVertex* v2,
+        uint32_t state, bool cull_faces)
+    {
+        if( v0->discard || v1->discard || v2->discard )
+            return;
+
+        int64_t x[3] = { to_subpixel(v0->x), to_subpixel(v1->x), to_subpixel(v2->x) };
+        int64_t y[3] = { to_subpixel(v0->y), to_subpixel(v1->y), to_subpixel(v2->y) };
+
+        auto area = (x[1]-x[0])*(y[2]-y[0]) - (y[1]-y[0])*(x[2]-x[0]);
+        if( area == 0 )
+            return;
+
+        // rows are stored from top, so a positive area is counter-clockwise in
+        // window coordinates of opengl, which is the front face.
+        if( cull_faces && cull != CullMode::DISABLE )
+        {
+            auto front = area > 0;
+            if( (cull == CullMode::BACK && !front) || (cull == CullMode::FRONT && front) )
+                return;
+        }
+
+        if( area < 0 )
+        {
+            std::swap(v1, v2);
+            std::swap(x[1], x[2]);
+            std::swap(y[1], y[2]);
+        }
+
+        auto& clip = states[state].clip;
+        auto xmin = std::max((int64_t)clip[0], floor_div(std::min({x[0], x[1], x[2]}), SubPixelScale));
+        auto ymin = std::max((int64_t)clip[1], floor_div(std::min({y[0], y[1], y[2]}), SubPixelScale));
+        auto xmax = std::min((int64_t)clip[2], floor_div(std::max({x[0], x[1], x[2]}), SubPixelScale) + 1);
+        auto ymax = std::min((int64_t)clip[3], floor_div(std::max({y[0], y[1], y[2]}), SubPixelScale) + 1);
+        if( xmin >= xmax || ymin >= ymax )
+            return;
+
+        SoftTriangle triangle;
+        triangle.xmin = (int)xmin;
+        triangle.ymin = (int)ymin;
+        triangle.xmax = (int)xmax;
+        triangle.ymax = (int)ymax;
+        triangle.state = state;
+
+        for( auto i=0; i<3; i++ )
+        {
+            auto j = (i+1) % 3;
+            triangle.a[i] = y[i] - y[j];
+            triangle.b[i] = x[j] - x[i];
+            triangle.c[i] = -(triangle.a[i]*x[i] + triangle.b[i]*y[i]);
+
+            // top edges and left edges are inclusive
+            auto top_left = triangle.a[i] > 0 || (triangle.a[i] == 0 && triangle.b[i] > 0);
+            triangle.bias[i] = top_left ? 0 : 1;
+        }
+
+        // planes of attributes are set up with snapped positions
+        const float scale = 1.f / (float)SubPixelScale;
+        auto fx1 = (float)(x[1]-x[0]) * scale, fy1 = (float)(y[1]-y[0]) * scale;
+        auto fx2 = (float)(x[2]-x[0]) * scale, fy2 = (float)(y[2]-y[0]) * scale;
+        auto inv_area = 1.f / (fx1*fy2 - fx2*fy1);
+
+        triangle.x0 = (float)x[0] * scale;
+        triangle.y0 = (float)y[0] * scale;
+        triangle.flat = true;
+
+        for( auto i=0; i<ATTR_COUNT; i++ )
+        {
+            auto a0 = v0->attributes[i];
+            auto d1 = v1->attributes[i] - a0;
+            auto d2 = v2->attributes[i] - a0;
+
+            triangle.base[i] = a0;
+            triangle.ddx[i] = (d1*fy2 - d2*fy1) * inv_area;
+            triangle.ddy[i] = (d2*fx1 - d1*fx2) * inv_area;
+
+            if( i < ATTR_U && (d1 != 0.f || d2 != 0.f) )
+                triangle.flat = false;
+        }
+
+        auto index = (uint32_t)triangles.size();
+        triangles.push_back(triangle);
+
+        for( auto ty=triangle.ymin/TileSize; ty<=(triangle.ymax-1)/TileSize; ty++ )
+            for( auto tx=triangle.xmin/TileSize; tx<=(triangle.xmax-1)/TileSize; tx++ )
+                bins[ty*tiles_x+tx].push_back(index);
+    }
+
+    // lines are expanded into quads of one pixel wide
+    void SoftwareInstance::add_line(const SoftVertex& from, const SoftVertex& to, uint32_t state)
+    {
+        if( from.discard || to.discard )
+            return;
+
+        auto dx = to.x - from.x, dy = to.y - from.y;
+        auto length = std::sqrt(dx*dx + dy*dy);
+        if( length <= 0.f )
+            return;
+
+        auto nx = -dy / length * 0.5f, ny = dx / length * 0.5f;
+
+        SoftVertex quad[4] = { from, from, to, to };
+        quad[0].x += nx; quad[0].y += ny;
+        quad[1].x -= nx; quad[1].y -= ny;
+        quad[2].x -= nx; quad[2].y -= ny;
+        quad[3].x += nx; quad[3].y += ny;
+
+        add_triangle(&quad[0], &quad[1], &quad[2], state, false);
+        add_triangle(&quad[0], &quad[2], &quad[3], state, false);
+    }
+
+    /// SPAN SHADING
+    static Vec4 sample(const SoftTexture& texture, float u, float v)
+    {
+        // bilinear filter with clamp to edge, mipmaps are not used
+        auto x = u * (float)texture.width - 0.5f;
+        auto y = v * (float)texture.height - 0.5f;
+        if( !(x >= -1.f) ) x = -1.f;
+        if( !(y >= -1.f) ) y = -1.f;
+        x = std::min(x, (float)texture.width);
+        y = std::min(y, (float)texture.height);
+
+        auto fx = std::floor(x), fy = std::floor(y);
+        auto tx = x - fx, ty = y - fy;
+        auto ix = (int)fx, iy = (int)fy;
+
+        auto x0 = std::min(std::max(ix, 0), texture.width-1);
+        auto x1 = std::min(std::max(ix+1, 0), texture.width-1);
+        auto y0 = std::min(std::max(iy, 0), texture.height-1);
+        auto y1 = std::min(std::max(iy+1, 0), texture.height-1);
+
+        auto row0 = texture.pixels.data() + y0 * texture.width;
+        auto row1 = texture.pixels.data() + y1 * texture.width;
+
+        auto top = lerp(Vec4::unpack(row0[x0]), Vec4::unpack(row0[x1]), tx);
+        auto bottom = lerp(Vec4::unpack(row1[x0]), Vec4::unpack(row1[x1]), tx);
+        return lerp(top, bottom, ty);
+    }
+
+    static Vec4 get_blend_factor(BlendFunc func, const Vec4& src, const Vec4& dst)
+    {
+        switch(func)
+        {
+            case BlendFunc::ZERO:
+                return Vec4(0.f);
+            case BlendFunc::SRC_COLOR:
+                return src;
+            case BlendFunc::ONE_MINUS_SRC_COLOR:
+                return Vec4(1.f) - src;
+            case BlendFunc::SRC_ALPHA:
+                return src.splat_w();
+            case BlendFunc::ONE_MINUS_SRC_ALPHA:
+                return Vec4(1.f) - src.splat_w();
+            case BlendFunc::DST_ALPHA:
+                return dst.splat_w();
+            case BlendFunc::ONE_MINUS_DST_ALPHA:
+                return Vec4(1.f) - dst.splat_w();
+            case BlendFunc::DST_COLOR:
+                return dst;
+            case BlendFunc::ONE_MINUS_DST_COLOR:
+                return Vec4(1.f) - dst;
+            case BlendFunc::SRC_ALPHA_SATURATE:
+            {
+                auto f = std::min(src.get_w(), 1.f - dst.get_w());
+                return Vec4(f, f, f, 1.f);
+            }
+            default:
+                return Vec4(1.f);
+        }
+    }
+
+    static inline uint32_t blend(const SoftDrawState& state, const Vec4& src, uint32_t pixel)
+    {
+        if( state.blend_src == BlendFunc::DISABLE )
+            return src.pack();
+
+        auto dst = Vec4::unpack(pixel);
+        auto color = src * get_blend_factor(state.blend_src, src, dst) +
+            dst * get_blend_factor(state.blend_dst, src, dst);
+        return color.saturate().pack();
+    }
+
+    static inline bool depth_test(DepthTestFunc func, float z, float depth)
+    {
+        switch(func)
+        {
+            case DepthTestFunc::LESS_EQUAL:     return z <= depth;
+            case DepthTestFunc::LESS:           return z < depth;
+            case DepthTestFunc::EQUAL:          return z == depth;
+            case DepthTestFunc::GREATER:        return z > depth;
+            case DepthTestFunc::GREATER_EQUAL:  return z >= depth;
+            default:                            return true;
+        }
+    }
+
+    static bool is_dst_dependent(BlendFunc func)
+    {
+        return func == BlendFunc::DST_ALPHA || func == BlendFunc::ONE_MINUS_DST_ALPHA ||
+            func == BlendFunc::DST_COLOR || func == BlendFunc::ONE_MINUS_DST_COLOR ||
+            func == BlendFunc::SRC_ALPHA_SATURATE;
+    }
+
+    // a color which replaces anything under it with current blending
+    static bool is_opaque(const SoftDrawState& state, const Vec4& src)
+    {
+        if( state.blend_src == BlendFunc::DISABLE )
+            return true;
+
+        if( state.blend_dst != BlendFunc::ONE_MINUS_SRC_ALPHA || src.get_w() < 1.f )
+            return false;
+
+        return state.blend_src == BlendFunc::ONE || state.blend_src == BlendFunc::SRC_ALPHA;
+    }
+
+    static void shade_span(const SoftTriangle& triangle, const SoftDrawState& state,
+        uint32_t* colors, float* depths, int y, int from, int to)
+    {
+        auto fx = (float)from + 0.5f - triangle.x0;
+        auto fy = (float)y + 0.5f - triangle.y0;
+
+        float attributes[ATTR_COUNT];
+        for( auto i=0; i<ATTR_COUNT; i++ )
+            attributes[i] = triangle.base[i] + triangle.ddx[i]*fx + triangle.ddy[i]*fy;
+
+        auto testing = state.depth != DepthTestFunc::DISABLE;
+        auto writing = testing && state.depthmask;
+
+        // an unbound texture samples as opaque black in opengl
+        const Vec4 black(0.f, 0.f, 0.f, 1.f);
+
+        if( triangle.flat && state.sampler == nullptr && !testing )
+        {
+            auto src = (black * Vec4::load(attributes+ATTR_DIFFUSE) +
+                Vec4::load(attributes+ATTR_ADDITIVE)).saturate();
+
+            if( is_opaque(state, src) )
+            {
+                std::fill(colors+from, colors+to, src.pack());
+                return;
+            }
+
+            // factors of a constant color are computed once if they do not
+            // depend on destination.
+            if( !is_dst_dependent(state.blend_src) && !is_dst_dependent(state.blend_dst) )
+            {
+                auto src_term = src * get_blend_factor(state.blend_src, src, src);
+                auto dst_factor = get_blend_factor(state.blend_dst, src, src);
+                for( auto x=from; x<to; x++ )
+                    colors[x] = (src_term + Vec4::unpack(colors[x]) * dst_factor).saturate().pack();
+                return;
+            }
+
+            for( auto x=from; x<to; x++ )
+                colors[x] = blend(state, src, colors[x]);
+            return;
+        }
+
+        auto diffuse = Vec4::load(attributes+ATTR_DIFFUSE);
+        auto additive = Vec4::load(attributes+ATTR_ADDITIVE);
+        auto u = attributes[ATTR_U], v = attributes[ATTR_V], z = attributes[ATTR_Z];
+
+        auto step_diffuse = Vec4::load(triangle.ddx+ATTR_DIFFUSE);
+        auto step_additive = Vec4::load(triangle.ddx+ATTR_ADDITIVE);
+        auto step_u = triangle.ddx[ATTR_U], step_v = triangle.ddx[ATTR_V], step_z = triangle.ddx[ATTR_Z];
+
+        for( auto x=from; x<to; x++ )
+        {
+            if( !testing || depth_test(state.depth, z, depths[x]) )
+            {
+                auto texel = state.sampler != nullptr ? sample(*state.sampler, u, v) : black;
+                auto src = (texel * diffuse + additive).saturate();
+                colors[x] = blend(state, src, colors[x]);
+
+                if( writing )
+                    depths[x] = z;
+            }
+
+            diffuse = diffuse + step_diffuse;
+            additive = additive + step_additive;
+            u += step_u;
+            v += step_v;
+            z += step_z;
+        }
+    }
+
+    void SoftwareInstance::shade_tiles()
+    {
+        uint64_t count = 0;
+        for( ;; )
+        {
+            auto index = next_tile++;
+            if( index >= active_tiles.size() )
+                break;
+
+            count += shade_tile(active_tiles[index]);
+        }
+
+        pixels += count;
+    }
+
+    uint64_t SoftwareInstance::shade_tile(uint32_t tile)
+    {
+        auto left = (int)(tile % tiles_x) * TileSize;
+        auto top = (int)(tile / tiles_x) * TileSize;
+        auto right = std::min(left + TileSize, width);
+        auto bottom = std::min(top + TileSize, height);
+
+        const int64_t half = SubPixelScale / 2;
+        uint64_t count = 0;
+
+        for( auto index : bins[tile] )
+        {
+            auto& triangle = triangles[index];
+            auto& state = states[triangle.state];
+
+            auto xmin = std::max(left, triangle.xmin);
+            auto xmax = std::min(right, triangle.xmax);
+            auto ymin = std::max(top, triangle.ymin);
+            auto ymax = std::min(bottom, triangle.ymax);
+
+            for( auto y=ymin; y<ymax; y++ )
+            {
+                // solves the range of pixel centers inside all edges of this row
+                auto py = (int64_t)y * SubPixelScale + half;
+                int64_t from = xmin, to = xmax;
+                for( auto i=0; i<3 && from<to; i++ )
+                {
+                    auto a = triangle.a[i];
+                    auto rest = triangle.bias[i] - (triangle.b[i]*py + triangle.c[i]) - a*half;
+                    if( a > 0 )
+                        from = std::max(from, ceil_div(rest, a*SubPixelScale));
+                    else if( a < 0 )
+                        to = std::min(to, floor_div(rest, a*SubPixelScale) + 1);
+                    else if( rest > 0 )
+                        to = from;
+                }
+
+                if( from >= to )
+                    continue;
+
+                auto offset = y * width;
+                shade_span(triangle, state, colors.data()+offset, depths.data()+offset, y, (int)from, (int)to);
+                count += to - from;
+            }
+        }
+
+        return count;
+    }
+
+    /// SOFTWARE RENDER
+    SoftwareRender* SoftwareRender::create(int threads)
+    {
+        auto render = new (std::nothrow) SoftwareRender();
+        if( !render ) return nullptr;
+
+        render->m_state = new (std::nothrow) SoftwareInstance();
+        if( !render->m_state )
+        {
+            delete render;
+            return nullptr;
+        }
+
+        if( threads <= 0 )
+            threads = std::max((int)std::thread::hardware_concurrency(), 1);
+
+        render->m_state->stats = &render->m_stats;
+        render->m_state->start(threads);
+        return render;
+    }
+
+    SoftwareRender::~SoftwareRender()
+    {
+        if( m_state != nullptr )
+        {
+            m_state->stop();
+            delete m_state;
+            m_state = nullptr;
+        }
+    }
+
+    int SoftwareRender::get_thread_count() const
+    {
+        return (int)m_state->threads.size() + 1;
+    }
+
+    // the framebuffer grows to cover viewport, and its contents are dropped
+    void SoftwareRender::set_viewport(int x, int y, int width, int height)
+    {
+        m_state->resolve();
+
+        auto w = std::max(x + width, m_state->width);
+        auto h = std::max(y + height, m_state->height);
+        if( w != m_state->width || h != m_state->height )
+            m_state->resize(w, h);
+
+        m_state->viewport[0] = x;
+        m_state->viewport[1] = y;
+        m_state->viewport[2] = width;
+        m_state->viewport[3] = height;
+    }
+
+    void SoftwareRender::set_scissor(bool enable, int x, int y, int width, int height)
+    {
+        m_state->scissor = enable;
+        m_state->scissor_rect[0] = x;
+        m_state->scissor_rect[1] = y;
+        m_state->scissor_rect[2] = width;
+        m_state->scissor_rect[3] = height;
+    }
+
+    void SoftwareRender::set_blend(BlendFunc src, BlendFunc dst)
+    {
+        m_state->blend_src = src;
+        m_state->blend_dst = dst;
+    }
+
+    void SoftwareRender::set_depth(bool write, DepthTestFunc test)
+    {
+        m_state->depth = test;
+        m_state->depthmask = write;
+    }
+
+    void SoftwareRender::set_cull(CullMode mode)
+    {
+        m_state->cull = mode;
+    }
+
+    void SoftwareRender::reset()
+    {
+        m_state->resolve();
+        m_state->reset();
+    }
+
+    // states are captured by each draw call, nothing to commit
+    void SoftwareRender::flush()
+    {
+    }
+
+    void SoftwareRender::finish()
+    {
+        m_state->resolve();
+    }
+
+    void SoftwareRender::clear(uint32_t mask, uint8_t r, uint8_t g, uint8_t b, uint8_t a)
+    {
+        m_state->resolve();
+
+        int clip[4] = { 0, 0, m_state->width, m_state->height };
+        if( m_state->scissor )
+        {
+            auto& rect = m_state->scissor_rect;
+            clip[0] = std::max(clip[0], rect[0]);
+            clip[1] = std::max(clip[1], m_state->height - (rect[1] + rect[3]));
+            clip[2] = std::min(clip[2], rect[0] + rect[2]);
+            clip[3] = std::min(clip[3], m_state->height - rect[1]);
+        }
+
+        auto color = pack_rgba(r, g, b, a);
+        for( auto y=clip[1]; y<clip[3]; y++ )
+        {
+            auto offset = y * m_state->width;
+            if( mask & CLEAR_COLOR )
+                std::fill(m_state->colors.begin()+offset+clip[0], m_state->colors.begin()+offset+clip[2], color);
+
+            if( mask & CLEAR_DEPTH )
+                std::fill(m_state->depths.begin()+offset+clip[0], m_state->depths.begin()+offset+clip[2], 1.f);
+        }
+    }
+
+    void SoftwareRender::draw(DrawMode mode, int from_index, int number)
+    {
+        auto state = m_state;
+        auto program = array_get(state->programs, state->program);
+        if( program == nullptr || program->handle == 0 || number <= 0 )
+            return;
+
+        auto index_buffer = array_get(state->buffers, state->index_buffer.rid);
+        assert( index_buffer != nullptr && index_buffer->handle != 0 );
+
+        // vertices are transformed once for the range of referenced indices
+        state->indices.resize(number);
+        uint32_t first = ~0u, last = 0;
+        for( auto i=0; i<number; i++ )
+        {
+            auto index = state->fetch_index(from_index + i);
+            state->indices[i] = index;
+            first = std::min(first, index);
+            last = std::max(last, index);
+        }
+
+        state->vertices.resize(last - first + 1);
+        for( auto i=first; i<=last; i++ )
+            state->transform(*program, i, state->vertices[i-first]);
+
+        auto sid = state->push_state();
+        auto vertices = state->vertices.data() - first;
+        auto& indices = state->indices;
+
+        if( mode == DrawMode::TRIANGLE )
+        {
+            for( auto i=0; i+2<number; i+=3 )
+                state->add_triangle(&vertices[indices[i]], &vertices[indices[i+1]], &vertices[indices[i+2]], sid, true);
+            m_stats.triangles += number / 3;
+        }
+        else
+        {
+            for( auto i=0; i+1<number; i+=2 )
+                state->add_line(vertices[indices[i]], vertices[indices[i+1]], sid);
+        }
+
+        m_stats.draw_calls ++;
+        if( state->triangles.size() >= MaxQueuedTriangles )
+            state->resolve();
+    }
+
+    void SoftwareRender::bind_shader(Rid id)
+    {
+        m_state->program = id;
+    }
+
+    void SoftwareRender::bind_index_buffer(Rid id, ElementFormat format, int stride, int offset)
+    {
+        m_state->index_buffer.rid = id;
+        m_state->index_buffer.n = 1;
+        m_state->index_buffer.format = format;
+        m_state->index_buffer.stride = stride;
+        m_state->index_buffer.offset = offset;
+        m_state->index_buffer.normalized = false;
+    }
+
+    void SoftwareRender::bind_vertex_buffer(int index, Rid id, int n, ElementFormat format, int stride, int offset, bool normalized)
+    {
+        assert( index >= 0 && index < MaxVertexBufferSlot );
+        auto& layout = m_state->vertex_buffers[index];
+        layout.rid = id;
+        layout.n = n;
+        layout.format = format;
+        layout.stride = stride;
+        layout.offset = offset;
+        layout.normalized = normalized;
+    }
+
+    void SoftwareRender::bind_texture(int index, Rid id)
+    {
+        assert( index >= 0 && index < MaxTexture );
+        m_state->textures[index] = id;
+    }
+
+    void SoftwareRender::bind_uniform(int index, UniformFormat format, const float* v)
+    {
+        auto program = array_get(m_state->programs, m_state->program);
+        if( program == nullptr || program->handle == 0 )
+            return;
+
+        if( index < 0 || index >= program->uniform_n )
+            return;
+
+        static const int sizes[] = { 0, 1, 2, 3, 4, 1, 2, 3, 4, 9, 16 };
+        program->formats[index] = format;
+        memcpy(program->uniforms[index], v, sizes[(int)format] * sizeof(float));
+    }
+
+    Rid SoftwareRender::create_buffer(RenderObject what, const void* data, int size)
+    {
+        assert( what == RenderObject::VERTEX_BUFFER || what == RenderObject::INDEX_BUFFER );
+
+        auto buffer = array_alloc(m_state->buffers);
+        if( buffer == nullptr ) return 0;
+
+        buffer->handle = 1;
+        buffer->data.clear();
+        if( data && size > 0 )
+            buffer->data.assign((const uint8_t*)data, (const uint8_t*)data + size);
+
+        return array_id(m_state->buffers, buffer);
+    }
+
+    void SoftwareRender::update_buffer(Rid id, const void* data, int size)
+    {
+        auto buffer = array_get(m_state->buffers, id);
+        if( buffer == nullptr ) return;
+
+        // pending triangles keep transformed vertices, no need to resolve
+        if( data != nullptr )
+            buffer->data.assign((const uint8_t*)data, (const uint8_t*)data + size);
+        else
+            buffer->data.resize(size);
+    }
+
+    void SoftwareRender::update_buffer_range(Rid id, int offset, const void* data, int size)
+    {
+        auto buffer = array_get(m_state->buffers, id);
+        if( buffer == nullptr ) return;
+
+        assert( offset >= 0 && offset+size <= (int)buffer->data.size() );
+        memcpy(buffer->data.data()+offset, data, size);
+    }
+
+    Rid SoftwareRender::create_texture(const void* data, int width, int height, TextureFormat format, int mipmap)
+    {
+        assert(mipmap >= 0 && width > 0 && height > 0);
+
+        auto texture = array_alloc(m_state->textures_list);
+        if( texture == nullptr ) return 0;
+
+        texture->handle = 1;
+        texture->width = width;
+        texture->height = height;
+        texture->pixels.assign(width*height, 0);
+
+        if( data != nullptr )
+        {
+            auto bytes = (const uint8_t*)data;
+            auto& pixels = texture->pixels;
+            for( auto i=0; i<width*height; i++ )
+            {
+                switch(format)
+                {
+                    case TextureFormat::RGBA8:
+                        pixels[i] = pack_rgba(bytes[i*4], bytes[i*4+1], bytes[i*4+2], bytes[i*4+3]);
+                        break;
+
+                    case TextureFormat::RGB8:
+                        pixels[i] = pack_rgba(bytes[i*3], bytes[i*3+1], bytes[i*3+2], 255);
+                        break;
+
+                    case TextureFormat::RGBA4:
+                    {
+                        uint16_t v; memcpy(&v, bytes+i*2, sizeof(v));
+                        pixels[i] = pack_rgba(((v>>12)&0xF)*17, ((v>>8)&0xF)*17, ((v>>4)&0xF)*17, (v&0xF)*17);
+                        break;
+                    }
+
+                    case TextureFormat::RGB565:
+                    {
+                        uint16_t v; memcpy(&v, bytes+i*2, sizeof(v));
+                        pixels[i] = pack_rgba(((v>>11)&0x1F)*255/31, ((v>>5)&0x3F)*255/63, (v&0x1F)*255/31, 255);
+                        break;
+                    }
+
+                    case TextureFormat::ALPHA8:
+                        pixels[i] = pack_rgba(0, 0, 0, bytes[i]);
+                        break;
+
+                    default:
+                        assert(0);
+                        return 0;
+                }
+            }
+        }
+
+        return array_id(m_state->textures_list, texture);
+    }
+
+    Rid SoftwareRender::create_shader(const char* /*vs*/, const char* /*fs*/, int attribute_n,
+        int texture_n, const char** /*textures*/,
+        int uniform_n, const char** /*uniforms*/)
+    {
+        auto program = array_alloc(m_state->programs);
+        if( program == nullptr ) return 0;
+
+        assert( attribute_n > 0 && attribute_n < MaxAttribute );
+        assert( uniform_n >= 0 && uniform_n < MaxUniform );
+        assert( texture_n >= 0 && texture_n < MaxTexture );
+
+        program->handle = 1;
+        program->attribute_n = attribute_n;
+        program->texture_n = texture_n;
+        program->uniform_n = uniform_n;
+
+        for( auto i=0; i<MaxUniform; i++ )
+        {
+            program->formats[i] = UniformFormat::INVALID;
+            memset(program->uniforms[i], 0, sizeof(program->uniforms[i]));
+        }
+
+        return array_id(m_state->programs, program);
+    }
+
+    // pixels of any format are kept as RGBA8, mipmaps are not created
+    int SoftwareRender::get_texture_memsize(Rid id)
+    {
+        auto texture = array_get(m_state->textures_list, id);
+        return texture != nullptr ? (int)texture->pixels.size()*4 : 0;
+    }
+
+    void SoftwareRender::release(RenderObject what, Rid id)
+    {
+        switch(what)
+        {
+            case RenderObject::INDEX_BUFFER:
+            case RenderObject::VERTEX_BUFFER:
+            {
+                auto buffer = array_get(m_state->buffers, id);
+                if( buffer == nullptr ) return;
+
+                buffer->data = std::vector<uint8_t>();
+                array_free(m_state->buffers, id);
+                return;
+            }
+            case RenderObject::TEXTURE:
+            {
+                auto texture = array_get(m_state->textures_list, id);
+                if( texture == nullptr ) return;
+
+                // pending triangles may sample it
+                m_state->resolve();
+                texture->pixels = std::vector<uint32_t>();
+                array_free(m_state->textures_list, id);
+                return;
+            }
+            case RenderObject::SHADER:
+            {
+                array_free(m_state->programs, id);
+                return;
+            }
+            default:
+                assert(false);
+        }
+    }
+
+    void SoftwareRender::read_pixels(int x, int y, int width, int height, void* pixels)
+    {
+        assert( width > 0 && height > 0 && pixels != nullptr );
+        m_state->resolve();
+
+        auto bytes = (uint8_t*)pixels;
+        auto top = m_state->height - (y + height);
+        for( auto row=0; row<height; row++ )
+        {
+            for( auto column=0; column<width; column++ )
+            {
+                auto sx = x + column, sy = top + row;
+                uint32_t color = 0;
+                if( sx >= 0 && sx < m_state->width && sy >= 0 && sy < m_state->height )
+                    color = m_state->colors[sy * m_state->width + sx];
+
+                *bytes++ = color & 0xFF;
+                *bytes++ = (color >> 8) & 0xFF;
+                *bytes++ = (color >> 16) & 0xFF;
+                *bytes++ = color >> 24;
+            }
+        }
+    }
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "render.hpp"
+
+namespace openswf
+{
+    class SoftwareInstance;
+
+    // a headless render which rasterizes on cpu. triangles are set up and binned
+    // into screen tiles when drawn, and tiles are shaded by worker threads when
+    // results are required: at finish, read_pixels, clear or a full queue.
+    // shaders are not compiled, every program runs the fixed function of the
+    // default one: texture0*diffuse+additive, with uniform 0 as transform matrix.
+    class SoftwareRender : public Render
+    {
+    protected:
+        SoftwareInstance* m_state;
+
+        SoftwareRender() : m_state(nullptr) {}
+
+    public:
+        // uses all of the hardware threads if thread count is not positive
+        static SoftwareRender* create(int threads = 0);
+        virtual ~SoftwareRender();
+
+        int get_thread_count() const;
+
+        virtual void set_viewport(int x, int y, int width, int height);
+        virtual void set_scissor(bool enable, int x=0, int y=0, int width=0, int height=0);
+        virtual void set_blend(BlendFunc src, BlendFunc dst);
+        virtual void set_depth(bool write, DepthTestFunc test);
+        virtual void set_cull(CullMode mode);
+
+        virtual void reset();
+        virtual void flush();
+        virtual void finish();
+
+        virtual void clear(uint32_t mask, uint8_t r, uint8_t g, uint8_t b, uint8_t a);
+        virtual void draw(DrawMode mode, int from_index, int number_index);
+
+        virtual void bind_shader(Rid id);
+        virtual void bind_index_buffer(Rid id, ElementFormat format, int stride, int offset);
+        virtual void bind_vertex_buffer(int index, Rid id,
+            int n, ElementFormat format, int stride, int offset, bool normalized = false);
+        virtual void bind_texture(int index, Rid id);
+        virtual void bind_uniform(int index, UniformFormat format, const float* v);
+
+        virtual Rid create_buffer(RenderObject what, const void* data, int size);
+        virtual Rid create_texture(const void* data, int width, int height, TextureFormat format, int mipmap);
+        virtual Rid create_shader(const char* vs, const char* fs, int attribute_n,
+            int texture_n, const char** textures,
+            int uniform_n, const char** uniforms);
+
+        virtual void release(RenderObject what, Rid id);
+
+        virtual void update_buffer(Rid id, const void* data, int size);
+        virtual void update_buffer_range(Rid id, int offset, const void* data, int size);
+        virtual int  get_texture_memsize(Rid id);
+        virtual void read_pixels(int x, int y, int width, int height, void* pixels);
+    };
+}
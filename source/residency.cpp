@@ -0,0 +1,125 @@
+#include "residency.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <iterator>
+
+namespace openswf
+{
+    /// TEXTURE RESIDENCY
+    TextureResidency::TextureResidency(Render& render)
+    : m_render(render), m_frame(0)
+    {}
+
+    // the render is being destroyed with all of its textures
+    TextureResidency::~TextureResidency()
+    {
+        for( auto& entry : m_entries )
+            entry.owner->on_texture_evicted();
+    }
+
+    TextureResidency::Handle TextureResidency::insert(ITextureOwner* owner, Rid rid)
+    {
+        Entry entry;
+        entry.owner = owner;
+        entry.rid = rid;
+        entry.bytes = m_render.get_texture_memsize(rid);
+        entry.frame = m_frame;
+
+        trim(entry.bytes);
+        m_entries.push_front(entry);
+
+        m_stats.textures ++;
+        m_stats.uploads ++;
+        m_stats.bytes += entry.bytes;
+        m_stats.peak_bytes = std::max(m_stats.peak_bytes, m_stats.bytes);
+        return m_entries.begin();
+    }
+
+    void TextureResidency::touch(Handle handle)
+    {
+        handle->frame = m_frame;
+        if( handle != m_entries.begin() )
+            m_entries.splice(m_entries.begin(), m_entries, handle);
+    }
+
+    void TextureResidency::release(Handle handle)
+    {
+        m_render.release(RenderObject::TEXTURE, handle->rid);
+        m_stats.textures --;
+        m_stats.bytes -= handle->bytes;
+        m_entries.erase(handle);
+    }
+
+    // evicts from the least recently used until incoming bytes fit
+    void TextureResidency::trim(uint64_t incoming)
+    {
+        if( m_stats.budget == 0 )
+            return;
+
+        while( !m_entries.empty() && m_stats.bytes + incoming > m_stats.budget )
+        {
+            auto& oldest = m_entries.back();
+            if( oldest.frame == m_frame )
+                break;
+
+            auto owner = oldest.owner;
+            release(std::prev(m_entries.end()));
+            m_stats.evictions ++;
+            owner->on_texture_evicted();
+        }
+    }
+
+    void TextureResidency::end_frame()
+    {
+        m_frame ++;
+    }
+
+    void TextureResidency::set_budget(uint64_t bytes)
+    {
+        m_stats.budget = bytes;
+        trim(0);
+    }
+
+    /// RESIDENT TEXTURE
+    ResidentTexture::~ResidentTexture()
+    {
+        release();
+    }
+
+    Rid ResidentTexture::get(Render& render, const void* pixels, int width, int height, TextureFormat format, int mipmap)
+    {
+        if( m_rid != 0 && m_render != &render )
+            release();
+
+        if( m_rid != 0 )
+        {
+            m_render->get_residency().touch(m_handle);
+            return m_rid;
+        }
+
+        m_rid = render.create_texture(pixels, width, height, format, mipmap);
+        if( m_rid != 0 )
+        {
+            m_render = &render;
+            m_handle = render.get_residency().insert(this, m_rid);
+        }
+
+        return m_rid;
+    }
+
+    void ResidentTexture::release()
+    {
+        if( m_rid != 0 )
+            m_render->get_residency().release(m_handle);
+
+        m_rid = 0;
+        m_render = nullptr;
+    }
+
+    void ResidentTexture::on_texture_evicted()
+    {
+        m_rid = 0;
+        m_render = nullptr;
+    }
+}
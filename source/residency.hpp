@@ -0,0 +1,109 @@
+#pragma once
+
+#include "render.hpp"
+
+#include <list>
+
+namespace openswf
+{
+    // what owns a texture of render, which is told once the texture is evicted
+    // or its render is gone.
+    class ITextureOwner
+    {
+    public:
+        virtual ~ITextureOwner() {}
+        virtual void on_texture_evicted() = 0;
+    };
+
+    struct ResidencyStats
+    {
+        uint32_t textures;      // resident ones
+        uint64_t bytes;         // of resident textures
+        uint64_t peak_bytes;
+        uint64_t budget;        // zero if unlimited
+        uint32_t uploads;
+        uint32_t evictions;
+
+        ResidencyStats()
+        : textures(0), bytes(0), peak_bytes(0), budget(0), uploads(0), evictions(0) {}
+    };
+
+    // tracks textures of a render from the most recently used, the least
+    // recently used ones are evicted to keep them in the byte budget. textures
+    // used in current frame are never evicted, they may be in pending batches,
+    // so the budget could be exceeded by a single frame.
+    class TextureResidency
+    {
+    protected:
+        struct Entry
+        {
+            ITextureOwner*  owner;
+            Rid             rid;
+            int             bytes;
+            uint32_t        frame;
+        };
+
+        Render&             m_render;
+        std::list<Entry>    m_entries;
+        uint32_t            m_frame;
+        ResidencyStats      m_stats;
+
+        void trim(uint64_t incoming);
+
+    public:
+        typedef std::list<Entry>::iterator Handle;
+
+        TextureResidency(Render& render);
+        ~TextureResidency();
+
+        // starts tracking a texture just created, others may be evicted first
+        Handle insert(ITextureOwner* owner, Rid rid);
+        void   touch(Handle handle);
+        // releases the texture and stops tracking it
+        void   release(Handle handle);
+
+        void   end_frame();
+        void   set_budget(uint64_t bytes);
+        const ResidencyStats& get_stats() const;
+    };
+
+    // a texture uploaded from pixels of cpu, which is uploaded again if it has
+    // been evicted, or if it's used with another render.
+    class ResidentTexture : public ITextureOwner
+    {
+    protected:
+        Rid                         m_rid;
+        Render*                     m_render;
+        TextureResidency::Handle    m_handle;
+
+        ResidentTexture(const ResidentTexture&) = delete;
+        ResidentTexture& operator = (const ResidentTexture&) = delete;
+
+    public:
+        ResidentTexture() : m_rid(0), m_render(nullptr) {}
+        virtual ~ResidentTexture();
+
+        Rid  get(Render& render, const void* pixels, int width, int height, TextureFormat format, int mipmap);
+        void release();
+        bool is_resident() const;
+        bool is_resident(const Render& render) const;
+
+        virtual void on_texture_evicted();
+    };
+
+    /// INLINE METHODS
+    inline const ResidencyStats& TextureResidency::get_stats() const
+    {
+        return m_stats;
+    }
+
+    inline bool ResidentTexture::is_resident() const
+    {
+        return m_rid != 0;
+    }
+
+    inline bool ResidentTexture::is_resident(const Render& render) const
+    {
+        return m_rid != 0 && m_render == &render;
+    }
+}
@@ -1,6 +1,9 @@
 #include "shader.hpp"
+#include "vertex_transform.hpp"
+#include "residency.hpp"
 
 #include <memory>
+#include <algorithm>
 
 #include "glm/glm.hpp"
 #include "glm/gtc/matrix_transform.hpp"
@@ -8,22 +11,13 @@
 
 namespace openswf
 {
-    static Screen* s_screen = nullptr;
-    Screen& Screen::get_instance()
+    Screen* Screen::create(float width, float height)
     {
-        assert( s_screen != nullptr );
-        return *s_screen;
-    }
-
-    bool Screen::initialize(float width, float height)
-    {
-        assert( s_screen == nullptr );
-
-        s_screen = new (std::nothrow) Screen();
-        if( s_screen == nullptr ) return false;
+        auto screen = new (std::nothrow) Screen();
+        if( screen == nullptr ) return nullptr;
 
-        s_screen->set_design_resolution(width, height);
-        return true;
+        screen->set_design_resolution(width, height);
+        return screen;
     }
 
     void Screen::set_design_resolution(float width, float height)
@@ -39,60 +33,104 @@ namespace openswf
             y >= m_design_area.ymin && y < m_design_area.ymax;
     }
 
-    static Shader* s_shader = nullptr;
-    Shader& Shader::get_instance()
+    Shader* Shader::create(Render& render, Screen& screen, int capacity, int max_capacity)
     {
-        assert( s_shader != nullptr );
-        return *s_shader;
+        auto shader = new (std::nothrow) Shader();
+        if( shader == nullptr ) return nullptr;
+
+        shader->m_render = &render;
+        shader->m_screen = &screen;
+        shader->m_vertices = render.create_buffer(RenderObject::VERTEX_BUFFER, NULL, 0);
+        shader->m_indices = render.create_buffer(RenderObject::INDEX_BUFFER, NULL, 0);
+
+        // a triangle should always fit
+        shader->m_capacity = std::min(std::max(capacity, 3), MaxBatchCapacity);
+        shader->m_max_capacity = std::min(std::max(max_capacity, shader->m_capacity), MaxBatchCapacity);
+        shader->m_vused = shader->m_iused = 0;
+        shader->m_vflushed = shader->m_iflushed = 0;
+        shader->m_bound = false;
+        shader->m_remap_stamp = 0;
+        shader->m_reordering = shader->m_recording = false;
+        shader->m_blend_src = BlendFunc::ONE;
+        shader->m_blend_dst = BlendFunc::ONE_MINUS_SRC_ALPHA;
+
+        shader->m_current_program = -1;
+        for( auto i=0; i<MaxTexture; i++ ) shader->m_textures[i] = 0;
+        for( auto i=0; i<PROGRAM_MAX; i++ ) shader->m_programs[i] = 0;
+
+        shader->resize(shader->m_capacity);
+        return shader;
     }
 
-    bool Shader::initialize()
+    Shader::~Shader()
     {
-        assert( s_shader == nullptr );
-
-        s_shader = new (std::nothrow) Shader();
-        if( s_shader == nullptr ) return false;
-
-        auto& render = Render::get_instance();
-
-        s_shader->m_vertices = render.create_buffer(
-            RenderObject::VERTEX_BUFFER, NULL, MaxCombine*sizeof(VertexPack));
-        s_shader->m_indices = render.create_buffer(
-            RenderObject::INDEX_BUFFER, NULL, 2*MaxCombine*sizeof(uint16_t));
-
-        s_shader->m_vused = s_shader->m_iused = 0;
-        s_shader->m_blend_src = BlendFunc::ONE;
-        s_shader->m_blend_dst = BlendFunc::ONE_MINUS_SRC_ALPHA;
+        for( auto i=0; i<PROGRAM_MAX; i++ )
+        {
+            if( m_programs[i] != 0 )
+                m_render->release(RenderObject::SHADER, m_programs[i]);
+        }
 
-        s_shader->m_current_program = -1;
-        for( auto i=0; i<MaxTexture; i++ ) s_shader->m_textures[i] = 0;
-        for( auto i=0; i<PROGRAM_MAX; i++ ) s_shader->m_programs[i] = 0;
-        return true;
+        m_render->release(RenderObject::VERTEX_BUFFER, m_vertices);
+        m_render->release(RenderObject::INDEX_BUFFER, m_indices);
     }
 
     void Shader::create(int index, const char* vs, const char* fs, 
         int texture_n, const char** textures, int uniform_n, const char** uniforms)
     {
         assert( index >= 0 && index < PROGRAM_MAX );
-        auto rid = Render::get_instance().create_shader(vs, fs, 4, texture_n, textures, uniform_n, uniforms);
+        auto rid = m_render->create_shader(vs, fs, 4, texture_n, textures, uniform_n, uniforms);
         m_programs[index] = rid;
     }
 
-    static void vertices_apply_transform(int size, VertexPack* vertices,
-        const Matrix& matrix, const ColorTransform& cxform)
+    // makes room for vertices and indices at the end of ring, which restarts
+    // if the rest is not enough. returns false if they exceed the whole ring.
+    bool Shader::reserve(int vsize, int isize)
     {
-        for( auto i=0; i<size; i++ )
+        if( vsize > m_capacity || isize > m_capacity*2 )
+            return false;
+
+        if( m_vused > m_capacity-vsize || m_iused > m_capacity*2-isize )
         {
-            vertices[i].position = matrix*vertices[i].position;
-            vertices[i].diffuse = cxform*vertices[i].diffuse;
+            m_frame_stats.wraps ++;
+            restart();
         }
+
+        return true;
+    }
+
+    void Shader::restart()
+    {
+        flush();
+
+        // orphans storages of render buffers, draws in flight keep the old ones
+        m_render->update_buffer(m_vertices, nullptr, m_capacity*sizeof(VertexPack));
+        m_render->update_buffer(m_indices, nullptr, m_capacity*2*sizeof(uint16_t));
+        m_vused = m_iused = 0;
+        m_vflushed = m_iflushed = 0;
+    }
+
+    void Shader::resize(int capacity)
+    {
+        flush();
+
+        m_capacity = capacity;
+        m_vbuffer.resize(capacity);
+        m_ibuffer.resize(capacity*2);
+        restart();
     }
 
     void Shader::draw(const VertexPack& p1, const VertexPack& p2, const VertexPack& p3,
         const Matrix& matrix, const ColorTransform& cxform)
     {
-        if( m_vused >= (MaxCombine-3) || m_iused >= (MaxCombine*2-3) )
-            flush();
+        if( m_recording )
+        {
+            const VertexPack vertices[] = { p1, p2, p3 };
+            const uint16_t indices[] = { 0, 1, 2 };
+            record(3, vertices, 3, indices, matrix, cxform);
+            return;
+        }
+
+        reserve(3, 3);
 
         m_ibuffer[m_iused++] = m_vused;
         m_ibuffer[m_iused++] = m_vused+1;
@@ -102,14 +140,27 @@ namespace openswf
         m_vbuffer[m_vused++] = p2;
         m_vbuffer[m_vused++] = p3;
 
-        vertices_apply_transform(3, m_vbuffer+(m_vused-3), matrix, cxform);
+        transform_vertices(3, m_vbuffer.data()+(m_vused-3), matrix, cxform);
     }
 
     void Shader::draw(const VertexPack& p1, const VertexPack& p2, const VertexPack& p3, const VertexPack& p4,
         const Matrix& matrix, const ColorTransform& cxform)
     {
-        if( m_vused >= (MaxCombine-4) || m_iused >= (MaxCombine*2-6) )
-            flush();
+        if( m_recording )
+        {
+            const VertexPack vertices[] = { p1, p2, p3, p4 };
+            const uint16_t indices[] = { 0, 1, 2, 0, 2, 3 };
+            record(4, vertices, 6, indices, matrix, cxform);
+            return;
+        }
+
+        // the capacity is at least 3, a quad is drawn as two triangles otherwise
+        if( !reserve(4, 6) )
+        {
+            draw(p1, p2, p3, matrix, cxform);
+            draw(p1, p3, p4, matrix, cxform);
+            return;
+        }
 
         m_ibuffer[m_iused++] = m_vused;
         m_ibuffer[m_iused++] = m_vused+1;
@@ -124,18 +175,38 @@ namespace openswf
         m_vbuffer[m_vused++] = p3;
         m_vbuffer[m_vused++] = p4;
 
-        vertices_apply_transform(4, m_vbuffer+(m_vused-4), matrix, cxform);
+        transform_vertices(4, m_vbuffer.data()+(m_vused-4), matrix, cxform);
     }
 
     void Shader::draw(int vsize, const VertexPack* vertices, int isize, const uint16_t* indices,
         const Matrix& matrix, const ColorTransform& cxform)
+    {
+        if( m_recording )
+            record(vsize, vertices, isize, indices, matrix, cxform);
+        else
+            draw_indexed(vsize, vertices, isize, indices, matrix, cxform);
+    }
+
+    void Shader::draw(int vsize, const VertexPack* vertices, int isize, const uint32_t* indices,
+        const Matrix& matrix, const ColorTransform& cxform)
+    {
+        if( m_recording )
+            record(vsize, vertices, isize, indices, matrix, cxform);
+        else
+            draw_indexed(vsize, vertices, isize, indices, matrix, cxform);
+    }
+
+    template<typename T> void Shader::draw_indexed(int vsize, const VertexPack* vertices, int isize, const T* indices,
+        const Matrix& matrix, const ColorTransform& cxform)
     {
         if( vsize <= 0 || isize <= 0 )
             return;
 
-        assert( vsize < MaxCombine && isize <MaxCombine*2 );
-        if( m_vused >= (MaxCombine-vsize) || m_iused >= (MaxCombine*2-isize) )
-            flush();
+        if( !reserve(vsize, isize) )
+        {
+            draw_chunked(vsize, vertices, isize, indices, matrix, cxform);
+            return;
+        }
 
         for( auto i=0; i<isize; i++ )
             m_ibuffer[m_iused++] = m_vused+indices[i];
@@ -143,47 +214,294 @@ namespace openswf
         for( auto i=0; i<vsize; i++ )
             m_vbuffer[m_vused++] = vertices[i];
 
-        vertices_apply_transform(vsize, m_vbuffer+(m_vused-vsize), matrix, cxform);
+        transform_vertices(vsize, m_vbuffer.data()+(m_vused-vsize), matrix, cxform);
+    }
+
+    // splits a mesh which exceeds the batch capacity by triangles, vertices used
+    // by a triangle are copied into current batch if they are not there yet.
+    template<typename T> void Shader::draw_chunked(int vsize, const VertexPack* vertices, int isize, const T* indices,
+        const Matrix& matrix, const ColorTransform& cxform)
+    {
+        if( m_remap_stamps.size() < vsize )
+        {
+            m_remap_stamps.resize(vsize, 0);
+            m_remap_indices.resize(vsize, 0);
+        }
+
+        auto first = m_vused;
+        m_remap_stamp++;
+        m_frame_stats.chunked ++;
+        for( auto i=0; i+2<isize; i+=3 )
+        {
+            if( m_vused > m_capacity-3 || m_iused > m_capacity*2-3 )
+            {
+                transform_vertices(m_vused-first, m_vbuffer.data()+first, matrix, cxform);
+                m_frame_stats.wraps ++;
+                restart();
+
+                first = 0;
+                m_remap_stamp++;
+            }
+
+            for( auto j=0; j<3; j++ )
+            {
+                auto index = indices[i+j];
+                assert( index < vsize );
+
+                if( m_remap_stamps[index] != m_remap_stamp )
+                {
+                    m_remap_stamps[index] = m_remap_stamp;
+                    m_remap_indices[index] = m_vused;
+                    m_vbuffer[m_vused++] = vertices[index];
+                }
+
+                m_ibuffer[m_iused++] = m_remap_indices[index];
+            }
+        }
+
+        transform_vertices(m_vused-first, m_vbuffer.data()+first, matrix, cxform);
+    }
+
+    // searching of a batch to join stops at this distance, and packets of
+    // batches passed by are tested up to this number. which bound the cost of
+    // recording while most of shared states are still found.
+    const static int MaxReorderDistance = 32;
+    const static int MaxReorderTests = 128;
+
+    static bool is_overlapped(const Rect& a, const Rect& b)
+    {
+        // touching edges count, rasterized pixels along them may be shared
+        return a.xmin <= b.xmax && b.xmin <= a.xmax && a.ymin <= b.ymax && b.ymin <= a.ymax;
+    }
+
+    template<typename T> void Shader::record(int vsize, const VertexPack* vertices, int isize, const T* indices,
+        const Matrix& matrix, const ColorTransform& cxform)
+    {
+        if( vsize <= 0 || isize <= 0 || m_current_program < 0 )
+            return;
+
+        RenderPacket packet;
+        packet.program = m_current_program;
+        packet.blend_src = m_blend_src;
+        packet.blend_dst = m_blend_dst;
+        for( auto i=0; i<MaxTexture; i++ ) packet.textures[i] = m_textures[i];
+        packet.vfirst = (int)m_packet_vertices.size();
+        packet.vsize = vsize;
+        packet.ifirst = (int)m_packet_indices.size();
+        packet.isize = isize;
+        packet.next = -1;
+
+        m_packet_vertices.insert(m_packet_vertices.end(), vertices, vertices+vsize);
+        m_packet_indices.insert(m_packet_indices.end(), indices, indices+isize);
+
+        auto transformed = m_packet_vertices.data()+packet.vfirst;
+        transform_vertices(vsize, transformed, matrix, cxform);
+
+        auto& bounds = packet.bounds;
+        bounds.reset(transformed[0].position.x, transformed[0].position.x,
+            transformed[0].position.y, transformed[0].position.y);
+        for( auto i=1; i<vsize; i++ )
+        {
+            auto& position = transformed[i].position;
+            bounds.xmin = std::min(bounds.xmin, position.x);
+            bounds.xmax = std::max(bounds.xmax, position.x);
+            bounds.ymin = std::min(bounds.ymin, position.y);
+            bounds.ymax = std::max(bounds.ymax, position.y);
+        }
+
+        auto index = (int)m_packets.size();
+        m_packets.push_back(packet);
+
+        auto target = -1, tests = MaxReorderTests;
+        auto stop = std::max((int)m_packet_batches.size()-MaxReorderDistance, 0);
+        for( auto i=(int)m_packet_batches.size()-1; i>=stop; i-- )
+        {
+            auto& batch = m_packet_batches[i];
+            auto& head = m_packets[batch.first];
+            if( head.program == packet.program &&
+                head.blend_src == packet.blend_src && head.blend_dst == packet.blend_dst &&
+                std::equal(head.textures, head.textures+MaxTexture, packet.textures) )
+            {
+                target = i;
+                break;
+            }
+
+            // the union of a batch is tested first, then packets of it
+            if( !is_overlapped(batch.bounds, bounds) )
+                continue;
+
+            auto overlapped = false;
+            for( auto j=batch.first; j>=0 && !overlapped; j=m_packets[j].next )
+                overlapped = --tests < 0 || is_overlapped(m_packets[j].bounds, bounds);
+
+            if( overlapped )
+                break;
+        }
+
+        if( target < 0 )
+        {
+            PacketBatch batch;
+            batch.first = batch.last = index;
+            batch.bounds = bounds;
+            m_packet_batches.push_back(batch);
+            return;
+        }
+
+        auto& batch = m_packet_batches[target];
+        m_packets[batch.last].next = index;
+        batch.last = index;
+        batch.bounds.xmin = std::min(batch.bounds.xmin, bounds.xmin);
+        batch.bounds.xmax = std::max(batch.bounds.xmax, bounds.xmax);
+        batch.bounds.ymin = std::min(batch.bounds.ymin, bounds.ymin);
+        batch.bounds.ymax = std::max(batch.bounds.ymax, bounds.ymax);
+    }
+
+    // draws recorded packets batch by batch into the ring, states set after
+    // the last packet are kept for following draws.
+    void Shader::replay()
+    {
+        if( m_packets.empty() )
+            return;
+
+        auto program = m_current_program;
+        auto blend_src = m_blend_src, blend_dst = m_blend_dst;
+        Rid textures[MaxTexture];
+        for( auto i=0; i<MaxTexture; i++ ) textures[i] = m_textures[i];
+
+        m_recording = false;
+        for( auto& batch : m_packet_batches )
+        {
+            for( auto i=batch.first; i>=0; i=m_packets[i].next )
+            {
+                auto& packet = m_packets[i];
+                set_program(packet.program);
+                set_blend(packet.blend_src, packet.blend_dst);
+                for( auto j=0; j<MaxTexture; j++ ) set_texture(j, packet.textures[j]);
+
+                // vertices are transformed already
+                draw_indexed(packet.vsize, m_packet_vertices.data()+packet.vfirst,
+                    packet.isize, m_packet_indices.data()+packet.ifirst,
+                    Matrix::identity, ColorTransform::identity);
+            }
+        }
+        submit();
+        m_recording = true;
+
+        m_current_program = program;
+        m_blend_src = blend_src;
+        m_blend_dst = blend_dst;
+        for( auto i=0; i<MaxTexture; i++ ) m_textures[i] = textures[i];
+
+        m_frame_stats.packets += (uint32_t)m_packets.size();
+        m_frame_stats.batches += (uint32_t)m_packet_batches.size();
+        m_packet_vertices.clear();
+        m_packet_indices.clear();
+        m_packets.clear();
+        m_packet_batches.clear();
+    }
+
+    void Shader::set_reordering(bool enabled)
+    {
+        if( m_reordering == enabled )
+            return;
+
+        flush();
+        m_reordering = m_recording = enabled;
+    }
+
+    void Shader::bind_attributes()
+    {
+        auto& render = *m_render;
+        const auto stride = sizeof(VertexPack);
+        auto offset = 0;
+        render.bind_index_buffer(m_indices, ElementFormat::UNSIGNED_SHORT, 0, 0);
+
+        // positions
+        render.bind_vertex_buffer(0, m_vertices, 2, ElementFormat::FLOAT, stride, offset);
+        // texcoords
+        offset += sizeof(float) * 2;
+        render.bind_vertex_buffer(1, m_vertices, 2, ElementFormat::FLOAT, stride, offset);
+        // diffuse color
+        offset += sizeof(float) * 2;
+        render.bind_vertex_buffer(2, m_vertices, 4, ElementFormat::UNSIGNED_BYTE, stride, offset, true);
+        // addtive color
+        offset += sizeof(uint8_t)*4;
+        render.bind_vertex_buffer(3, m_vertices, 4, ElementFormat::UNSIGNED_BYTE, stride, offset, true);
+        m_bound = true;
     }
 
     void Shader::flush()
     {
-        if( m_iused > 0 && m_current_program >= 0 )
+        if( m_recording )
+            replay();
+        submit();
+    }
+
+    // uploads the batch appended since last flush, and draws it in place
+    void Shader::submit()
+    {
+        if( m_iused > m_iflushed && m_current_program >= 0 )
         {
-            auto& render = Render::get_instance();
+            auto& render = *m_render;
             render.set_blend(m_blend_src, m_blend_dst);
 
             render.bind_shader(m_programs[m_current_program]);
 
-            render.update_buffer(m_vertices, m_vbuffer, m_vused*sizeof(VertexPack));
-            render.update_buffer(m_indices, m_ibuffer, m_iused*sizeof(uint16_t));
-
-            const auto stride = sizeof(VertexPack);
-            auto offset = 0;
-            render.bind_index_buffer(m_indices, ElementFormat::UNSIGNED_SHORT, 0, 0);
-
-            // positions
-            render.bind_vertex_buffer(0, m_vertices, 2, ElementFormat::FLOAT, stride, offset);
-            // texcoords
-            offset += sizeof(float) * 2;
-            render.bind_vertex_buffer(1, m_vertices, 2, ElementFormat::FLOAT, stride, offset);
-            // diffuse color
-            offset += sizeof(float) * 2;
-            render.bind_vertex_buffer(2, m_vertices, 4, ElementFormat::UNSIGNED_BYTE, stride, offset, true);
-            // addtive color
-            offset += sizeof(uint8_t)*4;
-            render.bind_vertex_buffer(3, m_vertices, 4, ElementFormat::UNSIGNED_BYTE, stride, offset, true);
-
-            auto area = Screen::get_instance().get_design_area();
+            auto vbytes = (m_vused-m_vflushed)*(int)sizeof(VertexPack);
+            auto ibytes = (m_iused-m_iflushed)*(int)sizeof(uint16_t);
+            render.update_buffer_range(m_vertices,
+                m_vflushed*sizeof(VertexPack), m_vbuffer.data()+m_vflushed, vbytes);
+            render.update_buffer_range(m_indices,
+                m_iflushed*sizeof(uint16_t), m_ibuffer.data()+m_iflushed, ibytes);
+
+            if( !m_bound )
+                bind_attributes();
+
+            auto area = m_screen->get_design_area();
             auto projection = glm::ortho(0.f, area.get_width(), area.get_height(), 0.f, -1.f, 1000.f);
             render.bind_uniform(0, UniformFormat::MATRIX_F44, glm::value_ptr(projection));
 
             for( auto i=0; i<MaxTexture; i++ )
                 render.bind_texture(i, m_textures[i]);
 
-            render.draw(DrawMode::TRIANGLE, 0, m_iused);
+            render.draw(DrawMode::TRIANGLE, m_iflushed, m_iused-m_iflushed);
+
+            m_frame_stats.draw_calls ++;
+            m_frame_stats.vertices += m_vused-m_vflushed;
+            m_frame_stats.indices += m_iused-m_iflushed;
+            m_frame_stats.bytes_uploaded += vbytes + ibytes;
         }
-        m_vused = m_iused = 0;
+
+        m_vflushed = m_vused;
+        m_iflushed = m_iused;
     }
 
-}
\ No newline at end of file
+    void Shader::end_frame()
+    {
+        flush();
+        m_frame_stats.capacity = m_capacity;
+        m_last_frame_stats = m_frame_stats;
+
+        // next frame is likely to be alike, the ring grows to hold it at once
+        auto capacity = m_capacity;
+        if( m_frame_stats.wraps > 0 )
+        {
+            while( capacity < m_max_capacity &&
+                (capacity < (int)m_frame_stats.vertices || capacity*2 < (int)m_frame_stats.indices) )
+                capacity *= 2;
+            capacity = std::min(capacity, m_max_capacity);
+        }
+
+        if( capacity != m_capacity )
+            resize(capacity);
+        else
+            restart();
+
+        // bindings of render may be changed by others between frames
+        m_frame_stats = BatchStats();
+        m_bound = false;
+
+        // textures of this frame are all submitted, they could be evicted
+        m_render->get_residency().end_frame();
+    }
+}
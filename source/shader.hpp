@@ -3,9 +3,14 @@
 #include "types.hpp"
 #include "render.hpp"
 
+#include <vector>
+
 namespace openswf
 {
-    const static int MaxCombine = 1024;
+    // batched vertices are streamed into a ring, which starts with default
+    // capacity and grows when a frame wraps it, up to the range of 16-bit indices.
+    const static int DefaultBatchCapacity = 1024;
+    const static int MaxBatchCapacity = 65536;
 
     enum ProgramNames
     {
@@ -40,8 +45,7 @@ namespace openswf
         Rect      m_design_area;
 
     public:
-        static Screen& get_instance();
-        static bool initialize(float width, float height);
+        static Screen* create(float width, float height);
 
         void set_design_resolution(float width, float height);
         bool is_visible(float x, float y);
@@ -65,13 +69,41 @@ namespace openswf
         : rid(0) {}
     };
 
+    // statistics of batches submitted in one frame
+    struct BatchStats
+    {
+        uint32_t draw_calls;
+        uint32_t vertices;
+        uint32_t indices;
+        uint64_t bytes_uploaded;
+        uint32_t wraps;     // times the ring restarted within the frame
+        uint32_t capacity;  // vertices of the ring
+        uint32_t packets;   // draws recorded for reordering
+        uint32_t batches;   // groups of recorded draws sharing states
+        uint32_t chunked;   // meshes split as they exceed the ring
+
+        BatchStats()
+        : draw_calls(0), vertices(0), indices(0), bytes_uploaded(0), wraps(0), capacity(0),
+        packets(0), batches(0), chunked(0) {}
+    };
+
     class Shader
     {
     protected:
-        Rid         m_vertices, m_indices;
-        VertexPack  m_vbuffer[MaxCombine];
-        uint16_t    m_ibuffer[MaxCombine*2];
-        int         m_vused, m_iused;
+        Render*     m_render;
+        Screen*     m_screen;
+
+        // the ring of vertices and indices mirrored by render buffers, a batch
+        // is the range appended since last flush, which is uploaded and drawn
+        // in place. so that attributes are bound once for all batches.
+        Rid                     m_vertices, m_indices;
+        std::vector<VertexPack> m_vbuffer;
+        std::vector<uint16_t>   m_ibuffer;
+        int                     m_vused, m_iused;
+        int                     m_vflushed, m_iflushed;
+        int                     m_capacity, m_max_capacity;
+        bool                    m_bound;
+        BatchStats              m_frame_stats, m_last_frame_stats;
 
         BlendFunc   m_blend_src, m_blend_dst;
         Rid         m_textures[MaxTexture];
@@ -80,9 +112,61 @@ namespace openswf
 
         Color       m_color;
 
+        // maps vertices of a mesh larger than batch into current batch,
+        // an entry is valid only if its stamp equals current one.
+        std::vector<uint32_t>   m_remap_stamps;
+        std::vector<uint16_t>   m_remap_indices;
+        uint32_t                m_remap_stamp;
+
+        // a recorded draw with transformed vertices, states and screen bounds
+        struct RenderPacket
+        {
+            int         program;
+            BlendFunc   blend_src, blend_dst;
+            Rid         textures[MaxTexture];
+            Rect        bounds;
+            int         vfirst, vsize, ifirst, isize;
+            int         next;   // the next packet of same batch
+        };
+
+        // packets of same states, drawn in their recorded order
+        struct PacketBatch
+        {
+            int     first, last;
+            Rect    bounds;
+        };
+
+        // with reordering, draws are recorded till a flush instead of batched
+        // at once. a draw joins the latest batch of its states as long as it
+        // doesn't overlap any batch recorded after that one, so that painter's
+        // order holds wherever it's visible.
+        bool                        m_reordering, m_recording;
+        std::vector<VertexPack>     m_packet_vertices;
+        std::vector<uint32_t>       m_packet_indices;
+        std::vector<RenderPacket>   m_packets;
+        std::vector<PacketBatch>    m_packet_batches;
+
+        template<typename T> void draw_indexed(int vsize, const VertexPack* vertices, int isize, const T* indices,
+            const Matrix& matrix, const ColorTransform& cxform);
+        template<typename T> void draw_chunked(int vsize, const VertexPack* vertices, int isize, const T* indices,
+            const Matrix& matrix, const ColorTransform& cxform);
+
+        template<typename T> void record(int vsize, const VertexPack* vertices, int isize, const T* indices,
+            const Matrix& matrix, const ColorTransform& cxform);
+        void replay();
+        void submit();
+
+        bool reserve(int vsize, int isize);
+        void restart();
+        void resize(int capacity);
+        void bind_attributes();
+
     public:
-        static Shader& get_instance();
-        static bool initialize();
+        // a batcher which draws with render, projecting design area of screen.
+        // capacities are numbers of vertices, indices are twice as many.
+        static Shader* create(Render& render, Screen& screen,
+            int capacity = DefaultBatchCapacity, int max_capacity = MaxBatchCapacity);
+        ~Shader();
 
         void create(int index, const char* vs, const char* fs,
             int texture_n, const char** textures,
@@ -94,7 +178,17 @@ namespace openswf
             const Matrix& matrix = Matrix::identity, const ColorTransform& cxform = ColorTransform::identity);
         void draw(int vsize, const VertexPack* vertices, int isize, const uint16_t* indices,
             const Matrix& matrix = Matrix::identity, const ColorTransform& cxform = ColorTransform::identity);
+        void draw(int vsize, const VertexPack* vertices, int isize, const uint32_t* indices,
+            const Matrix& matrix = Matrix::identity, const ColorTransform& cxform = ColorTransform::identity);
         void flush();
+        // records draws of a frame to group them by states, it's off by default.
+        void set_reordering(bool enabled);
+        // flushes and restarts the ring for next frame, which grows if this
+        // frame has wrapped it.
+        void end_frame();
+
+        const BatchStats& get_frame_stats() const;
+        int  get_capacity() const;
 
         void set_program(int index);
         void set_blend(BlendFunc src, BlendFunc dst);
@@ -108,10 +202,21 @@ namespace openswf
         return m_design_area;
     }
 
+    // statistics of the last ended frame
+    inline const BatchStats& Shader::get_frame_stats() const
+    {
+        return m_last_frame_stats;
+    }
+
+    inline int Shader::get_capacity() const
+    {
+        return m_capacity;
+    }
+
     inline void Shader::set_program(int index)
     {
         assert( index >= 0 && index < PROGRAM_MAX );
-        if( m_current_program != index )
+        if( m_current_program != index && !m_recording )
             flush();
 
         m_current_program = index;
@@ -119,7 +224,7 @@ namespace openswf
 
     inline void Shader::set_blend(BlendFunc src, BlendFunc dst)
     {
-        if( m_blend_src != src || m_blend_dst != dst )
+        if( (m_blend_src != src || m_blend_dst != dst) && !m_recording )
             flush();
 
         m_blend_src = src;
@@ -129,7 +234,7 @@ namespace openswf
     inline void Shader::set_texture(int index, Rid rid)
     {
         assert( index >=0 && index < MaxTexture );
-        if( m_textures[index] != rid )
+        if( m_textures[index] != rid && !m_recording )
             flush();
         m_textures[index] = rid;
     }
@@ -137,6 +242,6 @@ namespace openswf
     inline void Shader::set_uniform(int index, UniformFormat format, const float* v)
     {
         flush();
-        Render::get_instance().bind_uniform(index, format, v);
+        m_render->bind_uniform(index, format, v);
     }
 }
\ No newline at end of file
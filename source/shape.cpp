@@ -1,10 +1,13 @@
 #include <memory>
 #include <algorithm>
+#include <unordered_map>
+#include <cmath>
 
 #include "debug.hpp"
 #include "stream.hpp"
 #include "player.hpp"
 #include "shader.hpp"
+#include "render_context.hpp"
 #include "shape.hpp"
 #include "image.hpp"
 
@@ -28,7 +31,9 @@ namespace openswf
 
         fill->m_texture_cid = cid;
         fill->m_bitmap = std::move(bitmap);
-        fill->m_texture_rid = 0;
+        fill->m_image = nullptr;
+        fill->m_gradients = nullptr;
+        fill->m_repeating = false;
 
         fill->m_additive_start = additive_start;
         fill->m_additive_end = additive_end;
@@ -59,42 +64,67 @@ namespace openswf
         return create(0, std::move(bitmap), Color::empty, Color::empty, start, end);
     }
 
-    ShapeFillPtr ShapeFill::create(uint16_t cid, const Matrix& transform)
+    ShapeFillPtr ShapeFill::create(uint16_t cid, const Matrix& transform, bool repeating)
     {
-        return create(cid, nullptr, Color::empty, Color::empty, transform, transform);
+        return create(cid, transform, transform, repeating);
     }
 
-    ShapeFillPtr ShapeFill::create(uint16_t cid, const Matrix& start, const Matrix& end)
+    ShapeFillPtr ShapeFill::create(uint16_t cid, const Matrix& start, const Matrix& end, bool repeating)
     {
-        return create(cid, nullptr, Color::empty, Color::empty, start, end);
+        auto fill = create(cid, nullptr, Color::empty, Color::empty, start, end);
+        if( fill != nullptr ) fill->m_repeating = repeating;
+        return fill;
     }
 
+    // textures of bitmap fills are owned by images
+    ShapeFill::~ShapeFill()
+    {}
+
     void ShapeFill::attach(Player* env)
     {
         if( m_texture_cid != 0 ) // bitmap
         {
-            auto texture = env->get_character<Image>(m_texture_cid);
-            if( texture != nullptr )
+            m_image = env->get_character<Image>(m_texture_cid);
+            if( m_image != nullptr )
             {
-                m_coordinate.reset(0, texture->get_width(), 0, texture->get_height());
-                m_texture_rid = texture->get_texture_rid();
+                m_coordinate.reset(0, m_image->get_width(), 0, m_image->get_height());
+                if( m_repeating )
+                    m_image->set_repeating();
             }
         }
 
-        if( m_bitmap != nullptr ) // gradient
-        {
+        if( m_bitmap != nullptr || m_gradients != nullptr ) // gradient
             m_coordinate.reset(-16384, 16384, -16384, 16384);
-            m_texture_rid = Render::get_instance().create_texture(
-                m_bitmap->get_ptr(),
-                m_bitmap->get_width(), m_bitmap->get_height(), m_bitmap->get_format(), 1);
+
+        if( m_bitmap != nullptr && m_gradients == nullptr )
+        {
+            m_gradient = env->get_gradient_atlas().insert(*m_bitmap);
+            if( m_gradient.page >= 0 )
+            {
+                m_gradients = &env->get_gradient_atlas();
+                m_bitmap.reset();
+            }
         }
 
         // solid
     }
 
-    Rid ShapeFill::get_bitmap() const
+    // textures are created with the render of first use, so that players
+    // could be parsed without any render.
+    Rid ShapeFill::get_bitmap(Render& render)
     {
-        return m_texture_rid;
+        if( m_image != nullptr )
+            return m_image->get_texture_rid(render);
+
+        if( m_gradients != nullptr )
+            return m_gradients->get_texture_rid(m_gradient.page, render);
+
+        if( m_bitmap == nullptr )
+            return 0;
+
+        return m_texture.get(render,
+            m_bitmap->get_ptr(),
+            m_bitmap->get_width(), m_bitmap->get_height(), m_bitmap->get_format(), 1);
     }
 
     Color ShapeFill::get_additive_color(uint16_t ratio) const
@@ -115,7 +145,16 @@ namespace openswf
         Point2f ll = transform*Point2f(m_coordinate.xmin, m_coordinate.ymin);
         Point2f ru = transform*Point2f(m_coordinate.xmax, m_coordinate.ymax);
 
-        return Point2f( (position.x-ll.x) / (ru.x - ll.x), (position.y-ll.y) / (ru.y - ll.y) );
+        auto u = (position.x-ll.x) / (ru.x - ll.x);
+        auto v = (position.y-ll.y) / (ru.y - ll.y);
+
+        // a linear gradient is a row of atlas, which varies along u only
+        if( m_gradients != nullptr && m_gradient.row >= 0.f )
+            return Point2f(u, m_gradient.row);
+
+        if( m_image != nullptr )
+            return m_image->get_texcoord(Point2f(u, v));
+        return Point2f(u, v);
     }
 
     /// SHAPE LINE
@@ -126,6 +165,14 @@ namespace openswf
 
     ShapeLinePtr ShapeLine::create(uint16_t width_start, uint16_t width_end,
         const Color& additive_start, const Color& additive_end)
+    {
+        return create(width_start, width_end, additive_start, additive_end,
+            Capcode::ROUND, Capcode::ROUND, Joincode::ROUND, 3.f, false);
+    }
+
+    ShapeLinePtr ShapeLine::create(uint16_t width_start, uint16_t width_end,
+        const Color& additive_start, const Color& additive_end,
+        Capcode start_cap, Capcode end_cap, Joincode join, float miter_limit, bool no_close)
     {
         auto style = new (std::nothrow) ShapeLine();
         if( style == nullptr ) return nullptr;
@@ -134,6 +181,11 @@ namespace openswf
         style->m_width_end = width_end;
         style->m_additive_start = additive_start;
         style->m_additive_end = additive_end;
+        style->m_start_cap = start_cap;
+        style->m_end_cap = end_cap;
+        style->m_join = join;
+        style->m_miter_limit = miter_limit;
+        style->m_no_close = no_close;
 
         return ShapeLinePtr(style);
     }
@@ -149,40 +201,398 @@ namespace openswf
         return (uint16_t)((float)m_width_start + (float)(m_width_end - m_width_start)*(float)ratio/65535.f);
     }
 
+    StrokeStyle ShapeLine::get_stroke_style(int level, uint16_t ratio) const
+    {
+        StrokeStyle style;
+        style.width = std::max((float)get_width(ratio), std::ldexp(PIXEL_TO_TWIPS, -level));
+        style.tolerance = ShapeRecord::get_tolerance(level);
+        style.miter_limit = m_miter_limit;
+        style.start_cap = m_start_cap;
+        style.end_cap = m_end_cap;
+        style.join = m_join;
+        return style;
+    }
+
+    bool ShapeLine::is_closable() const
+    {
+        return !m_no_close;
+    }
+
     /// SHAPE RECORD
-    ShapeRecordPtr ShapeRecord::create(const Rect& rect,
-        std::vector<Point2f>&& vertices, std::vector<uint16_t>&& contour_indices)
+    const static int    MAX_CURVE_SUBDIVIDE = 1024;
+    const static float  CURVE_TOLERANCE     = 4.f;
+
+    // the deviation of a quadratic curve from its n uniform chords is bounded
+    // by |prev - 2*ctrl + next| / (8*n^2), which gives the segment count directly.
+    static void contour_add_curve(PointList& out, const Point2f& prev, const Point2f& ctrl, const Point2f& next, float tolerance)
+    {
+        Point2f dd = prev - ctrl*2.f + next;
+        float deviation = std::sqrt(dd.x*dd.x + dd.y*dd.y) * 0.125f;
+
+        int count = (int)std::ceil(std::sqrt(deviation / tolerance));
+        count = std::min(std::max(count, 1), MAX_CURVE_SUBDIVIDE);
+
+        float step = 1.f / (float)count;
+        for( auto i=1; i<count; i++ )
+        {
+            float t = step * (float)i, u = 1.f - t;
+            out.push_back(prev*(u*u) + ctrl*(2.f*u*t) + next*(t*t));
+        }
+        out.push_back(next);
+    }
+
+    const static uint32_t InvalidPiece = ~0u;
+
+    // a piece is the edges of one path bounding one of its fills. pieces are
+    // linked into chains by matching end points, a reversed piece walks its
+    // edges backward.
+    struct ContourPiece
+    {
+        const ShapePath*    path;
+        uint32_t            fill;
+        uint32_t            next;
+        uint32_t            next_by_start;
+        uint32_t            next_by_end;
+        bool                reversed;
+        bool                used;
+
+        ContourPiece(const ShapePath* path, uint32_t fill, bool reversed)
+        : path(path), fill(fill), next(InvalidPiece),
+        next_by_start(InvalidPiece), next_by_end(InvalidPiece),
+        reversed(reversed), used(false) {}
+
+        const Point2f& head() const
+        {
+            return reversed ? path->edges.back().anchor : path->start;
+        }
+
+        const Point2f& tail() const
+        {
+            return reversed ? path->start : path->edges.back().anchor;
+        }
+
+        // appends all the edges of this piece
+        void emit(PointList& anchors, PointList& controls) const
+        {
+            auto& edges = path->edges;
+            if( !reversed )
+            {
+                for( auto& edge : edges )
+                {
+                    anchors.push_back(edge.anchor);
+                    controls.push_back(edge.control);
+                }
+            }
+            else
+            {
+                for( int i=edges.size()-1; i>=0; i-- )
+                {
+                    anchors.push_back(i == 0 ? path->start : edges[i-1].anchor);
+                    controls.push_back(edges[i].control);
+                }
+            }
+        }
+    };
+
+    // end points are quantized to whole twips, and only pieces of the same
+    // fill style could be linked together.
+    struct EndpointKey
+    {
+        int32_t     x, y;
+        uint32_t    fill;
+
+        EndpointKey(const Point2f& point, uint32_t fill)
+        : x((int32_t)std::floor(point.x+0.5f)), y((int32_t)std::floor(point.y+0.5f)), fill(fill) {}
+
+        bool operator == (const EndpointKey& rh) const
+        {
+            return x == rh.x && y == rh.y && fill == rh.fill;
+        }
+    };
+
+    struct EndpointHash
+    {
+        size_t operator() (const EndpointKey& key) const
+        {
+            uint64_t h = (uint64_t)(uint32_t)key.x * 0x9E3779B97F4A7C15ull;
+            h ^= ((uint64_t)(uint32_t)key.y + (h << 6) + (h >> 2)) * 0xC2B2AE3D27D4EB4Full;
+            h ^= (uint64_t)key.fill * 0x165667B19E3779F9ull;
+            return (size_t)(h ^ (h >> 29));
+        }
+    };
+
+    typedef std::unordered_map<EndpointKey, uint32_t, EndpointHash> EndpointMap;
+
+    // pops an unused piece from the list of end point, used pieces left in
+    // list are skipped lazily, so every piece would be visited only once.
+    static uint32_t endpoint_pop(EndpointMap& map, const EndpointKey& key,
+        std::vector<ContourPiece>& pieces, bool by_start)
+    {
+        auto found = map.find(key);
+        if( found == map.end() )
+            return InvalidPiece;
+
+        auto index = found->second;
+        while( index != InvalidPiece && pieces[index].used )
+            index = by_start ? pieces[index].next_by_start : pieces[index].next_by_end;
+
+        found->second = index == InvalidPiece ? index :
+            (by_start ? pieces[index].next_by_start : pieces[index].next_by_end);
+        return index;
+    }
+
+    ShapeRecordPtr ShapeRecord::create(const Rect& rect, const ShapePathList& paths,
+        uint32_t fill_count, uint32_t line_count)
     {
         auto record = new (std::nothrow) ShapeRecord;
         if( record == nullptr ) return nullptr;
 
         record->bounds = rect;
-        record->vertices = std::move(vertices);
-        record->contour_indices = std::move(contour_indices);
+
+        // orient pieces with fill on the right side, and sort them by fill
+        // style with a counting pass, so contours of each fill are emitted together.
+        OffsetList offsets(fill_count+1, 0);
+        auto edge_count = 0;
+        for( auto& path : paths )
+        {
+            if( path.edges.empty() ) continue;
+            if( path.left_fill > 0 && path.left_fill <= fill_count ) offsets[path.left_fill] ++;
+            if( path.right_fill > 0 && path.right_fill <= fill_count ) offsets[path.right_fill] ++;
+            edge_count += path.edges.size();
+        }
+
+        for( auto i=1; i<=fill_count; i++ )
+            offsets[i] += offsets[i-1];
+
+        OffsetList cursor(offsets.begin(), offsets.end()-1);
+        std::vector<ContourPiece> pieces(offsets[fill_count], ContourPiece(nullptr, 0, false));
+        for( auto& path : paths )
+        {
+            if( path.edges.empty() ) continue;
+            if( path.right_fill > 0 && path.right_fill <= fill_count )
+                pieces[cursor[path.right_fill-1]++] = ContourPiece(&path, path.right_fill-1, false);
+
+            if( path.left_fill > 0 && path.left_fill <= fill_count )
+                pieces[cursor[path.left_fill-1]++] = ContourPiece(&path, path.left_fill-1, true);
+        }
+
+        EndpointMap by_start, by_end;
+        by_start.reserve(pieces.size());
+        by_end.reserve(pieces.size());
+
+        for( int i=pieces.size()-1; i>=0; i-- )
+        {
+            auto& piece = pieces[i];
+
+            auto& head = by_start.emplace(EndpointKey(piece.head(), piece.fill), InvalidPiece).first->second;
+            piece.next_by_start = head;
+            head = i;
+
+            auto& tail = by_end.emplace(EndpointKey(piece.tail(), piece.fill), InvalidPiece).first->second;
+            piece.next_by_end = tail;
+            tail = i;
+        }
+
+        record->anchors.reserve(edge_count + pieces.size());
+        record->controls.reserve(edge_count + pieces.size());
+        record->fills.reserve(fill_count);
+
+        auto piece_index = 0;
+        for( auto fill = 0; fill < fill_count; fill++ )
+        {
+            for( ; piece_index < offsets[fill+1]; piece_index++ )
+            {
+                if( pieces[piece_index].used )
+                    continue;
+
+                // follow pieces which start at the tail of current one, or end at it
+                // with a flipped direction, until the chain returns to its head.
+                auto first = piece_index;
+                auto current = first;
+                pieces[first].used = true;
+
+                auto start = EndpointKey(pieces[first].head(), fill);
+                for(;;)
+                {
+                    auto tail = EndpointKey(pieces[current].tail(), fill);
+                    if( tail == start )
+                        break;
+
+                    auto next = endpoint_pop(by_start, tail, pieces, true);
+                    if( next == InvalidPiece )
+                    {
+                        next = endpoint_pop(by_end, tail, pieces, false);
+                        if( next == InvalidPiece ) break;
+                        pieces[next].reversed = !pieces[next].reversed;
+                    }
+
+                    pieces[next].used = true;
+                    pieces[current].next = next;
+                    current = next;
+                }
+
+                // emits the chain with curves, the closing point is kept to
+                // make contours of morph shapes have the same size.
+                record->anchors.push_back(pieces[first].head());
+                record->controls.push_back(pieces[first].head());
+                for( auto index = first; index != InvalidPiece; index = pieces[index].next )
+                    pieces[index].emit(record->anchors, record->controls);
+
+                record->contours.push_back(record->anchors.size());
+            }
+
+            record->fills.push_back(record->contours.size());
+        }
+
+        // strokes keep the order of paths, a path starts where the last stroke
+        // of its line style ends continues that stroke.
+        OffsetList line_offsets(line_count+1, 0);
+        for( auto& path : paths )
+        {
+            if( !path.edges.empty() && path.line > 0 && path.line <= line_count )
+                line_offsets[path.line] ++;
+        }
+
+        for( auto i=1; i<=line_count; i++ )
+            line_offsets[i] += line_offsets[i-1];
+
+        OffsetList line_cursor(line_offsets.begin(), line_offsets.end()-1);
+        std::vector<ContourPiece> line_pieces(line_offsets[line_count], ContourPiece(nullptr, 0, false));
+        for( auto& path : paths )
+        {
+            if( !path.edges.empty() && path.line > 0 && path.line <= line_count )
+                line_pieces[line_cursor[path.line-1]++] = ContourPiece(&path, path.line-1, false);
+        }
+
+        record->lines.reserve(line_count);
+        for( auto line = 0; line < line_count; line++ )
+        {
+            for( auto i=line_offsets[line]; i<line_offsets[line+1]; i++ )
+            {
+                auto& piece = line_pieces[i];
+                auto stroke_start = record->strokes.empty() ? 0 : record->strokes.back();
+                auto connected = record->line_anchors.size() > stroke_start &&
+                    EndpointKey(record->line_anchors.back(), line) == EndpointKey(piece.head(), line);
+
+                if( !connected )
+                {
+                    if( record->line_anchors.size() > stroke_start )
+                        record->strokes.push_back(record->line_anchors.size());
+
+                    record->line_anchors.push_back(piece.head());
+                    record->line_controls.push_back(piece.head());
+                }
+
+                piece.emit(record->line_anchors, record->line_controls);
+            }
+
+            auto stroke_start = record->strokes.empty() ? 0 : record->strokes.back();
+            if( record->line_anchors.size() > stroke_start )
+                record->strokes.push_back(record->line_anchors.size());
+
+            record->lines.push_back(record->strokes.size());
+        }
+
         return ShapeRecordPtr(record);
     }
 
+    static void flatten_curves(const PointList& anchors, const PointList& controls,
+        uint32_t start, uint32_t end, float tolerance, PointList& out_vertices)
+    {
+        out_vertices.push_back(anchors[start]);
+        for( auto k=start+1; k<end; k++ )
+        {
+            if( controls[k] == anchors[k] )
+                out_vertices.push_back(anchors[k]);
+            else
+                contour_add_curve(out_vertices, anchors[k-1], controls[k], anchors[k], tolerance);
+        }
+    }
+
+    void ShapeRecord::flatten_stroke(uint32_t index, float tolerance, PointList& out_vertices) const
+    {
+        out_vertices.clear();
+        flatten_curves(line_anchors, line_controls,
+            index == 0 ? 0 : strokes[index-1], strokes[index], tolerance, out_vertices);
+    }
+
+    void ShapeRecord::flatten(float tolerance, PointList& out_vertices,
+        OffsetList& out_contours, OffsetList& out_fills) const
+    {
+        out_vertices.clear();
+        out_contours.clear();
+        out_fills.clear();
+
+        for( auto i=0; i<fills.size(); i++ )
+        {
+            auto contour_start = i == 0 ? 0 : fills[i-1];
+            for( auto j=contour_start; j<fills[i]; j++ )
+            {
+                auto start_pos = j == 0 ? 0 : contours[j-1];
+                auto base = out_vertices.size();
+                flatten_curves(anchors, controls, start_pos, contours[j], tolerance, out_vertices);
+
+                if( out_vertices.size() - base > 1 && out_vertices.back() == out_vertices[base] )
+                    out_vertices.pop_back();
+
+                if( out_vertices.size() - base < 3 )
+                    out_vertices.resize(base);
+                else
+                    out_contours.push_back(out_vertices.size());
+            }
+
+            out_fills.push_back(out_contours.size());
+        }
+    }
+
+    int ShapeRecord::get_level(const Matrix& matrix)
+    {
+        auto scale = matrix.get_max_scale();
+        if( scale <= 0.f ) return ShapeMinLevel;
+
+        auto level = (int)std::ceil(std::log2(scale));
+        return std::min(std::max(level, ShapeMinLevel), ShapeMaxLevel);
+    }
+
+    float ShapeRecord::get_tolerance(int level)
+    {
+        return std::ldexp(CURVE_TOLERANCE, -level);
+    }
+
     static bool tesselate(
-        const PointList& vertices, const IndexList& contour_indices,
-        ShapeFillList& fill_styles,
-        VertexPackList& out_vertices, IndexList& out_vertices_size,
-        IndexList& out_indices, IndexList& out_indices_size)
+        const PointList& vertices, const OffsetList& contours, const OffsetList& fills,
+        VertexPackList& out_vertices, OffsetList& out_vertices_size,
+        IndexList& out_indices, OffsetList& out_indices_size)
     {
         out_vertices.clear();
         out_vertices_size.clear();
         out_indices.clear();
         out_indices_size.clear();
-        
-        for( auto i=0; i<contour_indices.size(); i++ )
+
+        for( auto i=0; i<fills.size(); i++ )
         {
+            auto contour_start = i == 0 ? 0 : fills[i-1];
+            auto contour_end = fills[i];
+
+            // keeps an empty range for fill style without any contour
+            if( contour_start == contour_end )
+            {
+                out_indices_size.push_back( out_indices.size() );
+                out_vertices_size.push_back( out_vertices.size() );
+                continue;
+            }
+
             auto tess = tessNewTess(nullptr);
             if( !tess ) return false;
-            
-            auto end_pos = contour_indices[i];
-            auto start_pos = i == 0 ? 0 : contour_indices[i-1];
-            tessAddContour(tess, 2, vertices.data()+start_pos, sizeof(Point2f), end_pos-start_pos);
-            
-            if( !tessTesselate(tess, TESS_WINDING_NONZERO, TESS_POLYGONS, MAX_POLYGON_SIZE, 2, 0) )
+
+            for( auto j=contour_start; j<contour_end; j++ )
+            {
+                auto end_pos = contours[j];
+                auto start_pos = j == 0 ? 0 : contours[j-1];
+                tessAddContour(tess, 2, vertices.data()+start_pos, sizeof(Point2f), end_pos-start_pos);
+            }
+
+            if( !tessTesselate(tess, TESS_WINDING_ODD, TESS_POLYGONS, MAX_POLYGON_SIZE, 2, 0) )
             {
                 tessDeleteTess(tess);
                 return false;
@@ -198,7 +608,6 @@ namespace openswf
             for( int j=0; j<vcount; j++ )
             {
                 auto position = Point2f(tess_vertices[j*2], tess_vertices[j*2+1]).to_pixel();
-                // auto texcoord = fill_styles[i]->get_texcoord(position);
                 out_vertices.push_back( {position.x, position.y, 0, 0} );
             }
 
@@ -223,11 +632,103 @@ namespace openswf
             out_vertices_size.push_back( out_vertices.size() );
         }
 
-        assert( out_indices_size.back() == out_indices.size() );
         assert( out_indices_size.size() == out_vertices_size.size() );
         return true;
     }
 
+    /// SHAPE MESH
+    static bool tesselate(const ShapeRecord& record, const ShapeLineList& lines,
+        int level, uint16_t ratio,
+        VertexPackList& out_vertices, OffsetList& out_vertices_size,
+        IndexList& out_indices, OffsetList& out_indices_size)
+    {
+        PointList vertices;
+        OffsetList contours, fills;
+        record.flatten(ShapeRecord::get_tolerance(level), vertices, contours, fills);
+
+        if( !tesselate(vertices, contours, fills,
+            out_vertices, out_vertices_size, out_indices, out_indices_size) )
+            return false;
+
+        // strokes of each line style follow the fills
+        assert( record.lines.size() <= lines.size() );
+        for( auto i=0; i<record.lines.size(); i++ )
+        {
+            auto style = lines[i]->get_stroke_style(level, ratio);
+            auto closable = lines[i]->is_closable();
+
+            Stroker stroker(style, out_vertices, out_indices);
+            for( auto j = i == 0 ? 0 : record.lines[i-1]; j<record.lines[i]; j++ )
+            {
+                record.flatten_stroke(j, style.tolerance, vertices);
+                stroker.add_polyline(vertices.data(), vertices.size(), closable);
+            }
+
+            out_indices_size.push_back( out_indices.size() );
+            out_vertices_size.push_back( out_vertices.size() );
+        }
+
+        return true;
+    }
+
+    // optimizes each range of a mesh and packs them together again
+    static MeshStats optimize(VertexPackList& vertices, IndexList& indices,
+        OffsetList& vertices_size, OffsetList& indices_size)
+    {
+        MeshStats stats;
+        stats.vertices_before = vertices.size();
+        stats.indices_before = indices.size();
+
+        uint32_t vbase = 0, ibase = 0, vused = 0, iused = 0;
+        for( auto i=0; i<vertices_size.size(); i++ )
+        {
+            uint32_t vsize = vertices_size[i] - vbase;
+            uint32_t isize = indices_size[i] - ibase;
+            if( isize > 0 )
+                MeshOptimizer::optimize(vertices.data()+vbase, vsize, indices.data()+ibase, isize);
+
+            std::copy(vertices.begin()+vbase, vertices.begin()+vbase+vsize, vertices.begin()+vused);
+            std::copy(indices.begin()+ibase, indices.begin()+ibase+isize, indices.begin()+iused);
+
+            vbase = vertices_size[i];
+            ibase = indices_size[i];
+            vertices_size[i] = (vused += vsize);
+            indices_size[i] = (iused += isize);
+        }
+
+        vertices.resize(vused);
+        indices.resize(iused);
+
+        stats.vertices_after = vused;
+        stats.indices_after = iused;
+        return stats;
+    }
+
+    ShapeMeshPtr ShapeMesh::create(const ShapeRecord& record, const ShapeLineList& lines, int level)
+    {
+        auto mesh = new (std::nothrow) ShapeMesh();
+        if( mesh == nullptr ) return nullptr;
+
+        mesh->last_used = 0;
+        if( !tesselate(record, lines, level, 0,
+            mesh->vertices, mesh->vertices_size, mesh->indices, mesh->indices_size) )
+        {
+            delete mesh;
+            return nullptr;
+        }
+
+        mesh->stats = optimize(mesh->vertices, mesh->indices, mesh->vertices_size, mesh->indices_size);
+
+        return ShapeMeshPtr(mesh);
+    }
+
+    uint32_t ShapeMesh::get_memsize() const
+    {
+        return vertices.size()*sizeof(VertexPack) +
+            indices.size()*sizeof(uint32_t) +
+            (vertices_size.size() + indices_size.size())*sizeof(uint32_t);
+    }
+
     /// SHAPE PARSING
     Shape* Shape::create(uint16_t cid, 
         ShapeFillList&& fill_styles, ShapeLineList&& line_styles, ShapeRecordPtr record)
@@ -250,10 +751,48 @@ namespace openswf
         this->bounds        = record->bounds;
         this->fill_styles   = std::move(fill_styles);
         this->line_styles   = std::move(line_styles);
+        this->record        = std::move(record);
+        this->mesh_memsize  = 0;
+        this->mesh_tick     = 0;
+
+        // the mesh of original size is created eagerly to report broken shapes
+        return get_mesh(0) != nullptr;
+    }
+
+    ShapeMesh* Shape::get_mesh(int level)
+    {
+        assert( level >= ShapeMinLevel && level <= ShapeMaxLevel );
+
+        auto& mesh = this->meshes[level-ShapeMinLevel];
+        if( mesh == nullptr )
+        {
+            mesh = ShapeMesh::create(*this->record, this->line_styles, level);
+            if( mesh == nullptr ) return nullptr;
+
+            this->mesh_memsize += mesh->get_memsize();
+            if( m_player != nullptr )
+                m_player->add_mesh_stats(mesh->stats);
+        }
+
+        mesh->last_used = ++this->mesh_tick;
+
+        // releases the least recently used levels except the current one
+        while( this->mesh_memsize > ShapeMeshMemoryCap )
+        {
+            ShapeMeshPtr* oldest = nullptr;
+            for( auto& candidate : this->meshes )
+            {
+                if( candidate != nullptr && candidate != mesh &&
+                    (oldest == nullptr || candidate->last_used < (*oldest)->last_used) )
+                    oldest = &candidate;
+            }
+
+            if( oldest == nullptr ) break;
+            this->mesh_memsize -= (*oldest)->get_memsize();
+            oldest->reset();
+        }
 
-        return tesselate(
-            record->vertices, record->contour_indices, this->fill_styles,
-            this->vertices, this->vertices_size, this->indices, this->indices_size);
+        return mesh.get();
     }
 
     INode* Shape::create_instance()
@@ -265,6 +804,13 @@ namespace openswf
     {
         ICharacter::set_player(env);
 
+        // meshes created while parsing
+        for( auto& mesh : meshes )
+        {
+            if( mesh != nullptr )
+                env->add_mesh_stats(mesh->stats);
+        }
+
         for( auto& style : fill_styles )
             style->attach(env);
     }
@@ -282,33 +828,49 @@ namespace openswf
     void ShapeNode::update(float dt)
     {}
 
-    void ShapeNode::render(const Matrix& matrix, const ColorTransform& cxform)
+    void ShapeNode::render(RenderContext& context, const Matrix& matrix, const ColorTransform& cxform)
     {
-        auto& shader = Shader::get_instance();
+        auto transform = matrix*m_matrix;
+        auto mesh = m_shape->get_mesh(ShapeRecord::get_level(transform));
+        if( mesh == nullptr ) return;
+
+        auto& shader = context.get_shader();
         shader.set_program(PROGRAM_DEFAULT);
         shader.set_blend(BlendFunc::ONE, BlendFunc::ONE_MINUS_SRC_ALPHA);
 
-        for( auto i=0; i<m_shape->vertices_size.size(); i++ )
+        for( auto i=0; i<mesh->vertices_size.size(); i++ )
         {
-            auto vbase = i == 0 ? 0 : m_shape->vertices_size[i-1];
-            auto vcount = m_shape->vertices_size[i] - vbase;
+            auto vbase = i == 0 ? 0 : mesh->vertices_size[i-1];
+            auto vcount = mesh->vertices_size[i] - vbase;
+
+            auto ibase = i == 0 ? 0 : mesh->indices_size[i-1];
+            auto icount = mesh->indices_size[i] - ibase;
 
-            auto ibase = i == 0 ? 0 : m_shape->indices_size[i-1];
-            auto icount = m_shape->indices_size[i] - ibase;
+            if( i < m_shape->fill_styles.size() )
+            {
+                auto& style = m_shape->fill_styles[i];
+                auto color = style->get_additive_color();
+                for( auto j=vbase; j<vbase+vcount; j++ )
+                {
+                    mesh->vertices[j].texcoord = style->get_texcoord(mesh->vertices[j].position);
+                    mesh->vertices[j].additive = color;
+                }
 
-            auto& style = m_shape->fill_styles[i];
-            auto color = style->get_additive_color();
-            for( auto j=vbase; j<vbase+vcount; j++ )
+                shader.set_texture(0, style->get_bitmap(context.get_render()));
+            }
+            else
             {
-                m_shape->vertices[j].texcoord = style->get_texcoord(m_shape->vertices[j].position);
-                m_shape->vertices[j].additive = color;
+                auto color = m_shape->line_styles[i - m_shape->fill_styles.size()]->get_additive_color();
+                for( auto j=vbase; j<vbase+vcount; j++ )
+                    mesh->vertices[j].additive = color;
+
+                shader.set_texture(0, 0);
             }
 
-            shader.set_texture(0, m_shape->fill_styles[i]->get_bitmap());
             shader.draw(
-                vcount, m_shape->vertices.data()+vbase,
-                icount, m_shape->indices.data()+ibase,
-                matrix*m_matrix, cxform*m_cxform);
+                vcount, mesh->vertices.data()+vbase,
+                icount, mesh->indices.data()+ibase,
+                transform, cxform*m_cxform);
         }
     }
 
@@ -324,10 +886,27 @@ namespace openswf
         morph->fill_styles = std::move(fill_styles);
         morph->line_styles = std::move(line_styles);
 
-        assert( start->vertices.size() == end->vertices.size() );
-        assert( start->contour_indices.size() == end->contour_indices.size() );
+        assert( start->anchors.size() == end->anchors.size() );
+        assert( start->contours.size() == end->contours.size() );
+
+        morph->interp.anchors.resize(start->anchors.size());
+        morph->interp.controls.resize(start->controls.size());
+        morph->interp.contours = start->contours;
+        morph->interp.fills = start->fills;
+
+        // strokes are merged by end points, which may connect differently
+        // at both ends of a morph. keeps the start strokes in that case.
+        if( start->line_anchors.size() != end->line_anchors.size() ||
+            start->strokes != end->strokes )
+        {
+            end->line_anchors = start->line_anchors;
+            end->line_controls = start->line_controls;
+        }
 
-        morph->interp.resize(start->vertices.size());
+        morph->interp.line_anchors.resize(start->line_anchors.size());
+        morph->interp.line_controls.resize(start->line_controls.size());
+        morph->interp.strokes = start->strokes;
+        morph->interp.lines = start->lines;
 
         morph->start = std::move(start);
         morph->end = std::move(end);
@@ -352,29 +931,34 @@ namespace openswf
         return new MorphShapeNode(this->m_player, this);
     }
 
-    void MorphShape::tesselate(uint16_t ratio, 
+    void MorphShape::tesselate(uint16_t ratio, int level,
         VertexPackList& out_vertices,
-        IndexList& out_vertices_size,
+        OffsetList& out_vertices_size,
         IndexList& out_indices,
-        IndexList& out_indices_size)
+        OffsetList& out_indices_size)
     {
-        for( auto i=0; i<this->start->vertices.size(); i++ )
+        // curves are interpolated before flattening, so both ends of
+        // a morph are approximated with the same tolerance
+        auto fixed = (float)ratio / 65535.f;
+        for( auto i=0; i<this->start->anchors.size(); i++ )
+        {
+            this->interp.anchors[i] = Point2f::lerp(this->start->anchors[i], this->end->anchors[i], fixed);
+            this->interp.controls[i] = Point2f::lerp(this->start->controls[i], this->end->controls[i], fixed);
+        }
+
+        for( auto i=0; i<this->start->line_anchors.size(); i++ )
         {
-            this->interp[i] = Point2f::lerp(
-                this->start->vertices[i],
-                this->end->vertices[i],
-                (float)ratio / 65535.f);
+            this->interp.line_anchors[i] = Point2f::lerp(this->start->line_anchors[i], this->end->line_anchors[i], fixed);
+            this->interp.line_controls[i] = Point2f::lerp(this->start->line_controls[i], this->end->line_controls[i], fixed);
         }
 
-        ::openswf::tesselate(
-            this->interp, this->start->contour_indices,
-            this->fill_styles,
+        ::openswf::tesselate(this->interp, this->line_styles, level, ratio,
             out_vertices, out_vertices_size, out_indices, out_indices_size);
     }
 
     /// MORPH SHAPE NODE
     MorphShapeNode::MorphShapeNode(Player* env, MorphShape* shape)
-    : INode(env, shape), m_morph_shape(shape), m_current_ratio(0)
+    : INode(env, shape), m_morph_shape(shape), m_current_ratio(0), m_current_level(0)
     {
         tesselate();
     }
@@ -388,9 +972,17 @@ namespace openswf
         }
     }
 
-    void MorphShapeNode::render(const Matrix& matrix, const ColorTransform& cxform)
+    void MorphShapeNode::render(RenderContext& context, const Matrix& matrix, const ColorTransform& cxform)
     {
-        auto& shader = Shader::get_instance();
+        auto transform = matrix*m_matrix;
+        auto level = ShapeRecord::get_level(transform);
+        if( m_current_level != level )
+        {
+            m_current_level = level;
+            tesselate();
+        }
+
+        auto& shader = context.get_shader();
         shader.set_program(PROGRAM_DEFAULT);
         shader.set_blend(BlendFunc::ONE, BlendFunc::ONE_MINUS_SRC_ALPHA);
 
@@ -402,25 +994,38 @@ namespace openswf
             auto ibase = i == 0 ? 0 : m_indices_size[i-1];
             auto icount = m_indices_size[i] - ibase;
 
-            auto& style = m_morph_shape->fill_styles[i];
-            auto color = style->get_additive_color(m_current_ratio);
-            for( auto j=vbase; j<vbase+vcount; j++ )
+            if( i < m_morph_shape->fill_styles.size() )
             {
-                m_vertices[j].additive = color;
-                m_vertices[j].texcoord = style->get_texcoord(m_vertices[j].position, m_current_ratio);
+                auto& style = m_morph_shape->fill_styles[i];
+                auto color = style->get_additive_color(m_current_ratio);
+                for( auto j=vbase; j<vbase+vcount; j++ )
+                {
+                    m_vertices[j].additive = color;
+                    m_vertices[j].texcoord = style->get_texcoord(m_vertices[j].position, m_current_ratio);
+                }
+
+                shader.set_texture(0, style->get_bitmap(context.get_render()));
+            }
+            else
+            {
+                auto& style = m_morph_shape->line_styles[i - m_morph_shape->fill_styles.size()];
+                auto color = style->get_additive_color(m_current_ratio);
+                for( auto j=vbase; j<vbase+vcount; j++ )
+                    m_vertices[j].additive = color;
+
+                shader.set_texture(0, 0);
             }
 
-            shader.set_texture(0, m_morph_shape->fill_styles[i]->get_bitmap());
             shader.draw(
                 vcount, m_vertices.data()+vbase,
                 icount, m_indices.data()+ibase,
-                matrix*m_matrix, cxform*m_cxform);
+                transform, cxform*m_cxform);
         }
     }
 
     void MorphShapeNode::tesselate()
     {
-        this->m_morph_shape->tesselate(m_current_ratio,
+        this->m_morph_shape->tesselate(m_current_ratio, m_current_level,
             m_vertices, m_vertices_size, m_indices, m_indices_size);
     }
 }
\ No newline at end of file
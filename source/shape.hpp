@@ -2,6 +2,9 @@
 
 #include "character.hpp"
 #include "image.hpp"
+#include "atlas.hpp"
+#include "stroke.hpp"
+#include "mesh.hpp"
 
 namespace openswf
 {
@@ -14,8 +17,14 @@ namespace openswf
         uint16_t        m_texture_cid;
         BitmapPtr   m_bitmap;
 
-        Rid         m_texture_rid;
+        ResidentTexture m_texture;
+        Image*      m_image;
         Rect        m_coordinate;
+        bool        m_repeating;
+
+        // gradients are moved into the atlas of player once attached
+        GradientAtlas*  m_gradients;
+        GradientSlot    m_gradient;
 
         Color       m_additive_start, m_additive_end;
         Matrix      m_texcoord_start, m_texcoord_end;
@@ -29,11 +38,13 @@ namespace openswf
         static ShapeFillPtr create(const Color&, const Color&);
         static ShapeFillPtr create(BitmapPtr bitmap, const Matrix&);
         static ShapeFillPtr create(BitmapPtr bitmap, const Matrix&, const Matrix&);
-        static ShapeFillPtr create(uint16_t cid, const Matrix&);
-        static ShapeFillPtr create(uint16_t cid, const Matrix&, const Matrix&);
+        static ShapeFillPtr create(uint16_t cid, const Matrix&, bool repeating = false);
+        static ShapeFillPtr create(uint16_t cid, const Matrix&, const Matrix&, bool repeating = false);
+
+        ~ShapeFill();
 
         void    attach(Player* env);
-        Rid     get_bitmap() const;
+        Rid     get_bitmap(Render& render);
         Color   get_additive_color(uint16_t ratio = 0) const;
         Point2f get_texcoord(const Point2f&, uint16_t ratio = 0) const;
     };
@@ -41,37 +52,140 @@ namespace openswf
     class ShapeLine;
     typedef std::unique_ptr<ShapeLine> ShapeLinePtr;
 
+    // widths are in twips, a line thinner than one pixel is drawn as a hairline
     struct ShapeLine
     {
     protected:
         uint16_t m_width_start, m_width_end;
         Color    m_additive_start, m_additive_end;
+        Capcode  m_start_cap, m_end_cap;
+        Joincode m_join;
+        float    m_miter_limit;
+        bool     m_no_close;
 
     public:
         static ShapeLinePtr create(uint16_t width, const Color& additive);
         static ShapeLinePtr create(uint16_t width_start, uint16_t width_end,
             const Color& additive_start, const Color& additive_end);
+        static ShapeLinePtr create(uint16_t width_start, uint16_t width_end,
+            const Color& additive_start, const Color& additive_end,
+            Capcode start_cap, Capcode end_cap, Joincode join, float miter_limit, bool no_close);
 
         Color       get_additive_color(uint16_t ratio = 0) const;
         uint16_t    get_width(uint16_t ratio = 0) const;
+        StrokeStyle get_stroke_style(int level, uint16_t ratio = 0) const;
+        bool        is_closable() const;
     };
 
     typedef std::vector<Point2f>        PointList;
     typedef std::vector<VertexPack>     VertexPackList;
-    typedef std::vector<uint16_t>       IndexList;
+    typedef std::vector<uint32_t>       IndexList;
     typedef std::vector<ShapeFillPtr>   ShapeFillList;
     typedef std::vector<ShapeLinePtr>   ShapeLineList;
 
+    typedef std::vector<uint32_t>       OffsetList;
+
+    // an edge record of shape path, which is a quadratic bezier curve
+    // from previous anchor to this anchor. the control point of straight
+    // edge is the same as its anchor.
+    struct ShapeEdge
+    {
+        ShapeEdge(const Point2f& anchor)
+            : control(anchor), anchor(anchor) {}
+
+        ShapeEdge(int32_t ax, int32_t ay, int32_t cx, int32_t cy)
+            : control(Point2f(cx, cy)), anchor(Point2f(ax, ay)){}
+
+        Point2f control, anchor;
+    };
+
+    struct ShapePath
+    {
+        uint32_t                left_fill;
+        uint32_t                right_fill;
+        uint32_t                line;
+
+        Point2f                 start;
+        std::vector<ShapeEdge>  edges;
+
+        ShapePath() : left_fill(0), right_fill(0), line(0) {}
+        void reset()
+        {
+            left_fill = right_fill = 0;
+            line = 0;
+        }
+
+        void restart(const Point2f& cursor)
+        {
+            start.x = cursor.x;
+            start.y = cursor.y;
+            edges.clear();
+        }
+    };
+
+    typedef std::vector<ShapePath> ShapePathList;
+
     class ShapeRecord;
     typedef std::unique_ptr<ShapeRecord> ShapeRecordPtr;
 
+    // the closed contours of each fill style, assembled from the edges of paths.
+    // contours of the i-th fill style are in range [fills[i-1], fills[i]),
+    // points of the j-th contour are in range [contours[j-1], contours[j]).
+    // a contour keeps its curves, the first anchor is the start point and k-th
+    // edge goes from anchor k-1 to anchor k, bending towards control k.
+    // the strokes of line styles are kept in the same layout, with connected
+    // paths of the same line style merged into one stroke.
     struct ShapeRecord
     {
         Rect        bounds;
-        PointList   vertices;
-        IndexList   contour_indices;
+        PointList   anchors;
+        PointList   controls;
+        OffsetList  contours;
+        OffsetList  fills;
 
-        static ShapeRecordPtr create(const Rect& rect, PointList&&, IndexList&&);
+        PointList   line_anchors;
+        PointList   line_controls;
+        OffsetList  strokes;
+        OffsetList  lines;
+
+        static ShapeRecordPtr create(const Rect& rect, const ShapePathList& paths,
+            uint32_t fill_count, uint32_t line_count = 0);
+
+        // approximates curves with line segments which deviate less than
+        // tolerance twips, contours degenerated into lines are dropped.
+        void flatten(float tolerance, PointList& out_vertices,
+            OffsetList& out_contours, OffsetList& out_fills) const;
+
+        // approximates curves of the j-th stroke, the closing point is kept
+        void flatten_stroke(uint32_t index, float tolerance, PointList& out_vertices) const;
+
+        // the level of detail for a transform, each level up halves the tolerance
+        static int   get_level(const Matrix& matrix);
+        static float get_tolerance(int level);
+    };
+
+    const static int        ShapeMinLevel       = -3;
+    const static int        ShapeMaxLevel       = 4;
+    const static int        ShapeLevelCount     = ShapeMaxLevel - ShapeMinLevel + 1;
+    const static uint32_t   ShapeMeshMemoryCap  = 512*1024;
+
+    class ShapeMesh;
+    typedef std::unique_ptr<ShapeMesh> ShapeMeshPtr;
+
+    // triangles of all fill styles tessellated at one level of detail,
+    // followed by the triangles of strokes of each line style. each range
+    // is welded and reordered for vertex cache once it is created.
+    struct ShapeMesh
+    {
+        VertexPackList  vertices;
+        IndexList       indices;
+        OffsetList      vertices_size;
+        OffsetList      indices_size;
+        uint32_t        last_used;
+        MeshStats       stats;
+
+        static ShapeMeshPtr create(const ShapeRecord& record, const ShapeLineList& lines, int level);
+        uint32_t get_memsize() const;
     };
 
     struct Shape : public ICharacter
@@ -80,15 +194,19 @@ namespace openswf
         Rect            bounds;
         ShapeFillList   fill_styles;
         ShapeLineList   line_styles;
+        ShapeRecordPtr  record;
 
-        VertexPackList  vertices;
-        IndexList       indices;
-        IndexList       vertices_size;
-        IndexList       indices_size;
+        // meshes are tessellated on demand, and the least recently used
+        // ones are released when they take more than ShapeMeshMemoryCap.
+        ShapeMeshPtr    meshes[ShapeLevelCount];
+        uint32_t        mesh_memsize;
+        uint32_t        mesh_tick;
 
         bool initialize(uint16_t, ShapeFillList&&, ShapeLineList&&, ShapeRecordPtr);
         static Shape* create(uint16_t, ShapeFillList&&, ShapeLineList&&, ShapeRecordPtr);
 
+        ShapeMesh* get_mesh(int level);
+
         virtual void     set_player(Player* env);
         virtual uint16_t get_character_id() const;
         virtual INode*   create_instance();
@@ -103,7 +221,7 @@ namespace openswf
         ShapeNode(Player* env, Shape* shape);
 
         virtual void update(float dt);
-        virtual void render(const Matrix& matrix, const ColorTransform& cxform);
+        virtual void render(RenderContext& context, const Matrix& matrix, const ColorTransform& cxform);
     };
 
     struct MorphShape : public ICharacter
@@ -113,7 +231,7 @@ namespace openswf
         ShapeLineList   line_styles;
         ShapeRecordPtr  start;
         ShapeRecordPtr  end;
-        PointList       interp;
+        ShapeRecord     interp;
 
         static MorphShape* create(uint16_t, ShapeFillList&&, ShapeLineList&&, ShapeRecordPtr, ShapeRecordPtr);
 
@@ -121,11 +239,11 @@ namespace openswf
         virtual uint16_t get_character_id() const;
         virtual INode*   create_instance();
 
-        void tesselate(uint16_t ratio,
+        void tesselate(uint16_t ratio, int level,
             VertexPackList& out_vertices,
-            IndexList& out_vertices_size,
+            OffsetList& out_vertices_size,
             IndexList& out_indices,
-            IndexList& out_indices_size);
+            OffsetList& out_indices_size);
     };
 
     class MorphShapeNode : public INode
@@ -133,16 +251,17 @@ namespace openswf
     protected:
         MorphShape*     m_morph_shape;
         uint16_t        m_current_ratio;
+        int             m_current_level;
         VertexPackList  m_vertices;
-        IndexList       m_vertices_size;
+        OffsetList      m_vertices_size;
         IndexList       m_indices;
-        IndexList       m_indices_size;
+        OffsetList      m_indices_size;
 
     public:
         MorphShapeNode(Player* env, MorphShape* shape);
 
         virtual void update(float dt);
-        virtual void render(const Matrix& matrix, const ColorTransform& cxform);
+        virtual void render(RenderContext& context, const Matrix& matrix, const ColorTransform& cxform);
 
         void tesselate();
     };
@@ -0,0 +1,135 @@
+#include "snapshot.hpp"
+#include "render_software.hpp"
+#include "render_context.hpp"
+#include "shader.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+extern "C" {
+    #include "zlib.h"
+}
+
+namespace openswf
+{
+    Snapshot::Snapshot()
+    : m_context(nullptr)
+    {}
+
+    Snapshot* Snapshot::create(int threads)
+    {
+        auto snapshot = new (std::nothrow) Snapshot();
+        if( snapshot && snapshot->initialize(threads) )
+            return snapshot;
+
+        if( snapshot ) delete snapshot;
+        return nullptr;
+    }
+
+    bool Snapshot::initialize(int threads)
+    {
+        m_context = RenderContext::create(SoftwareRender::create(threads), 1.f, 1.f);
+        return m_context != nullptr;
+    }
+
+    Snapshot::~Snapshot()
+    {
+        if( m_context ) delete m_context;
+    }
+
+    BitmapRGBA8::Ptr Snapshot::render(Player& player, uint16_t frame, int width, int height)
+    {
+        if( width <= 0 || height <= 0 )
+            return nullptr;
+
+        auto bitmap = BitmapRGBA8::create(width, height);
+        if( bitmap == nullptr )
+            return nullptr;
+
+        player.goto_frame(frame);
+
+        auto& render = m_context->get_render();
+        auto& shader = m_context->get_shader();
+
+        auto stage = player.get_size();
+        stage.to_pixel();
+        auto stage_width  = std::max(stage.get_width(), 1.f);
+        auto stage_height = std::max(stage.get_height(), 1.f);
+        m_context->get_screen().set_design_resolution(stage_width, stage_height);
+
+        // framebuffer grows with the first viewport, background covers all of it
+        auto scale = std::min(width / stage_width, height / stage_height);
+        auto vw = std::max((int)std::round(stage_width*scale), 1);
+        auto vh = std::max((int)std::round(stage_height*scale), 1);
+        render.set_viewport(0, 0, width, height);
+        render.set_viewport((width-vw)/2, (height-vh)/2, vw, vh);
+
+        shader.set_program(PROGRAM_DEFAULT);
+        player.render(*m_context);
+        shader.end_frame();
+
+        render.read_pixels(0, 0, width, height, bitmap->get_ptr());
+        return bitmap;
+    }
+
+    /// PNG ENCODING
+    static void write_uint32(std::vector<uint8_t>& out, uint32_t value)
+    {
+        out.push_back((uint8_t)(value >> 24));
+        out.push_back((uint8_t)(value >> 16));
+        out.push_back((uint8_t)(value >> 8));
+        out.push_back((uint8_t)value);
+    }
+
+    static void write_chunk(std::vector<uint8_t>& out, const char* type, const uint8_t* data, uint32_t size)
+    {
+        write_uint32(out, size);
+        auto start = out.size();
+        out.insert(out.end(), type, type+4);
+        out.insert(out.end(), data, data+size);
+        // crc covers the chunk type and data
+        write_uint32(out, (uint32_t)crc32(0, out.data()+start, (uInt)(size+4)));
+    }
+
+    bool Snapshot::encode_png(const BitmapRGBA8& bitmap, std::vector<uint8_t>& out)
+    {
+        const uint8_t signature[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+        auto width = bitmap.get_width(), height = bitmap.get_height();
+        auto stride = width*4;
+
+        // each row is prefixed with filter type 1 (sub), which stores the
+        // difference with the pixel on the left.
+        std::vector<uint8_t> filtered((stride+1)*height);
+        auto source = bitmap.get_ptr();
+        for( uint32_t y=0; y<height; y++ )
+        {
+            auto row = source + y*stride;
+            auto dst = filtered.data() + y*(stride+1);
+            dst[0] = 1;
+            for( uint32_t x=0; x<stride; x++ )
+                dst[x+1] = (uint8_t)(row[x] - (x >= 4 ? row[x-4] : 0));
+        }
+
+        auto compressed_size = compressBound((uLong)filtered.size());
+        std::vector<uint8_t> compressed(compressed_size);
+        if( compress2(compressed.data(), &compressed_size,
+            filtered.data(), (uLong)filtered.size(), Z_DEFAULT_COMPRESSION) != Z_OK )
+            return false;
+
+        std::vector<uint8_t> header;
+        write_uint32(header, width);
+        write_uint32(header, height);
+        header.push_back(8); // bit depth
+        header.push_back(6); // color type of rgba
+        header.push_back(0); // deflate
+        header.push_back(0); // adaptive filtering
+        header.push_back(0); // no interlace
+
+        out.clear();
+        out.insert(out.end(), signature, signature+8);
+        write_chunk(out, "IHDR", header.data(), (uint32_t)header.size());
+        write_chunk(out, "IDAT", compressed.data(), (uint32_t)compressed_size);
+        write_chunk(out, "IEND", nullptr, 0);
+        return true;
+    }
+}
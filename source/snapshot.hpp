@@ -0,0 +1,36 @@
+#pragma once
+
+#include "image.hpp"
+#include "player.hpp"
+
+#include <vector>
+
+namespace openswf
+{
+    class RenderContext;
+
+    // an offscreen target which renders frames of players into rgba bitmaps,
+    // with a render context of software render. snapshots could run in parallel
+    // with one per thread, players should be deleted before the snapshot they
+    // are rendered with. Parser::initialize should be called before loading
+    // any player.
+    class Snapshot
+    {
+    protected:
+        RenderContext*  m_context;
+
+        Snapshot();
+        bool initialize(int threads);
+
+    public:
+        static Snapshot* create(int threads = 1);
+        ~Snapshot();
+
+        // advances player to frame, then renders the stage with aspect ratio
+        // kept in the center of bitmap. rows are stored from the top.
+        BitmapRGBA8::Ptr render(Player& player, uint16_t frame, int width, int height);
+
+        // encodes bitmap as a png of 8-bit rgba.
+        static bool encode_png(const BitmapRGBA8& bitmap, std::vector<uint8_t>& out);
+    };
+}
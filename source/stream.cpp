@@ -203,11 +203,12 @@ Rect Stream::read_rect()
 {
     align();
     auto bitcount = read_bits_as_uint32(5); 
-    auto rect = Rect(
-        read_bits_as_int32(bitcount),   // x_min
-        read_bits_as_int32(bitcount),   // x_max
-        read_bits_as_int32(bitcount),   // y_min
-        read_bits_as_int32(bitcount));  // y_max
+    // fields are read one by one, the evaluation order of arguments is unspecified
+    auto x_min = read_bits_as_int32(bitcount);
+    auto x_max = read_bits_as_int32(bitcount);
+    auto y_min = read_bits_as_int32(bitcount);
+    auto y_max = read_bits_as_int32(bitcount);
+    auto rect = Rect(x_min, x_max, y_min, y_max);
     align();
     return rect;
 }
\ No newline at end of file
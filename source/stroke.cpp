@@ -0,0 +1,202 @@
+#include <cmath>
+#include <algorithm>
+
+#include "stroke.hpp"
+
+namespace openswf
+{
+    const static float PI = 3.14159265f;
+    const static float MIN_ROUND_STEP = PI / 64.f;
+    const static float MAX_ROUND_STEP = PI / 2.f;
+
+    static Point2f normalize(const Point2f& v)
+    {
+        float length = std::sqrt(v.x*v.x + v.y*v.y);
+        return length > 0.f ? v * (1.f/length) : Point2f();
+    }
+
+    static Point2f perpendicular(const Point2f& v)
+    {
+        return Point2f(-v.y, v.x);
+    }
+
+    static float cross(const Point2f& a, const Point2f& b)
+    {
+        return a.x*b.y - a.y*b.x;
+    }
+
+    static float dot(const Point2f& a, const Point2f& b)
+    {
+        return a.x*b.x + a.y*b.y;
+    }
+
+    Stroker::Stroker(const StrokeStyle& style,
+        std::vector<VertexPack>& vertices, std::vector<uint32_t>& indices)
+    : m_style(style), m_vertices(vertices), m_indices(indices)
+    {
+        m_half_width = std::max(style.width, 1.f) * 0.5f;
+        m_base = vertices.size();
+
+        // the largest angle whose arc deviates less than tolerance from its chord
+        auto ratio = 1.f - style.tolerance / m_half_width;
+        m_round_step = ratio > -1.f ? 2.f*std::acos(ratio) : MAX_ROUND_STEP;
+        m_round_step = std::min(std::max(m_round_step, MIN_ROUND_STEP), MAX_ROUND_STEP);
+    }
+
+    uint32_t Stroker::add_vertex(const Point2f& position)
+    {
+        auto pixel = position;
+        m_vertices.push_back(VertexPack(pixel.to_pixel(), Point2f()));
+        return (uint32_t)(m_vertices.size() - 1 - m_base);
+    }
+
+    void Stroker::add_triangle(const Point2f& a, const Point2f& b, const Point2f& c)
+    {
+        m_indices.push_back(add_vertex(a));
+        m_indices.push_back(add_vertex(b));
+        m_indices.push_back(add_vertex(c));
+    }
+
+    // a triangle fan sweeping the offset 'from' around center by angle
+    void Stroker::add_fan(const Point2f& center, const Point2f& from, float angle)
+    {
+        auto steps = std::max((int)std::ceil(std::abs(angle) / m_round_step), 1);
+        auto step = angle / (float)steps;
+        auto c = std::cos(step), s = std::sin(step);
+
+        auto center_index = add_vertex(center);
+        auto offset = from;
+        auto last = add_vertex(center + offset);
+        for( auto i=0; i<steps; i++ )
+        {
+            offset = Point2f(offset.x*c - offset.y*s, offset.x*s + offset.y*c);
+            auto next = add_vertex(center + offset);
+
+            m_indices.push_back(center_index);
+            m_indices.push_back(last);
+            m_indices.push_back(next);
+            last = next;
+        }
+    }
+
+    void Stroker::add_segment(const Point2f& from, const Point2f& to)
+    {
+        auto normal = perpendicular(normalize(to - from)) * m_half_width;
+
+        auto a = add_vertex(from + normal);
+        auto b = add_vertex(from - normal);
+        auto c = add_vertex(to + normal);
+        auto d = add_vertex(to - normal);
+
+        uint32_t quad[] = { a, b, c, b, d, c };
+        m_indices.insert(m_indices.end(), quad, quad+6);
+    }
+
+    // direction is the unit vector pointing out of the end of line
+    void Stroker::add_cap(const Point2f& point, const Point2f& direction, Capcode cap)
+    {
+        auto normal = perpendicular(direction) * m_half_width;
+        if( cap == Capcode::ROUND )
+            add_fan(point, normal, -PI);
+        else if( cap == Capcode::SQUARE )
+        {
+            auto extent = direction * m_half_width;
+            add_triangle(point + normal, point - normal, point - normal + extent);
+            add_triangle(point + normal, point - normal + extent, point + normal + extent);
+        }
+    }
+
+    // fills the gap on the outer side of a corner, in and out are unit
+    // directions of the segments before and after the corner.
+    void Stroker::add_join(const Point2f& point, const Point2f& in, const Point2f& out)
+    {
+        auto turn = cross(in, out);
+        if( std::abs(turn) < 1e-6f && dot(in, out) > 0.f )
+            return;
+
+        auto side = turn > 0.f ? -m_half_width : m_half_width;
+        auto from = perpendicular(in) * side;
+        auto to = perpendicular(out) * side;
+
+        if( m_style.join == Joincode::ROUND )
+        {
+            add_fan(point, from, std::atan2(cross(from, to), dot(from, to)));
+            return;
+        }
+
+        if( m_style.join == Joincode::MITER )
+        {
+            auto miter = normalize(from + to);
+            auto cosine = dot(miter, from) / m_half_width;
+            if( cosine > 1e-6f && 1.f / cosine <= m_style.miter_limit )
+            {
+                auto tip = point + miter * (m_half_width / cosine);
+                add_triangle(point, point + from, tip);
+                add_triangle(point, tip, point + to);
+                return;
+            }
+        }
+
+        // bevel, or a miter exceeds its limit
+        add_triangle(point, point + from, point + to);
+    }
+
+    void Stroker::add_polyline(const Point2f* points, uint32_t count, bool closable)
+    {
+        m_points.clear();
+        for( auto i=0; i<count; i++ )
+        {
+            if( m_points.empty() || !(m_points.back() == points[i]) )
+                m_points.push_back(points[i]);
+        }
+
+        auto closed = false;
+        if( closable && m_points.size() > 3 && m_points.back() == m_points.front() )
+        {
+            m_points.pop_back();
+            closed = true;
+        }
+
+        if( m_points.empty() )
+            return;
+
+        // a single point is drawn as its caps
+        if( m_points.size() == 1 )
+        {
+            auto point = m_points[0];
+            if( m_style.start_cap == Capcode::ROUND )
+                add_fan(point, Point2f(m_half_width, 0), 2.f*PI);
+            else if( m_style.start_cap == Capcode::SQUARE )
+            {
+                auto h = m_half_width;
+                add_triangle(point + Point2f(-h, -h), point + Point2f(h, -h), point + Point2f(h, h));
+                add_triangle(point + Point2f(-h, -h), point + Point2f(h, h), point + Point2f(-h, h));
+            }
+            return;
+        }
+
+        auto size = m_points.size();
+        auto segments = closed ? size : size - 1;
+        for( auto i=0; i<segments; i++ )
+            add_segment(m_points[i], m_points[(i+1)%size]);
+
+        auto direction = [&](uint32_t from)
+        {
+            return normalize(m_points[(from+1)%size] - m_points[from]);
+        };
+
+        for( auto i=1; i<size-1; i++ )
+            add_join(m_points[i], direction(i-1), direction(i));
+
+        if( closed )
+        {
+            add_join(m_points[size-1], direction(size-2), direction(size-1));
+            add_join(m_points[0], direction(size-1), direction(0));
+        }
+        else
+        {
+            add_cap(m_points[0], direction(0) * -1.f, m_style.start_cap);
+            add_cap(m_points[size-1], direction(size-2), m_style.end_cap);
+        }
+    }
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "types.hpp"
+#include "shader.hpp"
+
+#include <vector>
+
+namespace openswf
+{
+    enum class Capcode : uint8_t {
+        ROUND = 0,
+        NO = 1,
+        SQUARE = 2,
+    };
+
+    enum class Joincode : uint8_t {
+        ROUND = 0,
+        BEVEL = 1,
+        MITER = 2,
+    };
+
+    // geometry of a stroke, lengths are in twips. the miter limit is
+    // the maximum ratio of miter length to half of the stroke width.
+    struct StrokeStyle
+    {
+        float       width;
+        float       miter_limit;
+        float       tolerance;
+        Capcode     start_cap, end_cap;
+        Joincode    join;
+
+        StrokeStyle()
+        : width(PIXEL_TO_TWIPS), miter_limit(3.f), tolerance(4.f),
+        start_cap(Capcode::ROUND), end_cap(Capcode::ROUND), join(Joincode::ROUND) {}
+    };
+
+    // expands polylines into triangles with caps and joins, the output
+    // positions are in pixels as the tessellated fills. indices are relative
+    // to the first vertex generated by this stroker.
+    class Stroker
+    {
+    protected:
+        StrokeStyle                 m_style;
+        float                       m_half_width;
+        float                       m_round_step;
+        uint32_t                    m_base;
+        std::vector<VertexPack>&    m_vertices;
+        std::vector<uint32_t>&      m_indices;
+        std::vector<Point2f>        m_points;
+
+        uint32_t add_vertex(const Point2f& position);
+        void add_triangle(const Point2f& a, const Point2f& b, const Point2f& c);
+        void add_fan(const Point2f& center, const Point2f& from, float angle);
+        void add_segment(const Point2f& from, const Point2f& to);
+        void add_cap(const Point2f& point, const Point2f& direction, Capcode cap);
+        void add_join(const Point2f& point, const Point2f& in, const Point2f& out);
+
+    public:
+        Stroker(const StrokeStyle& style,
+            std::vector<VertexPack>& vertices, std::vector<uint32_t>& indices);
+
+        // a polyline which ends where it starts is joined there instead of capped,
+        // unless it is not closable.
+        void add_polyline(const Point2f* points, uint32_t count, bool closable = true);
+    };
+}
@@ -106,7 +106,7 @@ namespace openswf
         return std::move(bitmap);
     }
 
-    static Image* create_image(Stream& stream, TagHeader& header, uint16_t cid, uint32_t size)
+    static BitmapPtr decode_image(Stream& stream, const TagHeader& header, uint32_t size)
     {
         auto start_pos = stream.get_position();
         auto byte1 = stream.read_uint8();
@@ -126,8 +126,7 @@ namespace openswf
 
             stream.set_position(start_pos);
             auto alpha = header.end_pos - start_pos - size;
-            auto bitmap = create_jpeg(stream.get_current_ptr(), size, alpha);
-            return Image::create(cid, std::move(bitmap));
+            return create_jpeg(stream.get_current_ptr(), size, alpha);
         }
         else if( byte1 == 0x89 )
         {
@@ -155,27 +154,65 @@ namespace openswf
         return nullptr;
     }
 
-    void Parser::DefineBitsJPEG2(Environment& env)
+    static BitmapPtr decode_bits_lossless(Stream& stream, const TagHeader& header);
+    static BitmapPtr decode_bits_lossless2(Stream& stream, const TagHeader& header);
+
+    // bytes start with the character id, positions are relative to them
+    BitmapPtr Parser::decode_bitmap(const TagHeader& header, const uint8_t* bytes)
     {
+        auto stream = Stream(bytes, header.size);
+        auto local = header;
+        local.end_pos = header.size;
+
+        stream.read_uint16(); // character id
+        switch( header.code )
+        {
+        case TagCode::DEFINE_BITS_JPEG2:
+            return decode_image(stream, local, header.size - 2);
+        case TagCode::DEFINE_BITS_JPEG3:
+        {
+            auto size = stream.read_uint32();
+            return decode_image(stream, local, size);
+        }
+        case TagCode::DEFINE_BITS_LOSSLESS:
+            return decode_bits_lossless(stream, local);
+        case TagCode::DEFINE_BITS_LOSSLESS2:
+            return decode_bits_lossless2(stream, local);
+        default:
+            return nullptr;
+        }
+    }
+
+    // images of a player which releases pixels keep a copy of their tags
+    static void define_bitmap(Environment& env)
+    {
+        auto bytes = env.stream.get_current_ptr();
         auto cid = env.stream.read_uint16();
-        auto size = env.tag.end_pos - env.stream.get_position();
-        auto image = create_image(env.stream, env.tag, cid, size);
-        if( image != nullptr )
-            env.player.set_character(image->get_character_id(), image);
+        auto image = Image::create(cid, Parser::decode_bitmap(env.tag, bytes));
+        if( image == nullptr )
+            return;
+
+        if( env.player.get_bitmap_retention() == BitmapRetention::RELEASE )
+        {
+            env.stream.set_position(env.tag.end_pos - env.tag.size);
+            image->set_source(env.tag, env.stream.extract(env.tag.size), &Parser::decode_bitmap);
+        }
+
+        env.player.set_character(cid, image);
+    }
+
+    void Parser::DefineBitsJPEG2(Environment& env)
+    {
+        define_bitmap(env);
     }
 
     void Parser::DefineBitsJPEG3(Environment& env)
     {
-        auto cid = env.stream.read_uint16();
-        auto size = env.stream.read_uint32();
-        auto image = create_image(env.stream, env.tag, cid, size);
-        if( image != nullptr )
-            env.player.set_character(image->get_character_id(), image);
+        define_bitmap(env);
     }
 
-    static Image* create_bits_lossless(Stream& stream, TagHeader& header)
+    static BitmapPtr decode_bits_lossless(Stream& stream, const TagHeader& header)
     {
-        auto cid = stream.read_uint16();
         auto format = (BitmapFormat)stream.read_uint8();
         auto width = stream.read_uint16();
         auto height = stream.read_uint16();
@@ -196,7 +233,7 @@ namespace openswf
                     bitmap->set(i, j, bytes.get()+base);
                 }
 
-            return Image::create(cid, std::move(bitmap));
+            return std::move(bitmap);
         }
         else if( format == BitmapFormat::RGB15)
         {
@@ -208,7 +245,7 @@ namespace openswf
                 for( auto j=0; j<width; j++ )
                     bitmap->get(i, j).cast_from_1555();
 
-            return Image::create(cid, std::move(bitmap));
+            return std::move(bitmap);
         }
         else if( format == BitmapFormat::RGB24 )
         {
@@ -216,7 +253,7 @@ namespace openswf
             auto bitmap = BitmapRGB8::create(width, height);
             decompress(stream.get_current_ptr(), src_size, bitmap->get_ptr(), bitmap->get_size());
 
-            return Image::create(cid, std::move(bitmap));
+            return std::move(bitmap);
         }
 
         return nullptr;
@@ -224,14 +261,11 @@ namespace openswf
 
     void Parser::DefineBitsLossless(Environment& env)
     {
-        auto image = create_bits_lossless(env.stream, env.tag);
-        if( image != nullptr )
-            env.player.set_character(image->get_character_id(), image);
+        define_bitmap(env);
     }
 
-    static Image* create_bits_lossless2(Stream& stream, TagHeader& header)
+    static BitmapPtr decode_bits_lossless2(Stream& stream, const TagHeader& header)
     {
-        auto cid = stream.read_uint16();
         auto format = (BitmapFormat)stream.read_uint8();
         auto width = stream.read_uint16();
         auto height = stream.read_uint16();
@@ -252,7 +286,7 @@ namespace openswf
                     bitmap->set(i, j, bytes.get()+base);
                 }
 
-            return Image::create(cid, std::move(bitmap));
+            return std::move(bitmap);
         }
         else if( format == BitmapFormat::RGB15 || format == BitmapFormat::RGB24 )
         {
@@ -264,7 +298,7 @@ namespace openswf
                 for( int j=0; j<width; j++ )
                     bitmap->get(i, j).cast_from_argb();
 
-            return Image::create(cid, std::move(bitmap));
+            return std::move(bitmap);
         }
 
         return nullptr;
@@ -272,8 +306,6 @@ namespace openswf
 
     void Parser::DefineBitsLossless2(Environment& env)
     {
-        auto image = create_bits_lossless2(env.stream, env.tag);
-        if( image != nullptr )
-            env.player.set_character(image->get_character_id(), image);
+        define_bitmap(env);
     }
 }
\ No newline at end of file
@@ -9,9 +9,6 @@
 namespace openswf
 {
     // TAG: 2, 22, 32, 83 DEFINE SHAPE
-    const uint32_t  MAX_CURVE_SUBDIVIDE = 10;
-    const float     CURVE_TOLERANCE     = 4.f;
-
     enum class StyleMode : uint8_t
     {
         SOLID                           = 0x00,
@@ -51,55 +48,6 @@ namespace openswf
         RESERVED_2  = 3
     };
 
-    enum class Capcode : uint8_t {
-        ROUND = 0,
-        NO = 1,
-        SQUARE = 2,
-    };
-
-    enum class Joincode : uint8_t {
-        ROUND = 0,
-        BEVEL = 1,
-        MITER = 2,
-    };
-
-    struct ShapeEdge
-    {
-        ShapeEdge(const Point2f& anchor)
-            : control(anchor), anchor(anchor) {}
-
-        ShapeEdge(int32_t ax, int32_t ay, int32_t cx, int32_t cy)
-            : control(Point2f(cx, cy)), anchor(Point2f(ax, ay)){}
-
-        Point2f control, anchor;
-    };
-
-    struct ShapePath
-    {
-        uint32_t                left_fill;
-        uint32_t                right_fill;
-        uint32_t                line;
-
-        Point2f                 start;
-        std::vector<ShapeEdge>  edges;
-
-        ShapePath() : left_fill(0), right_fill(0), line(0) {}
-        void reset()
-        {
-            left_fill = right_fill = 0;
-            line = 0;
-        }
-
-        void restart(const Point2f& cursor)
-        {
-            start.x = cursor.x;
-            start.y = cursor.y;
-            edges.clear();
-        }
-    };
-
-    typedef std::vector<ShapePath> ShapePathList;
-
     struct GradientPoint
     {
         int     ratio;
@@ -213,6 +161,11 @@ namespace openswf
         }
     };
 
+    static bool is_repeating(StyleMode type)
+    {
+        return type == StyleMode::REPEATING_BITMAP || type == StyleMode::NON_SMOOTHED_REPEATING_BITMAP;
+    }
+
     static ShapeFillPtr read_fill_style(Stream& stream, TagCode tag)
     {
         auto type = (StyleMode)stream.read_uint8();
@@ -242,7 +195,7 @@ namespace openswf
         {
             auto cid = stream.read_uint16();
             auto transform = stream.read_matrix().to_pixel();
-            return ShapeFill::create(cid, transform);
+            return ShapeFill::create(cid, transform, is_repeating(type));
         }
         else
             assert(false);
@@ -277,40 +230,65 @@ namespace openswf
             auto cid = stream.read_uint16();
             auto start_matrix = stream.read_matrix().to_pixel();
             auto end_matrix = stream.read_matrix().to_pixel();
-            return ShapeFill::create(cid, start_matrix, end_matrix);
+            return ShapeFill::create(cid, start_matrix, end_matrix, is_repeating(type));
         }
         else
             assert(false);
     }
 
-    static ShapeLinePtr read_line_style(Stream& stream, TagCode type)
+    // the flags and miter limit of LINESTYLE2 and MORPHLINESTYLE2
+    struct LineStyle2
     {
-        auto width = stream.read_uint16() * TWIPS_TO_PIXEL;
+        Capcode     start_cap, end_cap;
+        Joincode    join;
+        float       miter_limit;
+        bool        has_fill;
+        bool        no_close;
 
-        if( type == TagCode::DEFINE_SHAPE4 )
-        {   // line style 2
-            stream.read_bits_as_uint32(2); // Start Capcode
-            auto join = (Joincode)stream.read_bits_as_uint32(2); // Joincode
-            auto has_fill = stream.read_bits_as_uint32(1);
+        static LineStyle2 read(Stream& stream)
+        {
+            LineStyle2 style;
+            style.start_cap = (Capcode)stream.read_bits_as_uint32(2);
+            style.join = (Joincode)stream.read_bits_as_uint32(2);
+            style.has_fill = stream.read_bits_as_uint32(1) > 0;
             stream.read_bits_as_uint32(1); // no_hscale
             stream.read_bits_as_uint32(1); // no_vscale
             stream.read_bits_as_uint32(1); // pixel_hinting
 
             assert( stream.read_bits_as_uint32(5) == 0 ); //reserved bits
 
-            stream.read_bits_as_uint32(1); // no_close
-            stream.read_bits_as_uint32(2); // End Capcode
+            style.no_close = stream.read_bits_as_uint32(1) > 0;
+            style.end_cap = (Capcode)stream.read_bits_as_uint32(2);
 
-            if( join == Joincode::MITER )
-                stream.read_uint16(); // miter limit factor
+            // the miter limit factor is a 8.8 fixed value
+            style.miter_limit = 3.f;
+            if( style.join == Joincode::MITER )
+                style.miter_limit = (float)stream.read_uint16() / 256.f;
 
-            if( has_fill )
+            return style;
+        }
+    };
+
+    static ShapeLinePtr read_line_style(Stream& stream, TagCode type)
+    {
+        auto width = stream.read_uint16();
+
+        if( type == TagCode::DEFINE_SHAPE4 )
+        {   // line style 2
+            auto style = LineStyle2::read(stream);
+
+            // only the color of solid fill is used by strokes
+            auto color = Color::empty;
+            if( style.has_fill )
             {
-                read_fill_style(stream, type); // fill style
-                return ShapeLine::create(width, Color::empty);
+                auto fill = read_fill_style(stream, type);
+                if( fill != nullptr ) color = fill->get_additive_color();
             }
             else
-                return ShapeLine::create(width, stream.read_rgba());
+                color = stream.read_rgba();
+
+            return ShapeLine::create(width, width, color, color,
+                style.start_cap, style.end_cap, style.join, style.miter_limit, style.no_close);
         }
         else
         {   // line style
@@ -323,42 +301,37 @@ namespace openswf
 
     static ShapeLinePtr read_morph_line_style(Stream& stream, TagCode type)
     {
+        auto width_start = stream.read_uint16();
+        auto width_end = stream.read_uint16();
+
         if( type == TagCode::DEFINE_MORPH_SHAPE )
         {
-            return ShapeLine::create(
-                stream.read_uint16() * TWIPS_TO_PIXEL,
-                stream.read_uint16() * TWIPS_TO_PIXEL,
-                stream.read_rgba(),
-                stream.read_rgba());
+            auto color_start = stream.read_rgba();
+            auto color_end = stream.read_rgba();
+            return ShapeLine::create(width_start, width_end, color_start, color_end);
         }
         else
         {
-            auto width_start = stream.read_uint16();
-            auto width_end = stream.read_uint16();
+            auto style = LineStyle2::read(stream);
 
-            stream.read_bits_as_uint32(2); // Start Capcode
-            auto join = (Joincode)stream.read_bits_as_uint32(2); // Joincode
-            auto has_fill = stream.read_bits_as_uint32(1);
-            stream.read_bits_as_uint32(1); // no_hscale
-            stream.read_bits_as_uint32(1); // no_vscale
-            stream.read_bits_as_uint32(1); // pixel_hinting
-
-            assert( stream.read_bits_as_uint32(5) == 0 ); //reserved bits
-
-            stream.read_bits_as_uint32(1); // no_close
-            stream.read_bits_as_uint32(2); // End Capcode
-
-            if( join == Joincode::MITER )
-                stream.read_uint16(); // miter limit factor
-
-            if( has_fill )
+            auto color_start = Color::empty, color_end = Color::empty;
+            if( style.has_fill )
             {
-                read_morph_line_style(stream, type);
-                return ShapeLine::create(width_start, width_end, Color::empty, Color::empty);
+                auto fill = read_morph_fill_style(stream, type);
+                if( fill != nullptr )
+                {
+                    color_start = fill->get_additive_color(0);
+                    color_end = fill->get_additive_color(65535);
+                }
             }
             else
-                return ShapeLine::create(width_start, width_end,
-                    stream.read_rgba(), stream.read_rgba());
+            {
+                color_start = stream.read_rgba();
+                color_end = stream.read_rgba();
+            }
+
+            return ShapeLine::create(width_start, width_end, color_start, color_end,
+                style.start_cap, style.end_cap, style.join, style.miter_limit, style.no_close);
         }
     }
 
@@ -402,90 +375,6 @@ namespace openswf
         }
     }
 
-    typedef std::vector<Point2f>    Segments;
-    typedef std::vector<Segments>   Contours;
-
-    static void contour_add_curve(Segments& segments, const Point2f& prev, const Point2f& ctrl, const Point2f& next, int depth = 0)
-    {
-        Point2f mid = (prev + next) * 0.5f;
-        Point2f q = (mid + ctrl) * 0.5f;
-
-        float dist = std::abs((mid.x - q.x)) + std::abs(mid.y - q.y);
-        if( dist < CURVE_TOLERANCE || depth >= MAX_CURVE_SUBDIVIDE )
-            segments.push_back(next);
-        else
-        {
-            // subdivide
-            contour_add_curve(segments, prev, (prev + ctrl) * 0.5f, q, depth + 1);
-            contour_add_curve(segments, q, (ctrl + next) * 0.5f, next, depth + 1);
-        }
-    }
-
-    static bool contour_merge_segments(Contours& contours, Segments& next)
-    {
-        for( auto& segments : contours )
-        {
-            if(segments.front() == next.back())
-            {
-                next.pop_back();
-
-                next.reserve(next.size() + segments.size());
-                next.insert(next.end(), segments.begin(), segments.end());
-                segments = std::move(next);
-                return true;
-            }
-            else if(segments.back() == next.front())
-            {
-                segments.pop_back();
-
-                segments.reserve(segments.size() + next.size());
-                segments.insert(segments.end(), next.begin(), next.end());
-                return true;
-            }
-            else if(segments.back() == next.back())
-            {
-                next.pop_back();
-                std::reverse(next.begin(), next.end());
-
-                segments.reserve(next.size() + segments.size());
-                segments.insert(segments.end(), next.begin(), next.end());
-                return true;
-            }
-            else if(segments.front() == next.front())
-            {
-                std::reverse(next.begin(), next.end());
-                next.pop_back();
-
-                next.reserve(next.size() + segments.size());
-                next.insert(next.end(), segments.begin(), segments.end());
-                segments = std::move(next);
-                return true;
-            }
-        }
-        return false;
-    }
-
-    static void contour_push_path(Contours& contours, const ShapePath& path)
-    {
-        Segments segments;
-        segments.reserve(path.edges.size() + 1);
-        segments.push_back(path.start);
-
-        Point2f last = path.start;
-        for( auto& edge : path.edges )
-        {
-            if( edge.control == edge.anchor )
-                segments.push_back(edge.anchor);
-            else
-                contour_add_curve(segments, last, edge.control, edge.anchor);
-
-            last = edge.anchor;
-        }
-
-        contours.push_back(std::move(segments));
-        // if( !contour_merge_segments(contours, segments) )
-    }
-
     static ShapePathList read_shape_path(Stream& stream,
         ShapeFillList& fill_styles, ShapeLineList& line_styles, TagCode type)
     {
@@ -616,58 +505,7 @@ namespace openswf
     static ShapeRecordPtr create_shape_record(const ShapePathList& paths, const Rect& bounds,
         ShapeFillList& fill_styles, ShapeLineList& line_styles, TagCode type)
     {
-        auto mesh_set = std::vector<Contours>(fill_styles.size(), Contours());
-
-        for( auto& path : paths )
-        {
-            assert( path.edges.size() != 0 );
-            
-            if( path.left_fill > 0 )
-                contour_push_path( mesh_set[path.left_fill-1], path );
-
-            if( path.right_fill > 0 )
-                contour_push_path( mesh_set[path.right_fill-1], path );
-        }
-
-        int numv = 0;
-        for( int i=mesh_set.size()-1; i>=0; i-- )
-        {
-            auto& mesh = mesh_set[i];
-            if( mesh.size() == 0 )
-            {
-                fill_styles.erase(fill_styles.begin()+i);
-                mesh_set.erase(mesh_set.begin()+i);
-                continue;
-            }
-
-            for(;;)
-            {
-                if( mesh.size() == 1 ||
-                    !contour_merge_segments(mesh, mesh.back()) )
-                {
-                    break;
-                }
-                mesh.pop_back();
-            }
-
-            assert(mesh.size() == 1);
-            numv += mesh[0].size();
-        }
-
-        auto vertices = std::vector<Point2f>();
-        auto contour_indices = std::vector<uint16_t>();
-
-        vertices.reserve(numv);
-        contour_indices.reserve(mesh_set.size());
-        for( auto& mesh : mesh_set )
-        {
-            vertices.insert(vertices.end(), mesh[0].begin(), mesh[0].end());
-            contour_indices.push_back(vertices.size());
-        }
-
-        assert( contour_indices.size() == fill_styles.size() );
-
-        return ShapeRecord::create(bounds, std::move(vertices), std::move(contour_indices));
+        return ShapeRecord::create(bounds, paths, fill_styles.size(), line_styles.size());
     }
 
     static Shape* create_shape(Stream& stream, TagCode type)
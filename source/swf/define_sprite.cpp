@@ -75,7 +75,8 @@ namespace openswf
     {
         env.frame.actions.push_back(FrameAction::create(
             env.tag,
-            env.stream.extract(env.tag.size)));
+            env.stream.extract(env.tag.size),
+            env.movie->m_frames.size()+1));
     }
 
     void Parser::ShowFrame(Environment& env)
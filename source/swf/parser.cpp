@@ -3,6 +3,7 @@
 #include "stream.hpp"
 
 #include <unordered_map>
+#include <mutex>
 
 namespace openswf
 {
@@ -27,10 +28,13 @@ namespace openswf
 
     typedef std::function<void(Environment&)> TagHandler;
     static std::unordered_map<uint32_t, TagHandler> s_handlers;
+    static std::mutex s_handlers_mutex;
 
+    // it's safe to initialize several times, from several threads
     bool Parser::initialize()
     {
-        assert( s_handlers.size() == 0 );
+        std::lock_guard<std::mutex> guard(s_handlers_mutex);
+        if( s_handlers.size() != 0 ) return true;
 
         s_handlers[(uint32_t)TagCode::SET_BACKGROUND_COLOR]   = SetBackgroundColor;
         s_handlers[(uint32_t)TagCode::PROTECT]                = Protect;
@@ -34,6 +34,9 @@ namespace openswf
         static bool         execute(Environment& env);
         static const char*  to_string(TagCode);
 
+        // decodes pixels of a bitmap tag again, see BitmapDecoder
+        static BitmapPtr    decode_bitmap(const TagHeader& header, const uint8_t* bytes);
+
     protected:
         /// ----------------------------------------------------------------------------
         /// GENERIC CONTROL TAGS
@@ -1,4 +1,5 @@
 #include <algorithm>
+#include <cmath>
 
 #include "types.hpp"
 
@@ -83,6 +84,16 @@ namespace openswf
         );
     }
 
+    float Matrix::get_max_scale() const
+    {
+        // largest singular value of the 2x2 linear part
+        float a = values[0][0], b = values[0][1], c = values[1][0], d = values[1][1];
+        float e = a*a + b*b + c*c + d*d;
+        float det = a*d - b*c;
+        float disc = std::max(e*e - 4.f*det*det, 0.f);
+        return std::sqrt((e + std::sqrt(disc)) * 0.5f);
+    }
+
     Matrix Matrix::lerp(const Matrix& lh, const Matrix& rh, float ratio)
     {
         float fixed = clamp(ratio, 0.f, 1.f);
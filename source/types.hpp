@@ -119,6 +119,11 @@ namespace openswf
             return Point<T>(this->x + rh.x, this->y + rh.y);
         }
 
+        Point<T> operator - (const Point<T>& rh) const
+        {
+            return Point<T>(this->x - rh.x, this->y - rh.y);
+        }
+
         Point<T> operator * (T factor) const
         {
             return Point<T>(this->x*factor, this->y*factor);
@@ -285,6 +290,9 @@ namespace openswf
         Matrix operator * (const Matrix& rh) const;
         Point2f operator * (const Point2f& rh) const;
 
+        // the largest stretch of a unit vector by the linear part
+        float get_max_scale() const;
+
         static Matrix lerp(const Matrix& lh, const Matrix& rh, float ratio);
         const static Matrix identity;
     };
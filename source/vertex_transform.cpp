@@ -0,0 +1,308 @@
+#include "vertex_transform.hpp"
+
+#include <cstring>
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define OPENSWF_SSE2
+#include <emmintrin.h>
+#endif
+
+// avx2 kernels are compiled for their own functions only, and picked if the
+// cpu supports them at runtime.
+#if defined(OPENSWF_SSE2) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define OPENSWF_AVX2
+#define OPENSWF_TARGET_AVX2 __attribute__((target("avx2")))
+#include <immintrin.h>
+#endif
+
+namespace openswf
+{
+    struct TransformKernels
+    {
+        void (*transform)(int size, VertexPack* vertices, const Matrix& matrix);
+        void (*translate)(int size, VertexPack* vertices, float tx, float ty);
+        void (*colorize)(int size, VertexPack* vertices, const ColorTransform& cxform);
+    };
+
+    /// SCALAR KERNELS
+    static void transform_positions_scalar(int size, VertexPack* vertices, const Matrix& matrix)
+    {
+        for( auto i=0; i<size; i++ )
+            vertices[i].position = matrix*vertices[i].position;
+    }
+
+    static void translate_positions_scalar(int size, VertexPack* vertices, float tx, float ty)
+    {
+        for( auto i=0; i<size; i++ )
+        {
+            vertices[i].position.x += tx;
+            vertices[i].position.y += ty;
+        }
+    }
+
+    static void colorize_scalar(int size, VertexPack* vertices, const ColorTransform& cxform)
+    {
+        for( auto i=0; i<size; i++ )
+            vertices[i].diffuse = cxform*vertices[i].diffuse;
+    }
+
+    /// SSE2 KERNELS
+    // positions of two vertices are processed in one register as [x0 y0 x1 y1],
+    // colors are processed per vertex and packed back four at a time.
+#ifdef OPENSWF_SSE2
+    static inline __m128 load_positions(const VertexPack* vertices)
+    {
+        auto lo = _mm_loadl_pi(_mm_setzero_ps(), (const __m64*)&vertices[0].position);
+        return _mm_loadh_pi(lo, (const __m64*)&vertices[1].position);
+    }
+
+    static inline void store_positions(VertexPack* vertices, __m128 positions)
+    {
+        _mm_storel_pi((__m64*)&vertices[0].position, positions);
+        _mm_storeh_pi((__m64*)&vertices[1].position, positions);
+    }
+
+    static inline uint32_t load_color(const Color& color)
+    {
+        uint32_t pixel;
+        memcpy(&pixel, &color.r, sizeof(pixel));
+        return pixel;
+    }
+
+    static inline void store_color(Color& color, int pixel)
+    {
+        memcpy(&color.r, &pixel, sizeof(pixel));
+    }
+
+    static void transform_positions_sse2(int size, VertexPack* vertices, const Matrix& matrix)
+    {
+        auto mx = _mm_setr_ps(matrix.values[0][0], matrix.values[1][0], matrix.values[0][0], matrix.values[1][0]);
+        auto my = _mm_setr_ps(matrix.values[0][1], matrix.values[1][1], matrix.values[0][1], matrix.values[1][1]);
+        auto mt = _mm_setr_ps(matrix.values[0][2], matrix.values[1][2], matrix.values[0][2], matrix.values[1][2]);
+
+        auto i = 0;
+        for( ; i+2<=size; i+=2 )
+        {
+            auto p = load_positions(vertices+i);
+            auto xs = _mm_shuffle_ps(p, p, _MM_SHUFFLE(2, 2, 0, 0));
+            auto ys = _mm_shuffle_ps(p, p, _MM_SHUFFLE(3, 3, 1, 1));
+            // same order of operations as Matrix*Point2f
+            store_positions(vertices+i, _mm_add_ps(_mm_add_ps(_mm_mul_ps(xs, mx), _mm_mul_ps(ys, my)), mt));
+        }
+
+        transform_positions_scalar(size-i, vertices+i, matrix);
+    }
+
+    static void translate_positions_sse2(int size, VertexPack* vertices, float tx, float ty)
+    {
+        auto mt = _mm_setr_ps(tx, ty, tx, ty);
+
+        auto i = 0;
+        for( ; i+2<=size; i+=2 )
+            store_positions(vertices+i, _mm_add_ps(load_positions(vertices+i), mt));
+
+        translate_positions_scalar(size-i, vertices+i, tx, ty);
+    }
+
+    static inline __m128i colorize_sse2(uint32_t pixel, __m128 mult, __m128 add)
+    {
+        auto zero = _mm_setzero_si128();
+        auto bytes = _mm_cvtsi32_si128((int)pixel);
+        auto ints = _mm_unpacklo_epi16(_mm_unpacklo_epi8(bytes, zero), zero);
+
+        auto color = _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(ints), mult), add);
+        color = _mm_max_ps(_mm_min_ps(color, _mm_set1_ps(255.f)), _mm_setzero_ps());
+        return _mm_cvttps_epi32(color);
+    }
+
+    static void colorize_sse2(int size, VertexPack* vertices, const ColorTransform& cxform)
+    {
+        auto mult = _mm_loadu_ps(cxform.values[0]);
+        auto add = _mm_loadu_ps(cxform.values[1]);
+
+        auto i = 0;
+        for( ; i+4<=size; i+=4 )
+        {
+            auto lo = _mm_packs_epi32(
+                colorize_sse2(load_color(vertices[i].diffuse), mult, add),
+                colorize_sse2(load_color(vertices[i+1].diffuse), mult, add));
+            auto hi = _mm_packs_epi32(
+                colorize_sse2(load_color(vertices[i+2].diffuse), mult, add),
+                colorize_sse2(load_color(vertices[i+3].diffuse), mult, add));
+            auto bytes = _mm_packus_epi16(lo, hi);
+
+            store_color(vertices[i].diffuse, _mm_cvtsi128_si32(bytes));
+            store_color(vertices[i+1].diffuse, _mm_cvtsi128_si32(_mm_srli_si128(bytes, 4)));
+            store_color(vertices[i+2].diffuse, _mm_cvtsi128_si32(_mm_srli_si128(bytes, 8)));
+            store_color(vertices[i+3].diffuse, _mm_cvtsi128_si32(_mm_srli_si128(bytes, 12)));
+        }
+
+        colorize_scalar(size-i, vertices+i, cxform);
+    }
+#endif
+
+    /// AVX2 KERNELS
+    // twice the width of sse2 ones: four positions or two colors a register.
+#ifdef OPENSWF_AVX2
+    OPENSWF_TARGET_AVX2 static inline __m256 load_positions_avx2(const VertexPack* vertices)
+    {
+        return _mm256_insertf128_ps(
+            _mm256_castps128_ps256(load_positions(vertices)), load_positions(vertices+2), 1);
+    }
+
+    OPENSWF_TARGET_AVX2 static inline void store_positions_avx2(VertexPack* vertices, __m256 positions)
+    {
+        store_positions(vertices, _mm256_castps256_ps128(positions));
+        store_positions(vertices+2, _mm256_extractf128_ps(positions, 1));
+    }
+
+    OPENSWF_TARGET_AVX2 static void transform_positions_avx2(int size, VertexPack* vertices, const Matrix& matrix)
+    {
+        auto a = matrix.values[0][0], b = matrix.values[0][1], tx = matrix.values[0][2];
+        auto c = matrix.values[1][0], d = matrix.values[1][1], ty = matrix.values[1][2];
+        auto mx = _mm256_setr_ps(a, c, a, c, a, c, a, c);
+        auto my = _mm256_setr_ps(b, d, b, d, b, d, b, d);
+        auto mt = _mm256_setr_ps(tx, ty, tx, ty, tx, ty, tx, ty);
+
+        auto i = 0;
+        for( ; i+4<=size; i+=4 )
+        {
+            auto p = load_positions_avx2(vertices+i);
+            auto xs = _mm256_moveldup_ps(p);
+            auto ys = _mm256_movehdup_ps(p);
+            store_positions_avx2(vertices+i,
+                _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(xs, mx), _mm256_mul_ps(ys, my)), mt));
+        }
+
+        transform_positions_sse2(size-i, vertices+i, matrix);
+    }
+
+    OPENSWF_TARGET_AVX2 static void translate_positions_avx2(int size, VertexPack* vertices, float tx, float ty)
+    {
+        auto mt = _mm256_setr_ps(tx, ty, tx, ty, tx, ty, tx, ty);
+
+        auto i = 0;
+        for( ; i+4<=size; i+=4 )
+            store_positions_avx2(vertices+i, _mm256_add_ps(load_positions_avx2(vertices+i), mt));
+
+        translate_positions_sse2(size-i, vertices+i, tx, ty);
+    }
+
+    OPENSWF_TARGET_AVX2 static inline __m256i colorize_avx2(uint32_t p0, uint32_t p1, __m256 mult, __m256 add)
+    {
+        auto bytes = _mm_unpacklo_epi32(_mm_cvtsi32_si128((int)p0), _mm_cvtsi32_si128((int)p1));
+        auto ints = _mm256_cvtepu8_epi32(bytes);
+
+        auto color = _mm256_add_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(ints), mult), add);
+        color = _mm256_max_ps(_mm256_min_ps(color, _mm256_set1_ps(255.f)), _mm256_setzero_ps());
+        return _mm256_cvttps_epi32(color);
+    }
+
+    OPENSWF_TARGET_AVX2 static void colorize_avx2(int size, VertexPack* vertices, const ColorTransform& cxform)
+    {
+        auto mult4 = _mm_loadu_ps(cxform.values[0]);
+        auto add4 = _mm_loadu_ps(cxform.values[1]);
+        auto mult = _mm256_insertf128_ps(_mm256_castps128_ps256(mult4), mult4, 1);
+        auto add = _mm256_insertf128_ps(_mm256_castps128_ps256(add4), add4, 1);
+
+        auto i = 0;
+        for( ; i+4<=size; i+=4 )
+        {
+            auto c01 = colorize_avx2(load_color(vertices[i].diffuse), load_color(vertices[i+1].diffuse), mult, add);
+            auto c23 = colorize_avx2(load_color(vertices[i+2].diffuse), load_color(vertices[i+3].diffuse), mult, add);
+
+            // packing works in 128-bit lanes: [c0 c2 c0 c2 | c1 c3 c1 c3]
+            auto words = _mm256_packs_epi32(c01, c23);
+            auto bytes = _mm256_packus_epi16(words, words);
+            auto lo = _mm256_castsi256_si128(bytes);
+            auto hi = _mm256_extracti128_si256(bytes, 1);
+
+            store_color(vertices[i].diffuse, _mm_cvtsi128_si32(lo));
+            store_color(vertices[i+1].diffuse, _mm_cvtsi128_si32(hi));
+            store_color(vertices[i+2].diffuse, _mm_cvtsi128_si32(_mm_srli_si128(lo, 4)));
+            store_color(vertices[i+3].diffuse, _mm_cvtsi128_si32(_mm_srli_si128(hi, 4)));
+        }
+
+        colorize_sse2(size-i, vertices+i, cxform);
+    }
+#endif
+
+    /// DISPATCH
+    // levels not compiled fall back to the best lower one
+    static const TransformKernels s_kernels[] =
+    {
+        { transform_positions_scalar, translate_positions_scalar, colorize_scalar },
+#ifdef OPENSWF_SSE2
+        { transform_positions_sse2, translate_positions_sse2, colorize_sse2 },
+#else
+        { transform_positions_scalar, translate_positions_scalar, colorize_scalar },
+#endif
+#ifdef OPENSWF_AVX2
+        { transform_positions_avx2, translate_positions_avx2, colorize_avx2 },
+#elif defined(OPENSWF_SSE2)
+        { transform_positions_sse2, translate_positions_sse2, colorize_sse2 },
+#else
+        { transform_positions_scalar, translate_positions_scalar, colorize_scalar },
+#endif
+    };
+
+    static SimdLevel detect_simd_level()
+    {
+#ifdef OPENSWF_AVX2
+        __builtin_cpu_init();
+        if( __builtin_cpu_supports("avx2") )
+            return SimdLevel::AVX2;
+#endif
+
+#ifdef OPENSWF_SSE2
+        return SimdLevel::SSE2;
+#else
+        return SimdLevel::SCALAR;
+#endif
+    }
+
+    SimdLevel get_simd_level()
+    {
+        static const SimdLevel level = detect_simd_level();
+        return level;
+    }
+
+    static bool is_identity(const ColorTransform& cxform)
+    {
+        for( auto i=0; i<4; i++ )
+        {
+            if( cxform.values[0][i] != 1.f || cxform.values[1][i] != 0.f )
+                return false;
+        }
+        return true;
+    }
+
+    void transform_vertices(int size, VertexPack* vertices,
+        const Matrix& matrix, const ColorTransform& cxform)
+    {
+        transform_vertices(size, vertices, matrix, cxform, get_simd_level());
+    }
+
+    void transform_vertices(int size, VertexPack* vertices,
+        const Matrix& matrix, const ColorTransform& cxform, SimdLevel level)
+    {
+        if( size <= 0 )
+            return;
+
+        auto& kernels = s_kernels[(int)std::min(level, get_simd_level())];
+
+        // most of nodes are placed by translation only, and not colored
+        auto& m = matrix.values;
+        if( m[0][0] == 1.f && m[0][1] == 0.f && m[1][0] == 0.f && m[1][1] == 1.f )
+        {
+            if( m[0][2] != 0.f || m[1][2] != 0.f )
+                kernels.translate(size, vertices, m[0][2], m[1][2]);
+        }
+        else
+            kernels.transform(size, vertices, matrix);
+
+        if( !is_identity(cxform) )
+            kernels.colorize(size, vertices, cxform);
+    }
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "shader.hpp"
+
+namespace openswf
+{
+    enum class SimdLevel : uint8_t
+    {
+        SCALAR = 0,
+        SSE2,
+        AVX2,
+    };
+
+    // the best level supported by both the build and the cpu, detected once.
+    SimdLevel get_simd_level();
+
+    // transforms positions by matrix and diffuse colors by cxform in place.
+    // vertices are processed in groups with kernels of the detected level, or
+    // of the given one for comparisons, which falls back to a lower level if
+    // it's not supported. results of all kernels are identical.
+    void transform_vertices(int size, VertexPack* vertices,
+        const Matrix& matrix, const ColorTransform& cxform);
+    void transform_vertices(int size, VertexPack* vertices,
+        const Matrix& matrix, const ColorTransform& cxform, SimdLevel level);
+}
@@ -42,3 +42,119 @@ TagHeader get_tag_at(Stream& stream, uint32_t pos)
     return TagHeader::read(stream);
 }
 
+
+/// ACTION WRITER
+void ActionWriter::write_uint16(uint16_t value)
+{
+    m_bytes.push_back(value & 0xFF);
+    m_bytes.push_back(value >> 8);
+}
+
+void ActionWriter::write_uint32(uint32_t value)
+{
+    write_uint16(value & 0xFFFF);
+    write_uint16(value >> 16);
+}
+
+ActionWriter& ActionWriter::op(avm::Opcode code)
+{
+    assert( (uint8_t)code < 0x80 );
+    m_bytes.push_back((uint8_t)code);
+    return *this;
+}
+
+ActionWriter& ActionWriter::constants(const std::vector<const char*>& strings)
+{
+    m_bytes.push_back((uint8_t)avm::Opcode::CONSTANT_POOL);
+    auto size = 2;
+    for( auto str : strings )
+        size += strlen(str) + 1;
+
+    write_uint16(size);
+    write_uint16(strings.size());
+    for( auto str : strings )
+        m_bytes.insert(m_bytes.end(), str, str + strlen(str) + 1);
+    return *this;
+}
+
+ActionWriter& ActionWriter::begin_push()
+{
+    m_bytes.push_back((uint8_t)avm::Opcode::PUSH);
+    m_push = m_bytes.size();
+    write_uint16(0);
+    return *this;
+}
+
+ActionWriter& ActionWriter::push_string(const char* str)
+{
+    m_bytes.push_back(0);
+    m_bytes.insert(m_bytes.end(), str, str + strlen(str) + 1);
+    return *this;
+}
+
+ActionWriter& ActionWriter::push_integer(int32_t value)
+{
+    m_bytes.push_back(7);
+    write_uint32(value);
+    return *this;
+}
+
+ActionWriter& ActionWriter::push_double(double value)
+{
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    // the high word is stored first
+    m_bytes.push_back(6);
+    write_uint32(bits >> 32);
+    write_uint32(bits & 0xFFFFFFFF);
+    return *this;
+}
+
+ActionWriter& ActionWriter::push_constant(uint8_t index)
+{
+    m_bytes.push_back(8);
+    m_bytes.push_back(index);
+    return *this;
+}
+
+ActionWriter& ActionWriter::end_push()
+{
+    assert( m_push >= 0 );
+    auto size = m_bytes.size() - m_push - 2;
+    m_bytes[m_push] = size & 0xFF;
+    m_bytes[m_push+1] = size >> 8;
+    m_push = -1;
+    return *this;
+}
+
+int ActionWriter::label() const
+{
+    return m_bytes.size();
+}
+
+int ActionWriter::jump(avm::Opcode code, int target)
+{
+    m_bytes.push_back((uint8_t)code);
+    write_uint16(2);
+
+    auto offset = m_bytes.size();
+    write_uint16(0);
+    if( target >= 0 )
+        patch(offset, target);
+    return offset;
+}
+
+void ActionWriter::patch(int jump, int target)
+{
+    // offsets are relative to the record after jump
+    auto offset = (int16_t)(target - (jump + 2));
+    m_bytes[jump] = (uint16_t)offset & 0xFF;
+    m_bytes[jump+1] = (uint16_t)offset >> 8;
+}
+
+const std::vector<uint8_t>& ActionWriter::finish()
+{
+    m_bytes.push_back((uint8_t)avm::Opcode::END);
+    return m_bytes;
+}
@@ -1,5 +1,41 @@
 #pragma once
 #include "openswf.hpp"
+#include "avm/opcode.hpp"
+
+#include <vector>
 
 openswf::Stream             create_from_file(const char* path);
 openswf::TagHeader  get_tag_at(openswf::Stream&, uint32_t pos);
+
+// assembles action records of avm bytecode, a push record is opened with
+// begin_push and sized once closed. jumps are patched to labels later.
+class ActionWriter
+{
+protected:
+    std::vector<uint8_t>    m_bytes;
+    int                     m_push;
+
+    void write_uint16(uint16_t);
+    void write_uint32(uint32_t);
+
+public:
+    ActionWriter() : m_push(-1) {}
+
+    ActionWriter& op(openswf::avm::Opcode code);
+    ActionWriter& constants(const std::vector<const char*>& strings);
+
+    ActionWriter& begin_push();
+    ActionWriter& push_string(const char* str);
+    ActionWriter& push_integer(int32_t value);
+    ActionWriter& push_double(double value);
+    ActionWriter& push_constant(uint8_t index);
+    ActionWriter& end_push();
+
+    // returns the position of the next record
+    int  label() const;
+    // returns the position of the offset to patch
+    int  jump(openswf::avm::Opcode code, int target = -1);
+    void patch(int jump, int target);
+
+    const std::vector<uint8_t>& finish();
+};
@@ -0,0 +1,233 @@
+#include "openswf_test.hpp"
+#include "render_software.hpp"
+#include "atlas.hpp"
+
+#include <memory>
+
+using namespace openswf;
+
+// a linear gradient of 64 texels from black to color
+static BitmapPtr create_linear_gradient(const Color& color)
+{
+    auto bitmap = BitmapRGBA8::create(GradientPageWidth, 1);
+    for( auto i=0; i<GradientPageWidth; i++ )
+        bitmap->set(0, i, Color::lerp(Color::black, color, (float)i/(GradientPageWidth-1)));
+    return bitmap;
+}
+
+TEST_CASE("GRADIENT_ATLAS", "[OPENSWF]")
+{
+    // textures of atlas are released before the render
+    std::unique_ptr<SoftwareRender> render(SoftwareRender::create(1));
+    std::unique_ptr<GradientAtlas> atlas(GradientAtlas::create());
+
+    auto red = create_linear_gradient(Color(255, 0, 0, 255));
+    auto green = create_linear_gradient(Color(0, 255, 0, 255));
+    auto radial = BitmapRGBA8::create(16, 16);
+    memset(radial->get_ptr(), 128, radial->get_size());
+
+    // identical gradients share a row, linear ones share a page
+    auto a = atlas->insert(*red);
+    auto b = atlas->insert(*green);
+    auto c = atlas->insert(*red);
+    auto d = atlas->insert(*radial);
+    REQUIRE( a.page == 0 );
+    REQUIRE( b.page == 0 );
+    REQUIRE( c.page == a.page );
+    REQUIRE( c.row == a.row );
+    REQUIRE( a.row != b.row );
+    REQUIRE( d.page == 1 );
+    REQUIRE( d.row < 0.f );
+
+    auto& stats = atlas->get_stats();
+    REQUIRE( stats.fills == 4 );
+    REQUIRE( stats.gradients == 3 );
+    REQUIRE( stats.pages == 2 );
+
+    // a page is recreated if rows are inserted after uploading
+    auto rid = atlas->get_texture_rid(a.page, *render);
+    REQUIRE( rid != 0 );
+    REQUIRE( atlas->get_texture_rid(a.page, *render) == rid );
+    atlas->insert(*create_linear_gradient(Color(0, 0, 255, 255)));
+    REQUIRE( atlas->get_texture_rid(a.page, *render) != 0 );
+    REQUIRE( atlas->get_texture_rid(5, *render) == 0 );
+
+    // sampling a row is the same as sampling a texture of the gradient
+    const int width = 64, height = 4;
+    std::unique_ptr<Screen> screen(Screen::create(width, height));
+    std::unique_ptr<Shader> shader(Shader::create(*render, *screen));
+
+    const char* textures[] = { "texture0" };
+    const char* uniforms[] = { "transform" };
+    shader->create(PROGRAM_DEFAULT, "", "", 1, textures, 1, uniforms);
+    render->set_viewport(0, 0, width, height);
+
+    auto draw_frame = [&](Rid texture, float v, std::vector<uint8_t>& pixels)
+    {
+        VertexPack quad[4] = {
+            VertexPack(0, 0, -0.25f, v), VertexPack(width, 0, 1.25f, v),
+            VertexPack(width, height, 1.25f, v), VertexPack(0, height, -0.25f, v) };
+
+        render->clear(CLEAR_COLOR, 0, 0, 0, 255);
+        shader->set_program(PROGRAM_DEFAULT);
+        shader->set_texture(0, texture);
+        shader->draw(quad[0], quad[1], quad[2], quad[3]);
+        shader->end_frame();
+
+        pixels.resize(width*height*4);
+        render->read_pixels(0, 0, width, height, pixels.data());
+    };
+
+    auto single = render->create_texture(green->get_ptr(), GradientPageWidth, 1, TextureFormat::RGBA8, 0);
+    std::vector<uint8_t> expected, pixels;
+    draw_frame(single, 0.5f, expected);
+    draw_frame(atlas->get_texture_rid(b.page, *render), b.row, pixels);
+
+    // ends are clamped to the first and last texels of row
+    REQUIRE( expected[1] == 0 );
+    REQUIRE( expected[(width-1)*4+1] == 255 );
+    for( auto i=0; i<expected.size(); i++ )
+        REQUIRE( std::abs((int)pixels[i] - (int)expected[i]) <= 1 );
+
+    render->release(RenderObject::TEXTURE, single);
+}
+
+TEST_CASE("GRADIENT_FILL_ATLAS", "[OPENSWF]")
+{
+    REQUIRE( Parser::initialize() );
+
+    std::unique_ptr<SoftwareRender> render(SoftwareRender::create(1));
+    auto stream = create_from_file("../test/resources/simple-shape-1.swf");
+    std::unique_ptr<Player> player(Player::create(stream));
+    REQUIRE( player != nullptr );
+
+    // fills of identical gradients are drawn with one texture
+    auto first = ShapeFill::create(create_linear_gradient(Color(255, 0, 0, 255)), Matrix::identity);
+    auto second = ShapeFill::create(create_linear_gradient(Color(255, 0, 0, 255)), Matrix::identity);
+    first->attach(player.get());
+    second->attach(player.get());
+
+    auto rid = first->get_bitmap(*render);
+    REQUIRE( rid != 0 );
+    REQUIRE( second->get_bitmap(*render) == rid );
+
+    // u follows the gradient square, v is the row of page
+    auto texcoord = first->get_texcoord(Point2f(0, 0));
+    REQUIRE( texcoord.x == Approx(0.5f) );
+    REQUIRE( texcoord.y == Approx(0.5f / GradientPageRows) );
+    REQUIRE( player->get_gradient_atlas().get_stats().gradients == 1 );
+}
+
+TEST_CASE("SKYLINE_PACKER", "[OPENSWF]")
+{
+    const int size = 256;
+    SkylinePacker packer(size, size);
+    std::vector<Rect> placed;
+
+    // rectangles fit in page without overlapping, until it's full
+    for( auto i=0; i<1000; i++ )
+    {
+        auto width = 8 + (i*37) % 41, height = 8 + (i*53) % 29;
+        auto x = 0, y = 0;
+        if( !packer.insert(width, height, x, y) )
+            break;
+
+        REQUIRE( x >= 0 );
+        REQUIRE( y >= 0 );
+        REQUIRE( x+width <= size );
+        REQUIRE( y+height <= size );
+
+        Rect rect(x, x+width, y, y+height);
+        for( auto& other : placed )
+        {
+            auto apart = rect.xmax <= other.xmin || other.xmax <= rect.xmin ||
+                rect.ymax <= other.ymin || other.ymax <= rect.ymin;
+            REQUIRE( apart );
+        }
+        placed.push_back(rect);
+    }
+
+    auto area = 0.f;
+    for( auto& rect : placed )
+        area += rect.get_width() * rect.get_height();
+    REQUIRE( area > size*size*0.7f );
+}
+
+static Image* create_image(uint16_t cid, int width, int height, const Color& color)
+{
+    auto bitmap = BitmapRGBA8::create(width, height);
+    for( auto i=0; i<height; i++ )
+        for( auto j=0; j<width; j++ )
+            bitmap->set(i, j, Color::lerp(color, Color::black, (float)j/width));
+    return Image::create(cid, std::move(bitmap));
+}
+
+TEST_CASE("IMAGE_ATLAS", "[OPENSWF]")
+{
+    std::unique_ptr<SoftwareRender> render(SoftwareRender::create(1));
+    std::unique_ptr<ImageAtlas> atlas(ImageAtlas::create());
+
+    std::unique_ptr<Image> red(create_image(1, 16, 8, Color(255, 0, 0, 255)));
+    std::unique_ptr<Image> green(create_image(2, 24, 24, Color(0, 255, 0, 255)));
+    std::unique_ptr<Image> tiled(create_image(3, 16, 16, Color(0, 0, 255, 255)));
+    std::unique_ptr<Image> large(create_image(4, ImageMaxSize+1, 4, Color::white));
+    tiled->set_repeating();
+
+    atlas->pack({ red.get(), green.get(), tiled.get(), large.get() });
+    auto& stats = atlas->get_stats();
+    REQUIRE( stats.images == 4 );
+    REQUIRE( stats.packed == 2 );
+    REQUIRE( stats.pages == 1 );
+
+    // small images share a page, the others keep textures of their own
+    auto page = red->get_texture_rid(*render);
+    REQUIRE( green->get_texture_rid(*render) == page );
+    REQUIRE( tiled->get_texture_rid(*render) != page );
+    REQUIRE( large->get_texture_rid(*render) != page );
+    REQUIRE( tiled->get_texcoord(Point2f(2.f, -1.f)).x == Approx(2.f) );
+
+    // texcoords are mapped into the region of image, and clamped
+    auto corner = red->get_texcoord(Point2f(0, 0));
+    auto opposite = red->get_texcoord(Point2f(1.5f, 1));
+    REQUIRE( (opposite.x - corner.x) * ImagePageSize == Approx(16.f) );
+    REQUIRE( opposite.y > corner.y );
+
+    // a packed image is drawn as its own texture, padding clamps the edges
+    const int width = 32, height = 16;
+    std::unique_ptr<Screen> screen(Screen::create(width, height));
+    std::unique_ptr<Shader> shader(Shader::create(*render, *screen));
+
+    const char* textures[] = { "texture0" };
+    const char* uniforms[] = { "transform" };
+    shader->create(PROGRAM_DEFAULT, "", "", 1, textures, 1, uniforms);
+    render->set_viewport(0, 0, width, height);
+
+    auto draw_frame = [&](Rid texture, const Point2f& from, const Point2f& to, std::vector<uint8_t>& pixels)
+    {
+        VertexPack quad[4] = {
+            VertexPack(0, 0, from.x, from.y), VertexPack(width, 0, to.x, from.y),
+            VertexPack(width, height, to.x, to.y), VertexPack(0, height, from.x, to.y) };
+
+        render->clear(CLEAR_COLOR, 0, 0, 0, 255);
+        shader->set_program(PROGRAM_DEFAULT);
+        shader->set_texture(0, texture);
+        shader->draw(quad[0], quad[1], quad[2], quad[3]);
+        shader->end_frame();
+
+        pixels.resize(width*height*4);
+        render->read_pixels(0, 0, width, height, pixels.data());
+    };
+
+    auto& bitmap = red->get_bitmap();
+    auto single = render->create_texture(bitmap.get_ptr(), bitmap.get_width(), bitmap.get_height(), bitmap.get_format(), 0);
+
+    std::vector<uint8_t> expected, pixels;
+    draw_frame(single, Point2f(0, 0), Point2f(1, 1), expected);
+    draw_frame(page, red->get_texcoord(Point2f(0, 0)), red->get_texcoord(Point2f(1, 1)), pixels);
+
+    REQUIRE( expected[0] == 255 );
+    for( auto i=0; i<expected.size(); i++ )
+        REQUIRE( std::abs((int)pixels[i] - (int)expected[i]) <= 1 );
+
+    render->release(RenderObject::TEXTURE, single);
+}
@@ -0,0 +1,567 @@
+#include "openswf_test.hpp"
+#include "avm/virtual_machine.hpp"
+#include "avm/bytecode.hpp"
+#include "avm/string_object.hpp"
+#include "avm/heap.hpp"
+#include "avm/slab.hpp"
+#include "avm/shape.hpp"
+#include "avm/profiler.hpp"
+
+#include <cmath>
+#include <limits>
+#include <memory>
+
+using namespace openswf;
+using namespace openswf::avm;
+
+// scripts are executed on the root context of a movie
+static std::unique_ptr<Player> create_player()
+{
+    Parser::initialize();
+    auto stream = create_from_file("../test/resources/simple-timeline-1.swf");
+    return std::unique_ptr<Player>(Player::create(stream));
+}
+
+static void execute(Player& player, const std::vector<uint8_t>& bytes)
+{
+    auto& vm = player.get_virtual_machine();
+    vm.execute(player.get_root().get_context(), bytes.data(), bytes.size());
+}
+
+TEST_CASE("AVM_DISPATCH", "[OPENSWF]")
+{
+    auto player = create_player();
+    auto context = player->get_root().get_context();
+    REQUIRE( context != nullptr );
+
+    // a counter loop of backward jumps, until i is not less than 10
+    ActionWriter writer;
+    writer.constants({ "i", "sum" });
+    writer.begin_push().push_constant(0).push_integer(0).end_push().op(Opcode::SET_VARIABLE);
+    writer.begin_push().push_constant(1).push_integer(0).end_push().op(Opcode::SET_VARIABLE);
+
+    auto loop = writer.label();
+    writer.begin_push().push_constant(0).end_push().op(Opcode::GET_VARIABLE);
+    writer.begin_push().push_integer(10).end_push().op(Opcode::LESS).op(Opcode::NOT);
+    auto exit = writer.jump(Opcode::IF);
+
+    writer.begin_push().push_constant(1).push_constant(1).end_push().op(Opcode::GET_VARIABLE);
+    writer.begin_push().push_constant(0).end_push().op(Opcode::GET_VARIABLE);
+    writer.op(Opcode::ADD).op(Opcode::SET_VARIABLE);
+    writer.begin_push().push_constant(0).push_constant(0).end_push().op(Opcode::GET_VARIABLE);
+    writer.begin_push().push_integer(1).end_push().op(Opcode::ADD).op(Opcode::SET_VARIABLE);
+    writer.jump(Opcode::JUMP, loop);
+    writer.patch(exit, writer.label());
+
+    // records without handlers are skipped by their length
+    writer.op((Opcode)0x30);
+    writer.begin_push().push_string("tail").push_double(2.5).end_push().op(Opcode::SET_VARIABLE);
+
+    execute(*player, writer.finish());
+    REQUIRE( context->get_variable("i").to_integer() == 10 );
+    REQUIRE( context->get_variable("sum").to_integer() == 45 );
+    REQUIRE( context->get_variable("tail").to_number() == Approx(2.5) );
+
+    // a jump out of the block ends it
+    ActionWriter out;
+    out.begin_push().push_string("j").push_integer(1).end_push().op(Opcode::SET_VARIABLE);
+    out.jump(Opcode::JUMP, 1000);
+    out.begin_push().push_string("j").push_integer(2).end_push().op(Opcode::SET_VARIABLE);
+
+    execute(*player, out.finish());
+    REQUIRE( context->get_variable("j").to_integer() == 1 );
+}
+
+TEST_CASE("AVM_BYTECODE", "[OPENSWF]")
+{
+    ActionWriter writer;
+    writer.constants({ "a", "b" });
+    auto start = writer.label();
+    writer.begin_push().push_constant(1).push_string("c").push_double(0.25).end_push();
+    writer.jump(Opcode::JUMP, start);
+    writer.jump(Opcode::IF, start + 1);
+    writer.op(Opcode::POP);
+
+    auto& bytes = writer.finish();
+    std::unique_ptr<Bytecode> bytecode(Bytecode::create(bytes.data(), bytes.size()));
+    REQUIRE( bytecode != nullptr );
+    REQUIRE( bytecode->get_instruction_count() == 6 );
+
+    auto instructions = bytecode->get_instructions();
+    REQUIRE( instructions[0].code == Opcode::CONSTANT_POOL );
+    REQUIRE( instructions[0].count == 2 );
+    REQUIRE( bytecode->get_string(instructions[0].operand+1) == "b" );
+
+    REQUIRE( instructions[1].code == Opcode::PUSH );
+    REQUIRE( instructions[1].count == 3 );
+    auto& constant = bytecode->get_literal(instructions[1].operand);
+    auto& str = bytecode->get_literal(instructions[1].operand+1);
+    auto& number = bytecode->get_literal(instructions[1].operand+2);
+    REQUIRE( constant.code == LiteralCode::CONSTANT );
+    REQUIRE( constant.index == 1 );
+    REQUIRE( str.code == LiteralCode::STRING );
+    REQUIRE( bytecode->get_string(str.index) == "c" );
+    REQUIRE( number.code == LiteralCode::VALUE );
+    REQUIRE( number.value.to_number() == Approx(0.25) );
+
+    // jumps are resolved into instructions, the ones into the middle of a
+    // record go to END
+    REQUIRE( instructions[2].operand == 1 );
+    REQUIRE( instructions[3].operand == 5 );
+    REQUIRE( instructions[5].code == Opcode::END );
+}
+
+TEST_CASE("AVM_STRING_ATOMS", "[OPENSWF]")
+{
+    auto player = create_player();
+    auto& vm = player->get_virtual_machine();
+    auto context = player->get_root().get_context();
+
+    auto& strings = vm.get_strings();
+    auto atom = strings.intern("name");
+    REQUIRE( atom->is_atom() );
+    REQUIRE( strings.intern(std::string("name")) == atom );
+    REQUIRE( strings.find("name") == atom );
+    REQUIRE( strings.find("unknown") == nullptr );
+    REQUIRE( context->get_variable("unknown").get_type() == ValueCode::UNDEFINED );
+
+    // constant pools, string literals and names of variables are atoms, so
+    // running a script again allocates nothing
+    ActionWriter writer;
+    writer.constants({ "first", "second" });
+    writer.begin_push().push_constant(0).push_string("value").end_push().op(Opcode::SET_VARIABLE);
+    writer.begin_push().push_string("second").push_constant(0).end_push().op(Opcode::GET_VARIABLE);
+    writer.op(Opcode::SET_VARIABLE);
+    auto& bytes = writer.finish();
+
+    std::unique_ptr<Bytecode> bytecode(Bytecode::create(bytes.data(), bytes.size()));
+    vm.execute(context, *bytecode);
+    auto atoms = strings.get_count();
+    auto objects = vm.get_object_count();
+
+    for( auto i=0; i<16; i++ )
+        vm.execute(context, *bytecode);
+    REQUIRE( strings.get_count() == atoms );
+    REQUIRE( vm.get_object_count() == objects );
+
+    auto value = context->get_variable("second").to_object<StringObject>();
+    REQUIRE( value == strings.find("value") );
+    REQUIRE( value->to_string() == "value" );
+
+    // names computed at runtime are interned by stores only
+    ActionWriter computed;
+    computed.begin_push().push_integer(12345).end_push().op(Opcode::GET_VARIABLE).op(Opcode::POP);
+    computed.begin_push().push_integer(0).push_integer(678).end_push().op(Opcode::GET_MEMBER).op(Opcode::POP);
+    execute(*player, computed.finish());
+    REQUIRE( strings.get_count() == atoms );
+    REQUIRE( strings.find("12345") == nullptr );
+
+    ActionWriter stored;
+    stored.begin_push().push_integer(12345).push_integer(1).end_push().op(Opcode::SET_VARIABLE);
+    stored.begin_push().push_string("read").push_integer(12345).end_push().op(Opcode::GET_VARIABLE);
+    stored.op(Opcode::SET_VARIABLE);
+    execute(*player, stored.finish());
+    REQUIRE( strings.find("12345") != nullptr );
+    REQUIRE( context->get_variable("read").to_integer() == 1 );
+}
+
+TEST_CASE("AVM_GC", "[OPENSWF]")
+{
+    auto player = create_player();
+    auto& vm = player->get_virtual_machine();
+    auto& heap = vm.get_heap();
+    auto context = player->get_root().get_context();
+    auto next = vm.intern("next");
+
+    // a list of young objects, reachable from root by its head only
+    const int count = 2000;
+    std::vector<ScriptObject*> nodes;
+    for( auto i=0; i<count; i++ )
+        nodes.push_back(vm.new_object<ScriptObject>());
+    for( auto i=0; i<count-1; i++ )
+        nodes[i]->set_variable(next, Value().set_object(nodes[i+1]));
+    context->set_variable("head", Value().set_object(nodes[0]));
+
+    // the first slice promotes the nursery and marks the head of list only
+    heap.step(0.0);
+    REQUIRE( heap.get_phase() == GCPhase::MARK );
+    REQUIRE( heap.get_stats().old_objects == count );
+    REQUIRE( nodes[0]->get_color() == GCColor::BLACK );
+    REQUIRE( nodes[1000]->get_color() == GCColor::WHITE );
+
+    // an object moved while marking is shaded by write barrier, it would be
+    // swept as white otherwise
+    context->set_variable("moved", Value().set_object(nodes[1000]));
+    REQUIRE( nodes[1000]->get_color() == GCColor::GRAY );
+    nodes[999]->set_variable(next, Value());
+    nodes[499]->set_variable(next, Value());
+
+    while( heap.get_phase() != GCPhase::IDLE )
+        heap.step(0.0);
+
+    auto& stats = heap.get_stats();
+    REQUIRE( stats.major_collections == 1 );
+    REQUIRE( stats.old_objects == count - 500 );
+    REQUIRE( stats.freed == 500 );
+
+    auto length = 0;
+    for( auto node = context->get_variable("moved").to_object<ScriptObject>(); node != nullptr;
+        node = node->get_variable(next).to_object<ScriptObject>() )
+        length ++;
+    REQUIRE( length == count - 1000 );
+
+    // young objects stored into old ones are remembered as roots of nursery
+    auto young = vm.new_object<ScriptObject>();
+    vm.new_object<ScriptObject>();
+    auto remembered = stats.remembered;
+    nodes[0]->set_variable(vm.intern("young"), Value().set_object(young));
+    REQUIRE( stats.remembered == remembered + 1 );
+
+    heap.set_nursery_size(1);
+    execute(*player, ActionWriter().finish());
+    REQUIRE( young->get_generation() == GCGeneration::OLD );
+    REQUIRE( stats.young_objects == 0 );
+    REQUIRE( stats.freed == 501 );
+
+    uint32_t pauses = 0;
+    for( auto i=0; i<GCPauseBuckets; i++ )
+        pauses += stats.pauses[i];
+    REQUIRE( pauses >= stats.steps + 1 );
+}
+
+TEST_CASE("AVM_SLAB", "[OPENSWF]")
+{
+    REQUIRE( SlabAllocator::get_class(1) == 0 );
+    REQUIRE( SlabAllocator::get_class(16) == 0 );
+    REQUIRE( SlabAllocator::get_class(17) == 1 );
+    REQUIRE( SlabAllocator::get_class(SlabMaxSize) == SlabClasses-1 );
+    REQUIRE( SlabAllocator::get_class(SlabMaxSize+1) == SlabLarge );
+
+    // slots of a class are contiguous, and freed ones are reused first
+    SlabAllocator slabs;
+    auto index = SlabAllocator::get_class(48);
+    auto a = (uint8_t*)slabs.allocate(index, 48);
+    auto b = (uint8_t*)slabs.allocate(index, 48);
+    REQUIRE( b == a + 48 );
+    slabs.free(a, index);
+    REQUIRE( slabs.allocate(index, 48) == a );
+    REQUIRE( slabs.get_stats().slots == 2 );
+    REQUIRE( slabs.get_stats().pages == 1 );
+
+    auto large = slabs.allocate(SlabLarge, SlabMaxSize+1);
+    REQUIRE( slabs.get_stats().large == 1 );
+    slabs.free(large, SlabLarge);
+    REQUIRE( slabs.get_stats().large == 0 );
+
+    // objects of heap are swept back into slabs, which are not grown again
+    auto player = create_player();
+    auto& vm = player->get_virtual_machine();
+    auto& heap = vm.get_heap();
+    for( auto i=0; i<1000; i++ )
+        vm.new_object<ScriptObject>();
+
+    auto pages = heap.get_slab_stats().pages;
+    REQUIRE( heap.get_slab_stats().slots == 1000 );
+    vm.gabarge_collect();
+    REQUIRE( heap.get_slab_stats().slots == 0 );
+
+    for( auto i=0; i<1000; i++ )
+        vm.new_object<ScriptObject>();
+    REQUIRE( heap.get_slab_stats().pages == pages );
+}
+
+TEST_CASE("AVM_VALUE", "[OPENSWF]")
+{
+    REQUIRE( sizeof(Value) == 8 );
+
+    for( auto number : { 0.0, -0.0, 1.5, -2.25e300, 4.9e-324, std::numeric_limits<double>::infinity() } )
+    {
+        auto value = Value().set_number(number);
+        REQUIRE( value.get_type() == ValueCode::NUMBER );
+        REQUIRE( value.is_double() );
+        REQUIRE( value.get_double() == number );
+    }
+
+    // nans are canonical, so they are never mistaken for tags
+    auto nan = Value().set_number(-std::numeric_limits<double>::quiet_NaN());
+    REQUIRE( nan.get_type() == ValueCode::NUMBER );
+    REQUIRE( std::isnan(nan.to_number()) );
+
+    for( auto integer : { 0, -1, 7, std::numeric_limits<int32_t>::min(), std::numeric_limits<int32_t>::max() } )
+    {
+        auto value = Value().set_integer(integer);
+        REQUIRE( value.get_type() == ValueCode::INTEGER );
+        REQUIRE( !value.is_double() );
+        REQUIRE( value.to_integer() == integer );
+        REQUIRE( value.to_number() == (double)integer );
+    }
+
+    REQUIRE( Value().set_boolean(true).get_type() == ValueCode::BOOLEAN );
+    REQUIRE( Value().set_boolean(true).to_number() == 1.0 );
+    REQUIRE( Value().set_boolean(false).to_string() == "false" );
+    REQUIRE( Value().set_nil().get_type() == ValueCode::NULLPTR );
+    REQUIRE( Value().get_type() == ValueCode::UNDEFINED );
+    REQUIRE( Value().to_number() == 0.0 );
+    REQUIRE( Value().set_object(nullptr).get_type() == ValueCode::NULLPTR );
+
+    StringTable strings;
+    auto atom = strings.intern("atom");
+    auto value = Value().set_object(atom);
+    REQUIRE( value.get_type() == ValueCode::OBJECT );
+    REQUIRE( value.to_object<StringObject>() == atom );
+    REQUIRE( value.to_string() == "atom" );
+    REQUIRE( value.to_number() == 0.0 );
+
+    REQUIRE( Value::are_doubles(Value().set_number(1), Value().set_number(2)) );
+    REQUIRE( !Value::are_doubles(Value().set_number(1), Value().set_integer(2)) );
+}
+
+TEST_CASE("AVM_SHAPES", "[OPENSWF]")
+{
+    auto player = create_player();
+    auto& vm = player->get_virtual_machine();
+    auto context = player->get_root().get_context();
+    auto x = vm.intern("x"), y = vm.intern("y");
+
+    // objects adding the same names in the same order share shapes
+    auto a = vm.new_object<ScriptObject>();
+    auto b = vm.new_object<ScriptObject>();
+    auto c = vm.new_object<ScriptObject>();
+    a->set_variable(x, Value().set_integer(1));
+    a->set_variable(y, Value().set_integer(2));
+    b->set_variable(x, Value().set_integer(3));
+    b->set_variable(y, Value().set_integer(4));
+    c->set_variable(y, Value().set_integer(5));
+    c->set_variable(x, Value().set_integer(6));
+    REQUIRE( a->get_shape() == b->get_shape() );
+    REQUIRE( a->get_shape() != c->get_shape() );
+    REQUIRE( a->get_shape()->find(y) == 1 );
+    REQUIRE( c->get_shape()->find(y) == 0 );
+    REQUIRE( a->get_shape()->find(vm.intern("z")) == -1 );
+
+    // a member read in a loop is cached by its instruction, which is hit by
+    // objects of the same shape and missed by others
+    context->set_variable("a", Value().set_object(a));
+    context->set_variable("b", Value().set_object(b));
+    context->set_variable("c", Value().set_object(c));
+
+    ActionWriter writer;
+    writer.constants({ "sum", "object" });
+    writer.begin_push().push_constant(0).push_integer(0).end_push().op(Opcode::SET_VARIABLE);
+    for( auto name : { "a", "b", "c", "a" } )
+    {
+        writer.begin_push().push_constant(0).push_constant(0).end_push().op(Opcode::GET_VARIABLE);
+        writer.begin_push().push_string(name).end_push().op(Opcode::GET_VARIABLE);
+        writer.begin_push().push_string("y").end_push().op(Opcode::GET_MEMBER);
+        writer.op(Opcode::ADD).op(Opcode::SET_VARIABLE);
+    }
+
+    auto& bytes = writer.finish();
+    std::unique_ptr<Bytecode> bytecode(Bytecode::create(bytes.data(), bytes.size()));
+    vm.execute(context, *bytecode);
+    REQUIRE( context->get_variable("sum").to_integer() == 2+4+5+2 );
+
+    // the member read of each repetition has a cache of its own
+    auto member = 0;
+    for( auto i=0; i<bytecode->get_cache_count(); i++ )
+    {
+        auto& cache = bytecode->get_cache(i);
+        if( cache.name == y )
+            REQUIRE( cache.shape == (member++ == 2 ? c : a)->get_shape() );
+    }
+    REQUIRE( member == 4 );
+
+    // locals of frame scripts are variables of timeline
+    ActionWriter local;
+    local.begin_push().push_string("local").push_integer(7).end_push().op(Opcode::DEFINE_LOCAL);
+    execute(*player, local.finish());
+    REQUIRE( context->get_variable("local").to_integer() == 7 );
+
+    // objects with too many variables become dictionaries
+    auto d = vm.new_object<ScriptObject>();
+    for( uint32_t i=0; i<=MaxShapeSlots; i++ )
+        d->set_variable(vm.intern(("v" + std::to_string(i)).c_str()), Value().set_integer(i));
+    REQUIRE( d->is_dictionary() );
+    REQUIRE( d->get_shape() == nullptr );
+    for( uint32_t i=0; i<=MaxShapeSlots; i++ )
+        REQUIRE( d->get_variable(vm.intern(("v" + std::to_string(i)).c_str())).to_integer() == (int)i );
+}
+
+TEST_CASE("AVM_CONTEXTS", "[OPENSWF]")
+{
+    auto player = create_player();
+    auto& vm = player->get_virtual_machine();
+    auto& heap = vm.get_heap();
+    auto& root = player->get_root();
+
+    const uint16_t cid = 0xFFF0;
+    player->set_character(cid, new MovieClip(cid, 1, 24.f));
+
+    // sprites get contexts once they are asked for
+    auto roots = heap.get_root_count();
+    for( uint16_t depth=0; depth<100; depth++ )
+        REQUIRE( root.set(depth, cid) != nullptr );
+    REQUIRE( heap.get_root_count() == roots );
+
+    auto value = vm.new_object<ScriptObject>();
+    for( uint16_t depth=0; depth<100; depth++ )
+    {
+        auto context = dynamic_cast<MovieNode*>(root.get(depth))->get_context();
+        REQUIRE( context != nullptr );
+        REQUIRE( context == dynamic_cast<MovieNode*>(root.get(depth))->get_context() );
+        context->set_variable("depth", Value().set_integer(depth));
+        context->set_variable("value", Value().set_object(value));
+    }
+    REQUIRE( heap.get_root_count() == roots + 100 );
+
+    // contexts are freed in any order, the others are still traced
+    for( uint16_t depth=0; depth<100; depth+=3 )
+        root.erase(depth);
+    REQUIRE( heap.get_root_count() == roots + 66 );
+
+    vm.gabarge_collect();
+    for( uint16_t depth=1; depth<100; depth++ )
+    {
+        if( depth % 3 == 0 )
+            continue;
+        auto context = dynamic_cast<MovieNode*>(root.get(depth))->get_context();
+        REQUIRE( context->get_variable("depth").to_integer() == depth );
+        REQUIRE( context->get_variable("value").to_object() == value );
+    }
+
+    root.reset();
+    REQUIRE( heap.get_root_count() == roots );
+}
+
+TEST_CASE("AVM_PROFILER", "[OPENSWF]")
+{
+    auto player = create_player();
+    auto& vm = player->get_virtual_machine();
+    auto context = player->get_root().get_context();
+    REQUIRE( vm.get_profiler() == nullptr );
+
+    // a loop of 5 iterations, 12 instructions each
+    ActionWriter writer;
+    writer.constants({ "i" });
+    writer.begin_push().push_constant(0).push_integer(0).end_push().op(Opcode::SET_VARIABLE);
+    auto loop = writer.label();
+    writer.begin_push().push_constant(0).end_push().op(Opcode::GET_VARIABLE);
+    writer.begin_push().push_integer(5).end_push().op(Opcode::LESS).op(Opcode::NOT);
+    auto exit = writer.jump(Opcode::IF);
+    writer.begin_push().push_constant(0).push_constant(0).end_push().op(Opcode::GET_VARIABLE);
+    writer.begin_push().push_integer(1).end_push().op(Opcode::ADD).op(Opcode::SET_VARIABLE);
+    writer.jump(Opcode::JUMP, loop);
+    writer.patch(exit, writer.label());
+
+    auto& bytes = writer.finish();
+    BytecodePtr bytecode(Bytecode::create(bytes.data(), bytes.size()));
+
+    vm.set_profiling(true);
+    auto profiler = vm.get_profiler();
+    REQUIRE( profiler != nullptr );
+
+    vm.execute(context, *bytecode, ActionSite(7, 3));
+    vm.execute(context, *bytecode, ActionSite(7, 3));
+    vm.execute(context, *bytecode);
+    REQUIRE( context->get_variable("i").to_integer() == 5 );
+
+    // 3 + 5 * 12 + 6 instructions by each execution
+    REQUIRE( profiler->get_instruction_count() == 3 * 69 );
+    REQUIRE( profiler->get_opcode(Opcode::JUMP).instructions == 3 * 5 );
+    REQUIRE( profiler->get_opcode(Opcode::IF).instructions == 3 * 6 );
+    REQUIRE( profiler->get_opcode(Opcode::CONSTANT_POOL).instructions == 3 );
+
+    auto& actions = profiler->get_actions();
+    REQUIRE( actions.size() == 2 );
+    REQUIRE( actions[0].site.sprite == 7 );
+    REQUIRE( actions[0].site.frame == 3 );
+    REQUIRE( actions[0].executions == 2 );
+    REQUIRE( actions[0].instructions == 2 * 69 );
+    REQUIRE( actions[1].executions == 1 );
+
+    auto& contexts = profiler->get_contexts();
+    REQUIRE( contexts.size() == 1 );
+    REQUIRE( contexts[0].name == "_level0" );
+    REQUIRE( contexts[0].executions == 3 );
+    REQUIRE( contexts[0].instructions == 3 * 69 );
+
+    // contexts of sprites are kept once freed
+    const uint16_t cid = 0xFFF0;
+    player->set_character(cid, new MovieClip(cid, 1, 24.f));
+    auto sprite = dynamic_cast<MovieNode*>(player->get_root().set(1, cid));
+    sprite->set_name("sprite");
+    vm.execute(sprite->get_context(), *bytecode);
+    player->get_root().erase(1);
+    REQUIRE( contexts.size() == 2 );
+    REQUIRE( contexts[1].name == "sprite" );
+    REQUIRE( contexts[1].freed );
+
+    vm.new_object<ScriptObject>();
+    vm.gabarge_collect();
+    auto gc = profiler->get_gc();
+    REQUIRE( gc.major_collections >= 1 );
+    REQUIRE( gc.allocated_bytes >= sizeof(ScriptObject) );
+
+    auto json = profiler->to_json();
+    for( auto key : { "\"opcodes\"", "\"actions\"", "\"contexts\"", "\"gc\"", "\"name\": \"JUMP\"",
+        "\"sprite\": 7, \"frame\": 3", "\"name\": \"sprite\", \"freed\": true" } )
+        REQUIRE( json.find(key) != std::string::npos );
+
+    profiler->reset();
+    REQUIRE( profiler->get_instruction_count() == 0 );
+    REQUIRE( profiler->get_actions().empty() );
+
+    vm.set_profiling(false);
+    REQUIRE( vm.get_profiler() == nullptr );
+}
+
+TEST_CASE("AVM_SCRIPT_LIMITS", "[OPENSWF]")
+{
+    auto player = create_player();
+    auto& vm = player->get_virtual_machine();
+    auto context = player->get_root().get_context();
+
+    // limits of movie without a ScriptLimits tag
+    REQUIRE( vm.get_limits().max_recursion == DefaultMaxRecursion );
+    REQUIRE( vm.get_limits().max_instructions == DefaultTimeoutSeconds * InstructionsPerSecond );
+    REQUIRE( ScriptLimits(64, 0).max_instructions == DefaultTimeoutSeconds * InstructionsPerSecond );
+
+    ScriptLimits limits;
+    limits.max_instructions = 1000;
+    vm.set_limits(limits);
+
+    // a loop that never ends, of 7 instructions
+    ActionWriter writer;
+    writer.constants({ "i" });
+    writer.begin_push().push_constant(0).push_integer(0).end_push().op(Opcode::SET_VARIABLE);
+    auto loop = writer.label();
+    writer.begin_push().push_constant(0).push_constant(0).end_push().op(Opcode::GET_VARIABLE);
+    writer.begin_push().push_integer(1).end_push().op(Opcode::ADD).op(Opcode::SET_VARIABLE);
+    writer.begin_push().push_integer(1).end_push();
+    writer.jump(Opcode::IF, loop);
+    writer.begin_push().push_constant(0).push_integer(-1).end_push().op(Opcode::SET_VARIABLE);
+
+    auto& bytes = writer.finish();
+    BytecodePtr bytecode(Bytecode::create(bytes.data(), bytes.size()));
+    vm.execute(context, *bytecode);
+
+    // aborted once the budget is used up, with nothing after the loop done
+    REQUIRE( context->get_variable("i").to_integer() == 1000 / 7 + 1 );
+    REQUIRE( vm.get_script_stats().budget_aborts == 1 );
+    REQUIRE( vm.get_script_stats().recursion_aborts == 0 );
+
+    // each block executed by host has a budget of its own
+    vm.execute(context, *bytecode);
+    REQUIRE( context->get_variable("i").to_integer() == 1000 / 7 + 1 );
+    REQUIRE( vm.get_script_stats().budget_aborts == 2 );
+
+    // blocks within budget are not aborted, and the movie goes on
+    ActionWriter bounded;
+    bounded.begin_push().push_string("j").push_integer(2).end_push().op(Opcode::SET_VARIABLE);
+    execute(*player, bounded.finish());
+    REQUIRE( context->get_variable("j").to_integer() == 2 );
+    REQUIRE( vm.get_script_stats().budget_aborts == 2 );
+    REQUIRE( vm.get_script_stats().max_depth == 1 );
+
+    player->update(0.1f);
+}
@@ -0,0 +1,66 @@
+#include "openswf_test.hpp"
+
+#include <algorithm>
+#include <array>
+#include <random>
+
+using namespace openswf;
+
+TEST_CASE("MESH_WELD", "[OPENSWF]")
+{
+    // a quad of two triangles without shared vertices, and a degenerated one
+    VertexPackList vertices = {
+        VertexPack(0, 0, 0, 0), VertexPack(1, 0, 0, 0), VertexPack(1, 1, 0, 0),
+        VertexPack(0, 0, 0, 0), VertexPack(1, 1, 0, 0), VertexPack(0, 1, 0, 0),
+        VertexPack(2, 2, 0, 0), VertexPack(3, 3, 0, 0), VertexPack(4, 4, 0, 0) };
+    IndexList indices = { 0, 1, 2, 3, 4, 5, 6, 7, 8 };
+
+    uint32_t vsize = vertices.size(), isize = indices.size();
+    MeshOptimizer::optimize(vertices.data(), vsize, indices.data(), isize);
+
+    REQUIRE( vsize == 4 );
+    REQUIRE( isize == 6 );
+    for( auto i=0; i<isize; i++ )
+        REQUIRE( indices[i] < vsize );
+
+    // the first use of vertices is in order
+    REQUIRE( indices[0] == 0 );
+}
+
+TEST_CASE("MESH_VERTEX_CACHE", "[OPENSWF]")
+{
+    // a grid with triangles in random order
+    const auto size = 32;
+    VertexPackList vertices;
+    for( auto y=0; y<=size; y++ )
+        for( auto x=0; x<=size; x++ )
+            vertices.push_back(VertexPack((float)x, (float)y, 0, 0));
+
+    std::vector<std::array<uint32_t, 3>> triangles;
+    for( auto y=0; y<size; y++ )
+    {
+        for( auto x=0; x<size; x++ )
+        {
+            uint32_t a = y*(size+1)+x, b = a+1, c = a+size+1, d = c+1;
+            triangles.push_back({{a, b, d}});
+            triangles.push_back({{a, d, c}});
+        }
+    }
+
+    std::mt19937 random(size);
+    std::shuffle(triangles.begin(), triangles.end(), random);
+
+    IndexList indices;
+    for( auto& triangle : triangles )
+        indices.insert(indices.end(), triangle.begin(), triangle.end());
+
+    auto before = MeshOptimizer::get_acmr(indices.data(), indices.size(), 16);
+    uint32_t vsize = vertices.size(), isize = indices.size();
+    MeshOptimizer::optimize(vertices.data(), vsize, indices.data(), isize);
+
+    REQUIRE( vsize == (size+1)*(size+1) );
+    REQUIRE( isize == size*size*6 );
+    auto after = MeshOptimizer::get_acmr(indices.data(), isize, 16);
+    REQUIRE( after < before * 0.5f );
+    REQUIRE( after < 1.f );
+}
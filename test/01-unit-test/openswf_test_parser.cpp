@@ -1,4 +1,11 @@
 #include "openswf_test.hpp"
+#include "render_software.hpp"
+
+#include <memory>
+
+extern "C" {
+    #include "zlib.h"
+}
 
 using namespace openswf;
 
@@ -54,6 +61,82 @@ TEST_CASE("PARSE_TAG_HEADER", "[OPENSWF]")
     REQUIRE( stream.is_finished() );
 }
 
+// a DefineBitsLossless2 tag of 8x8 argb pixels, without its header
+static std::vector<uint8_t> create_bits_lossless2(uint16_t cid, const uint8_t argb[4])
+{
+    const int width = 8, height = 8;
+    std::vector<uint8_t> pixels;
+    for( auto i=0; i<width*height; i++ )
+        pixels.insert(pixels.end(), argb, argb+4);
+
+    auto size = compressBound(pixels.size());
+    std::vector<uint8_t> bytes = {
+        (uint8_t)(cid & 0xFF), (uint8_t)(cid >> 8), 5, width, 0, height, 0 };
+    bytes.resize(7 + size);
+    compress(bytes.data()+7, &size, pixels.data(), pixels.size());
+    bytes.resize(7 + size);
+    return bytes;
+}
+
+TEST_CASE("IMAGE_BITMAP_RETENTION", "[OPENSWF]")
+{
+    std::unique_ptr<SoftwareRender> render(SoftwareRender::create(1));
+
+    const uint8_t argb[4] = { 255, 10, 20, 30 };
+    auto bytes = create_bits_lossless2(1, argb);
+
+    TagHeader header;
+    header.code = TagCode::DEFINE_BITS_LOSSLESS2;
+    header.size = header.end_pos = (uint32_t)bytes.size();
+
+    auto bitmap = Parser::decode_bitmap(header, bytes.data());
+    REQUIRE( bitmap != nullptr );
+    REQUIRE( bitmap->get_format() == TextureFormat::RGBA8 );
+    REQUIRE( bitmap->get_width() == 8 );
+    REQUIRE( bitmap->get_ptr()[0] == 10 );
+    REQUIRE( bitmap->get_ptr()[3] == 255 );
+
+    // pixels are released once uploaded, size and format are kept
+    std::unique_ptr<Image> image(Image::create(1, std::move(bitmap)));
+    BytesPtr source(new uint8_t[bytes.size()]);
+    memcpy(source.get(), bytes.data(), bytes.size());
+    image->set_source(header, std::move(source), &Parser::decode_bitmap);
+    REQUIRE( image->set_retention(BitmapRetention::RELEASE) );
+    REQUIRE( image->has_bitmap() );
+
+    auto rid = image->get_texture_rid(*render);
+    REQUIRE( rid != 0 );
+    REQUIRE( !image->has_bitmap() );
+    REQUIRE( image->get_width() == Approx(8) );
+    REQUIRE( image->get_texture_format() == TextureFormat::RGBA8 );
+    REQUIRE( image->get_texture_rid(*render) == rid );
+
+    // and decoded again once the texture is evicted
+    auto& residency = render->get_residency();
+    residency.end_frame();
+    residency.set_budget(1);
+    REQUIRE( residency.get_stats().textures == 0 );
+    REQUIRE( image->get_texture_rid(*render) != 0 );
+    REQUIRE( !image->has_bitmap() );
+
+    BitmapStats stats;
+    image->add_bitmap_stats(stats);
+    REQUIRE( stats.images == 1 );
+    REQUIRE( stats.released == 1 );
+    REQUIRE( stats.decodes == 2 );
+    REQUIRE( stats.bytes_bitmaps == 0 );
+    REQUIRE( stats.bytes_sources == bytes.size() );
+
+    // images without a source can't release their pixels
+    const uint8_t other[4] = { 255, 0, 0, 0 };
+    auto copy = create_bits_lossless2(2, other);
+    header.size = header.end_pos = (uint32_t)copy.size();
+    std::unique_ptr<Image> kept(Image::create(2, Parser::decode_bitmap(header, copy.data())));
+    REQUIRE( !kept->set_retention(BitmapRetention::RELEASE) );
+    REQUIRE( kept->get_texture_rid(*render) != 0 );
+    REQUIRE( kept->has_bitmap() );
+}
+
 // TEST_CASE("DEFINE-SHAPE-PARSE", "[OPENSWF]")
 // {
 //     auto stream = create_from_file("../test/resources/simple-shape-1.swf");
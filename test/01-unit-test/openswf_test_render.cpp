@@ -0,0 +1,311 @@
+#include "openswf_test.hpp"
+#include "render_software.hpp"
+#include "residency.hpp"
+
+#include <memory>
+
+using namespace openswf;
+
+// binds vertices as Shader does, with an orthographic projection of pixels
+static void bind_vertices(Render& render, Rid program, Rid vb, Rid ib, int width, int height)
+{
+    const auto stride = sizeof(VertexPack);
+    render.bind_shader(program);
+    render.bind_index_buffer(ib, ElementFormat::UNSIGNED_SHORT, 0, 0);
+    render.bind_vertex_buffer(0, vb, 2, ElementFormat::FLOAT, stride, 0);
+    render.bind_vertex_buffer(1, vb, 2, ElementFormat::FLOAT, stride, 8);
+    render.bind_vertex_buffer(2, vb, 4, ElementFormat::UNSIGNED_BYTE, stride, 16, true);
+    render.bind_vertex_buffer(3, vb, 4, ElementFormat::UNSIGNED_BYTE, stride, 20, true);
+
+    float projection[16] = {
+        2.f/width, 0, 0, 0,
+        0, -2.f/height, 0, 0,
+        0, 0, 1, 0,
+        -1, 1, 0, 1 };
+    render.bind_uniform(0, UniformFormat::MATRIX_F44, projection);
+}
+
+static Color get_pixel(const std::vector<uint8_t>& pixels, int width, int x, int y)
+{
+    auto p = pixels.data() + (y*width + x)*4;
+    return Color(p[0], p[1], p[2], p[3]);
+}
+
+TEST_CASE("SOFTWARE_RENDER_FILL", "[OPENSWF]")
+{
+    const int width = 96, height = 80;
+    std::unique_ptr<SoftwareRender> render(SoftwareRender::create(3));
+    REQUIRE( render != nullptr );
+    REQUIRE( render->get_thread_count() == 3 );
+
+    const char* uniforms[] = { "transform" };
+    auto program = render->create_shader("", "", 4, 0, nullptr, 1, uniforms);
+
+    // a quad of two triangles, the shared diagonal must be shaded only once
+    VertexPack vertices[4] = {
+        VertexPack(10, 10, 0, 0), VertexPack(70, 10, 0, 0),
+        VertexPack(70, 50, 0, 0), VertexPack(10, 50, 0, 0) };
+    for( auto& vertex : vertices )
+    {
+        vertex.diffuse = Color::white;
+        vertex.additive = Color(100, 50, 0, 0);
+    }
+    uint16_t indices[6] = { 0, 1, 2, 0, 2, 3 };
+
+    auto vb = render->create_buffer(RenderObject::VERTEX_BUFFER, vertices, sizeof(vertices));
+    auto ib = render->create_buffer(RenderObject::INDEX_BUFFER, indices, sizeof(indices));
+
+    render->set_viewport(0, 0, width, height);
+    render->clear(CLEAR_COLOR | CLEAR_DEPTH, 0, 0, 0, 0);
+    render->set_blend(BlendFunc::ONE, BlendFunc::ONE);
+    bind_vertices(*render, program, vb, ib, width, height);
+    render->draw(DrawMode::TRIANGLE, 0, 6);
+
+    std::vector<uint8_t> pixels(width*height*4);
+    render->read_pixels(0, 0, width, height, pixels.data());
+
+    auto covered = 0;
+    for( auto y=0; y<height; y++ )
+    {
+        for( auto x=0; x<width; x++ )
+        {
+            auto color = get_pixel(pixels, width, x, y);
+            auto inside = x >= 10 && x < 70 && y >= 10 && y < 50;
+            if( inside ) covered ++;
+
+            // an unbound texture samples as opaque black
+            REQUIRE( color.r == (inside ? 100 : 0) );
+            REQUIRE( color.g == (inside ? 50 : 0) );
+            REQUIRE( color.a == (inside ? 255 : 0) );
+        }
+    }
+
+    REQUIRE( covered == 60*40 );
+    REQUIRE( render->get_stats().triangles == 2 );
+    REQUIRE( render->get_stats().pixels == 60*40 );
+}
+
+TEST_CASE("SOFTWARE_RENDER_TEXTURE_AND_SCISSOR", "[OPENSWF]")
+{
+    const int width = 128, height = 128;
+    std::unique_ptr<SoftwareRender> render(SoftwareRender::create(2));
+
+    const char* textures[] = { "texture0" };
+    const char* uniforms[] = { "transform" };
+    auto program = render->create_shader("", "", 4, 1, textures, 1, uniforms);
+
+    uint8_t texels[4] = { 0, 0, 255, 128 };
+    auto texture = render->create_texture(texels, 1, 1, TextureFormat::RGBA8, 0);
+
+    // a triangle over the whole viewport
+    VertexPack vertices[3] = {
+        VertexPack(-10, -10, 0, 0), VertexPack(300, -10, 1, 0), VertexPack(-10, 300, 0, 1) };
+    uint16_t indices[3] = { 0, 1, 2 };
+
+    auto vb = render->create_buffer(RenderObject::VERTEX_BUFFER, vertices, sizeof(vertices));
+    auto ib = render->create_buffer(RenderObject::INDEX_BUFFER, indices, sizeof(indices));
+
+    render->set_viewport(0, 0, width, height);
+    render->clear(CLEAR_COLOR, 255, 0, 0, 255);
+
+    // scissor is from the bottom-left as opengl
+    render->set_scissor(true, 0, 0, 32, 16);
+    render->set_blend(BlendFunc::SRC_ALPHA, BlendFunc::ONE_MINUS_SRC_ALPHA);
+    render->bind_texture(0, texture);
+    bind_vertices(*render, program, vb, ib, width, height);
+    render->draw(DrawMode::TRIANGLE, 0, 3);
+
+    std::vector<uint8_t> pixels(width*height*4);
+    render->read_pixels(0, 0, width, height, pixels.data());
+
+    auto blended = get_pixel(pixels, width, 4, height-4);
+    REQUIRE( std::abs((int)blended.r - 127) <= 1 );
+    REQUIRE( blended.g == 0 );
+    REQUIRE( std::abs((int)blended.b - 128) <= 1 );
+
+    REQUIRE( get_pixel(pixels, width, 40, height-4).r == 255 );
+    REQUIRE( get_pixel(pixels, width, 4, height-20).b == 0 );
+    REQUIRE( render->get_stats().pixels == 32*16 );
+
+    // reading a region keeps the bottom-left origin
+    std::vector<uint8_t> corner(4*4*4);
+    render->read_pixels(0, 0, 4, 4, corner.data());
+    REQUIRE( get_pixel(corner, 4, 0, 3).b == blended.b );
+}
+
+TEST_CASE("SHADER_BATCH_RING", "[OPENSWF]")
+{
+    const int width = 64, height = 16;
+    std::unique_ptr<SoftwareRender> render(SoftwareRender::create(1));
+    std::unique_ptr<Screen> screen(Screen::create(width, height));
+    std::unique_ptr<Shader> shader(Shader::create(*render, *screen, 8, 64));
+    REQUIRE( shader->get_capacity() == 8 );
+
+    const char* uniforms[] = { "transform" };
+    shader->create(PROGRAM_DEFAULT, "", "", 0, nullptr, 1, uniforms);
+    render->set_viewport(0, 0, width, height);
+
+    VertexPack quad[4] = {
+        VertexPack(0, 0, 0, 0), VertexPack(4, 0, 0, 0),
+        VertexPack(4, 4, 0, 0), VertexPack(0, 4, 0, 0) };
+    for( auto& vertex : quad )
+        vertex.additive = Color(0, 200, 0, 0);
+
+    // ten quads of 40 vertices wrap a ring of 8 vertices
+    auto draw_frame = [&]()
+    {
+        render->clear(CLEAR_COLOR, 0, 0, 0, 255);
+        shader->set_program(PROGRAM_DEFAULT);
+        for( auto i=0; i<10; i++ )
+        {
+            Matrix matrix;
+            matrix.values[0][2] = (float)(i*6);
+            shader->draw(quad[0], quad[1], quad[2], quad[3], matrix);
+        }
+        shader->end_frame();
+    };
+
+    draw_frame();
+    REQUIRE( shader->get_frame_stats().wraps > 0 );
+    REQUIRE( shader->get_frame_stats().draw_calls == 5 );
+    REQUIRE( shader->get_frame_stats().vertices == 40 );
+    REQUIRE( shader->get_frame_stats().bytes_uploaded == 40*sizeof(VertexPack) + 60*sizeof(uint16_t) );
+    REQUIRE( shader->get_capacity() == 64 );
+
+    // the grown ring holds the frame at once
+    draw_frame();
+    REQUIRE( shader->get_frame_stats().wraps == 0 );
+    REQUIRE( shader->get_frame_stats().draw_calls == 1 );
+
+    std::vector<uint8_t> pixels(width*height*4);
+    render->read_pixels(0, 0, width, height, pixels.data());
+    for( auto i=0; i<10; i++ )
+    {
+        REQUIRE( get_pixel(pixels, width, i*6+1, 1).g == 200 );
+        REQUIRE( get_pixel(pixels, width, i*6+5, 1).g == 0 );
+    }
+}
+
+TEST_CASE("SHADER_PACKET_REORDER", "[OPENSWF]")
+{
+    const int width = 64, height = 16;
+    std::unique_ptr<SoftwareRender> render(SoftwareRender::create(1));
+    std::unique_ptr<Screen> screen(Screen::create(width, height));
+    std::unique_ptr<Shader> shader(Shader::create(*render, *screen));
+
+    const char* textures[] = { "texture0" };
+    const char* uniforms[] = { "transform" };
+    shader->create(PROGRAM_DEFAULT, "", "", 1, textures, 1, uniforms);
+    render->set_viewport(0, 0, width, height);
+
+    uint8_t red[4] = { 255, 0, 0, 255 }, blue[4] = { 0, 0, 255, 255 };
+    Rid palette[2] = {
+        render->create_texture(red, 1, 1, TextureFormat::RGBA8, 0),
+        render->create_texture(blue, 1, 1, TextureFormat::RGBA8, 0) };
+
+    VertexPack quad[4] = {
+        VertexPack(0, 0, 0, 0), VertexPack(4, 0, 1, 0),
+        VertexPack(4, 4, 1, 1), VertexPack(0, 4, 0, 1) };
+
+    // quads alternate textures, each one is placed at x of step*i
+    auto draw_frame = [&](int count, float step, std::vector<uint8_t>& pixels)
+    {
+        render->clear(CLEAR_COLOR, 0, 0, 0, 255);
+        shader->set_program(PROGRAM_DEFAULT);
+        for( auto i=0; i<count; i++ )
+        {
+            Matrix matrix;
+            matrix.values[0][2] = step*i;
+            shader->set_texture(0, palette[i%2]);
+            shader->draw(quad[0], quad[1], quad[2], quad[3], matrix);
+        }
+        shader->end_frame();
+
+        pixels.resize(width*height*4);
+        render->read_pixels(0, 0, width, height, pixels.data());
+    };
+
+    // apart quads are grouped by texture, to the same pixels
+    std::vector<uint8_t> expected, pixels;
+    draw_frame(10, 6.f, expected);
+    REQUIRE( shader->get_frame_stats().draw_calls == 10 );
+    REQUIRE( get_pixel(expected, width, 1, 1).r == 255 );
+    REQUIRE( get_pixel(expected, width, 7, 1).b == 255 );
+
+    shader->set_reordering(true);
+    draw_frame(10, 6.f, pixels);
+    REQUIRE( shader->get_frame_stats().draw_calls == 2 );
+    REQUIRE( shader->get_frame_stats().packets == 10 );
+    REQUIRE( shader->get_frame_stats().batches == 2 );
+    REQUIRE( pixels == expected );
+
+    // overlapped quads keep their order
+    draw_frame(3, 2.f, pixels);
+    REQUIRE( shader->get_frame_stats().draw_calls == 3 );
+    REQUIRE( get_pixel(pixels, width, 3, 1).b == 255 );
+    REQUIRE( get_pixel(pixels, width, 5, 1).r == 255 );
+
+    shader->set_reordering(false);
+    draw_frame(3, 2.f, expected);
+    REQUIRE( pixels == expected );
+}
+
+TEST_CASE("TEXTURE_RESIDENCY", "[OPENSWF]")
+{
+    // textures outlive the render, which tells them once destroyed
+    ResidentTexture a, b, c;
+    std::unique_ptr<SoftwareRender> render(SoftwareRender::create(1));
+    auto& residency = render->get_residency();
+
+    const int size = 16, bytes = size*size*4;
+    std::vector<uint8_t> pixels(bytes, 255);
+    auto upload = [&](ResidentTexture& texture)
+    {
+        return texture.get(*render, pixels.data(), size, size, TextureFormat::RGBA8, 0);
+    };
+
+    residency.set_budget(bytes*2);
+    REQUIRE( upload(a) != 0 );
+    REQUIRE( upload(b) != 0 );
+    REQUIRE( residency.get_stats().bytes == bytes*2 );
+
+    // the least recently used one is evicted to fit
+    residency.end_frame();
+    // a resident one is only touched, pixels are not read
+    auto rid = b.get(*render, nullptr, size, size, TextureFormat::RGBA8, 0);
+    REQUIRE( upload(c) != 0 );
+    REQUIRE( !a.is_resident() );
+    REQUIRE( b.is_resident() );
+    REQUIRE( rid != 0 );
+    REQUIRE( residency.get_stats().evictions == 1 );
+
+    // evicted ones are uploaded again on demand, textures of current frame
+    // are kept even if the budget is exceeded.
+    residency.end_frame();
+    REQUIRE( upload(a) != 0 );
+    REQUIRE( !b.is_resident() );
+    REQUIRE( upload(b) != 0 );
+    REQUIRE( upload(c) != 0 );
+    REQUIRE( a.is_resident() );
+    REQUIRE( b.is_resident() );
+    REQUIRE( c.is_resident() );
+
+    auto& stats = residency.get_stats();
+    REQUIRE( stats.textures == 3 );
+    REQUIRE( stats.bytes == bytes*3 );
+    REQUIRE( stats.peak_bytes == bytes*3 );
+    REQUIRE( stats.uploads == 6 );
+    REQUIRE( stats.evictions == 3 );
+
+    // lowering the budget evicts the ones of previous frames
+    residency.end_frame();
+    upload(c);
+    residency.set_budget(bytes);
+    REQUIRE( !a.is_resident() );
+    REQUIRE( !b.is_resident() );
+    REQUIRE( c.is_resident() );
+
+    b.release();
+    render.reset();
+    REQUIRE( !c.is_resident() );
+}
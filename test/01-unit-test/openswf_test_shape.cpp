@@ -0,0 +1,309 @@
+#include "openswf_test.hpp"
+#include "render_software.hpp"
+
+#include <memory>
+
+using namespace openswf;
+
+static ShapePath create_path(std::initializer_list<Point2f> points, uint32_t left, uint32_t right)
+{
+    ShapePath path;
+    auto iter = points.begin();
+    path.restart(*iter++);
+    for( ; iter != points.end(); iter++ )
+        path.edges.push_back(ShapeEdge(*iter));
+
+    path.left_fill = left;
+    path.right_fill = right;
+    return path;
+}
+
+TEST_CASE("SHAPE_RECORD_CONTOURS", "[OPENSWF]")
+{
+    // two rectangles share an edge in the middle, and the edges of
+    // the left one are out of order with mixed directions
+    ShapePathList paths;
+    paths.push_back(create_path({ Point2f(0, 100), Point2f(0, 0) }, 0, 1));
+    paths.push_back(create_path({ Point2f(100, 0), Point2f(100, 100) }, 2, 1));
+    paths.push_back(create_path({ Point2f(100, 0), Point2f(0, 0) }, 1, 0));
+    paths.push_back(create_path({ Point2f(0, 100), Point2f(100, 100) }, 1, 0));
+    paths.push_back(create_path({ Point2f(100, 0), Point2f(200, 0), Point2f(200, 100), Point2f(100, 100) }, 0, 2));
+
+    auto record = ShapeRecord::create(Rect(), paths, 3);
+    REQUIRE( record != nullptr );
+
+    REQUIRE( record->fills.size() == 3 );
+    REQUIRE( record->fills[0] == 1 );
+    REQUIRE( record->fills[1] == 2 );
+    REQUIRE( record->fills[2] == 2 ); // no edge with fill style 3
+
+    // anchors of a contour include its closing point
+    REQUIRE( record->contours.size() == 2 );
+    REQUIRE( record->contours[0] == 5 );
+    REQUIRE( record->contours[1] == 10 );
+
+    // every contour is closed by consecutive edges
+    REQUIRE( record->anchors[4] == record->anchors[0] );
+    for( auto i=0; i<4; i++ )
+    {
+        auto& from = record->anchors[i];
+        auto& to = record->anchors[i+1];
+        REQUIRE( (from.x == to.x || from.y == to.y) );
+    }
+}
+
+TEST_CASE("SHAPE_RECORD_HOLES", "[OPENSWF]")
+{
+    ShapePathList paths;
+    paths.push_back(create_path({ Point2f(0, 0), Point2f(300, 0), Point2f(300, 300), Point2f(0, 300), Point2f(0, 0) }, 0, 1));
+    paths.push_back(create_path({ Point2f(100, 100), Point2f(100, 200), Point2f(200, 200) }, 0, 1));
+    paths.push_back(create_path({ Point2f(200, 200), Point2f(200, 100), Point2f(100, 100) }, 0, 1));
+
+    auto record = ShapeRecord::create(Rect(), paths, 1);
+    REQUIRE( record->fills.size() == 1 );
+    REQUIRE( record->fills[0] == 2 );
+    REQUIRE( record->contours[0] == 5 );
+    REQUIRE( record->contours[1] == 10 );
+}
+
+TEST_CASE("SHAPE_LEVEL_OF_DETAIL", "[OPENSWF]")
+{
+    // a circle with radius of 100 pixels made of 8 curves
+    ShapePath circle;
+    circle.right_fill = 1;
+    circle.restart(Point2f(2000, 0));
+    for( auto i=1; i<=8; i++ )
+    {
+        auto angle = 0.7853982f * (float)i;
+        auto control = 0.7853982f * ((float)i - 0.5f);
+        auto radius = 2000.f / std::cos(0.3926991f);
+        circle.edges.push_back(ShapeEdge(
+            (int32_t)(2000.f*std::cos(angle)), (int32_t)(2000.f*std::sin(angle)),
+            (int32_t)(radius*std::cos(control)), (int32_t)(radius*std::sin(control))));
+    }
+
+    ShapeFillList fills;
+    fills.push_back(ShapeFill::create(Color::white));
+
+    auto record = ShapeRecord::create(Rect(), ShapePathList(1, circle), 1);
+    std::unique_ptr<Shape> shape(Shape::create(1, std::move(fills), ShapeLineList(), std::move(record)));
+    REQUIRE( shape != nullptr );
+
+    Matrix matrix;
+    REQUIRE( ShapeRecord::get_level(matrix) == 0 );
+
+    matrix.set(0, 0, 3.f);
+    matrix.set(1, 1, 3.f);
+    REQUIRE( ShapeRecord::get_level(matrix) == 2 );
+
+    matrix.set(0, 0, 0.1f);
+    matrix.set(1, 1, 0.1f);
+    REQUIRE( ShapeRecord::get_level(matrix) == ShapeMinLevel );
+
+    auto original = shape->get_mesh(0);
+    auto zoomed = shape->get_mesh(ShapeMaxLevel);
+    auto tiny = shape->get_mesh(ShapeMinLevel);
+    REQUIRE( original != nullptr );
+    REQUIRE( shape->get_mesh(0) == original );
+
+    REQUIRE( zoomed->vertices.size() > original->vertices.size() );
+    REQUIRE( tiny->vertices.size() < original->vertices.size() );
+    REQUIRE( shape->mesh_memsize ==
+        original->get_memsize() + zoomed->get_memsize() + tiny->get_memsize() );
+}
+
+static Rect get_bounds(const VertexPackList& vertices)
+{
+    Rect bounds(vertices[0].position.x, vertices[0].position.x, vertices[0].position.y, vertices[0].position.y);
+    for( auto& vertex : vertices )
+    {
+        bounds.xmin = std::min(bounds.xmin, vertex.position.x);
+        bounds.xmax = std::max(bounds.xmax, vertex.position.x);
+        bounds.ymin = std::min(bounds.ymin, vertex.position.y);
+        bounds.ymax = std::max(bounds.ymax, vertex.position.y);
+    }
+    return bounds;
+}
+
+TEST_CASE("STROKE_CAPS_AND_JOINS", "[OPENSWF]")
+{
+    VertexPackList vertices;
+    IndexList indices;
+
+    StrokeStyle style;
+    style.width = 40.f; // 2 pixels
+    style.start_cap = style.end_cap = Capcode::NO;
+
+    Point2f line[] = { Point2f(0, 0), Point2f(200, 0) };
+    SECTION("BUTT")
+    {
+        Stroker(style, vertices, indices).add_polyline(line, 2);
+        REQUIRE( vertices.size() == 4 );
+        REQUIRE( indices.size() == 6 );
+
+        auto bounds = get_bounds(vertices);
+        REQUIRE( bounds.xmin == Approx(0) );
+        REQUIRE( bounds.xmax == Approx(10) );
+        REQUIRE( bounds.ymin == Approx(-1) );
+        REQUIRE( bounds.ymax == Approx(1) );
+    }
+
+    SECTION("SQUARE")
+    {
+        style.start_cap = style.end_cap = Capcode::SQUARE;
+        Stroker(style, vertices, indices).add_polyline(line, 2);
+
+        auto bounds = get_bounds(vertices);
+        REQUIRE( bounds.xmin == Approx(-1) );
+        REQUIRE( bounds.xmax == Approx(11) );
+    }
+
+    SECTION("ROUND")
+    {
+        style.start_cap = style.end_cap = Capcode::ROUND;
+        Stroker(style, vertices, indices).add_polyline(line, 2);
+
+        // arcs are within curve tolerance of the half width
+        auto bounds = get_bounds(vertices);
+        REQUIRE( bounds.xmin >= -1.01f );
+        REQUIRE( bounds.xmin <= -0.8f );
+        REQUIRE( bounds.xmax >= 10.8f );
+        REQUIRE( bounds.xmax <= 11.01f );
+        REQUIRE( indices.size() > 6*3 );
+        REQUIRE( indices.size() % 3 == 0 );
+    }
+
+    Point2f corner[] = { Point2f(0, 0), Point2f(200, 0), Point2f(200, 200) };
+    SECTION("MITER")
+    {
+        style.join = Joincode::MITER;
+        Stroker(style, vertices, indices).add_polyline(corner, 3);
+
+        auto bounds = get_bounds(vertices);
+        REQUIRE( bounds.xmax == Approx(11) );
+        REQUIRE( bounds.ymin == Approx(-1) );
+    }
+
+    SECTION("MITER_LIMIT")
+    {
+        style.join = Joincode::MITER;
+        style.miter_limit = 1.f;
+        Stroker(style, vertices, indices).add_polyline(corner, 3);
+        REQUIRE( indices.size() == 6*2 + 3 ); // bevel
+    }
+
+    SECTION("CLOSED")
+    {
+        Point2f square[] = { Point2f(0, 0), Point2f(200, 0), Point2f(200, 200), Point2f(0, 200), Point2f(0, 0) };
+        style.join = Joincode::BEVEL;
+        style.start_cap = style.end_cap = Capcode::ROUND;
+        Stroker(style, vertices, indices).add_polyline(square, 5);
+        REQUIRE( indices.size() == 6*4 + 3*4 );
+    }
+}
+
+TEST_CASE("SHAPE_RECORD_STROKES", "[OPENSWF]")
+{
+    ShapePathList paths;
+    paths.push_back(create_path({ Point2f(0, 0), Point2f(100, 0) }, 0, 0));
+    paths.push_back(create_path({ Point2f(100, 0), Point2f(100, 100) }, 0, 0));
+    paths.push_back(create_path({ Point2f(0, 200), Point2f(100, 200) }, 0, 0));
+    paths[0].line = paths[1].line = paths[2].line = 2;
+
+    auto record = ShapeRecord::create(Rect(), paths, 0, 2);
+    REQUIRE( record->lines.size() == 2 );
+    REQUIRE( record->lines[0] == 0 );
+    REQUIRE( record->lines[1] == 2 );
+
+    // the first two paths are connected
+    REQUIRE( record->strokes[0] == 3 );
+    REQUIRE( record->strokes[1] == 5 );
+
+    ShapeLineList lines;
+    lines.push_back(ShapeLine::create(20, Color::black));
+    lines.push_back(ShapeLine::create(0, Color::black));
+
+    auto mesh = ShapeMesh::create(*record, lines, 0);
+    REQUIRE( mesh->vertices_size.size() == 2 );
+    REQUIRE( mesh->vertices_size[0] == 0 );
+    REQUIRE( mesh->vertices_size[1] > 0 );
+}
+
+TEST_CASE("SHAPE_LARGE_MESH", "[OPENSWF]")
+{
+    // a polygon and its outline, each needs more vertices than 16 bits indices
+    const auto count = 70000;
+    ShapePath ring;
+    ring.right_fill = 1;
+    ring.line = 1;
+    ring.restart(Point2f(400000, 0));
+    for( auto i=1; i<=count; i++ )
+    {
+        auto angle = 6.2831853f * (float)(i % count) / (float)count;
+        ring.edges.push_back(ShapeEdge(Point2f(
+            std::floor(400000.f*std::cos(angle)), std::floor(400000.f*std::sin(angle)))));
+    }
+
+    ShapeLineList lines;
+    lines.push_back(ShapeLine::create(20, Color::black));
+
+    auto record = ShapeRecord::create(Rect(), ShapePathList(1, ring), 1, 1);
+    auto mesh = ShapeMesh::create(*record, lines, 0);
+    REQUIRE( mesh != nullptr );
+    REQUIRE( mesh->vertices_size.size() == 2 );
+
+    for( auto i=0; i<2; i++ )
+    {
+        auto vbase = i == 0 ? 0 : mesh->vertices_size[i-1];
+        auto ibase = i == 0 ? 0 : mesh->indices_size[i-1];
+        auto vcount = mesh->vertices_size[i] - vbase;
+
+        REQUIRE( vcount > 0xFFFF );
+        REQUIRE( (mesh->indices_size[i] - ibase) % 3 == 0 );
+
+        auto max_index = 0u;
+        for( auto j=ibase; j<mesh->indices_size[i]; j++ )
+            max_index = std::max(max_index, mesh->indices[j]);
+
+        REQUIRE( max_index > 0xFFFF );
+        REQUIRE( max_index < vcount );
+    }
+
+    // the polygon exceeds the largest ring, it's drawn in chunks of triangles
+    const int size = 64;
+    std::unique_ptr<SoftwareRender> render(SoftwareRender::create(1));
+    std::unique_ptr<Screen> screen(Screen::create(size, size));
+    std::unique_ptr<Shader> shader(Shader::create(*render, *screen));
+
+    const char* uniforms[] = { "transform" };
+    shader->create(PROGRAM_DEFAULT, "", "", 0, nullptr, 1, uniforms);
+    render->set_viewport(0, 0, size, size);
+
+    VertexPackList vertices(mesh->vertices.begin(), mesh->vertices.begin()+mesh->vertices_size[0]);
+    for( auto& vertex : vertices )
+        vertex.additive = Color(0, 200, 0, 0);
+
+    Matrix matrix;
+    matrix.values[0][0] = matrix.values[1][1] = 24.f / 20000.f; // twips are scaled to pixels
+    matrix.values[0][2] = matrix.values[1][2] = 32.f;
+
+    render->clear(CLEAR_COLOR, 0, 0, 0, 255);
+    shader->set_program(PROGRAM_DEFAULT);
+    shader->draw((int)vertices.size(), vertices.data(), (int)mesh->indices_size[0], mesh->indices.data(), matrix);
+    shader->end_frame();
+
+    auto& stats = shader->get_frame_stats();
+    REQUIRE( stats.chunked == 1 );
+    REQUIRE( stats.wraps > 0 );
+    REQUIRE( stats.draw_calls == stats.wraps+1 );
+    REQUIRE( stats.indices == mesh->indices_size[0] );
+
+    std::vector<uint8_t> pixels(size*size*4);
+    render->read_pixels(0, 0, size, size, pixels.data());
+    auto green = [&](int x, int y) { return pixels[(y*size + x)*4 + 1]; };
+    REQUIRE( green(32, 32) == 200 );
+    REQUIRE( green(32, 12) == 200 );
+    REQUIRE( green(12, 32) == 200 );
+    REQUIRE( green(2, 2) == 0 );
+    REQUIRE( green(61, 61) == 0 );
+}
@@ -0,0 +1,80 @@
+#include "openswf_test.hpp"
+#include "snapshot.hpp"
+
+#include <memory>
+#include <thread>
+
+using namespace openswf;
+
+static BitmapRGBA8::Ptr render_thumbnail(const char* path, uint16_t frame, int width, int height)
+{
+    std::unique_ptr<Snapshot> snapshot(Snapshot::create());
+    if( snapshot == nullptr ) return nullptr;
+
+    auto stream = create_from_file(path);
+    std::unique_ptr<Player> player(Player::create(stream));
+    if( player == nullptr ) return nullptr;
+
+    return snapshot->render(*player, frame, width, height);
+}
+
+TEST_CASE("SNAPSHOT", "[OPENSWF]")
+{
+    REQUIRE( Parser::initialize() );
+
+    std::unique_ptr<Snapshot> snapshot(Snapshot::create());
+    REQUIRE( snapshot != nullptr );
+
+    auto stream = create_from_file("../test/resources/simple-timeline-1.swf");
+    std::unique_ptr<Player> player(Player::create(stream));
+    REQUIRE( player != nullptr );
+
+    auto bitmap = snapshot->render(*player, 3, 64, 48);
+    REQUIRE( bitmap != nullptr );
+    REQUIRE( player->get_root().get_current_frame() == 3 );
+
+    // something other than background is drawn
+    auto background = player->get_background_color();
+    auto covered = 0;
+    for( auto y=0; y<48; y++ )
+    {
+        for( auto x=0; x<64; x++ )
+        {
+            auto& pixel = bitmap->get(y, x);
+            if( pixel.r != background.r || pixel.g != background.g || pixel.b != background.b )
+                covered ++;
+        }
+    }
+    REQUIRE( covered > 0 );
+
+    std::vector<uint8_t> png;
+    REQUIRE( Snapshot::encode_png(*bitmap, png) );
+    REQUIRE( png.size() > 8+25+12+12 );
+    REQUIRE( png[0] == 137 );
+    REQUIRE( png[1] == 'P' );
+    REQUIRE( memcmp(png.data()+png.size()-8, "IEND", 4) == 0 );
+}
+
+TEST_CASE("SNAPSHOT_PARALLEL", "[OPENSWF]")
+{
+    REQUIRE( Parser::initialize() );
+
+    const char* path = "../test/resources/simple-shape-1.swf";
+    auto expected = render_thumbnail(path, 1, 40, 30);
+    REQUIRE( expected != nullptr );
+
+    // each thread owns its snapshot and players
+    const int count = 4;
+    BitmapRGBA8::Ptr results[count];
+    std::vector<std::thread> threads;
+    for( auto i=0; i<count; i++ )
+        threads.push_back(std::thread([&, i]() { results[i] = render_thumbnail(path, 1, 40, 30); }));
+    for( auto& thread : threads )
+        thread.join();
+
+    for( auto i=0; i<count; i++ )
+    {
+        REQUIRE( results[i] != nullptr );
+        REQUIRE( memcmp(results[i]->get_ptr(), expected->get_ptr(), expected->get_size()) == 0 );
+    }
+}
@@ -0,0 +1,79 @@
+#include "openswf_test.hpp"
+#include "vertex_transform.hpp"
+
+#include <random>
+
+using namespace openswf;
+
+static std::vector<VertexPack> create_vertices(int size)
+{
+    std::mt19937 random(3);
+    std::uniform_real_distribution<float> position(-4000.f, 4000.f);
+    std::uniform_int_distribution<int> channel(0, 255);
+
+    std::vector<VertexPack> vertices;
+    for( auto i=0; i<size; i++ )
+    {
+        VertexPack vertex(position(random), position(random), 0, 0);
+        vertex.diffuse = Color(channel(random), channel(random), channel(random), channel(random));
+        vertices.push_back(vertex);
+    }
+    return vertices;
+}
+
+static void require_same_as_scalar(const Matrix& matrix, const ColorTransform& cxform)
+{
+    // sizes cover the tails of all group widths
+    for( auto size : { 1, 2, 3, 5, 8, 11, 64 } )
+    {
+        auto expected = create_vertices(size);
+        for( auto& vertex : expected )
+        {
+            vertex.position = matrix*vertex.position;
+            vertex.diffuse = cxform*vertex.diffuse;
+        }
+
+        for( auto level : { SimdLevel::SCALAR, SimdLevel::SSE2, SimdLevel::AVX2 } )
+        {
+            auto vertices = create_vertices(size);
+            transform_vertices(size, vertices.data(), matrix, cxform, level);
+
+            for( auto i=0; i<size; i++ )
+            {
+                REQUIRE( vertices[i].position.x == expected[i].position.x );
+                REQUIRE( vertices[i].position.y == expected[i].position.y );
+                REQUIRE( vertices[i].diffuse.r == expected[i].diffuse.r );
+                REQUIRE( vertices[i].diffuse.g == expected[i].diffuse.g );
+                REQUIRE( vertices[i].diffuse.b == expected[i].diffuse.b );
+                REQUIRE( vertices[i].diffuse.a == expected[i].diffuse.a );
+            }
+        }
+    }
+}
+
+TEST_CASE("TRANSFORM_VERTICES", "[OPENSWF]")
+{
+    Matrix matrix;
+    matrix.values[0][0] = 0.75f;
+    matrix.values[0][1] = -0.3f;
+    matrix.values[1][0] = 0.45f;
+    matrix.values[1][1] = 1.25f;
+    matrix.values[0][2] = 120.5f;
+    matrix.values[1][2] = -64.f;
+
+    ColorTransform cxform;
+    cxform.values[0][0] = 0.5f;
+    cxform.values[0][1] = 1.5f;
+    cxform.values[0][3] = 0.8f;
+    cxform.values[1][0] = 20.f;
+    cxform.values[1][2] = -300.f;
+
+    Matrix translation;
+    translation.values[0][2] = 33.25f;
+    translation.values[1][2] = -7.5f;
+
+    require_same_as_scalar(matrix, cxform);
+    require_same_as_scalar(matrix, ColorTransform::identity);
+    require_same_as_scalar(translation, cxform);
+    require_same_as_scalar(Matrix::identity, ColorTransform::identity);
+}
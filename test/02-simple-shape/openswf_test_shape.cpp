@@ -42,8 +42,9 @@ int main(int argc, char* argv[])
         return -1;
     }
 
-    auto& render = Render::get_instance();
-    auto& shader = Shader::get_instance();
+    auto& context = openswf::get_context();
+    auto& render = context.get_render();
+    auto& shader = context.get_shader();
 
     auto stream = create_from_file("../test/resources/simple-shape-2.swf");
     auto player = Player::create(stream);
@@ -56,13 +57,13 @@ int main(int argc, char* argv[])
         render.set_viewport(0, 0, width, height);
         render.clear(CLEAR_COLOR | CLEAR_DEPTH, 100, 100, 100, 255);
 
-        player->render();
+        player->render(context);
 
         // shader.bind(Matrix::identity, ColorTransform::identity);
         // render.draw(DrawMode::TRIANGLE, 0, 6);
 
         // shader.draw({0, 0, 0, 0}, {0, 256, 0, 0}, {256, 256, 0, 0}, {256, 0, 0, 0});
-        shader.flush();
+        shader.end_frame();
 
         glfwSwapBuffers(window);
         glfwPollEvents();
@@ -70,5 +71,6 @@ int main(int argc, char* argv[])
 
     delete player;
     glfwTerminate();
+    openswf::dispose();
     return 0;
 }
\ No newline at end of file
@@ -52,8 +52,9 @@ int main(int argc, char* argv[])
     auto stream = create_from_file("../test/resources/simple-timeline-2.swf");
     auto player = Player::create(stream);
 
-    auto& render = Render::get_instance();
-    auto& shader = Shader::get_instance();
+    auto& context = openswf::get_context();
+    auto& render = context.get_render();
+    auto& shader = context.get_shader();
     auto last_time = glfwGetTime();
 
     while( !glfwWindowShouldClose(window) )
@@ -64,8 +65,8 @@ int main(int argc, char* argv[])
         auto now_time = glfwGetTime();
         player->update(now_time-last_time);
         last_time = now_time;
-        player->render();
-        shader.flush();
+        player->render(context);
+        shader.end_frame();
         
         glfwSwapBuffers(window);
         glfwPollEvents();
@@ -73,6 +74,6 @@ int main(int argc, char* argv[])
 
     delete player;
     glfwTerminate();
-    Render::dispose();
+    openswf::dispose();
     return 0;
 }
\ No newline at end of file
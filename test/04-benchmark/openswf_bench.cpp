@@ -0,0 +1,46 @@
+#include "openswf_bench.hpp"
+
+#include <cstring>
+#include <vector>
+
+struct BenchmarkCase
+{
+    const char*     name;
+    BenchmarkFunc   func;
+};
+
+static std::vector<BenchmarkCase>& get_cases()
+{
+    static std::vector<BenchmarkCase> cases;
+    return cases;
+}
+
+int register_benchmark(const char* name, BenchmarkFunc func)
+{
+    get_cases().push_back({name, func});
+    return (int)get_cases().size();
+}
+
+double measure_ms(int iterations, const std::function<void()>& func)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    for( auto i=0; i<iterations; i++ )
+        func();
+    auto finish = std::chrono::high_resolution_clock::now();
+
+    return std::chrono::duration<double, std::milli>(finish - start).count() / iterations;
+}
+
+int main(int argc, char* argv[])
+{
+    const char* filter = argc > 1 ? argv[1] : nullptr;
+    for( auto& bench : get_cases() )
+    {
+        if( filter != nullptr && strstr(bench.name, filter) == nullptr )
+            continue;
+
+        printf("== %s\n", bench.name);
+        bench.func();
+    }
+    return 0;
+}
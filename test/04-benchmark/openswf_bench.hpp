@@ -0,0 +1,19 @@
+#pragma once
+
+#include "openswf_common.hpp"
+
+#include <chrono>
+#include <functional>
+
+// a minimal benchmark runner, all cases registered with BENCHMARK_CASE are
+// executed in order, or only the ones whose name contains the first argument.
+typedef void (*BenchmarkFunc)();
+int register_benchmark(const char* name, BenchmarkFunc func);
+
+// returns the average milliseconds of one iteration
+double measure_ms(int iterations, const std::function<void()>& func);
+
+#define BENCHMARK_CASE(name, func) \
+    static void func(); \
+    static int func##_registered = register_benchmark(name, func); \
+    static void func()
@@ -0,0 +1,176 @@
+#include "openswf_bench.hpp"
+#include "render_software.hpp"
+#include "render_context.hpp"
+#include "atlas.hpp"
+
+#include <memory>
+#include <random>
+
+using namespace openswf;
+
+// fills of a few distinct linear gradients scattered as a grid of squares,
+// as shapes of a movie which reuse styles. each fill owns a texture without
+// the atlas, which breaks batches even when draws are reordered.
+BENCHMARK_CASE("GRADIENT_ATLAS", bench_gradient_atlas)
+{
+    const int width = 320, height = 240;
+    const int columns = 20, rows = 15, distinct = 16;
+    const int fills = columns*rows;
+
+    std::mt19937 random(11);
+    std::uniform_int_distribution<int> channel(0, 255);
+    std::vector<BitmapPtr> gradients;
+    for( auto i=0; i<distinct; i++ )
+    {
+        auto from = Color(channel(random), channel(random), channel(random), 255);
+        auto to = Color(channel(random), channel(random), channel(random), 255);
+        auto bitmap = BitmapRGBA8::create(GradientPageWidth, 1);
+        for( auto j=0; j<GradientPageWidth; j++ )
+            bitmap->set(0, j, Color::lerp(from, to, (float)j/(GradientPageWidth-1)));
+        gradients.push_back(std::move(bitmap));
+    }
+
+    for( auto shared : { false, true } )
+    {
+        std::unique_ptr<RenderContext> context(RenderContext::create(SoftwareRender::create(1), width, height));
+        auto& render = context->get_render();
+        auto& shader = context->get_shader();
+        render.set_viewport(0, 0, width, height);
+
+        std::unique_ptr<GradientAtlas> atlas(GradientAtlas::create());
+        std::vector<Rid> textures;
+        std::vector<float> texcoords;
+        uint64_t bytes = 0;
+        for( auto i=0; i<fills; i++ )
+        {
+            auto& gradient = *gradients[i*7 % distinct];
+            if( shared )
+            {
+                auto slot = atlas->insert(gradient);
+                textures.push_back(atlas->get_texture_rid(slot.page, render));
+                texcoords.push_back(slot.row);
+            }
+            else
+            {
+                textures.push_back(render.create_texture(gradient.get_ptr(),
+                    gradient.get_width(), gradient.get_height(), gradient.get_format(), 1));
+                texcoords.push_back(0.5f);
+                bytes += gradient.get_size() * 4 / 3;
+            }
+        }
+
+        if( shared )
+            bytes = atlas->get_stats().bytes_after;
+
+        const int frames = 60;
+        uint64_t draws = 0;
+        Matrix matrix;
+        auto ms = measure_ms(frames, [&]()
+        {
+            render.clear(CLEAR_COLOR, 0, 0, 0, 255);
+            shader.set_program(PROGRAM_DEFAULT);
+            for( auto i=0; i<fills; i++ )
+            {
+                auto v = texcoords[i];
+                VertexPack quad[4] = {
+                    VertexPack(0, 0, 0, v), VertexPack(14, 0, 1, v),
+                    VertexPack(14, 14, 1, v), VertexPack(0, 14, 0, v) };
+
+                matrix.values[0][2] = (float)(i % columns * 16);
+                matrix.values[1][2] = (float)(i / columns * 16);
+                shader.set_texture(0, textures[i]);
+                shader.draw(quad[0], quad[1], quad[2], quad[3], matrix);
+            }
+            shader.end_frame();
+            render.finish();
+            draws += shader.get_frame_stats().draw_calls;
+        });
+
+        printf("%d fills of %d gradients, atlas %d: %8.3f ms/frame, %6.1f draws/frame, %6llu texture bytes\n",
+            fills, distinct, shared ? 1 : 0, ms, (double)draws / frames, (unsigned long long)bytes);
+
+        if( !shared )
+        {
+            for( auto rid : textures )
+                render.release(RenderObject::TEXTURE, rid);
+        }
+    }
+}
+
+// icons of an interface, each of which is a small image of its own. they are
+// drawn as images are, with textures of their own or in atlas pages.
+BENCHMARK_CASE("IMAGE_ATLAS", bench_image_atlas)
+{
+    const int width = 640, height = 480;
+    const int columns = 20, rows = 15;
+    const int icons = columns*rows;
+
+    std::mt19937 random(13);
+    std::uniform_int_distribution<int> size(12, 28), channel(0, 255);
+
+    for( auto packed : { false, true } )
+    {
+        std::unique_ptr<RenderContext> context(RenderContext::create(SoftwareRender::create(1), width, height));
+        auto& render = context->get_render();
+        auto& shader = context->get_shader();
+        render.set_viewport(0, 0, width, height);
+
+        random.seed(13);
+        std::vector<std::unique_ptr<Image>> images;
+        std::vector<Image*> pointers;
+        for( auto i=0; i<icons; i++ )
+        {
+            auto bitmap = BitmapRGBA8::create(size(random), size(random));
+            auto color = Color(channel(random), channel(random), channel(random), 255);
+            for( auto y=0; y<bitmap->get_height(); y++ )
+                for( auto x=0; x<bitmap->get_width(); x++ )
+                    bitmap->set(y, x, color);
+
+            images.push_back(std::unique_ptr<Image>(Image::create(i+1, std::move(bitmap))));
+            pointers.push_back(images.back().get());
+        }
+
+        std::unique_ptr<ImageAtlas> atlas(ImageAtlas::create());
+        if( packed )
+            atlas->pack(pointers);
+
+        uint64_t bytes = 0;
+        for( auto image : pointers )
+            bytes += packed ? 0 : image->get_bitmap().get_size() * 4 / 3;
+        if( packed )
+            bytes = atlas->get_stats().bytes_pages;
+
+        const int frames = 60;
+        uint64_t draws = 0;
+        Matrix matrix;
+        auto ms = measure_ms(frames, [&]()
+        {
+            render.clear(CLEAR_COLOR, 0, 0, 0, 255);
+            shader.set_program(PROGRAM_DEFAULT);
+            for( auto i=0; i<icons; i++ )
+            {
+                auto image = pointers[i];
+                auto w = image->get_width(), h = image->get_height();
+                VertexPack quad[4] = {
+                    VertexPack(Point2f(0, 0), image->get_texcoord(Point2f(0, 0))),
+                    VertexPack(Point2f(w, 0), image->get_texcoord(Point2f(1, 0))),
+                    VertexPack(Point2f(w, h), image->get_texcoord(Point2f(1, 1))),
+                    VertexPack(Point2f(0, h), image->get_texcoord(Point2f(0, 1))) };
+
+                matrix.values[0][2] = (float)(i % columns * 32);
+                matrix.values[1][2] = (float)(i / columns * 32);
+                shader.set_texture(0, image->get_texture_rid(render));
+                shader.draw(quad[0], quad[1], quad[2], quad[3], matrix);
+            }
+            shader.end_frame();
+            render.finish();
+            draws += shader.get_frame_stats().draw_calls;
+        });
+
+        printf("%d icons, atlas %d: %8.3f ms/frame, %6.1f draws/frame, %8llu texture bytes\n",
+            icons, packed ? 1 : 0, ms, (double)draws / frames, (unsigned long long)bytes);
+
+        // images are released before pages of atlas
+        images.clear();
+    }
+}
@@ -0,0 +1,413 @@
+#include "openswf_bench.hpp"
+#include "avm/virtual_machine.hpp"
+#include "avm/string_object.hpp"
+
+#include <memory>
+
+using namespace openswf;
+using namespace openswf::avm;
+
+// arithmetic and variable access on a counter, repeated without jumps. the
+// counter is named by the constant pool, so that nothing is allocated.
+static std::vector<uint8_t> create_counter_block(int repeats, int& instructions)
+{
+    ActionWriter writer;
+    writer.constants({ "i" });
+    writer.begin_push().push_constant(0).push_integer(0).end_push().op(Opcode::SET_VARIABLE);
+
+    for( auto i=0; i<repeats; i++ )
+    {
+        writer.begin_push().push_integer(3).push_integer(4).end_push().op(Opcode::MULTIPLY);
+        writer.begin_push().push_integer(5).end_push().op(Opcode::ADD);
+        writer.begin_push().push_integer(2).end_push().op(Opcode::SUBTRACT).op(Opcode::POP);
+
+        writer.begin_push().push_constant(0).push_constant(0).end_push().op(Opcode::GET_VARIABLE);
+        writer.begin_push().push_integer(1).end_push().op(Opcode::ADD).op(Opcode::SET_VARIABLE);
+    }
+
+    instructions = 3 + repeats * 12;
+    return writer.finish();
+}
+
+// stack operations only, which shows the cost of dispatch itself
+static std::vector<uint8_t> create_arithmetic_block(int repeats, int& instructions)
+{
+    ActionWriter writer;
+    for( auto i=0; i<repeats; i++ )
+    {
+        writer.begin_push().push_integer(3).push_integer(4).end_push().op(Opcode::MULTIPLY);
+        writer.begin_push().push_integer(5).end_push().op(Opcode::ADD).op(Opcode::POP);
+    }
+
+    instructions = 1 + repeats * 5;
+    return writer.finish();
+}
+
+// synthetic DoAction blocks executed on the root context of a movie,
+// reporting the average time of one instruction.
+BENCHMARK_CASE("AVM_DISPATCH", bench_avm_dispatch)
+{
+    Parser::initialize();
+
+    auto stream = create_from_file("../test/resources/simple-timeline-1.swf");
+    std::unique_ptr<Player> player(Player::create(stream));
+    auto& vm = player->get_virtual_machine();
+    auto context = player->get_root().get_context();
+
+    const int repeats = 200, runs = 500;
+    int instructions = 0;
+    auto bytes = create_arithmetic_block(repeats, instructions);
+    BytecodePtr arithmetic(Bytecode::create(bytes.data(), bytes.size()));
+    auto ms = measure_ms(runs, [&]()
+    {
+        vm.execute(context, *arithmetic);
+    });
+
+    printf("arithmetic, %6d instructions/block: %8.3f ms/block, %6.2f ns/instruction\n",
+        instructions, ms, ms * 1e6 / instructions);
+
+    bytes = create_counter_block(repeats, instructions);
+    BytecodePtr counter(Bytecode::create(bytes.data(), bytes.size()));
+    ms = measure_ms(runs, [&]()
+    {
+        vm.execute(context, *counter);
+    });
+
+    printf("variables,  %6d instructions/block: %8.3f ms/block, %6.2f ns/instruction, counter %d\n",
+        instructions, ms, ms * 1e6 / instructions, context->get_variable("i").to_integer());
+}
+
+// a script of one frame as exported by authoring tools, with a constant
+// pool, string literals and a short loop. it's executed once per frame of
+// a looping timeline, decoded every time or once.
+BENCHMARK_CASE("AVM_BYTECODE_CACHE", bench_avm_bytecode_cache)
+{
+    Parser::initialize();
+
+    auto stream = create_from_file("../test/resources/simple-timeline-1.swf");
+    std::unique_ptr<Player> player(Player::create(stream));
+    auto& vm = player->get_virtual_machine();
+    auto context = player->get_root().get_context();
+
+    ActionWriter writer;
+    writer.constants({ "score", "lives", "speed", "i", "label" });
+    writer.begin_push().push_constant(0).push_integer(0).end_push().op(Opcode::SET_VARIABLE);
+    writer.begin_push().push_constant(1).push_integer(3).end_push().op(Opcode::SET_VARIABLE);
+    writer.begin_push().push_constant(2).push_double(1.5).end_push().op(Opcode::SET_VARIABLE);
+    writer.begin_push().push_constant(4).push_string("running").end_push().op(Opcode::SET_VARIABLE);
+    writer.begin_push().push_constant(3).push_integer(0).end_push().op(Opcode::SET_VARIABLE);
+
+    auto loop = writer.label();
+    writer.begin_push().push_constant(3).end_push().op(Opcode::GET_VARIABLE);
+    writer.begin_push().push_integer(8).end_push().op(Opcode::LESS).op(Opcode::NOT);
+    auto exit = writer.jump(Opcode::IF);
+    writer.begin_push().push_constant(0).push_constant(0).end_push().op(Opcode::GET_VARIABLE);
+    writer.begin_push().push_constant(2).end_push().op(Opcode::GET_VARIABLE).op(Opcode::ADD).op(Opcode::SET_VARIABLE);
+    writer.begin_push().push_constant(3).push_constant(3).end_push().op(Opcode::GET_VARIABLE);
+    writer.begin_push().push_integer(1).end_push().op(Opcode::ADD).op(Opcode::SET_VARIABLE);
+    writer.jump(Opcode::JUMP, loop);
+    writer.patch(exit, writer.label());
+    auto& bytes = writer.finish();
+
+    const int frames = 20000;
+    for( auto cached : { false, true } )
+    {
+        BytecodePtr bytecode(Bytecode::create(bytes.data(), bytes.size()));
+        auto ms = measure_ms(frames, [&]()
+        {
+            if( cached )
+                vm.execute(context, *bytecode);
+            else
+                vm.execute(context, bytes.data(), bytes.size());
+        });
+
+        printf("frame script of %3d bytes, cached %d: %8.4f ms/frame, score %.1f\n",
+            (int)bytes.size(), cached ? 1 : 0, ms, context->get_variable("score").to_number());
+    }
+}
+
+// frames of a movie which keep a large set of objects alive, replacing some
+// of them and making short lived garbage each frame. stop-the-world collects
+// everything once objects double, as the heap did, incremental steps the heap
+// in slices of 1 ms per frame.
+BENCHMARK_CASE("AVM_GC", bench_avm_gc)
+{
+    Parser::initialize();
+
+    const int live = 20000, replaced = 50, garbage = 500, frames = 600;
+    for( auto incremental : { false, true } )
+    {
+        auto stream = create_from_file("../test/resources/simple-timeline-1.swf");
+        std::unique_ptr<Player> player(Player::create(stream));
+        auto& vm = player->get_virtual_machine();
+        auto& heap = vm.get_heap();
+        auto context = player->get_root().get_context();
+
+        std::vector<StringObject*> slots;
+        for( auto i=0; i<live; i++ )
+            slots.push_back(vm.intern(("slot" + std::to_string(i)).c_str()));
+        auto link = vm.intern("link");
+        BytecodePtr empty(Bytecode::create(nullptr, 0));
+
+        if( !incremental )
+            heap.set_nursery_size(0xFFFFFFFF);
+
+        uint32_t threshold = live * 2;
+        int frame = 0;
+        auto ms = measure_ms(frames, [&]()
+        {
+            auto count = frame == 0 ? live : replaced;
+            for( auto i=0; i<count; i++ )
+            {
+                auto object = vm.new_object<ScriptObject>();
+                object->set_variable(link, Value().set_object(vm.new_object<ScriptObject>()));
+                context->set_variable(slots[(frame * replaced + i) % live], Value().set_object(object));
+            }
+
+            for( auto i=0; i<garbage; i++ )
+                vm.new_object<ScriptObject>();
+
+            vm.execute(context, *empty);
+            if( incremental )
+                heap.step();
+            else if( vm.get_object_count() > threshold )
+            {
+                vm.gabarge_collect();
+                threshold = vm.get_object_count() * 2;
+            }
+            frame ++;
+        });
+
+        auto& stats = heap.get_stats();
+        uint32_t pauses = 0, long_pauses = 0;
+        for( auto i=0; i<GCPauseBuckets; i++ )
+        {
+            pauses += stats.pauses[i];
+            long_pauses += i >= GCPauseBuckets-5 ? stats.pauses[i] : 0;
+        }
+
+        printf("incremental %d: %8.3f ms/frame, %5u pauses, %3u over %.0f ms, max %6.3f ms, %u minor %u major\n",
+            incremental ? 1 : 0, ms, pauses, long_pauses, GCPauseBounds[GCPauseBuckets-6],
+            stats.pause_max_ms, stats.minor_collections, stats.major_collections);
+    }
+}
+
+// throughput of allocating short lived strings and objects and sweeping them
+// as garbage, then of marking and sweeping the same number of live objects.
+BENCHMARK_CASE("AVM_HEAP_ALLOC", bench_avm_heap_alloc)
+{
+    Parser::initialize();
+
+    auto stream = create_from_file("../test/resources/simple-timeline-1.swf");
+    std::unique_ptr<Player> player(Player::create(stream));
+    auto& vm = player->get_virtual_machine();
+    auto& heap = vm.get_heap();
+    auto context = player->get_root().get_context();
+    heap.set_nursery_size(0xFFFFFFFF);
+
+    const int objects = 50000, rounds = 20;
+    double alloc_ms = 0, sweep_ms = 0;
+    for( auto round=0; round<rounds; round++ )
+    {
+        alloc_ms += measure_ms(1, [&]()
+        {
+            for( auto i=0; i<objects/2; i++ )
+            {
+                vm.new_object<StringObject>();
+                vm.new_object<ScriptObject>();
+            }
+        });
+
+        sweep_ms += measure_ms(1, [&]() { vm.gabarge_collect(); });
+    }
+
+    printf("garbage, %d objects: %6.1f ns/allocation, %6.1f ns/sweep\n",
+        objects, alloc_ms * 1e6 / (objects * rounds), sweep_ms * 1e6 / (objects * rounds));
+
+    // a list of live objects from a variable of root, marked and swept as old
+    auto next = vm.intern("next");
+    ScriptObject* last = nullptr;
+    for( auto i=0; i<objects; i++ )
+    {
+        auto object = vm.new_object<ScriptObject>();
+        if( last != nullptr )
+            object->set_variable(next, Value().set_object(last));
+        last = object;
+    }
+
+    context->set_variable("list", Value().set_object(last));
+    vm.gabarge_collect();
+
+    auto ms = measure_ms(rounds, [&]() { vm.gabarge_collect(); });
+    printf("live, %d objects: %6.1f ns/object marked and swept, %u objects\n",
+        objects, ms * 1e6 / objects, vm.get_object_count());
+}
+
+// sizes of values where they are stored, and expressions of doubles, which
+// are the results of any arithmetic.
+BENCHMARK_CASE("AVM_VALUE", bench_avm_value)
+{
+    Parser::initialize();
+
+    auto stream = create_from_file("../test/resources/simple-timeline-1.swf");
+    std::unique_ptr<Player> player(Player::create(stream));
+    auto& vm = player->get_virtual_machine();
+    auto context = player->get_root().get_context();
+
+    printf("value %d bytes, literal %d bytes, operand stack %d bytes, variable entry %d bytes\n",
+        (int)sizeof(Value), (int)sizeof(Literal), (int)(sizeof(Value) * MaxOperands),
+        (int)sizeof(VariableMap::value_type));
+
+    const int repeats = 200, runs = 500;
+    ActionWriter writer;
+    for( auto i=0; i<repeats; i++ )
+    {
+        writer.begin_push().push_double(1.5).push_double(2.25).end_push().op(Opcode::MULTIPLY);
+        writer.begin_push().push_double(0.5).end_push().op(Opcode::ADD);
+        writer.begin_push().push_double(3.0).end_push().op(Opcode::DIVIDE);
+        writer.begin_push().push_double(1.0).end_push().op(Opcode::LESS).op(Opcode::POP);
+    }
+
+    auto& bytes = writer.finish();
+    auto instructions = 1 + repeats * 9;
+    BytecodePtr bytecode(Bytecode::create(bytes.data(), bytes.size()));
+    auto ms = measure_ms(runs, [&]() { vm.execute(context, *bytecode); });
+
+    printf("doubles, %5d instructions/block: %8.3f ms/block, %6.2f ns/instruction\n",
+        instructions, ms, ms * 1e6 / instructions);
+}
+
+// reads of timeline variables and members of an object with a dozen of
+// variables each, repeated without jumps.
+BENCHMARK_CASE("AVM_INLINE_CACHE", bench_avm_inline_cache)
+{
+    Parser::initialize();
+
+    auto stream = create_from_file("../test/resources/simple-timeline-1.swf");
+    std::unique_ptr<Player> player(Player::create(stream));
+    auto& vm = player->get_virtual_machine();
+    auto context = player->get_root().get_context();
+
+    auto object = vm.new_object<ScriptObject>();
+    for( auto i=0; i<12; i++ )
+    {
+        auto index = std::to_string(i);
+        object->set_variable(vm.intern(("p" + index).c_str()), Value().set_integer(i));
+        context->set_variable(("v" + index).c_str(), Value().set_integer(i));
+    }
+    context->set_variable("obj", Value().set_object(object));
+
+    const int repeats = 100, runs = 500;
+    ActionWriter writer;
+    writer.constants({ "sum", "obj", "p7", "p11", "v9" });
+    writer.begin_push().push_constant(0).push_integer(0).end_push().op(Opcode::SET_VARIABLE);
+    for( auto i=0; i<repeats; i++ )
+    {
+        writer.begin_push().push_constant(0).push_constant(0).end_push().op(Opcode::GET_VARIABLE);
+        writer.begin_push().push_constant(1).end_push().op(Opcode::GET_VARIABLE);
+        writer.begin_push().push_constant(2).end_push().op(Opcode::GET_MEMBER).op(Opcode::ADD);
+        writer.begin_push().push_constant(1).end_push().op(Opcode::GET_VARIABLE);
+        writer.begin_push().push_constant(3).end_push().op(Opcode::GET_MEMBER).op(Opcode::ADD);
+        writer.begin_push().push_constant(4).end_push().op(Opcode::GET_VARIABLE).op(Opcode::ADD);
+        writer.op(Opcode::SET_VARIABLE);
+    }
+
+    auto& bytes = writer.finish();
+    auto instructions = 3 + repeats * 17;
+    BytecodePtr bytecode(Bytecode::create(bytes.data(), bytes.size()));
+    auto ms = measure_ms(runs, [&]() { vm.execute(context, *bytecode); });
+
+    printf("lookups, %5d instructions/block: %8.3f ms/block, %6.2f ns/instruction, sum %d\n",
+        instructions, ms, ms * 1e6 / instructions, context->get_variable("sum").to_integer());
+}
+
+// sprites placed on and removed from the root timeline, with contexts for
+// all of them as if each ran a script, and for none.
+BENCHMARK_CASE("AVM_CONTEXT_CHURN", bench_avm_context_churn)
+{
+    Parser::initialize();
+
+    auto stream = create_from_file("../test/resources/simple-timeline-1.swf");
+    std::unique_ptr<Player> player(Player::create(stream));
+    auto& root = player->get_root();
+
+    const uint16_t cid = 0xFFF0;
+    player->set_character(cid, new MovieClip(cid, 1, 24.f));
+
+    const int sprites = 10000, rounds = 10;
+    for( auto scripted : { true, false } )
+    {
+        auto ms = measure_ms(rounds, [&]()
+        {
+            for( auto i=0; i<sprites; i++ )
+            {
+                auto node = dynamic_cast<MovieNode*>(root.set(i, cid));
+                if( scripted )
+                    node->get_context();
+            }
+            root.reset();
+        });
+
+        printf("%s, %d sprites: %8.3f ms/round, %6.1f ns/sprite\n",
+            scripted ? "scripted" : "plain   ", sprites, ms, ms * 1e6 / sprites);
+    }
+}
+
+// the counter block of AVM_DISPATCH with profiling disabled and enabled,
+// which times every instruction.
+BENCHMARK_CASE("AVM_PROFILER", bench_avm_profiler)
+{
+    Parser::initialize();
+
+    auto stream = create_from_file("../test/resources/simple-timeline-1.swf");
+    std::unique_ptr<Player> player(Player::create(stream));
+    auto& vm = player->get_virtual_machine();
+    auto context = player->get_root().get_context();
+
+    const int repeats = 200, runs = 500;
+    int instructions = 0;
+    auto bytes = create_counter_block(repeats, instructions);
+    BytecodePtr counter(Bytecode::create(bytes.data(), bytes.size()));
+
+    for( auto enabled : { false, true } )
+    {
+        vm.set_profiling(enabled);
+        auto ms = measure_ms(runs, [&]() { vm.execute(context, *counter, ActionSite(1, 1)); });
+        printf("%s, %6d instructions/block: %8.3f ms/block, %6.2f ns/instruction\n",
+            enabled ? "profiled" : "disabled", instructions, ms, ms * 1e6 / instructions);
+    }
+
+    auto json = vm.get_profiler()->to_json();
+    printf("%d bytes of json\n", (int)json.size());
+    vm.set_profiling(false);
+}
+
+// a counter loop of backward jumps, each of which is charged to the budget
+// of instructions.
+BENCHMARK_CASE("AVM_SCRIPT_LIMITS", bench_avm_script_limits)
+{
+    Parser::initialize();
+
+    auto stream = create_from_file("../test/resources/simple-timeline-1.swf");
+    std::unique_ptr<Player> player(Player::create(stream));
+    auto& vm = player->get_virtual_machine();
+    auto context = player->get_root().get_context();
+
+    const int iterations = 100000, runs = 20;
+    ActionWriter writer;
+    writer.constants({ "i" });
+    writer.begin_push().push_constant(0).push_integer(0).end_push().op(Opcode::SET_VARIABLE);
+    auto loop = writer.label();
+    writer.begin_push().push_constant(0).push_constant(0).end_push().op(Opcode::GET_VARIABLE);
+    writer.begin_push().push_integer(1).end_push().op(Opcode::ADD).op(Opcode::SET_VARIABLE);
+    writer.begin_push().push_constant(0).end_push().op(Opcode::GET_VARIABLE);
+    writer.begin_push().push_integer(iterations).end_push().op(Opcode::LESS);
+    writer.jump(Opcode::IF, loop);
+
+    auto& bytes = writer.finish();
+    BytecodePtr bytecode(Bytecode::create(bytes.data(), bytes.size()));
+    auto ms = measure_ms(runs, [&]() { vm.execute(context, *bytecode); });
+
+    printf("loop, %d iterations: %8.3f ms/block, %6.2f ns/iteration, counter %d\n",
+        iterations, ms, ms * 1e6 / iterations, context->get_variable("i").to_integer());
+}
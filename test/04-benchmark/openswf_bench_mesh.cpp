@@ -0,0 +1,72 @@
+#include "openswf_bench.hpp"
+
+#include <algorithm>
+#include <random>
+
+using namespace openswf;
+
+// a disk with bumpy edge, tessellated into a mesh of one fill
+static ShapeMeshPtr create_disk(int edges)
+{
+    ShapePath path;
+    path.right_fill = 1;
+    path.restart(Point2f(20000, 0));
+    for( auto i=1; i<=edges; i++ )
+    {
+        auto angle = 6.2831853f * (float)(i % edges) / (float)edges;
+        auto radius = i % 2 == 0 ? 20000.f : 18000.f;
+        path.edges.push_back(ShapeEdge(Point2f(
+            std::floor(radius*std::cos(angle)), std::floor(radius*std::sin(angle)))));
+    }
+
+    auto record = ShapeRecord::create(Rect(), ShapePathList(1, path), 1);
+    return ShapeMesh::create(*record, ShapeLineList(), 0);
+}
+
+BENCHMARK_CASE("MESH_OPTIMIZATION", bench_mesh_optimization)
+{
+    int sizes[] = { 1000, 10000, 50000 };
+    for( auto size : sizes )
+    {
+        auto mesh = create_disk(size);
+        auto& stats = mesh->stats;
+        printf("disk %6d edges: vertices %7u -> %7u, indices %7u -> %7u, acmr(16) %.3f\n",
+            size, stats.vertices_before, stats.vertices_after,
+            stats.indices_before, stats.indices_after,
+            MeshOptimizer::get_acmr(mesh->indices.data(), mesh->indices.size(), 16));
+
+        // unweld vertices and shuffle triangles to measure the optimizer alone
+        VertexPackList vertices;
+        IndexList indices;
+        std::vector<uint32_t> order(mesh->indices.size() / 3);
+        for( auto i=0; i<order.size(); i++ ) order[i] = i;
+
+        std::mt19937 random(size);
+        std::shuffle(order.begin(), order.end(), random);
+        for( auto triangle : order )
+        {
+            for( auto j=0; j<3; j++ )
+            {
+                indices.push_back(vertices.size());
+                vertices.push_back(mesh->vertices[mesh->indices[triangle*3+j]]);
+            }
+        }
+
+        auto before = MeshOptimizer::get_acmr(indices.data(), indices.size(), 16);
+        VertexPackList optimized_vertices;
+        IndexList optimized_indices;
+        uint32_t vsize = 0, isize = 0;
+        auto ms = measure_ms(5, [&]()
+        {
+            optimized_vertices = vertices;
+            optimized_indices = indices;
+            vsize = vertices.size();
+            isize = indices.size();
+            MeshOptimizer::optimize(optimized_vertices.data(), vsize, optimized_indices.data(), isize);
+        });
+
+        printf("  shuffled %7d vertices -> %7u, acmr(16) %.3f -> %.3f: %8.3f ms\n",
+            (int)vertices.size(), vsize, before,
+            MeshOptimizer::get_acmr(optimized_indices.data(), isize, 16), ms);
+    }
+}
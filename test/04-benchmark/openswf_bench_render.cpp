@@ -0,0 +1,256 @@
+#include "openswf_bench.hpp"
+#include "render_software.hpp"
+#include "render_context.hpp"
+
+#include <memory>
+#include <random>
+#include <thread>
+
+using namespace openswf;
+
+const static int BenchWidth     = 1024;
+const static int BenchHeight    = 768;
+
+static void print_throughput(const char* name, int threads, double ms, const RenderStats& stats, int frames)
+{
+    auto seconds = ms * frames / 1000.0;
+    printf("%-32s threads %2d: %8.3f ms/frame, %8.1f Mpix/s, %8.3f Mtri/s\n",
+        name, threads, ms,
+        (double)stats.pixels / seconds / 1e6, (double)stats.triangles / seconds / 1e6);
+}
+
+// random translucent triangles of various sizes, with fixed seed
+BENCHMARK_CASE("SOFTWARE_RASTER", bench_software_raster)
+{
+    const int count = 20000;
+    std::mt19937 random(7);
+    std::uniform_real_distribution<float> x(-64.f, BenchWidth+64.f), y(-64.f, BenchHeight+64.f);
+    std::uniform_real_distribution<float> offset(-48.f, 48.f);
+    std::uniform_int_distribution<int> channel(0, 255);
+
+    std::vector<VertexPack> vertices;
+    std::vector<uint16_t> indices;
+    for( auto i=0; i<count; i++ )
+    {
+        auto cx = x(random), cy = y(random);
+        auto color = Color(channel(random), channel(random), channel(random), 160);
+        for( auto j=0; j<3; j++ )
+        {
+            VertexPack vertex(cx+offset(random), cy+offset(random), 0.f, 0.f);
+            vertex.additive = color;
+            vertices.push_back(vertex);
+            // 16-bit indices are relative to the part of 60000 vertices
+            indices.push_back((uint16_t)(indices.size() % 60000));
+        }
+    }
+
+    int thread_counts[] = { 1, 2, 4, (int)std::thread::hardware_concurrency() };
+    for( auto threads : thread_counts )
+    {
+        if( threads <= 0 ) continue;
+
+        std::unique_ptr<SoftwareRender> render(SoftwareRender::create(threads));
+        const char* uniforms[] = { "transform" };
+        auto program = render->create_shader("", "", 4, 0, nullptr, 1, uniforms);
+        auto vb = render->create_buffer(RenderObject::VERTEX_BUFFER,
+            vertices.data(), (int)(vertices.size()*sizeof(VertexPack)));
+        auto ib = render->create_buffer(RenderObject::INDEX_BUFFER,
+            indices.data(), (int)(indices.size()*sizeof(uint16_t)));
+
+        float projection[16] = {
+            2.f/BenchWidth, 0, 0, 0,
+            0, -2.f/BenchHeight, 0, 0,
+            0, 0, 1, 0,
+            -1, 1, 0, 1 };
+
+        const auto stride = sizeof(VertexPack);
+        render->set_viewport(0, 0, BenchWidth, BenchHeight);
+        render->set_blend(BlendFunc::ONE, BlendFunc::ONE_MINUS_SRC_ALPHA);
+        render->bind_shader(program);
+        render->bind_uniform(0, UniformFormat::MATRIX_F44, projection);
+        render->bind_index_buffer(ib, ElementFormat::UNSIGNED_SHORT, 0, 0);
+
+        const int frames = 10;
+        auto ms = measure_ms(frames, [&]()
+        {
+            render->clear(CLEAR_COLOR, 0, 0, 0, 255);
+            for( auto base=0; base<count*3; base+=60000 )
+            {
+                // attributes start at the first vertex of this part
+                auto number = std::min(60000, count*3 - base);
+                render->bind_vertex_buffer(0, vb, 2, ElementFormat::FLOAT, stride, base*stride);
+                render->bind_vertex_buffer(1, vb, 2, ElementFormat::FLOAT, stride, base*stride+8);
+                render->bind_vertex_buffer(2, vb, 4, ElementFormat::UNSIGNED_BYTE, stride, base*stride+16, true);
+                render->bind_vertex_buffer(3, vb, 4, ElementFormat::UNSIGNED_BYTE, stride, base*stride+20, true);
+                render->draw(DrawMode::TRIANGLE, base, number);
+            }
+            render->finish();
+        });
+
+        print_throughput("random triangles", threads, ms, render->get_stats(), frames);
+    }
+}
+
+static const char* BenchMovies[] = {
+    "../test/resources/simple-shape-1.swf",
+    "../test/resources/simple-shape-2.swf",
+    "../test/resources/simple-timeline-1.swf",
+    "../test/resources/simple-timeline-2.swf",
+};
+
+// movies of test resources are played through the player with software render
+BENCHMARK_CASE("SOFTWARE_RENDER_MOVIE", bench_software_render_movie)
+{
+    Parser::initialize();
+
+    auto software = SoftwareRender::create();
+    std::unique_ptr<RenderContext> context(RenderContext::create(software, BenchWidth, BenchHeight));
+    if( context == nullptr )
+    {
+        printf("failed to create software render\n");
+        return;
+    }
+
+    auto& render = context->get_render();
+    auto& shader = context->get_shader();
+
+    for( auto path : BenchMovies )
+    {
+        auto stream = create_from_file(path);
+        auto player = Player::create(stream);
+        if( player == nullptr )
+        {
+            printf("failed to load %s\n", path);
+            continue;
+        }
+
+        render.set_viewport(0, 0, BenchWidth, BenchHeight);
+        render.reset_stats();
+
+        const int frames = 60;
+        auto ms = measure_ms(frames, [&]()
+        {
+            player->update(1.f / 24.f);
+            shader.set_program(PROGRAM_DEFAULT);
+            player->render(*context);
+            shader.end_frame();
+            render.finish();
+        });
+
+        print_throughput(strrchr(path, '/') + 1, software->get_thread_count(), ms, render.get_stats(), frames);
+        delete player;
+    }
+}
+
+// players are rendered in parallel, each thread owns a render context of
+// single-threaded software render and plays all of the test movies.
+BENCHMARK_CASE("RENDER_CONTEXT_SCALING", bench_render_context_scaling)
+{
+    Parser::initialize();
+
+    const int frames = 60;
+    const int width = 320, height = 240;
+    const int movie_count = sizeof(BenchMovies) / sizeof(BenchMovies[0]);
+
+    int thread_counts[] = { 1, 2, 4, (int)std::thread::hardware_concurrency() };
+    for( auto threads : thread_counts )
+    {
+        if( threads <= 0 ) continue;
+
+        auto ms = measure_ms(1, [&]()
+        {
+            std::vector<std::thread> workers;
+            for( auto i=0; i<threads; i++ )
+            {
+                workers.push_back(std::thread([&]()
+                {
+                    std::unique_ptr<RenderContext> context(
+                        RenderContext::create(SoftwareRender::create(1), width, height));
+                    if( context == nullptr ) return;
+
+                    auto& render = context->get_render();
+                    auto& shader = context->get_shader();
+                    render.set_viewport(0, 0, width, height);
+
+                    for( auto path : BenchMovies )
+                    {
+                        auto stream = create_from_file(path);
+                        std::unique_ptr<Player> player(Player::create(stream));
+                        if( player == nullptr ) continue;
+
+                        for( auto frame=0; frame<frames; frame++ )
+                        {
+                            player->update(1.f / 24.f);
+                            shader.set_program(PROGRAM_DEFAULT);
+                            player->render(*context);
+                            shader.end_frame();
+                            render.finish();
+                        }
+                    }
+                }));
+            }
+
+            for( auto& worker : workers )
+                worker.join();
+        });
+
+        auto total = threads * movie_count * frames;
+        printf("players %dx%d threads %2d: %8.3f ms, %8.1f frames/s\n",
+            width, height, threads, ms, total * 1000.0 / ms);
+    }
+}
+
+// a dense scene of small quads in one state, which are flushed only when the
+// batch ring wraps. a ring limited to the default capacity acts as the fixed
+// batch arrays of before.
+BENCHMARK_CASE("BATCH_STREAMING", bench_batch_streaming)
+{
+    const int quads = 16000;
+    const int width = 320, height = 240;
+
+    int max_capacities[] = { DefaultBatchCapacity, MaxBatchCapacity };
+    for( auto max_capacity : max_capacities )
+    {
+        auto render = SoftwareRender::create(1);
+        auto screen = Screen::create(width, height);
+        auto shader = Shader::create(*render, *screen, DefaultBatchCapacity, max_capacity);
+
+        const char* textures[] = { "texture0" };
+        const char* uniforms[] = { "transform" };
+        shader->create(PROGRAM_DEFAULT, "", "", 1, textures, 1, uniforms);
+        render->set_viewport(0, 0, width, height);
+
+        VertexPack quad[4] = {
+            VertexPack(0, 0, 0, 0), VertexPack(2, 0, 0, 0),
+            VertexPack(2, 2, 0, 0), VertexPack(0, 2, 0, 0) };
+
+        Matrix matrix;
+        const int frames = 20;
+        BatchStats total;
+        auto ms = measure_ms(frames, [&]()
+        {
+            render->clear(CLEAR_COLOR, 0, 0, 0, 255);
+            shader->set_program(PROGRAM_DEFAULT);
+            for( auto i=0; i<quads; i++ )
+            {
+                matrix.values[0][2] = (float)(i % width);
+                matrix.values[1][2] = (float)((i / width) % height);
+                shader->draw(quad[0], quad[1], quad[2], quad[3], matrix);
+            }
+            shader->end_frame();
+            render->finish();
+
+            auto& stats = shader->get_frame_stats();
+            total.draw_calls += stats.draw_calls;
+            total.bytes_uploaded += stats.bytes_uploaded;
+        });
+
+        printf("%d quads, max capacity %5d: %8.3f ms/frame, %6.1f draws/frame, %8.1f KB/frame, capacity %d\n",
+            quads, max_capacity, ms, (double)total.draw_calls / frames,
+            (double)total.bytes_uploaded / frames / 1024.0, shader->get_capacity());
+
+        delete shader;
+        delete screen;
+        delete render;
+    }
+}
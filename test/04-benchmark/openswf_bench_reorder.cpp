@@ -0,0 +1,112 @@
+#include "openswf_bench.hpp"
+#include "render_software.hpp"
+#include "render_context.hpp"
+
+#include <memory>
+
+using namespace openswf;
+
+static const char* ReorderMovies[] = {
+    "../test/resources/simple-shape-1.swf",
+    "../test/resources/simple-shape-2.swf",
+    "../test/resources/simple-timeline-1.swf",
+    "../test/resources/simple-timeline-2.swf",
+};
+
+// movies of test resources are played with draws reordered or not, comparing
+// draw calls and time of a frame.
+BENCHMARK_CASE("PACKET_REORDER_MOVIE", bench_packet_reorder_movie)
+{
+    Parser::initialize();
+
+    const int width = 320, height = 240;
+    for( auto path : ReorderMovies )
+    {
+        for( auto reordering : { false, true } )
+        {
+            std::unique_ptr<RenderContext> context(RenderContext::create(SoftwareRender::create(1), width, height));
+            auto stream = create_from_file(path);
+            std::unique_ptr<Player> player(Player::create(stream));
+            if( context == nullptr || player == nullptr )
+            {
+                printf("failed to load %s\n", path);
+                break;
+            }
+
+            auto& render = context->get_render();
+            auto& shader = context->get_shader();
+            shader.set_reordering(reordering);
+            render.set_viewport(0, 0, width, height);
+
+            const int frames = 60;
+            uint64_t draws = 0;
+            auto ms = measure_ms(frames, [&]()
+            {
+                player->update(1.f / 24.f);
+                shader.set_program(PROGRAM_DEFAULT);
+                player->render(*context);
+                shader.end_frame();
+                render.finish();
+                draws += shader.get_frame_stats().draw_calls;
+            });
+
+            printf("%-24s reordering %d: %8.3f ms/frame, %6.1f draws/frame\n",
+                strrchr(path, '/') + 1, reordering ? 1 : 0, ms, (double)draws / frames);
+        }
+    }
+}
+
+// a grid of small quads alternating textures, the worst case of painter's
+// order which is drawn in one batch per texture with reordering.
+BENCHMARK_CASE("PACKET_REORDER_GRID", bench_packet_reorder_grid)
+{
+    const int width = 320, height = 240;
+    const int columns = 80, rows = 60;
+
+    for( auto reordering : { false, true } )
+    {
+        std::unique_ptr<SoftwareRender> render(SoftwareRender::create(1));
+        std::unique_ptr<Screen> screen(Screen::create(width, height));
+        std::unique_ptr<Shader> shader(Shader::create(*render, *screen));
+
+        const char* textures[] = { "texture0" };
+        const char* uniforms[] = { "transform" };
+        shader->create(PROGRAM_DEFAULT, "", "", 1, textures, 1, uniforms);
+        shader->set_reordering(reordering);
+        render->set_viewport(0, 0, width, height);
+
+        uint8_t texels[2][4] = { { 255, 0, 0, 255 }, { 0, 0, 255, 255 } };
+        Rid palette[2] = {
+            render->create_texture(texels[0], 1, 1, TextureFormat::RGBA8, 0),
+            render->create_texture(texels[1], 1, 1, TextureFormat::RGBA8, 0) };
+
+        VertexPack quad[4] = {
+            VertexPack(0, 0, 0, 0), VertexPack(3, 0, 1, 0),
+            VertexPack(3, 3, 1, 1), VertexPack(0, 3, 0, 1) };
+
+        const int frames = 20;
+        uint64_t draws = 0;
+        Matrix matrix;
+        auto ms = measure_ms(frames, [&]()
+        {
+            render->clear(CLEAR_COLOR, 0, 0, 0, 255);
+            shader->set_program(PROGRAM_DEFAULT);
+            for( auto i=0; i<columns*rows; i++ )
+            {
+                matrix.values[0][2] = (float)(i % columns * 4);
+                matrix.values[1][2] = (float)(i / columns * 4);
+                shader->set_texture(0, palette[i%2]);
+                shader->draw(quad[0], quad[1], quad[2], quad[3], matrix);
+            }
+            shader->end_frame();
+            render->finish();
+            draws += shader->get_frame_stats().draw_calls;
+        });
+
+        printf("%d quads, reordering %d: %8.3f ms/frame, %8.1f draws/frame\n",
+            columns*rows, reordering ? 1 : 0, ms, (double)draws / frames);
+
+        render->release(RenderObject::TEXTURE, palette[0]);
+        render->release(RenderObject::TEXTURE, palette[1]);
+    }
+}
@@ -0,0 +1,178 @@
+#include "openswf_bench.hpp"
+
+#include <algorithm>
+#include <random>
+
+using namespace openswf;
+
+// a checkerboard of two fill styles, every edge between cells is a single
+// path with both left and right fill, just like the output of flash authoring.
+static ShapePathList create_checkerboard(int count, float cell, bool curved)
+{
+    ShapePathList paths;
+    auto fill_of = [=](int x, int y) -> uint32_t
+    {
+        if( x < 0 || y < 0 || x >= count || y >= count ) return 0;
+        return (x + y) % 2 + 1;
+    };
+
+    auto push = [&](int x0, int y0, int x1, int y1, uint32_t left, uint32_t right)
+    {
+        ShapePath path;
+        path.restart(Point2f(x0*cell, y0*cell));
+        path.left_fill = left;
+        path.right_fill = right;
+
+        if( curved )
+        {
+            auto cx = (x0+x1)*cell*0.5f + (y1-y0)*cell*0.25f;
+            auto cy = (y0+y1)*cell*0.5f + (x1-x0)*cell*0.25f;
+            path.edges.push_back(ShapeEdge(x1*cell, y1*cell, cx, cy));
+        }
+        else
+            path.edges.push_back(ShapeEdge(Point2f(x1*cell, y1*cell)));
+
+        paths.push_back(path);
+    };
+
+    for( auto y=0; y<=count; y++ )
+        for( auto x=0; x<count; x++ )
+            push(x, y, x+1, y, fill_of(x, y-1), fill_of(x, y));
+
+    for( auto x=0; x<=count; x++ )
+        for( auto y=0; y<count; y++ )
+            push(x, y, x, y+1, fill_of(x, y), fill_of(x-1, y));
+
+    std::mt19937 random(count);
+    std::shuffle(paths.begin(), paths.end(), random);
+    return paths;
+}
+
+// one polygon whose edges are split into single-edge paths in random order
+static ShapePathList create_ring(int count, float radius)
+{
+    ShapePathList paths;
+    auto point_at = [=](int i)
+    {
+        auto angle = 6.2831853f * (float)(i % count) / (float)count;
+        return Point2f(std::floor(radius*std::cos(angle)), std::floor(radius*std::sin(angle)));
+    };
+
+    for( auto i=0; i<count; i++ )
+    {
+        ShapePath path;
+        path.restart(point_at(i));
+        path.right_fill = 1;
+        path.edges.push_back(ShapeEdge(point_at(i+1)));
+        paths.push_back(path);
+    }
+
+    std::mt19937 random(count);
+    std::shuffle(paths.begin(), paths.end(), random);
+    return paths;
+}
+
+static void run(const char* name, const ShapePathList& paths, uint32_t fill_count)
+{
+    auto edges = 0;
+    for( auto& path : paths ) edges += path.edges.size();
+
+    ShapeRecordPtr record;
+    auto iterations = std::max(1, 200000 / edges);
+    auto ms = measure_ms(iterations, [&]()
+    {
+        record = ShapeRecord::create(Rect(), paths, fill_count);
+    });
+
+    printf("%-28s edges %7d contours %6d anchors %7d: %9.3f ms, %6.1f ns/edge\n",
+        name, edges, (int)record->contours.size(), (int)record->anchors.size(),
+        ms, ms * 1e6 / edges);
+}
+
+BENCHMARK_CASE("CONTOUR_ASSEMBLY", bench_contour_assembly)
+{
+    int sizes[] = { 24, 72, 144 };
+    for( auto size : sizes )
+    {
+        char name[64];
+        snprintf(name, sizeof(name), "checkerboard %dx%d", size, size);
+        run(name, create_checkerboard(size, 20.f, false), 2);
+
+        snprintf(name, sizeof(name), "curved checkerboard %dx%d", size, size);
+        run(name, create_checkerboard(size, 400.f, true), 2);
+    }
+
+    int rings[] = { 1000, 10000, 40000 };
+    for( auto size : rings )
+    {
+        char name[64];
+        snprintf(name, sizeof(name), "ring %d", size);
+        run(name, create_ring(size, 200000.f), 1);
+    }
+}
+
+BENCHMARK_CASE("SHAPE_LEVEL_OF_DETAIL", bench_shape_level_of_detail)
+{
+    auto paths = create_checkerboard(24, 400.f, true);
+    auto record = ShapeRecord::create(Rect(), paths, 2);
+
+    for( auto level = ShapeMinLevel; level <= ShapeMaxLevel; level++ )
+    {
+        ShapeMeshPtr mesh;
+        auto ms = measure_ms(4, [&]()
+        {
+            mesh = ShapeMesh::create(*record, ShapeLineList(), level);
+        });
+
+        printf("level %2d tolerance %7.3f twips: vertices %7d indices %7d memsize %8d, %8.3f ms\n",
+            level, ShapeRecord::get_tolerance(level),
+            (int)mesh->vertices.size(), (int)mesh->indices.size(), (int)mesh->get_memsize(), ms);
+    }
+}
+
+BENCHMARK_CASE("STROKE_GENERATION", bench_stroke_generation)
+{
+    // a random walk with sharp and smooth turns
+    std::mt19937 random(42);
+    std::uniform_real_distribution<float> angle(-2.5f, 2.5f);
+
+    PointList points;
+    Point2f cursor;
+    auto heading = 0.f;
+    for( auto i=0; i<10000; i++ )
+    {
+        heading += angle(random);
+        cursor = cursor + Point2f(std::cos(heading), std::sin(heading)) * 200.f;
+        points.push_back(cursor);
+    }
+
+    const char* names[] = { "round", "bevel", "miter" };
+    Joincode joins[] = { Joincode::ROUND, Joincode::BEVEL, Joincode::MITER };
+    float widths[] = { 20.f, 200.f };
+
+    VertexPackList vertices;
+    IndexList indices;
+    for( auto width : widths )
+    {
+        for( auto i=0; i<3; i++ )
+        {
+            StrokeStyle style;
+            style.width = width;
+            style.join = joins[i];
+
+            auto ms = measure_ms(20, [&]()
+            {
+                vertices.clear();
+                indices.clear();
+
+                // indices of each polyline are relative to its own vertices
+                for( auto j=0; j+100<=points.size(); j+=100 )
+                    Stroker(style, vertices, indices).add_polyline(points.data()+j, 100, false);
+            });
+
+            printf("%s join width %5.0f: vertices %7d indices %7d, %7.3f ms, %6.2f M segments/s\n",
+                names[i], width, (int)vertices.size(), (int)indices.size(),
+                ms, (float)points.size() / ms / 1000.f);
+        }
+    }
+}
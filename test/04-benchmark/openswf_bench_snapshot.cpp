@@ -0,0 +1,60 @@
+#include "openswf_bench.hpp"
+#include "snapshot.hpp"
+
+#include <memory>
+#include <thread>
+#include <atomic>
+
+using namespace openswf;
+
+// thumbnails of test resources are rendered by workers, each of which owns a
+// snapshot and loads its own players.
+BENCHMARK_CASE("SNAPSHOT_THUMBNAILS", bench_snapshot_thumbnails)
+{
+    Parser::initialize();
+
+    const char* movies[] = {
+        "../test/resources/simple-shape-1.swf",
+        "../test/resources/simple-shape-2.swf",
+        "../test/resources/simple-timeline-1.swf",
+        "../test/resources/simple-timeline-2.swf",
+    };
+    const int count = 64;
+    const int movie_count = sizeof(movies) / sizeof(movies[0]);
+
+    int thread_counts[] = { 1, 2, 4, (int)std::thread::hardware_concurrency() };
+    for( auto threads : thread_counts )
+    {
+        if( threads <= 0 ) continue;
+
+        std::atomic<int> next(0), succeeded(0);
+        auto ms = measure_ms(1, [&]()
+        {
+            std::vector<std::thread> workers;
+            for( auto i=0; i<threads; i++ )
+            {
+                workers.push_back(std::thread([&]()
+                {
+                    std::unique_ptr<Snapshot> snapshot(Snapshot::create());
+                    std::vector<uint8_t> png;
+                    for( auto index = next++; index < count; index = next++ )
+                    {
+                        auto stream = create_from_file(movies[index % movie_count]);
+                        std::unique_ptr<Player> player(Player::create(stream));
+                        if( player == nullptr ) continue;
+
+                        auto bitmap = snapshot->render(*player, 2, 160, 120);
+                        if( bitmap != nullptr && Snapshot::encode_png(*bitmap, png) )
+                            succeeded ++;
+                    }
+                }));
+            }
+
+            for( auto& worker : workers )
+                worker.join();
+        });
+
+        printf("thumbnails 160x120 threads %2d: %8.3f ms, %8.1f thumbnails/s (%d of %d)\n",
+            threads, ms, succeeded.load() * 1000.0 / ms, succeeded.load(), count);
+    }
+}
@@ -0,0 +1,61 @@
+#include "openswf_bench.hpp"
+#include "vertex_transform.hpp"
+
+#include <random>
+
+using namespace openswf;
+
+// vertices of a large batch are transformed repeatedly in place, with all
+// kernel levels and the fast paths of common transforms.
+BENCHMARK_CASE("TRANSFORM_VERTICES", bench_transform_vertices)
+{
+    const int size = 1 << 16;
+    std::mt19937 random(5);
+    std::uniform_real_distribution<float> position(-4000.f, 4000.f);
+
+    std::vector<VertexPack> vertices;
+    for( auto i=0; i<size; i++ )
+        vertices.push_back(VertexPack(position(random), position(random), 0, 0));
+
+    Matrix general;
+    general.values[0][0] = 0.999f;
+    general.values[0][1] = 0.01f;
+    general.values[1][0] = -0.01f;
+    general.values[1][1] = 0.999f;
+    general.values[0][2] = 0.5f;
+
+    Matrix translation;
+    translation.values[0][2] = 0.5f;
+
+    ColorTransform cxform;
+    cxform.values[0][0] = 0.99f;
+    cxform.values[1][2] = 1.f;
+
+    struct Case { const char* name; const Matrix* matrix; const ColorTransform* cxform; };
+    Case cases[] = {
+        { "matrix and cxform", &general, &cxform },
+        { "matrix only", &general, &ColorTransform::identity },
+        { "translation only", &translation, &ColorTransform::identity },
+    };
+
+    const char* names[] = { "scalar", "sse2", "avx2" };
+    printf("detected level: %s\n", names[(int)get_simd_level()]);
+
+    for( auto& item : cases )
+    {
+        double scalar_ms = 0;
+        for( auto level : { SimdLevel::SCALAR, SimdLevel::SSE2, SimdLevel::AVX2 } )
+        {
+            if( level > get_simd_level() ) continue;
+
+            auto ms = measure_ms(100, [&]()
+            {
+                transform_vertices(size, vertices.data(), *item.matrix, *item.cxform, level);
+            });
+
+            if( level == SimdLevel::SCALAR ) scalar_ms = ms;
+            printf("%-20s %-6s: %8.3f ms, %8.1f Mvert/s, x%.2f\n",
+                item.name, names[(int)level], ms, size / ms / 1000.0, scalar_ms / ms);
+        }
+    }
+}